@@ -0,0 +1,661 @@
+#!/usr/bin/env python3
+#
+# Usage: ./irc-loadgen.py [-p PORT] [-s SCENARIO | -f FILE] [-t TRACE] [-l MS]
+#
+# A loopback IRC server which generates load for Srain, only Python standard
+# library is required. Start it, then connect Srain to 127.0.0.1:6667:
+#
+#   $ ./script/irc-loadgen.py -s flood &
+#   $ srain irc://127.0.0.1:6667/
+#
+# Only the first client is served, the scenario starts after registration and
+# the server exits when it is finished. A summary is printed to stdout as one
+# JSON object.
+#
+# Scenario is a list of steps, one step per line, lines start with "#" are
+# comments:
+#
+#   channels N M              Join client to N channels with M members each
+#   flood RATE SECS [PROBE]   Send RATE PRIVMSGs per second to joined channels
+#                             for SECS seconds, send a probe every PROBE seconds
+#   netsplit N                N members quit with "*.net *.split"
+#   netjoin N                 N members who quit rejoin their channels
+#   away N                    N members toggle their away state
+#   list N                    Reply a LIST with N channels
+#   names CHAN N              Add N members to CHAN as a single NAMES burst
+#   playback CHAN N           ZNC-style playback of N messages to CHAN
+#   probe N [INTERVAL]        Send N probes, INTERVAL seconds apart
+#   sleep SECS                Do nothing
+#
+# A probe is a CTCP PING whose reply is sent by Srain after the message is
+# handled, the round trip time is reported. With "-t", steps and probes are
+# written as a Chrome trace with CLOCK_MONOTONIC timestamps, it can be merged
+# with the trace dumped by "/trace dump" of a Srain built with -Dtracing=true,
+# to see the latency from socket to message row.
+#
+# With "-l MS", every line from client is handled MS milliseconds after it is
+# received, which simulates a link with MS round trip time. The time from
+# connection to RPL_WELCOME is reported as "registration_ms", so the number of
+# round trips spent in registration is about registration_ms / MS. SASL PLAIN
+# is accepted with any credential.
+#
+
+import argparse
+import asyncio
+import json
+import random
+import sys
+import time
+
+SERVER = 'loadgen.invalid'
+NETWORK = 'LoadGen'
+CAPS = ['account-notify', 'away-notify', 'batch', 'chghost',
+        'draft/chathistory', 'extended-join', 'message-tags', 'multi-prefix',
+        'sasl', 'server-time', 'userhost-in-names']
+HISTORY_DEPTH = 500  # Messages of history available per target
+MONITOR_LIMIT = 100  # Size of monitor list announced in ISUPPORT
+
+SCENARIOS = {
+    'smoke': '''
+        channels 3 20
+        flood 50 5
+        probe 20 0.1
+    ''',
+    'flood': '''
+        channels 20 100
+        probe 20 0.1
+        flood 1000 30 0.5
+        probe 20 0.1
+    ''',
+    'netsplit': '''
+        channels 10 500
+        probe 10 0.1
+        netsplit 2000
+        netjoin 2000
+        probe 10 0.1
+    ''',
+    'list': '''
+        probe 10 0.1
+        list 50000
+        probe 10 0.1
+    ''',
+    'names': '''
+        channels 1 10
+        probe 10 0.1
+        names #load0 20000
+        probe 10 0.1
+    ''',
+    'playback': '''
+        channels 5 50
+        probe 10 0.1
+        playback #load0 5000
+        probe 10 0.1
+    ''',
+    'away': '''
+        channels 10 500
+        probe 10 0.1
+        away 2000
+        away 2000
+        probe 10 0.1
+    ''',
+}
+SCENARIOS['all'] = ''.join(SCENARIOS[k] for k in
+        ['flood', 'netsplit', 'list', 'names', 'playback', 'away'])
+
+WORDS = ('the build is broken again', 'anyone tried the new release?',
+         'lgtm', 'see https://example.org/issues/42', 'ping', 'brb',
+         '\x0304red\x03 and \x02bold\x02', 'Привет всем', 'ok 👍',
+         'a' * 300)
+
+
+def now_us():
+    return time.monotonic_ns() / 1000
+
+
+class Tracer:
+    '''Records spans as Chrome trace events, pid is 2 so it does not
+    collide with Srain's trace.'''
+
+    def __init__(self):
+        self.events = []
+
+    def span(self, name, start, end, **args):
+        self.events.append({'name': name, 'ph': 'X', 'pid': 2, 'tid': 1,
+                            'ts': start, 'dur': end - start, 'args': args})
+
+    def dump(self, path):
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': self.events}, f)
+
+
+class Session:
+    def __init__(self, reader, writer, args):
+        self.reader = reader
+        self.writer = writer
+        self.args = args
+        self.rand = random.Random(args.seed)
+        self.tracer = Tracer()
+
+        self.nick = None
+        self.user = None
+        self.caps = set()
+        self.negotiating = False
+        self.registered = asyncio.Event()
+        self.accepted = time.monotonic()
+        self.registration = None
+
+        self.channels = {}      # Channel name -> list of member nicks
+        self.split = {}         # Nick of split member -> list of channels
+        self.away = set()       # Nicks of away members
+        self.nick_seq = 0
+        self.batch_seq = 0
+        self.history = {}  # target -> (served, cursor)
+        self.monitor = set()    # Nicks in monitor list
+
+        self.probe_seq = 0
+        self.probes = {}        # Probe token -> send time in us
+        self.rtts = []          # Round trip time of probes in ms
+
+        self.lines = 0
+        self.bytes = 0
+
+    # Sending
+
+    def send(self, line, tags=None):
+        if tags:
+            line = '@' + ';'.join('%s=%s' % kv for kv in tags.items()) \
+                + ' ' + line
+        data = (line + '\r\n').encode('utf-8', 'replace')
+        self.writer.write(data)
+        self.lines += 1
+        self.bytes += len(data)
+
+    def numeric(self, num, *params):
+        self.send(':%s %03d %s %s' % (SERVER, num, self.nick, ' '.join(params)))
+
+    def time_tag(self, ts):
+        if 'server-time' not in self.caps:
+            return None
+        return {'time': time.strftime('%Y-%m-%dT%H:%M:%S', time.gmtime(ts))
+                + '.%03dZ' % (int(ts * 1000) % 1000)}
+
+    async def flush(self):
+        await self.writer.drain()
+
+    def new_nick(self):
+        self.nick_seq += 1
+        return 'u%05d' % self.nick_seq
+
+    def mask(self, nick):
+        return '%s!~%s@%s.example.net' % (nick, nick, nick)
+
+    # Receiving
+
+    async def serve(self):
+        reader_task = asyncio.ensure_future(self.read_loop())
+        try:
+            await asyncio.wait_for(self.registered.wait(), 30)
+        except asyncio.TimeoutError:
+            print('Client did not register', file=sys.stderr)
+            reader_task.cancel()
+            return None
+
+        start = time.monotonic()
+        for step in parse_scenario(self.args.scenario_text):
+            await self.run_step(step)
+            await self.flush()
+        elapsed = time.monotonic() - start
+
+        # Wait for replies of in-flight probes
+        for _ in range(50):
+            if not self.probes:
+                break
+            await asyncio.sleep(0.1)
+
+        self.send('ERROR :Closing Link: scenario finished')
+        await self.flush()
+        self.writer.close()
+        reader_task.cancel()
+
+        if self.args.trace:
+            self.tracer.dump(self.args.trace)
+
+        return self.summary(elapsed)
+
+    async def read_loop(self):
+        loop = asyncio.get_running_loop()
+        latency = self.args.latency / 1000
+        pending = asyncio.Queue()
+        delayer = asyncio.ensure_future(self.delay_loop(pending))
+        try:
+            while True:
+                line = await self.reader.readline()
+                if not line:
+                    break
+                line = line.decode('utf-8', 'replace').rstrip('\r\n')
+                if latency:
+                    pending.put_nowait((loop.time() + latency, line))
+                else:
+                    self.handle(line)
+        finally:
+            delayer.cancel()
+
+    async def delay_loop(self, pending):
+        loop = asyncio.get_running_loop()
+        while True:
+            due, line = await pending.get()
+            delay = due - loop.time()
+            if delay > 0:
+                await asyncio.sleep(delay)
+            self.handle(line)
+
+    def handle(self, line):
+        if line.startswith('@'):
+            line = line.split(' ', 1)[1] if ' ' in line else ''
+        if ' :' in line:
+            head, trailing = line.split(' :', 1)
+            params = head.split() + [trailing]
+        else:
+            params = line.split()
+        if not params:
+            return
+        cmd = params.pop(0).upper()
+
+        if cmd == 'CAP':
+            self.handle_cap(params)
+        elif cmd == 'NICK' and params:
+            if self.nick and self.registered.is_set():
+                self.send(':%s NICK %s' % (self.mask(self.nick), params[0]))
+            self.nick = params[0]
+        elif cmd == 'USER':
+            self.user = params[0] if params else self.nick
+        elif cmd == 'PING':
+            self.send(':%s PONG %s :%s' % (SERVER, SERVER,
+                                           params[-1] if params else ''))
+        elif cmd == 'JOIN' and params:
+            for chan in params[0].split(','):
+                self.join(chan, self.channels.get(chan, []))
+        elif cmd == 'PART' and params:
+            for chan in params[0].split(','):
+                self.send(':%s PART %s' % (self.mask(self.nick), chan))
+                self.channels.pop(chan, None)
+        elif cmd == 'NOTICE' and len(params) == 2:
+            self.handle_probe_reply(params[1])
+        elif cmd == 'AUTHENTICATE' and params:
+            self.handle_authenticate(params[0])
+        elif cmd == 'CHATHISTORY' and len(params) == 4:
+            self.handle_chathistory(*params)
+        elif cmd == 'MONITOR' and params:
+            self.handle_monitor(params[0], params[1] if len(params) > 1 else '')
+
+        if not self.registered.is_set() and self.nick and self.user \
+                and not self.negotiating:
+            self.welcome()
+
+    def handle_cap(self, params):
+        # Client sends "CAP <subcommand> [:<params>]", there is no target
+        sub = params[0].upper() if params else ''
+        if sub == 'LS':
+            self.negotiating = True
+            self.send(':%s CAP * LS :%s' % (SERVER, ' '.join(CAPS)))
+        elif sub == 'REQ':
+            req = params[1].split() if len(params) > 1 else []
+            if all(cap.lstrip('-') in CAPS for cap in req):
+                for cap in req:
+                    if cap.startswith('-'):
+                        self.caps.discard(cap[1:])
+                    else:
+                        self.caps.add(cap)
+                self.send(':%s CAP %s ACK :%s' % (SERVER, self.nick or '*',
+                                                  ' '.join(req)))
+            else:
+                self.send(':%s CAP %s NAK :%s' % (SERVER, self.nick or '*',
+                                                  ' '.join(req)))
+        elif sub == 'LIST':
+            self.send(':%s CAP %s LIST :%s' % (SERVER, self.nick or '*',
+                                              ' '.join(sorted(self.caps))))
+        elif sub == 'END':
+            self.negotiating = False
+
+    def handle_authenticate(self, param):
+        if param == '*':
+            self.numeric(906, ':SASL authentication aborted')
+        elif param.upper() == 'PLAIN':
+            self.send('AUTHENTICATE +')
+        elif 'sasl' not in self.caps:
+            self.numeric(904, ':SASL authentication failed')
+        else:
+            self.numeric(900, self.mask(self.nick), self.nick,
+                         ':You are now logged in as %s' % self.nick)
+            self.numeric(903, ':SASL authentication successful')
+
+    def handle_chathistory(self, sub, target, ref, limit):
+        # History is generated backwards from the time of the first request,
+        # one message per second, until HISTORY_DEPTH messages are served
+        served, cursor = self.history.get(target, (0, time.time()))
+        n = max(0, min(int(limit), HISTORY_DEPTH - served))
+        self.history[target] = (served + n, cursor - n)
+        batch = self.begin_batch('chathistory', target)
+        for i in range(n):
+            seq = served + n - i
+            tags = self.time_tag(cursor - n + i) or {}
+            tags.update(batch or {})
+            tags['msgid'] = '%s-h%d' % (target.lstrip('#'), seq)
+            nick = self.rand.choice(self.channels.get(target) or ['znc'])
+            self.send(':%s PRIVMSG %s :%s' % (self.mask(nick), target,
+                                             self.rand.choice(WORDS)), tags)
+        self.end_batch(batch)
+
+    def handle_monitor(self, op, targets):
+        # Members of any channel are online, other nicks are offline
+        nicks = [nick for nick in targets.split(',') if nick]
+        if op == '-':
+            self.monitor.difference_update(nicks)
+        elif op == '+':
+            members = {nick for nicks in self.channels.values()
+                       for nick in nicks}
+            room = MONITOR_LIMIT - len(self.monitor)
+            if len(nicks) > room:
+                self.numeric(734, str(MONITOR_LIMIT), ','.join(nicks[room:]),
+                             ':Monitor list is full')
+                nicks = nicks[:room]
+            self.monitor.update(nicks)
+            online = [self.mask(nick) for nick in nicks if nick in members]
+            offline = [nick for nick in nicks if nick not in members]
+            if online:
+                self.numeric(730, ':' + ','.join(online))
+            if offline:
+                self.numeric(731, ':' + ','.join(offline))
+        elif op == 'C':
+            self.monitor.clear()
+
+    def handle_probe_reply(self, text):
+        if not (text.startswith('\x01PING ') and text.endswith('\x01')):
+            return
+        token = text[6:-1]
+        start = self.probes.pop(token, None)
+        if start is None:
+            return
+        end = now_us()
+        self.rtts.append((end - start) / 1000)
+        self.tracer.span('probe', start, end, token=token)
+
+    def welcome(self):
+        self.numeric(1, ':Welcome to the %s IRC Network %s' % (NETWORK, self.nick))
+        self.numeric(2, ':Your host is %s, running version irc-loadgen' % SERVER)
+        self.numeric(5, 'CHANTYPES=# PREFIX=(ov)@+ NETWORK=%s' % NETWORK,
+                     'CASEMAPPING=ascii MONITOR=%d' % MONITOR_LIMIT,
+                     ':are supported by this server')
+        self.numeric(376, ':End of /MOTD command.')
+        self.registration = time.monotonic() - self.accepted
+        self.registered.set()
+
+    # Steps
+
+    async def run_step(self, step):
+        name, args = step[0], step[1:]
+        func = getattr(self, 'step_' + name, None)
+        if not func:
+            raise ValueError('Unknown step: %s' % name)
+        start = now_us()
+        await func(*args)
+        self.tracer.span(name, start, now_us(), step=' '.join(step))
+
+    async def step_channels(self, n, m):
+        pool = [self.new_nick() for _ in range(int(m) * 2)]
+        for i in range(int(n)):
+            chan = '#load%d' % len(self.channels)
+            self.channels[chan] = self.rand.sample(pool, int(m))
+            self.join(chan, self.channels[chan])
+            await self.flush()
+
+    async def step_flood(self, rate, secs, probe_interval=None):
+        rate = float(rate)
+        secs = float(secs)
+        chans = list(self.channels)
+        if not chans:
+            raise ValueError('flood requires channels')
+        sent = 0
+        start = time.monotonic()
+        next_probe = start
+        while True:
+            elapsed = time.monotonic() - start
+            if elapsed >= secs:
+                break
+            for _ in range(int(rate * elapsed) - sent):
+                chan = self.rand.choice(chans)
+                nick = self.rand.choice(self.channels[chan])
+                text = self.rand.choice(WORDS)
+                if self.rand.random() < 0.05:
+                    text = '%s: %s' % (self.nick, text)
+                self.send(':%s PRIVMSG %s :%s' % (self.mask(nick), chan, text),
+                          self.time_tag(time.time()))
+                sent += 1
+            if probe_interval and time.monotonic() >= next_probe:
+                self.probe()
+                next_probe += float(probe_interval)
+            await self.flush()
+            await asyncio.sleep(0.01)
+
+    def begin_batch(self, type_, *params):
+        """Open a batch if the client supports it, returns its tags."""
+        if 'batch' not in self.caps:
+            return None
+        self.batch_seq += 1
+        ref = 'b%d' % self.batch_seq
+        self.send(':%s BATCH +%s %s' % (SERVER, ref, ' '.join((type_,) + params)))
+        return {'batch': ref}
+
+    def end_batch(self, tags):
+        if tags:
+            self.send(':%s BATCH -%s' % (SERVER, tags['batch']))
+
+    async def step_netsplit(self, n):
+        members = sorted({nick for nicks in self.channels.values()
+                          for nick in nicks})
+        tags = self.begin_batch('netsplit', SERVER, 'split.example.net')
+        for nick in self.rand.sample(members, min(int(n), len(members))):
+            chans = [chan for chan, nicks in self.channels.items()
+                     if nick in nicks]
+            for chan in chans:
+                self.channels[chan].remove(nick)
+            self.split[nick] = chans
+            self.send(':%s QUIT :%s split.example.net' % (self.mask(nick), SERVER),
+                      tags)
+        self.end_batch(tags)
+        await self.flush()
+
+    async def step_netjoin(self, n):
+        tags = self.begin_batch('netjoin', SERVER, 'split.example.net')
+        for nick in list(self.split)[:int(n)]:
+            for chan in self.split.pop(nick):
+                if chan in self.channels:
+                    self.channels[chan].append(nick)
+                    self.send(':%s %s' % (self.mask(nick),
+                                          self.join_params(nick, chan)), tags)
+        self.end_batch(tags)
+        await self.flush()
+
+    async def step_away(self, n):
+        if 'away-notify' not in self.caps:
+            return
+        members = sorted({nick for nicks in self.channels.values()
+                          for nick in nicks})
+        nicks = self.rand.sample(members, min(int(n), len(members)))
+        for i, nick in enumerate(nicks):
+            if nick in self.away:
+                self.away.discard(nick)
+                self.send(':%s AWAY' % self.mask(nick))
+            else:
+                self.away.add(nick)
+                self.send(':%s AWAY :%s' % (self.mask(nick),
+                                            self.rand.choice(WORDS)))
+            if i % 1000 == 0:
+                await self.flush()
+
+    async def step_list(self, n):
+        self.numeric(321, 'Channel :Users  Name')
+        for i in range(int(n)):
+            self.numeric(322, '#list%d %d :%s' % (
+                i, self.rand.randint(1, 5000), self.rand.choice(WORDS)))
+            if i % 1000 == 0:
+                await self.flush()
+        self.numeric(323, ':End of /LIST')
+
+    async def step_names(self, chan, n):
+        nicks = self.channels.setdefault(chan, [])
+        nicks.extend(self.new_nick() for _ in range(int(n)))
+        self.names(chan, nicks)
+
+    async def step_playback(self, chan, n):
+        n = int(n)
+        batch = self.begin_batch('znc.in/playback', chan)
+        base = time.time() - n
+        for i in range(n):
+            nick = self.rand.choice(self.channels.get(chan) or ['znc'])
+            tags = self.time_tag(base + i) or {}
+            tags.update(batch or {})
+            self.send(':%s PRIVMSG %s :%s' % (self.mask(nick), chan,
+                                             self.rand.choice(WORDS)), tags)
+            if i % 1000 == 0:
+                await self.flush()
+        self.end_batch(batch)
+
+    async def step_probe(self, n, interval='0.1'):
+        for _ in range(int(n)):
+            self.probe()
+            await self.flush()
+            await asyncio.sleep(float(interval))
+
+    async def step_sleep(self, secs):
+        await asyncio.sleep(float(secs))
+
+    # Helpers
+
+    def join_params(self, nick, chan):
+        if 'extended-join' in self.caps:
+            return 'JOIN %s %s :%s' % (chan, nick, nick.upper())
+        return 'JOIN %s' % chan
+
+    def join(self, chan, members):
+        self.send(':%s %s' % (self.mask(self.nick),
+                              self.join_params(self.nick, chan)))
+        self.numeric(332, chan, ':Load test channel %s' % chan)
+        self.names(chan, members)
+
+    def names(self, chan, members):
+        prefixes = ['@', '+'] + [''] * 8
+        if 'multi-prefix' in self.caps:
+            prefixes.append('@+')
+        line = []
+        size = 0
+        for nick in [self.nick] + members:
+            if 'userhost-in-names' in self.caps:
+                nick = self.mask(nick)
+            nick = self.rand.choice(prefixes) + nick
+            if size + len(nick) > 400:
+                self.numeric(353, '=', chan, ':' + ' '.join(line))
+                line = []
+                size = 0
+            line.append(nick)
+            size += len(nick) + 1
+        if line:
+            self.numeric(353, '=', chan, ':' + ' '.join(line))
+        self.numeric(366, chan, ':End of /NAMES list.')
+
+    def probe(self):
+        self.probe_seq += 1
+        token = str(self.probe_seq)
+        self.probes[token] = now_us()
+        self.send(':probe!probe@%s PRIVMSG %s :\x01PING %s\x01' % (
+            SERVER, self.nick, token))
+
+    def summary(self, elapsed):
+        rtts = sorted(self.rtts)
+
+        def percentile(p):
+            if not rtts:
+                return None
+            return round(rtts[min(len(rtts) - 1, int(len(rtts) * p))], 3)
+
+        return {
+            'scenario': self.args.scenario_name,
+            'latency_ms': self.args.latency,
+            'registration_ms': round(self.registration * 1000, 3),
+            'seconds': round(elapsed, 3),
+            'lines': self.lines,
+            'bytes': self.bytes,
+            'lines_per_sec': round(self.lines / elapsed, 1) if elapsed else None,
+            'probes': self.probe_seq,
+            'probes_lost': self.probe_seq - len(rtts),
+            'rtt_ms': {
+                'p50': percentile(0.5),
+                'p90': percentile(0.9),
+                'p99': percentile(0.99),
+                'max': round(rtts[-1], 3) if rtts else None,
+            },
+        }
+
+
+def parse_scenario(text):
+    steps = []
+    for line in text.splitlines():
+        line = line.strip()
+        if line and not line.startswith('#'):
+            steps.append(line.split())
+    return steps
+
+
+async def main(args):
+    busy = False
+    done = asyncio.get_running_loop().create_future()
+
+    async def on_client(reader, writer):
+        nonlocal busy
+        if busy:
+            writer.close()
+            return
+        busy = True
+        try:
+            done.set_result(await Session(reader, writer, args).serve())
+        except Exception as e:
+            done.set_exception(e)
+
+    server = await asyncio.start_server(on_client, args.host, args.port)
+    print('Listening on %s:%d' % (args.host, args.port), file=sys.stderr)
+    try:
+        result = await done
+    finally:
+        server.close()
+    if result:
+        print(json.dumps(result))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Loopback IRC traffic generator for load testing Srain')
+    parser.add_argument('-H', '--host', default='127.0.0.1')
+    parser.add_argument('-p', '--port', type=int, default=6667)
+    parser.add_argument('-s', '--scenario', default='smoke',
+                        choices=sorted(SCENARIOS),
+                        help='Built-in scenario (default: smoke)')
+    parser.add_argument('-f', '--file', help='Read scenario from file')
+    parser.add_argument('-t', '--trace', help='Write Chrome trace to file')
+    parser.add_argument('-l', '--latency', type=float, default=0,
+                        help='Delay every line from client by MS milliseconds')
+    parser.add_argument('--seed', type=int, default=0,
+                        help='Random seed, same seed generates same traffic')
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file) as f:
+            args.scenario_text = f.read()
+        args.scenario_name = args.file
+    else:
+        args.scenario_text = SCENARIOS[args.scenario]
+        args.scenario_name = args.scenario
+
+    try:
+        asyncio.run(main(args))
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,398 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench.c
+ * @brief Micro-benchmark harness
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * Like Go's testing.B, a benchmark function is called with increasing
+ * SrnBench->n until it runs long enough. Result of the last round is printed
+ * to stdout as one JSON object per line:
+ *
+ *      {"name":"sirc/parse","ops":N,"ns_per_op":X,"allocs_per_op":Y}
+ *
+ * Allocations are counted by wrapping malloc(3) family, including the
+ * aligned ones, which is only supported on glibc, "allocs_per_op" is null
+ * elsewhere. GLib uses system allocator since 2.46 so g_malloc() and friends
+ * are counted too.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "meta.h"
+#include "sirc_parse.h"
+#include "histogram.h"
+#include "bench.h"
+
+#define DEFAULT_BENCH_TIME_MS   500
+#define MAX_BENCH_N             1000000000
+
+#ifdef __GLIBC__
+
+#include <malloc.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static guint64 alloc_count;
+static gint64 heap_bytes; // Usable size of live allocations
+
+void *malloc(size_t size){
+    void *ptr;
+
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    ptr = __libc_malloc(size);
+    __atomic_fetch_add(&heap_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size){
+    void *ptr;
+
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    ptr = __libc_calloc(nmemb, size);
+    __atomic_fetch_add(&heap_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size){
+    void *new_ptr;
+    size_t old_size;
+
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    old_size = malloc_usable_size(ptr);
+    new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr || size == 0){
+        __atomic_fetch_sub(&heap_bytes, old_size, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&heap_bytes, malloc_usable_size(new_ptr),
+            __ATOMIC_RELAXED);
+    return new_ptr;
+}
+
+// Used by g_aligned_alloc() since GLib 2.72
+void *memalign(size_t alignment, size_t size){
+    void *ptr;
+
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    ptr = __libc_memalign(alignment, size);
+    __atomic_fetch_add(&heap_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size){
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size){
+    void *ptr;
+
+    if (alignment % sizeof(void *) != 0
+            || (alignment & (alignment - 1)) != 0){
+        return EINVAL;
+    }
+    ptr = memalign(alignment, size);
+    if (!ptr){
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr){
+    __atomic_fetch_sub(&heap_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+static guint64 get_alloc_count(void){
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief srn_bench_get_heap_bytes returns bytes of live heap allocations,
+ * including padding of allocator.
+ *
+ * @return -1 if not supported
+ */
+gint64 srn_bench_get_heap_bytes(void){
+    return __atomic_load_n(&heap_bytes, __ATOMIC_RELAXED);
+}
+
+#define HAVE_ALLOC_COUNT 1
+
+#else
+
+static guint64 get_alloc_count(void){
+    return 0;
+}
+
+gint64 srn_bench_get_heap_bytes(void){
+    return -1;
+}
+
+#endif
+
+static guint64 get_bench_time(void);
+static void sample_free(SrnBenchSample *sample);
+static void remove_dir(const char *path);
+
+void srn_bench_run(const char *name, SrnBenchFunc *func, gpointer user_data){
+    guint64 target;
+    SrnBench bench = { 0 };
+
+    if (!srn_bench_is_selected(name)){
+        return;
+    }
+
+    target = get_bench_time();
+    bench.n = 1;
+    for (;;){
+        guint64 next;
+
+        bench.elapsed = 0;
+        bench.allocs = 0;
+        srn_bench_resume(&bench);
+        func(&bench, user_data);
+        srn_bench_pause(&bench);
+
+        if (bench.elapsed >= target || bench.n >= MAX_BENCH_N){
+            break;
+        }
+
+        // Predict ops needed, grow 20% more and at most 100x per round
+        next = bench.elapsed
+            ? bench.n * target / bench.elapsed * 6 / 5
+            : bench.n * 100;
+        next = MIN(next, bench.n * 100);
+        next = MAX(next, bench.n + 1);
+        bench.n = MIN(next, MAX_BENCH_N);
+    }
+
+    printf("{\"name\":\"%s\",\"ops\":%" G_GUINT64_FORMAT ",\"ns_per_op\":%.1f,",
+            name, bench.n, (double)bench.elapsed / bench.n);
+#ifdef HAVE_ALLOC_COUNT
+    printf("\"allocs_per_op\":%.2f}\n", (double)bench.allocs / bench.n);
+#else
+    printf("\"allocs_per_op\":null}\n");
+#endif
+    fflush(stdout);
+}
+
+void srn_bench_pause(SrnBench *bench){
+    g_return_if_fail(bench->running);
+
+    bench->elapsed += srn_get_monotonic_ns() - bench->start;
+    bench->allocs += get_alloc_count() - bench->alloc_start;
+    bench->running = FALSE;
+}
+
+void srn_bench_resume(SrnBench *bench){
+    g_return_if_fail(!bench->running);
+
+    bench->running = TRUE;
+    bench->alloc_start = get_alloc_count();
+    bench->start = srn_get_monotonic_ns();
+}
+
+/**
+ * @brief srn_bench_load_corpus loads lines from file, empty lines and lines
+ * start with "#" are ignored.
+ *
+ * @param path
+ *
+ * @return A GPtrArray of string, NULL if failed
+ */
+GPtrArray* srn_bench_load_corpus(const char *path){
+    char *content;
+    char **lines;
+    GError *err;
+    GPtrArray *corpus;
+
+    err = NULL;
+    if (!g_file_get_contents(path, &content, NULL, &err)){
+        g_printerr("Failed to load corpus: %s\n", err->message);
+        g_error_free(err);
+        return NULL;
+    }
+
+    corpus = g_ptr_array_new_with_free_func(g_free);
+    lines = g_strsplit(content, "\n", -1);
+    for (int i = 0; lines[i]; i++){
+        g_strchomp(lines[i]);
+        if (*lines[i] == '\0' || *lines[i] == '#'){
+            continue;
+        }
+        g_ptr_array_add(corpus, g_strdup(lines[i]));
+    }
+    g_strfreev(lines);
+    g_free(content);
+
+    return corpus;
+}
+
+/**
+ * @brief srn_bench_load_samples extracts sender and content of PRIVMSGs
+ * which are not CTCP messages.
+ *
+ * @param corpus
+ *
+ * @return A GPtrArray of SrnBenchSample
+ */
+GPtrArray* srn_bench_load_samples(GPtrArray *corpus){
+    GPtrArray *samples;
+
+    samples = g_ptr_array_new_with_free_func((GDestroyNotify)sample_free);
+    for (guint i = 0; i < corpus->len; i++){
+        char *line;
+        SircMessage *imsg;
+        SrnBenchSample *sample;
+
+        line = g_strdup(corpus->pdata[i]);
+        imsg = sirc_parse(line, NULL);
+        g_free(line);
+        if (!imsg){
+            continue;
+        }
+        if (imsg->nick
+                && g_ascii_strcasecmp(imsg->cmd, "PRIVMSG") == 0
+                && imsg->nparam == 2
+                && imsg->params[1][0] != '\x01'){
+            sample = g_malloc0(sizeof(SrnBenchSample));
+            sample->nick = g_strdup(imsg->nick);
+            sample->content = g_strdup(imsg->params[1]);
+            g_ptr_array_add(samples, sample);
+        }
+        sirc_message_free(imsg);
+    }
+
+    return samples;
+}
+
+/**
+ * @brief srn_bench_new_home redirects user configuration, data and cache
+ * directories to a new temporary directory, so user's files are neither read
+ * nor modified. It must be called before any g_get_user_*_dir().
+ *
+ * @param cfg Content of user configuration file, can be NULL
+ *
+ * @return Path of the directory, should be removed by srn_bench_remove_home()
+ */
+char* srn_bench_new_home(const char *cfg){
+    char *path;
+    char *cfg_path;
+    GError *err;
+
+    err = NULL;
+    path = g_dir_make_tmp("srain-bench-XXXXXX", &err);
+    if (!path){
+        g_printerr("Failed to create temporary directory: %s\n", err->message);
+        g_error_free(err);
+        return NULL;
+    }
+    g_setenv("XDG_CONFIG_HOME", path, TRUE);
+    g_setenv("XDG_DATA_HOME", path, TRUE);
+    g_setenv("XDG_CACHE_HOME", path, TRUE);
+
+    if (cfg){
+        cfg_path = g_build_filename(path, PACKAGE, NULL);
+        g_mkdir(cfg_path, 0700);
+        g_free(cfg_path);
+        cfg_path = g_build_filename(path, PACKAGE, "srain.cfg", NULL);
+        g_file_set_contents(cfg_path, cfg, -1, NULL);
+        g_free(cfg_path);
+    }
+
+    return path;
+}
+
+void srn_bench_remove_home(char *path){
+    if (!path){
+        return;
+    }
+    remove_dir(path);
+    g_free(path);
+}
+
+static guint64 get_bench_time(void){
+    const char *env;
+    guint64 ms;
+
+    ms = DEFAULT_BENCH_TIME_MS;
+    env = g_getenv("SRN_BENCH_TIME_MS");
+    if (env){
+        ms = g_ascii_strtoull(env, NULL, 10);
+        if (!ms){
+            ms = DEFAULT_BENCH_TIME_MS;
+        }
+    }
+
+    return ms * 1000 * 1000;
+}
+
+/**
+ * @brief srn_bench_is_selected checks whether a benchmark is selected by
+ * environment variable SRN_BENCH_FILTER, which is a substring of benchmark
+ * names.
+ */
+bool srn_bench_is_selected(const char *name){
+    const char *filter;
+
+    filter = g_getenv("SRN_BENCH_FILTER");
+
+    return !filter || strstr(name, filter);
+}
+
+static void sample_free(SrnBenchSample *sample){
+    g_free(sample->nick);
+    g_free(sample->content);
+    g_free(sample);
+}
+
+static void remove_dir(const char *path){
+    const char *name;
+    GDir *dir;
+
+    dir = g_dir_open(path, 0, NULL);
+    if (dir){
+        while ((name = g_dir_read_name(dir))){
+            char *child;
+
+            child = g_build_filename(path, name, NULL);
+            if (g_file_test(child, G_FILE_TEST_IS_DIR)
+                    && !g_file_test(child, G_FILE_TEST_IS_SYMLINK)){
+                remove_dir(child);
+            } else {
+                g_unlink(child);
+            }
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    g_rmdir(path);
+}
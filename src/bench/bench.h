@@ -0,0 +1,95 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <glib.h>
+
+#include "srain.h"
+#include "core/core.h"
+
+/* Number of ops prepared at once when setup should not be timed */
+#define SRN_BENCH_CHUNK 256
+
+typedef struct _SrnBench SrnBench;
+typedef struct _SrnBenchFixture SrnBenchFixture;
+typedef struct _SrnBenchSample SrnBenchSample;
+typedef void (SrnBenchFunc) (SrnBench *bench, gpointer user_data);
+
+/**
+ * @brief SrnBench is passed to a SrnBenchFunc, which should do the measured
+ * operation SrnBench->n times. Untimed setup can be excluded by
+ * srn_bench_pause() and srn_bench_resume().
+ */
+struct _SrnBench {
+    guint64 n;
+
+    /*< private >*/
+    bool running;
+    guint64 start;      // Time when the timer is resumed, in ns
+    guint64 elapsed;    // Timed duration, in ns
+    guint64 alloc_start;
+    guint64 allocs;     // Allocations during timed duration
+};
+
+/**
+ * @brief SrnBenchFixture is a minimal application, server and channel without
+ * UI, which is enough for running render and filter modules.
+ */
+struct _SrnBenchFixture {
+    SrnApplication *app;
+    SrnServer *srv;
+    SrnChat *chat;
+    GHashTable *user_table; // Nick -> SrnChatUser
+    SircMessageContext *context;
+};
+
+/**
+ * @brief SrnBenchSample is a message extracted from PRIVMSGs of corpus.
+ */
+struct _SrnBenchSample {
+    char *nick;
+    char *content;
+};
+
+void srn_bench_run(const char *name, SrnBenchFunc *func, gpointer user_data);
+void srn_bench_pause(SrnBench *bench);
+void srn_bench_resume(SrnBench *bench);
+bool srn_bench_is_selected(const char *name);
+gint64 srn_bench_get_heap_bytes(void);
+
+GPtrArray* srn_bench_load_corpus(const char *path);
+GPtrArray* srn_bench_load_samples(GPtrArray *corpus);
+
+char* srn_bench_new_home(const char *cfg);
+void srn_bench_remove_home(char *path);
+
+SrnBenchFixture* srn_bench_fixture_new(void);
+void srn_bench_fixture_free(SrnBenchFixture *self);
+SrnMessage* srn_bench_fixture_new_message(SrnBenchFixture *self,
+        const SrnBenchSample *sample);
+
+void srn_bench_sirc(GPtrArray *corpus);
+void srn_bench_render(GPtrArray *corpus);
+void srn_bench_filter(GPtrArray *corpus);
+void srn_bench_command(GPtrArray *corpus);
+void srn_bench_message(GPtrArray *corpus);
+void srn_bench_user(GPtrArray *corpus);
+
+#endif /* __BENCH_H */
@@ -0,0 +1,79 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench_command.c
+ * @brief Benchmarks of command parsing
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * An op is one line of command corpus. Commands are parsed against the real
+ * bindings of chat_command.h, but callbacks are replaced by a no-op one.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "command.h"
+#include "chat_command.h"
+#include "bench.h"
+
+typedef struct {
+    GPtrArray *corpus;
+    SrnCommandContext *ctx;
+} CommandBench;
+
+static void bench_proc(SrnBench *bench, gpointer user_data);
+static SrnRet on_command(SrnCommand *cmd, void *user_data);
+
+void srn_bench_command(GPtrArray *corpus){
+    int n;
+    CommandBench cb = { 0 };
+    SrnCommandBinding *bindings;
+
+    for (n = 0; cmd_bindings[n].name; n++);
+    bindings = g_malloc(sizeof(cmd_bindings[0]) * (n + 1));
+    memcpy(bindings, cmd_bindings, sizeof(cmd_bindings[0]) * (n + 1));
+    for (int i = 0; i < n; i++){
+        bindings[i].cb = on_command;
+    }
+
+    cb.corpus = corpus;
+    cb.ctx = srn_command_context_new();
+    srn_command_context_bind(cb.ctx, bindings);
+
+    srn_bench_run("command/proc", bench_proc, &cb);
+
+    srn_command_context_free(cb.ctx);
+    g_free(bindings);
+}
+
+static void bench_proc(SrnBench *bench, gpointer user_data){
+    CommandBench *cb;
+
+    cb = user_data;
+    for (guint64 i = 0; i < bench->n; i++){
+        srn_command_context_proc(cb->ctx,
+                cb->corpus->pdata[i % cb->corpus->len], NULL);
+    }
+}
+
+static SrnRet on_command(SrnCommand *cmd, void *user_data){
+    return SRN_OK;
+}
@@ -0,0 +1,146 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench_message.c
+ * @brief Memory benchmark of SrnMessage
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-23
+ *
+ * Unlike other suites, it keeps a large number of messages alive as a long
+ * scrollback does, and reports heap bytes used by each message (without UI):
+ *
+ *      {"name":"message/memory","messages":N,"bytes_per_message":X,
+ *       "content_bytes_per_message":Y}
+ *
+ * "content_bytes_per_message" is the average length of raw content, which
+ * is the lower bound. "message/memory/msgid" gives every message a msgid
+ * tag as a server with IRCv3 "message-tags" does. Environment variable
+ * ``SRN_BENCH_MESSAGES`` sets number of messages, defaults to 1000000.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "core/core.h"
+#include "render/render.h"
+#include "sirc_parse.h"
+#include "bench.h"
+
+#define DEFAULT_MESSAGES    1000000
+#define BENCH_MSGID         "01J8ZK6W3QF5T1X9M2R7B4C0DE" // ULID, as soju uses
+
+#define RENDER_FLAGS_ALL (SRN_RENDER_FLAG_PATTERN \
+        | SRN_RENDER_FLAG_MIRC_COLORIZE \
+        | SRN_RENDER_FLAG_URL \
+        | SRN_RENDER_FLAG_MENTION)
+
+static void bench_memory(const char *name, SrnBenchFixture *fixture,
+        GPtrArray *samples, guint64 count, bool render);
+static guint64 get_message_count(void);
+
+void srn_bench_message(GPtrArray *corpus){
+    guint64 count;
+    GPtrArray *samples;
+    SrnBenchFixture *fixture;
+    SircMessageContext *context;
+
+    if (srn_bench_get_heap_bytes() < 0){
+        g_printerr("Heap statistics is not supported on this platform\n");
+        return;
+    }
+
+    fixture = srn_bench_fixture_new();
+    samples = srn_bench_load_samples(corpus);
+    g_return_if_fail(samples->len);
+
+    // Create all users first, they are not counted
+    for (guint i = 0; i < samples->len; i++){
+        srn_message_free(srn_bench_fixture_new_message(fixture,
+                    samples->pdata[i]));
+    }
+
+    count = get_message_count();
+    bench_memory("message/memory", fixture, samples, count, FALSE);
+    bench_memory("message/memory/rendered", fixture, samples, count, TRUE);
+
+    context = fixture->context;
+    fixture->context = sirc_message_context_new_with_tags(NULL, BENCH_MSGID);
+    bench_memory("message/memory/msgid", fixture, samples, count, FALSE);
+    sirc_message_context_free(fixture->context);
+    fixture->context = context;
+
+    g_ptr_array_free(samples, TRUE);
+    srn_bench_fixture_free(fixture);
+}
+
+static void bench_memory(const char *name, SrnBenchFixture *fixture,
+        GPtrArray *samples, guint64 count, bool render){
+    gint64 before;
+    gint64 after;
+    guint64 content_bytes;
+    SrnMessage **msgs;
+
+    if (!srn_bench_is_selected(name)){
+        return;
+    }
+
+    // Allocated before measuring
+    msgs = g_malloc_n(count, sizeof(SrnMessage *));
+    content_bytes = 0;
+
+    before = srn_bench_get_heap_bytes();
+    for (guint64 i = 0; i < count; i++){
+        SrnBenchSample *sample;
+
+        sample = samples->pdata[i % samples->len];
+        msgs[i] = srn_bench_fixture_new_message(fixture, sample);
+        if (render){
+            srn_render_message(msgs[i], RENDER_FLAGS_ALL);
+        }
+        content_bytes += strlen(sample->content) + 1;
+    }
+    after = srn_bench_get_heap_bytes();
+
+    printf("{\"name\":\"%s\",\"messages\":%" G_GUINT64_FORMAT ","
+            "\"bytes_per_message\":%.1f,\"content_bytes_per_message\":%.1f}\n",
+            name, count, (double)(after - before) / count,
+            (double)content_bytes / count);
+    fflush(stdout);
+
+    for (guint64 i = 0; i < count; i++){
+        srn_message_free(msgs[i]);
+    }
+    g_free(msgs);
+}
+
+static guint64 get_message_count(void){
+    guint64 count;
+    const char *env;
+
+    env = g_getenv("SRN_BENCH_MESSAGES");
+    if (!env){
+        return DEFAULT_MESSAGES;
+    }
+    count = g_ascii_strtoull(env, NULL, 10);
+
+    return count > 0 ? count : DEFAULT_MESSAGES;
+}
@@ -0,0 +1,186 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench_render.c
+ * @brief Benchmarks of render and filter modules
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * An op is one message built from a PRIVMSG of corpus. Creating and freeing
+ * messages are not timed.
+ */
+
+#include <glib.h>
+
+#include "core/core.h"
+#include "render/render.h"
+#include "filter/filter.h"
+#include "renderer.h"
+#include "filter2.h"
+#include "bench.h"
+
+extern SrnMessageRenderer pattern_renderer;
+extern SrnMessageRenderer mirc_colorize_renderer;
+extern SrnMessageRenderer mirc_strip_renderer;
+extern SrnMessageRenderer url_renderer;
+extern SrnMessageRenderer mention_renderer;
+
+extern SrnMessageFilter user_filter;
+extern SrnMessageFilter pattern_filter;
+extern SrnMessageFilter log_filter;
+
+#define RENDER_FLAGS_ALL (SRN_RENDER_FLAG_PATTERN \
+        | SRN_RENDER_FLAG_MIRC_COLORIZE \
+        | SRN_RENDER_FLAG_URL \
+        | SRN_RENDER_FLAG_MENTION)
+
+#define FILTER_FLAGS_ALL (SRN_FILTER_FLAG_USER \
+        | SRN_FILTER_FLAG_PATTERN \
+        | SRN_FILTER_FLAG_LOG)
+
+typedef struct _RenderBench RenderBench;
+typedef void (RenderBenchFunc) (RenderBench *rb, SrnMessage *msg);
+
+struct _RenderBench {
+    SrnBenchFixture *fixture;
+    GPtrArray *samples;
+    RenderBenchFunc *func;
+
+    SrnMessageRenderer *renderer;
+    SrnMessageFilter *filter;
+};
+
+static void bench_messages(SrnBench *bench, gpointer user_data);
+static void do_render(RenderBench *rb, SrnMessage *msg);
+static void do_render_all(RenderBench *rb, SrnMessage *msg);
+static void do_filter(RenderBench *rb, SrnMessage *msg);
+static void do_filter_all(RenderBench *rb, SrnMessage *msg);
+
+static SrnMessageRenderer *renderers[] = {
+    &pattern_renderer,
+    &mirc_strip_renderer,
+    &mirc_colorize_renderer,
+    &url_renderer,
+    &mention_renderer,
+    NULL,
+};
+
+static SrnMessageFilter *filters[] = {
+    &user_filter,
+    &pattern_filter,
+    &log_filter,
+    NULL,
+};
+
+void srn_bench_render(GPtrArray *corpus){
+    RenderBench rb = { 0 };
+
+    rb.fixture = srn_bench_fixture_new();
+    rb.samples = srn_bench_load_samples(corpus);
+    g_return_if_fail(rb.samples->len);
+
+    rb.func = do_render;
+    for (int i = 0; renderers[i]; i++){
+        char *name;
+
+        name = g_strdup_printf("render/%s", renderers[i]->name);
+        rb.renderer = renderers[i];
+        srn_bench_run(name, bench_messages, &rb);
+        g_free(name);
+    }
+
+    rb.func = do_render_all;
+    srn_bench_run("render/all", bench_messages, &rb);
+
+    g_ptr_array_free(rb.samples, TRUE);
+    srn_bench_fixture_free(rb.fixture);
+}
+
+void srn_bench_filter(GPtrArray *corpus){
+    RenderBench rb = { 0 };
+
+    rb.fixture = srn_bench_fixture_new();
+    rb.samples = srn_bench_load_samples(corpus);
+    g_return_if_fail(rb.samples->len);
+
+    rb.func = do_filter;
+    for (int i = 0; filters[i]; i++){
+        char *name;
+
+        name = g_strdup_printf("filter/%s", filters[i]->name);
+        rb.filter = filters[i];
+        srn_bench_run(name, bench_messages, &rb);
+        g_free(name);
+    }
+
+    rb.func = do_filter_all;
+    srn_bench_run("filter/all", bench_messages, &rb);
+
+    g_ptr_array_free(rb.samples, TRUE);
+    srn_bench_fixture_free(rb.fixture);
+}
+
+static void bench_messages(SrnBench *bench, gpointer user_data){
+    RenderBench *rb;
+    SrnMessage *msgs[SRN_BENCH_CHUNK];
+
+    rb = user_data;
+    for (guint64 i = 0; i < bench->n; i += SRN_BENCH_CHUNK){
+        int n;
+
+        n = MIN(SRN_BENCH_CHUNK, bench->n - i);
+
+        srn_bench_pause(bench);
+        for (int j = 0; j < n; j++){
+            msgs[j] = srn_bench_fixture_new_message(rb->fixture,
+                    rb->samples->pdata[(i + j) % rb->samples->len]);
+        }
+        srn_bench_resume(bench);
+
+        for (int j = 0; j < n; j++){
+            rb->func(rb, msgs[j]);
+        }
+
+        srn_bench_pause(bench);
+        for (int j = 0; j < n; j++){
+            srn_message_free(msgs[j]);
+        }
+        srn_bench_resume(bench);
+    }
+}
+
+static void do_render(RenderBench *rb, SrnMessage *msg){
+    rb->renderer->render(msg);
+}
+
+static void do_render_all(RenderBench *rb, SrnMessage *msg){
+    srn_render_message(msg, RENDER_FLAGS_ALL);
+}
+
+static void do_filter(RenderBench *rb, SrnMessage *msg){
+    rb->filter->filter(msg);
+}
+
+static void do_filter_all(RenderBench *rb, SrnMessage *msg){
+    // Same order as chat.c, but message is not rendered here
+    srn_filter_message(msg, FILTER_FLAGS_ALL, SRN_FILTER_INPUT_SENDER)
+        && srn_filter_message(msg, FILTER_FLAGS_ALL, SRN_FILTER_INPUT_CONTENT)
+        && srn_filter_message(msg, FILTER_FLAGS_ALL, SRN_FILTER_INPUT_RENDERED);
+}
@@ -0,0 +1,264 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench_sirc.c
+ * @brief Benchmarks of IRC parsing, event dispatching and command building
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * An op is one line of corpus.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "sirc/sirc.h"
+#include "sirc_parse.h"
+#include "sirc_event_hdr.h"
+#include "sirc_cmd_builder.h"
+#include "arena.h"
+#include "bench.h"
+
+typedef struct {
+    GPtrArray *corpus;
+    SircSession *sirc;
+    SrnArena *arena; // Parse into heap if NULL
+    const char *codeset;
+} SircBench;
+
+static void bench_parse(SrnBench *bench, gpointer user_data);
+static void bench_transcoding(SrnBench *bench, gpointer user_data);
+static void bench_event_hdr(SrnBench *bench, gpointer user_data);
+static void bench_cmd_builder(SrnBench *bench, gpointer user_data);
+static void parse_chunk(GPtrArray *corpus, guint64 offset, int n,
+        SircMessage **imsgs);
+static void free_chunk(SircMessage **imsgs, int n);
+static void init_events(SircEvents *events);
+
+void srn_bench_sirc(GPtrArray *corpus){
+    SircBench sb = { 0 };
+    SircEvents events;
+    SircConfig *cfg;
+
+    init_events(&events);
+    cfg = sirc_config_new();
+    sirc_config_check(cfg); // Fill default encoding
+
+    sb.corpus = corpus;
+    sb.sirc = sirc_new_session(&events, cfg);
+
+    srn_bench_run("sirc/parse", bench_parse, &sb);
+    // As what SircSession does, the arena is reset after each line
+    sb.arena = srn_arena_new(4096);
+    srn_bench_run("sirc/parse/arena", bench_parse, &sb);
+    srn_arena_free(sb.arena);
+    sb.arena = NULL;
+
+    sb.codeset = SRN_CODESET;
+    srn_bench_run("sirc/transcoding/utf-8", bench_transcoding, &sb);
+    sb.codeset = "ISO-8859-1";
+    srn_bench_run("sirc/transcoding/latin1", bench_transcoding, &sb);
+
+    srn_bench_run("sirc/event_hdr", bench_event_hdr, &sb);
+    srn_bench_run("sirc/cmd_builder", bench_cmd_builder, &sb);
+
+    sirc_free_session(sb.sirc);
+    sirc_config_free(cfg);
+}
+
+static void bench_parse(SrnBench *bench, gpointer user_data){
+    char buf[SIRC_BUF_LEN];
+    SircBench *sb;
+
+    sb = user_data;
+    for (guint64 i = 0; i < bench->n; i++){
+        const char *line;
+        SircMessage *imsg;
+
+        // sirc_parse() modifies the line
+        line = sb->corpus->pdata[i % sb->corpus->len];
+        g_strlcpy(buf, line, sizeof(buf));
+        imsg = sirc_parse(buf, sb->arena);
+        if (sb->arena){
+            srn_arena_reset(sb->arena);
+        } else if (imsg){
+            sirc_message_free(imsg);
+        }
+    }
+}
+
+static void bench_transcoding(SrnBench *bench, gpointer user_data){
+    SircBench *sb;
+    SircMessage *imsgs[SRN_BENCH_CHUNK];
+
+    sb = user_data;
+    for (guint64 i = 0; i < bench->n; i += SRN_BENCH_CHUNK){
+        int n;
+
+        n = MIN(SRN_BENCH_CHUNK, bench->n - i);
+
+        srn_bench_pause(bench);
+        parse_chunk(sb->corpus, i, n, imsgs);
+        srn_bench_resume(bench);
+
+        for (int j = 0; j < n; j++){
+            if (imsgs[j]){
+                sirc_message_transcoding(imsgs[j], sb->codeset);
+            }
+        }
+
+        srn_bench_pause(bench);
+        free_chunk(imsgs, n);
+        srn_bench_resume(bench);
+    }
+}
+
+static void bench_event_hdr(SrnBench *bench, gpointer user_data){
+    SircBench *sb;
+    SircMessage *imsgs[SRN_BENCH_CHUNK];
+
+    sb = user_data;
+    for (guint64 i = 0; i < bench->n; i += SRN_BENCH_CHUNK){
+        int n;
+
+        n = MIN(SRN_BENCH_CHUNK, bench->n - i);
+
+        srn_bench_pause(bench);
+        parse_chunk(sb->corpus, i, n, imsgs);
+        srn_bench_resume(bench);
+
+        for (int j = 0; j < n; j++){
+            if (imsgs[j]){
+                sirc_event_hdr(sb->sirc, imsgs[j]);
+            }
+        }
+
+        srn_bench_pause(bench);
+        free_chunk(imsgs, n);
+        srn_bench_resume(bench);
+    }
+}
+
+/**
+ * @brief bench_cmd_builder splits trailing parameter of every line into
+ * PRIVMSGs, in the same way as sirc_cmd_msg() but without sending them.
+ */
+static void bench_cmd_builder(SrnBench *bench, gpointer user_data){
+    SircBench *sb;
+
+    sb = user_data;
+    for (guint64 i = 0; i < bench->n; i++){
+        const char *msg;
+        const char *prev;
+
+        // Use the whole raw line as message so long lines are also covered
+        msg = sb->corpus->pdata[i % sb->corpus->len];
+        while (msg){
+            char *cmd;
+            SircCommandBuilder *builder;
+
+            builder = sirc_command_builder_new("PRIVMSG");
+            sirc_command_builder_add_middle(builder, "#bench");
+            prev = msg;
+            msg = sirc_command_builder_set_trailing(builder, msg);
+            cmd = sirc_command_builder_build(builder);
+            g_free(cmd);
+            sirc_command_builder_free(builder);
+            if (msg == prev){
+                g_warn_if_reached();
+                break;
+            }
+        }
+    }
+}
+
+static void parse_chunk(GPtrArray *corpus, guint64 offset, int n,
+        SircMessage **imsgs){
+    char buf[SIRC_BUF_LEN];
+
+    for (int i = 0; i < n; i++){
+        g_strlcpy(buf, corpus->pdata[(offset + i) % corpus->len], sizeof(buf));
+        imsgs[i] = sirc_parse(buf, NULL);
+    }
+}
+
+static void free_chunk(SircMessage **imsgs, int n){
+    for (int i = 0; i < n; i++){
+        if (imsgs[i]){
+            sirc_message_free(imsgs[i]);
+        }
+    }
+}
+
+static void on_simple_event(SircSession *sirc, const char *event,
+        const SircMessageContext *context){
+}
+
+static void on_event(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context){
+}
+
+static void on_numeric_event(SircSession *sirc, int event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context){
+}
+
+/**
+ * @brief init_events fills all callbacks with no-op functions, so only the
+ * cost of dispatching is measured.
+ */
+static void init_events(SircEvents *events){
+    events->connect = on_simple_event;
+    events->connect_fail = on_event;
+    events->disconnect = on_event;
+
+    events->welcome = on_numeric_event;
+    events->nick = on_event;
+    events->quit = on_event;
+    events->join = on_event;
+    events->part = on_event;
+    events->mode = on_event;
+    events->umode = on_event;
+    events->topic = on_event;
+    events->kick = on_event;
+    events->channel = on_event;
+    events->privmsg = on_event;
+    events->notice = on_event;
+    events->tagmsg = on_event;
+    events->channel_notice = on_event;
+    events->invite = on_event;
+    events->away = on_event;
+    events->account = on_event;
+    events->chghost = on_event;
+    events->ctcp_req = on_event;
+    events->ctcp_rsp = on_event;
+    events->cap = on_event;
+    events->authenticate = on_event;
+    events->ping = on_event;
+    events->pong = on_event;
+    events->error = on_event;
+    events->fail = on_event;
+    events->warn = on_event;
+    events->note = on_event;
+    events->unknown = on_event;
+
+    events->numeric = on_numeric_event;
+}
@@ -0,0 +1,155 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file bench_user.c
+ * @brief Memory benchmark of SrnServerUser and SrnExtraData
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-24
+ *
+ * Keeps a large number of objects alive as a big network does, and reports
+ * heap bytes used by each object:
+ *
+ *      {"name":"user/memory","objects":N,"bytes_per_object":X}
+ *
+ * Environment variable ``SRN_BENCH_USERS`` sets number of objects, defaults
+ * to 100000. The corpus is not used.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "core/core.h"
+#include "extra_data.h"
+#include "bench.h"
+
+#define DEFAULT_USERS   100000
+
+#define KEY_A   "bench_key_a"
+#define KEY_B   "bench_key_b"
+
+static void bench_user_memory(SrnBenchFixture *fixture, guint64 count);
+static void bench_extra_data_memory(guint64 count);
+static void bench_extra_data_get(SrnBench *bench, gpointer user_data);
+static void print_memory(const char *name, guint64 count, gint64 bytes);
+static guint64 get_user_count(void);
+
+void srn_bench_user(GPtrArray *corpus){
+    guint64 count;
+    SrnBenchFixture *fixture;
+    SrnExtraData *extra_data;
+
+    fixture = srn_bench_fixture_new();
+    count = get_user_count();
+
+    if (srn_bench_get_heap_bytes() >= 0){
+        bench_user_memory(fixture, count);
+        bench_extra_data_memory(count);
+    } else {
+        g_printerr("Heap statistics is not supported on this platform\n");
+    }
+
+    extra_data = srn_extra_data_new();
+    srn_extra_data_set(extra_data, KEY_A, GINT_TO_POINTER(1), NULL);
+    srn_extra_data_set(extra_data, KEY_B, GINT_TO_POINTER(2), NULL);
+    srn_bench_run("extra_data/get", bench_extra_data_get, extra_data);
+    srn_extra_data_free(extra_data);
+
+    srn_bench_fixture_free(fixture);
+}
+
+/**
+ * @brief bench_user_memory measures server users, including interned nick
+ * and extra data.
+ */
+static void bench_user_memory(SrnBenchFixture *fixture, guint64 count){
+    char nick[32];
+    gint64 before;
+    SrnServerUser **users;
+
+    if (!srn_bench_is_selected("user/memory")){
+        return;
+    }
+
+    users = g_malloc_n(count, sizeof(SrnServerUser *));
+
+    before = srn_bench_get_heap_bytes();
+    for (guint64 i = 0; i < count; i++){
+        g_snprintf(nick, sizeof(nick), "user%" G_GUINT64_FORMAT, i);
+        users[i] = srn_server_user_new(fixture->srv, nick);
+    }
+    print_memory("user/memory", count, srn_bench_get_heap_bytes() - before);
+
+    for (guint64 i = 0; i < count; i++){
+        srn_server_user_free(users[i]);
+    }
+    g_free(users);
+}
+
+static void bench_extra_data_memory(guint64 count){
+    gint64 before;
+    SrnExtraData **extra_datas;
+
+    if (!srn_bench_is_selected("extra_data/memory")){
+        return;
+    }
+
+    extra_datas = g_malloc_n(count, sizeof(SrnExtraData *));
+
+    before = srn_bench_get_heap_bytes();
+    for (guint64 i = 0; i < count; i++){
+        extra_datas[i] = srn_extra_data_new();
+    }
+    print_memory("extra_data/memory", count,
+            srn_bench_get_heap_bytes() - before);
+
+    for (guint64 i = 0; i < count; i++){
+        srn_extra_data_free(extra_datas[i]);
+    }
+    g_free(extra_datas);
+}
+
+static void bench_extra_data_get(SrnBench *bench, gpointer user_data){
+    SrnExtraData *extra_data;
+
+    extra_data = user_data;
+    for (guint64 i = 0; i < bench->n; i++){
+        srn_extra_data_get(extra_data, i % 2 ? KEY_A : KEY_B);
+    }
+}
+
+static void print_memory(const char *name, guint64 count, gint64 bytes){
+    printf("{\"name\":\"%s\",\"objects\":%" G_GUINT64_FORMAT ","
+            "\"bytes_per_object\":%.1f}\n",
+            name, count, (double)bytes / count);
+    fflush(stdout);
+}
+
+static guint64 get_user_count(void){
+    guint64 count;
+    const char *env;
+
+    env = g_getenv("SRN_BENCH_USERS");
+    if (!env){
+        return DEFAULT_USERS;
+    }
+    count = g_ascii_strtoull(env, NULL, 10);
+
+    return count > 0 ? count : DEFAULT_USERS;
+}
@@ -0,0 +1,169 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file fixture.c
+ * @brief Minimal core objects for benchmarks
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * Objects are allocated by hand rather than by srn_server_new() and
+ * srn_chat_new(), which create UI widgets and need a display.
+ */
+
+#include <glib.h>
+
+#include "core/core.h"
+#include "pattern_set.h"
+#include "extra_data.h"
+#include "utils.h"
+#include "render/render.h"
+#include "filter/filter.h"
+#include "bench.h"
+
+#define BENCH_NICK  "srnbench"
+
+static SrnChat* chat_new(SrnServer *srv, const char *name, SrnChatType type);
+static void chat_free(SrnChat *chat);
+static SrnChatUser* chat_user_new(SrnChat *chat, const char *nick);
+static void chat_user_free(SrnChatUser *user);
+
+SrnBenchFixture* srn_bench_fixture_new(void){
+    SrnBenchFixture *self;
+    SrnApplication *app;
+    SrnServer *srv;
+
+    self = g_malloc0(sizeof(SrnBenchFixture));
+
+    app = g_malloc0(sizeof(SrnApplication));
+    app->pattern_set = srn_pattern_set_new();
+    srn_application_set_default(app);
+    self->app = app;
+
+    srv = g_malloc0(sizeof(SrnServer));
+    str_assign(&srv->name, "bench");
+    srv->cfg = srn_server_config_new();
+    srv->addr = srn_server_addr_new("irc.example.org", 6697);
+    srn_server_config_add_addr(srv->cfg, srv->addr);
+    srv->intern_pool = srn_intern_pool_new(SRN_CASEMAPPING_RFC1459);
+    srv->user = srn_server_user_new(srv, BENCH_NICK);
+    srn_server_user_set_is_me(srv->user, TRUE);
+    srv->chat = chat_new(srv, "bench", SRN_CHAT_TYPE_SERVER);
+    self->srv = srv;
+
+    self->chat = chat_new(srv, "#bench", SRN_CHAT_TYPE_CHANNEL);
+    self->user_table = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify)chat_user_free);
+    self->context = sirc_message_context_new(g_date_time_new_now_local());
+
+    /* Patterns similar to what a user may configure: a relay bot renderer
+     * and a spam filter */
+    srn_pattern_set_add(app->pattern_set, "bench-relay",
+            "^<(?<sender>[^>]+)> (?<content>.*)$");
+    srn_render_attach_pattern(self->chat->extra_data, "bench-relay");
+    srn_pattern_set_add(app->pattern_set, "bench-spam",
+            "(?i)free\\s+(bitcoin|nitro)");
+    srn_filter_attach_pattern(self->chat->extra_data, "bench-spam");
+
+    return self;
+}
+
+void srn_bench_fixture_free(SrnBenchFixture *self){
+    SrnServer *srv;
+
+    srv = self->srv;
+
+    g_hash_table_destroy(self->user_table);
+    sirc_message_context_free(self->context);
+    chat_free(self->chat);
+    chat_free(srv->chat);
+    srn_server_user_free(srv->user);
+    srn_intern_pool_free(srv->intern_pool);
+    srn_server_config_free(srv->cfg); // srv->addr is freed here
+    str_assign(&srv->name, NULL);
+    g_free(srv);
+
+    srn_application_set_default(NULL);
+    srn_pattern_set_free(self->app->pattern_set);
+    g_free(self->app);
+
+    g_free(self);
+}
+
+/**
+ * @brief srn_bench_fixture_new_message creates a message received in the
+ * channel of fixture.
+ *
+ * @param self
+ * @param sample
+ *
+ * @return A SrnMessage, should be freed by srn_message_free()
+ */
+SrnMessage* srn_bench_fixture_new_message(SrnBenchFixture *self,
+        const SrnBenchSample *sample){
+    SrnChatUser *user;
+
+    user = g_hash_table_lookup(self->user_table, sample->nick);
+    if (!user){
+        user = chat_user_new(self->chat, sample->nick);
+        g_hash_table_insert(self->user_table, user->srv_user->nick, user);
+    }
+
+    return srn_message_new(self->chat, user, sample->content,
+            SRN_MESSAGE_TYPE_RECV, self->context);
+}
+
+static SrnChat* chat_new(SrnServer *srv, const char *name, SrnChatType type){
+    SrnChat *chat;
+
+    chat = g_malloc0(sizeof(SrnChat));
+    str_assign(&chat->name, name);
+    chat->type = type;
+    chat->srv = srv;
+    chat->cfg = g_malloc0(sizeof(SrnChatConfig));
+    chat->cfg->log = FALSE;
+    chat->extra_data = srn_extra_data_new();
+
+    return chat;
+}
+
+static void chat_free(SrnChat *chat){
+    str_assign(&chat->name, NULL);
+    srn_extra_data_free(chat->extra_data);
+    g_free(chat->cfg);
+    g_free(chat);
+}
+
+static SrnChatUser* chat_user_new(SrnChat *chat, const char *nick){
+    SrnChatUser *user;
+
+    user = g_malloc0(sizeof(SrnChatUser));
+    user->type = SRN_CHAT_USER_TYPE_CHIGUA;
+    user->chat = chat;
+    user->srv_user = srn_server_user_new(chat->srv, nick);
+    user->extra_data = srn_extra_data_new();
+
+    return user;
+}
+
+static void chat_user_free(SrnChatUser *user){
+    srn_extra_data_free(user->extra_data);
+    srn_server_user_free(user->srv_user);
+    g_free(user);
+}
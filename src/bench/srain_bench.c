@@ -0,0 +1,110 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file srain_bench.c
+ * @brief Entry of benchmarks
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-20
+ *
+ * Usage: srain-bench <suite> <corpus>
+ *
+ * Available suites: sirc, render, filter, command, message, user.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "log.h"
+#include "i18n.h"
+#include "render/render.h"
+#include "filter/filter.h"
+#include "bench.h"
+
+typedef void (SuiteFunc) (GPtrArray *corpus);
+
+typedef struct {
+    const char *name;
+    SuiteFunc *func;
+} Suite;
+
+static Suite suites[] = {
+    { "sirc", srn_bench_sirc },
+    { "render", srn_bench_render },
+    { "filter", srn_bench_filter },
+    { "command", srn_bench_command },
+    { "message", srn_bench_message },
+    { "user", srn_bench_user },
+    { NULL, NULL },
+};
+
+int main(int argc, char *argv[]){
+    SuiteFunc *func;
+    GPtrArray *corpus;
+    SrnLogger *logger;
+    SrnLoggerConfig *logger_cfg;
+
+    if (argc != 3){
+        g_printerr("Usage: %s <suite> <corpus>\n", argv[0]);
+        return 1;
+    }
+
+    func = NULL;
+    for (int i = 0; suites[i].name; i++){
+        if (g_ascii_strcasecmp(argv[1], suites[i].name) == 0){
+            func = suites[i].func;
+            break;
+        }
+    }
+    if (!func){
+        g_printerr("Unknown suite: %s\n", argv[1]);
+        return 1;
+    }
+
+    corpus = srn_bench_load_corpus(argv[2]);
+    if (!corpus || !corpus->len){
+        return 1;
+    }
+
+    ret_init();
+    i18n_init();
+
+    // Only errors are logged, as what a release build does by default
+    logger_cfg = srn_logger_config_new();
+    logger_cfg->error_targets = g_list_append(
+            logger_cfg->error_targets, g_strdup(""));
+    logger = srn_logger_new(logger_cfg);
+    srn_logger_set_default(logger);
+
+    srn_filter_init();
+    srn_render_init();
+
+    func(corpus);
+
+    srn_render_finalize();
+    srn_filter_finalize();
+    srn_logger_free(logger);
+    srn_logger_config_free(logger_cfg);
+    ret_finalize();
+    g_ptr_array_free(corpus, TRUE);
+
+    return 0;
+}
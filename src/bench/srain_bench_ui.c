@@ -0,0 +1,384 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file srain_bench_ui.c
+ * @brief Frame time benchmark of message list under sustained inflow
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-22
+ *
+ * Usage: srain-bench-ui [-r RATE] [-d DEPTH] [-s SECS] <corpus>
+ *
+ * It runs the GTK user interface, so a display is required, a virtual one
+ * without GPU is preferred for stable numbers:
+ *
+ *      $ xvfb-run -a srain-bench-ui corpus/irc.txt
+ *      $ GDK_BACKEND=broadway srain-bench-ui corpus/irc.txt
+ *
+ * Themes are looked up as srain does, so data files should be installed.
+ *
+ * A channel is filled with DEPTH messages as scrollback, then messages built
+ * from PRIVMSGs of corpus come in at RATE per second for SECS seconds. During
+ * the inflow, phases of GdkFrameClock of the window are timed. The result is
+ * printed to stdout as one JSON object:
+ *
+ *      {"name":"ui","rate":R,"depth":D,"fill_ms":X,"frames":N,"fps":F,
+ *       "janky_frames":J,"rss_kb":{"fill":..,"end":..,"peak":..},
+ *       "frame":{..},"interval":{..},"layout":{..},"paint":{..}}
+ *
+ * "frame" is the time of a whole frame (from "before-paint" to
+ * "after-paint"), a frame longer than 1/60s is janky. "interval" is the time
+ * between two frames.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <gtk/gtk.h>
+
+#include "core/core.h"
+#include "sui/sui.h"
+#include "srain.h"
+#include "log.h"
+#include "i18n.h"
+#include "meta.h"
+#include "utils.h"
+#include "histogram.h"
+#include "render/render.h"
+#include "filter/filter.h"
+#include "bench.h"
+
+#include "sui_common.h"
+
+#define BENCH_SERVER    "bench"
+#define BENCH_CHANNEL   "#bench"
+#define BENCH_NICK      "srnbench"
+#define FRAME_BUDGET_NS (G_GUINT64_CONSTANT(1000000000) / 60)
+#define INFLOW_TICK_MS  4
+
+typedef struct {
+    int rate;
+    int depth;
+    int secs;
+    GPtrArray *samples;
+
+    SrnServer *srv;
+    SrnChat *chat;
+    guint64 sent;
+
+    guint64 fill_ns;
+    long fill_rss_kb;
+    guint64 inflow_start;
+    GdkFrameClock *clock;
+
+    /* Frame clock phases */
+    guint64 frame_start;
+    guint64 update_end;
+    guint64 layout_end;
+    guint64 last_frame_start;
+    guint64 frames;
+    guint64 janky_frames;
+    SrnHistogram frame;
+    SrnHistogram interval;
+    SrnHistogram layout;
+    SrnHistogram paint;
+} UiBench;
+
+static UiBench bench;
+static SuiApplicationEventCallback orig_activate = NULL;
+
+static SrnRet on_activate(SuiApplication *app, SuiEvent event,
+        GVariantDict *params);
+static gboolean setup_idle(gpointer user_data);
+static gboolean inflow_timeout(gpointer user_data);
+static void add_message(void);
+static void on_before_paint(GdkFrameClock *clock, gpointer user_data);
+static void on_update(GdkFrameClock *clock, gpointer user_data);
+static void on_layout(GdkFrameClock *clock, gpointer user_data);
+static void on_after_paint(GdkFrameClock *clock, gpointer user_data);
+static void print_result(void);
+static long get_rss_kb(void);
+
+int main(int argc, char *argv[]){
+    char *home;
+    char *cfg;
+    GError *err;
+    GOptionContext *opt_ctx;
+    GPtrArray *corpus;
+    SrnApplication *app;
+    char *ui_argv[] = { argv[0], "--no-auto", NULL };
+    GOptionEntry entries[] = {
+        { "rate", 'r', 0, G_OPTION_ARG_INT, &bench.rate,
+            "Incoming messages per second", "RATE" },
+        { "depth", 'd', 0, G_OPTION_ARG_INT, &bench.depth,
+            "Messages in scrollback before inflow", "DEPTH" },
+        { "secs", 's', 0, G_OPTION_ARG_INT, &bench.secs,
+            "Duration of inflow in seconds", "SECS" },
+        { NULL },
+    };
+
+    bench.rate = 50;
+    bench.depth = 1000;
+    bench.secs = 10;
+    err = NULL;
+    opt_ctx = g_option_context_new("<corpus>");
+    g_option_context_add_main_entries(opt_ctx, entries, NULL);
+    if (!g_option_context_parse(opt_ctx, &argc, &argv, &err)){
+        g_printerr("%s\n", err->message);
+        g_error_free(err);
+        g_option_context_free(opt_ctx);
+        return 1;
+    }
+    g_option_context_free(opt_ctx);
+    if (argc != 2 || bench.rate < 1 || bench.depth < 0 || bench.secs < 1){
+        g_printerr("Usage: %s [-r RATE] [-d DEPTH] [-s SECS] <corpus>\n",
+                argv[0]);
+        return 1;
+    }
+
+    corpus = srn_bench_load_corpus(argv[1]);
+    if (!corpus || !corpus->len){
+        return 1;
+    }
+    bench.samples = srn_bench_load_samples(corpus);
+    g_ptr_array_free(corpus, TRUE);
+    if (!bench.samples->len){
+        return 1;
+    }
+
+    // Use another application ID, do not talk to a running srain. Keep all
+    // messages, so that the list is as deep as required
+    cfg = g_strdup_printf("id = \"%s.Bench\";\n"
+            "server = { chat = { max-messages = 0; }; };\n", PACKAGE_APPID);
+    home = srn_bench_new_home(cfg);
+    g_free(cfg);
+    if (!home){
+        return 1;
+    }
+
+    ret_init();
+    i18n_init();
+    srn_filter_init();
+    srn_render_init();
+
+    app = srn_application_new();
+    orig_activate = app->ui_app_events.activate;
+    app->ui_app_events.activate = on_activate;
+    srn_application_run(app, 2, ui_argv);
+
+    g_ptr_array_free(bench.samples, TRUE);
+    srn_render_finalize();
+    srn_filter_finalize();
+    srn_application_quit(app);
+    ret_finalize();
+    srn_bench_remove_home(home);
+
+    return 0;
+}
+
+static SrnRet on_activate(SuiApplication *app, SuiEvent event,
+        GVariantDict *params){
+    SrnRet ret;
+
+    ret = orig_activate(app, event, params);
+    if (RET_IS_OK(ret) && !bench.srv){
+        // Let the window be shown firstly
+        g_idle_add(setup_idle, srn_application_get_default());
+    }
+
+    return ret;
+}
+
+static gboolean setup_idle(gpointer user_data){
+    guint64 start;
+    SrnRet ret;
+    SrnApplication *app;
+    SrnServerConfig *cfg;
+    GtkWidget *win;
+
+    app = user_data;
+    cfg = srn_server_config_new();
+    str_assign(&cfg->name, BENCH_SERVER);
+    srn_server_config_add_addr(cfg,
+            srn_server_addr_new(BENCH_SERVER ".invalid", 6667));
+    str_assign(&cfg->user->nick, BENCH_NICK);
+    ret = srn_application_add_server_with_config(app, BENCH_SERVER, cfg);
+    if (!RET_IS_OK(ret)){
+        g_printerr("Failed to add server: %s\n", RET_MSG(ret));
+        srn_server_config_free(cfg);
+        g_application_quit(g_application_get_default());
+        return G_SOURCE_REMOVE;
+    }
+    bench.srv = srn_application_get_server(app, BENCH_SERVER);
+    srn_server_add_chat(bench.srv, BENCH_CHANNEL);
+    bench.chat = srn_server_get_chat(bench.srv, BENCH_CHANNEL);
+    sui_activate_buffer(bench.chat->ui);
+
+    /* Fill scrollback, pending events are processed so that rows are
+     * realized as what happens in real world */
+    start = srn_get_monotonic_ns();
+    for (int i = 0; i < bench.depth; i++){
+        add_message();
+        if (i % SRN_BENCH_CHUNK == 0){
+            sui_proc_pending_event();
+        }
+    }
+    sui_proc_pending_event();
+    bench.fill_ns = srn_get_monotonic_ns() - start;
+    bench.fill_rss_kb = get_rss_kb();
+
+    win = GTK_WIDGET(sui_common_get_cur_window());
+    bench.clock = gtk_widget_get_frame_clock(win);
+    g_signal_connect(bench.clock, "before-paint",
+            G_CALLBACK(on_before_paint), NULL);
+    g_signal_connect_after(bench.clock, "update",
+            G_CALLBACK(on_update), NULL);
+    g_signal_connect_after(bench.clock, "layout",
+            G_CALLBACK(on_layout), NULL);
+    g_signal_connect_after(bench.clock, "after-paint",
+            G_CALLBACK(on_after_paint), NULL);
+
+    bench.sent = 0;
+    bench.inflow_start = srn_get_monotonic_ns();
+    g_timeout_add(INFLOW_TICK_MS, inflow_timeout, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean inflow_timeout(gpointer user_data){
+    guint64 elapsed;
+    guint64 target;
+
+    elapsed = srn_get_monotonic_ns() - bench.inflow_start;
+    if (elapsed >= (guint64)bench.secs * 1000000000){
+        g_signal_handlers_disconnect_by_data(bench.clock, NULL);
+        print_result();
+        g_application_quit(g_application_get_default());
+        return G_SOURCE_REMOVE;
+    }
+
+    target = elapsed * bench.rate / 1000000000;
+    while (bench.sent < target){
+        add_message();
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void add_message(void){
+    SrnBenchSample *sample;
+    SrnServerUser *srv_user;
+    SrnChatUser *chat_user;
+    SircMessageContext *context;
+
+    sample = bench.samples->pdata[bench.sent++ % bench.samples->len];
+    srv_user = srn_server_add_and_get_user(bench.srv, sample->nick);
+    chat_user = srn_chat_add_and_get_user(bench.chat, srv_user);
+    context = sirc_message_context_new(NULL);
+    srn_chat_add_recv_message(bench.chat, chat_user, sample->content, context);
+    sirc_message_context_free(context);
+}
+
+static void on_before_paint(GdkFrameClock *clock, gpointer user_data){
+    bench.frame_start = srn_get_monotonic_ns();
+    bench.update_end = bench.layout_end = bench.frame_start;
+    if (bench.last_frame_start){
+        srn_histogram_record(&bench.interval,
+                bench.frame_start - bench.last_frame_start);
+    }
+    bench.last_frame_start = bench.frame_start;
+}
+
+static void on_update(GdkFrameClock *clock, gpointer user_data){
+    bench.update_end = srn_get_monotonic_ns();
+}
+
+static void on_layout(GdkFrameClock *clock, gpointer user_data){
+    bench.layout_end = srn_get_monotonic_ns();
+    srn_histogram_record(&bench.layout, bench.layout_end - bench.update_end);
+}
+
+static void on_after_paint(GdkFrameClock *clock, gpointer user_data){
+    guint64 now;
+
+    if (!bench.frame_start){
+        return;
+    }
+
+    now = srn_get_monotonic_ns();
+    srn_histogram_record(&bench.paint, now - bench.layout_end);
+    srn_histogram_record(&bench.frame, now - bench.frame_start);
+    if (now - bench.frame_start > FRAME_BUDGET_NS){
+        bench.janky_frames++;
+    }
+    bench.frames++;
+}
+
+static void print_result(void){
+    struct rusage usage;
+    GString *str;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    str = g_string_new(NULL);
+    g_string_append_printf(str,
+            "{\"name\":\"ui\",\"rate\":%d,\"depth\":%d,\"fill_ms\":%.1f,"
+            "\"frames\":%" G_GUINT64_FORMAT ",\"fps\":%.1f,"
+            "\"janky_frames\":%" G_GUINT64_FORMAT ",",
+            bench.rate, bench.depth, bench.fill_ns / 1e6,
+            bench.frames, (double)bench.frames / bench.secs,
+            bench.janky_frames);
+    g_string_append_printf(str,
+            "\"rss_kb\":{\"fill\":%ld,\"end\":%ld,\"peak\":%ld},",
+            bench.fill_rss_kb, get_rss_kb(), usage.ru_maxrss);
+    g_string_append(str, "\"frame\":");
+    srn_histogram_to_json(&bench.frame, str);
+    g_string_append(str, ",\"interval\":");
+    srn_histogram_to_json(&bench.interval, str);
+    g_string_append(str, ",\"layout\":");
+    srn_histogram_to_json(&bench.layout, str);
+    g_string_append(str, ",\"paint\":");
+    srn_histogram_to_json(&bench.paint, str);
+    g_string_append(str, "}");
+
+    printf("%s\n", str->str);
+    fflush(stdout);
+    g_string_free(str, TRUE);
+}
+
+/**
+ * @brief get_rss_kb returns current resident set size, falls back to peak
+ * one where /proc is not available.
+ */
+static long get_rss_kb(void){
+    long pages;
+    char *content;
+    struct rusage usage;
+
+    if (g_file_get_contents("/proc/self/statm", &content, NULL, NULL)){
+        pages = 0;
+        sscanf(content, "%*ld %ld", &pages);
+        g_free(content);
+        return pages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
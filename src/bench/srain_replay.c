@@ -0,0 +1,240 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file srain_replay.c
+ * @brief Replay recorded IRC traffic through the whole application
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-21
+ *
+ * Usage: srain-replay [-r REPEAT] <transcript>
+ *
+ * The transcript has the same format as benchmark corpus. It is fed to a
+ * SircSession via an in-memory stream, so every line goes through the same
+ * path as a real connection: sirc → app_irc_event.c → chat → filter → render
+ * → UI, where the UI is the stub backend. Anything sent by application is
+ * ignored.
+ *
+ * The result is printed to stdout as one JSON object:
+ *
+ *      {"name":"replay","lines":N,"seconds":X,"lines_per_sec":Y,
+ *       "peak_rss_kb":Z,"stages":{"parse_ns":..,"dispatch_ns":..,
+ *       "render":{..},"filter":{..}}}
+ *
+ * "dispatch_ns" is the time spent in event handlers, which already includes
+ * the time of "render" and "filter".
+ *
+ * User configuration and data directories are redirected to a temporary
+ * directory, which is removed on exit.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "core/core.h"
+#include "sirc/sirc.h"
+#include "srain.h"
+#include "log.h"
+#include "i18n.h"
+#include "utils.h"
+#include "histogram.h"
+#include "render/render.h"
+#include "filter/filter.h"
+#include "bench.h"
+
+#define REPLAY_SERVER   "replay"
+#define REPLAY_NICK     "srnbench"
+
+static GMainLoop *loop = NULL;
+static SircEventCallback orig_disconnect = NULL;
+
+static SrnServer* add_server(SrnApplication *app);
+static GIOStream* new_stream(GPtrArray *transcript, int repeat);
+static void on_disconnect(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context);
+static void print_result(SrnServer *srv, guint64 lines, guint64 elapsed);
+
+int main(int argc, char *argv[]){
+    int repeat;
+    char *home;
+    guint64 start;
+    guint64 elapsed;
+    GError *err;
+    GOptionContext *opt_ctx;
+    GPtrArray *transcript;
+    SrnApplication *app;
+    SrnServer *srv;
+    GOptionEntry entries[] = {
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+            "Replay the transcript for N times", "N" },
+        { NULL },
+    };
+
+    repeat = 1;
+    err = NULL;
+    opt_ctx = g_option_context_new("<transcript>");
+    g_option_context_add_main_entries(opt_ctx, entries, NULL);
+    if (!g_option_context_parse(opt_ctx, &argc, &argv, &err)){
+        g_printerr("%s\n", err->message);
+        g_error_free(err);
+        g_option_context_free(opt_ctx);
+        return 1;
+    }
+    g_option_context_free(opt_ctx);
+    if (argc != 2 || repeat < 1){
+        g_printerr("Usage: %s [-r REPEAT] <transcript>\n", argv[0]);
+        return 1;
+    }
+
+    transcript = srn_bench_load_corpus(argv[1]);
+    if (!transcript || !transcript->len){
+        return 1;
+    }
+
+    home = srn_bench_new_home(NULL);
+    if (!home){
+        return 1;
+    }
+
+    ret_init();
+    i18n_init();
+    srn_filter_init();
+    srn_render_init();
+
+    app = srn_application_new();
+    srv = add_server(app);
+    if (!srv){
+        srn_bench_remove_home(home);
+        return 1;
+    }
+
+    // Quit when the whole transcript is consumed
+    loop = g_main_loop_new(NULL, FALSE);
+    orig_disconnect = app->irc_events.disconnect;
+    app->irc_events.disconnect = on_disconnect;
+
+    // Pretend that we are connecting, sirc_connect_stream() will finish it
+    srv->state = SRN_SERVER_STATE_CONNECTING;
+    sirc_connect_stream(srv->irc, new_stream(transcript, repeat));
+
+    start = srn_get_monotonic_ns();
+    g_main_loop_run(loop);
+    elapsed = srn_get_monotonic_ns() - start;
+
+    print_result(srv, (guint64)transcript->len * repeat, elapsed);
+
+    g_main_loop_unref(loop);
+    g_ptr_array_free(transcript, TRUE);
+    srn_render_finalize();
+    srn_filter_finalize();
+    srn_application_quit(app);
+    ret_finalize();
+
+    srn_bench_remove_home(home);
+
+    return 0;
+}
+
+static SrnServer* add_server(SrnApplication *app){
+    SrnRet ret;
+    SrnServerConfig *cfg;
+
+    cfg = srn_server_config_new();
+    str_assign(&cfg->name, REPLAY_SERVER);
+    srn_server_config_add_addr(cfg,
+            srn_server_addr_new(REPLAY_SERVER ".invalid", 6667));
+    str_assign(&cfg->user->nick, REPLAY_NICK);
+
+    ret = srn_application_add_server_with_config(app, REPLAY_SERVER, cfg);
+    if (!RET_IS_OK(ret)){
+        g_printerr("Failed to add server: %s\n", RET_MSG(ret));
+        srn_server_config_free(cfg);
+        return NULL;
+    }
+
+    return srn_application_get_server(app, REPLAY_SERVER);
+}
+
+/**
+ * @brief new_stream creates a stream which reads the transcript for given
+ * times, everything written to it is ignored.
+ */
+static GIOStream* new_stream(GPtrArray *transcript, int repeat){
+    GString *data;
+    GInputStream *in;
+    GOutputStream *out;
+    GIOStream *stream;
+
+    data = g_string_new(NULL);
+    for (int i = 0; i < repeat; i++){
+        for (guint j = 0; j < transcript->len; j++){
+            g_string_append(data, transcript->pdata[j]);
+            g_string_append(data, "\r\n");
+        }
+    }
+
+    in = g_memory_input_stream_new_from_data(data->str, data->len, g_free);
+    g_string_free(data, FALSE);
+    // Commands sent by application are few, just keep them in memory
+    out = g_memory_output_stream_new_resizable();
+    stream = g_simple_io_stream_new(in, out);
+    g_object_unref(in);
+    g_object_unref(out);
+
+    return stream;
+}
+
+static void on_disconnect(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context){
+    orig_disconnect(sirc, event, origin, params, count, context);
+    g_main_loop_quit(loop);
+}
+
+static void print_result(SrnServer *srv, guint64 lines, guint64 elapsed){
+    struct rusage usage;
+    const SircStats *stats;
+    GString *str;
+
+    getrusage(RUSAGE_SELF, &usage);
+    stats = sirc_get_stats(srv->irc);
+
+    str = g_string_new(NULL);
+    g_string_append_printf(str,
+            "{\"name\":\"replay\",\"lines\":%" G_GUINT64_FORMAT ","
+            "\"seconds\":%.3f,\"lines_per_sec\":%.1f,\"peak_rss_kb\":%ld,",
+            lines, elapsed / 1e9, lines / (elapsed / 1e9), usage.ru_maxrss);
+    g_string_append_printf(str,
+            "\"stages\":{\"parse_ns\":%" G_GUINT64_FORMAT ","
+            "\"dispatch_ns\":%" G_GUINT64_FORMAT ",",
+            stats->parse_ns, stats->dispatch_ns);
+    g_string_append(str, "\"render\":");
+    srn_render_dump_stats(str, TRUE);
+    g_string_append(str, ",\"filter\":");
+    srn_filter_dump_stats(str, TRUE);
+    g_string_append(str, "}}");
+
+    printf("%s\n", str->str);
+    fflush(stdout);
+    g_string_free(str, TRUE);
+}
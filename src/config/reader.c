@@ -299,6 +299,15 @@ static SrnRet read_application_config_from_cfg(config_t *cfg,
     config_lookup_string_ex(cfg, "chat-list-order",
             &app_cfg->ui->window.chat_list_order);
 
+    /* Read statistics config */
+    config_setting_t *stats;
+    stats = config_lookup(cfg, "stats");
+    if (stats){
+        config_setting_lookup_string_ex(stats, "file", &app_cfg->stats_file);
+        config_setting_lookup_string_ex(stats, "format", &app_cfg->stats_format);
+        config_setting_lookup_int(stats, "interval", &app_cfg->stats_interval);
+    }
+
     /* Read auto connect server list */
     config_setting_t *auto_connect;
     auto_connect = config_lookup(cfg, "auto-connect");
@@ -422,6 +431,24 @@ static SrnRet read_server_config_from_server(config_setting_t *server,
         }
     }
 
+    /* Read monitored nick list */
+    config_setting_t *monitor;
+    monitor = config_setting_lookup(server, "monitor");
+    if (monitor){
+        for (int i = 0; i < config_setting_length(monitor); i++){
+            const char *val;
+            config_setting_t *nick;
+
+            nick = config_setting_get_elem(monitor, i);
+            if (!nick) continue;
+            val = config_setting_get_string(nick);
+            if (!val) continue;
+
+            cfg->monitor_list = g_list_append(
+                    cfg->monitor_list, g_strdup(val));
+        }
+    }
+
     /* Read autorun command list */
     config_setting_t *cmds;
     cmds = config_setting_lookup(server, "auto-run");
@@ -499,6 +526,9 @@ static SrnRet read_chat_config_from_chat(config_setting_t *chat, SrnChatConfig *
     config_setting_lookup_bool_ex(chat, "show-avatar", &cfg->ui->show_avatar);
     config_setting_lookup_bool_ex(chat, "show-user-list", &cfg->ui->show_user_list);
     config_setting_lookup_bool_ex(chat, "render-mirc-color", &cfg->render_mirc_color);
+    config_setting_lookup_int(chat, "membership-collapse-window",
+            &cfg->membership_collapse_window);
+    config_setting_lookup_int(chat, "max-messages", &cfg->max_messages);
     config_setting_lookup_bool_ex(chat, "preview-url", &cfg->ui->preview_url);
     config_setting_lookup_bool_ex(chat, "auto-preview-url", &cfg->ui->auto_preview_url);
     config_setting_lookup_string_ex(chat, "nick-completion-suffix", &cfg->ui->nick_completion_suffix);
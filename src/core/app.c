@@ -24,6 +24,8 @@
  * @date 2016-03-01
  */
 
+#include <gio/gio.h>
+
 #include "core/core.h"
 #include "sui/sui.h"
 #include "config/reader.h"
@@ -33,6 +35,12 @@
 #include "path.h"
 #include "utils.h"
 #include "pattern_set.h"
+#include "trace.h"
+
+#if defined(ENABLE_TRACING) && defined(G_OS_UNIX)
+#include <signal.h>
+#include <glib-unix.h>
+#endif
 
 #include "app_event.h"
 #include "chat_command.h"
@@ -42,6 +50,11 @@ static SrnApplication *app_instance = NULL;
 
 static void init_logger(SrnApplication *app);
 static void finalize_logger(SrnApplication *app);
+static void on_network_changed(GNetworkMonitor *monitor, gboolean available,
+        gpointer user_data);
+#if defined(ENABLE_TRACING) && defined(G_OS_UNIX)
+static gboolean on_trace_signal(gpointer user_data);
+#endif
 
 /*****************************************************************************
  * Exported functions
@@ -54,6 +67,7 @@ SrnApplication* srn_application_new(void){
     SrnConfigManager *cfg_mgr;
     SrnApplication *app;
     SrnApplicationConfig *cfg;
+    GNetworkMonitor *monitor;
 
     // Keep only one instance
     g_return_val_if_fail(!app_instance, NULL);
@@ -103,6 +117,18 @@ SrnApplication* srn_application_new(void){
     app->cmd_ctx = srn_command_context_new();
     srn_command_context_bind(app->cmd_ctx, cmd_bindings);
 
+    srn_application_init_stats(app);
+
+    monitor = g_network_monitor_get_default();
+    app->network_available = g_network_monitor_get_network_available(monitor);
+    app->network_handler = g_signal_connect(monitor, "network-changed",
+            G_CALLBACK(on_network_changed), app);
+
+#if defined(ENABLE_TRACING) && defined(G_OS_UNIX)
+    // Dump trace without interacting with UI: kill -USR1 <pid>
+    g_unix_signal_add(SIGUSR1, on_trace_signal, NULL);
+#endif
+
     app_instance = app;
 
     return app;
@@ -113,8 +139,24 @@ SrnApplication* srn_application_get_default(void){
     return app_instance;
 }
 
+/**
+ * @brief srn_application_set_default replaces the default application
+ * instance. srn_application_new() already does it, this is only used by
+ * benchmarks which build a partial application without UI.
+ *
+ * @param app
+ */
+void srn_application_set_default(SrnApplication *app){
+    app_instance = app;
+}
+
 void srn_application_quit(SrnApplication *app){
     // TODO: cleanup
+    if (app->network_handler){
+        g_signal_handler_disconnect(g_network_monitor_get_default(),
+                app->network_handler);
+        app->network_handler = 0;
+    }
     finalize_logger(app);
 }
 
@@ -162,6 +204,7 @@ SrnRet srn_application_reload_config(SrnApplication *app){
         goto ERR_RELOAD_LOGGER;
     }
     srn_logger_set_config(app->logger, logger_cfg);
+    app->logger_cfg = logger_cfg;
     srn_logger_config_free(old_logger_cfg);
 
     /* Update application config */
@@ -177,6 +220,7 @@ SrnRet srn_application_reload_config(SrnApplication *app){
     }
     srn_application_set_config(app, cfg);
     srn_application_config_free(old_cfg);
+    srn_application_init_stats(app);
 
     /* Update server configs */
     lst = app->srv_list;
@@ -418,6 +462,56 @@ void srn_application_auto_connect_server(SrnApplication *app) {
  * Static functions
  *****************************************************************************/
 
+#if defined(ENABLE_TRACING) && defined(G_OS_UNIX)
+static gboolean on_trace_signal(gpointer user_data){
+    SrnRet ret;
+
+    ret = srn_trace_dump(NULL);
+    if (RET_IS_OK(ret)){
+        LOG_FR("%s", RET_MSG(ret));
+    } else {
+        ERR_FR("%s", RET_MSG(ret));
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+#endif
+
+/**
+ * @brief on_network_changed reconnects servers which are waiting for
+ * reconnecting immediately when network becomes available, for example, a
+ * laptop is resumed or moved to another Wi-Fi.
+ *
+ * The signal is also emitted for changes which keep network available, such
+ * as a route added by VPN, they are ignored, otherwise a flapping interface
+ * would defeat the reconnection backoff.
+ */
+static void on_network_changed(GNetworkMonitor *monitor, gboolean available,
+        gpointer user_data){
+    bool was_available;
+    SrnApplication *app;
+
+    app = user_data;
+    was_available = app->network_available;
+    app->network_available = available;
+    if (!available || was_available){
+        return;
+    }
+
+    for (GList *lst = app->srv_list; lst; lst = g_list_next(lst)){
+        SrnServer *srv;
+
+        srv = lst->data;
+        // Addresses may be different on the new network
+        sirc_flush_dns_cache(srv->irc);
+        if (srv->state == SRN_SERVER_STATE_RECONNECTING){
+            LOG_FR("Network changed, reconnecting to %s", srv->name);
+            srv->reconn_backoff = SRN_SERVER_RECONN_INTERVAL;
+            srn_server_connect(srv);
+        }
+    }
+}
+
 static void init_logger(SrnApplication *app) {
     SrnRet ret;
 
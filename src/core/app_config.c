@@ -11,6 +11,8 @@ SrnApplicationConfig *srn_application_config_new(void){
 }
 
 void srn_application_config_free(SrnApplicationConfig *cfg){
+    g_free(cfg->stats_file);
+    g_free(cfg->stats_format);
     g_list_free_full(cfg->auto_connect_srv_list, g_free);
     sui_application_config_free(cfg->ui);
     g_free(cfg);
@@ -21,5 +23,12 @@ SrnRet srn_application_config_check(SrnApplicationConfig *cfg){
             && g_strcmp0(cfg->ui->window.chat_list_order, CHAT_LIST_ORDER_ALPHABET) != 0){
         return RET_ERR(_("Invalid chat-list-order configuration"));
     }
+    if (g_strcmp0(cfg->stats_format, "json") != 0
+            && g_strcmp0(cfg->stats_format, "openmetrics") != 0){
+        return RET_ERR(_("Invalid stats.format configuration"));
+    }
+    if (cfg->stats_interval <= 0){
+        return RET_ERR(_("Invalid stats.interval configuration"));
+    }
     return SRN_OK;
 }
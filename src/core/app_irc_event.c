@@ -41,11 +41,17 @@
 #include "meta.h"
 #include "utils.h"
 
+/* Nicks listed in summary of a netsplit or netjoin */
+#define BATCH_SUMMARY_MAX_NICKS 10
+
 static gboolean do_period_ping(gpointer user_data);
 static void add_numeric_error_message(SrnChat *chat, int event, const char
         *origin, const char **params, int count, const SircMessageContext *context);
 static void rejoin_all_channels(SrnServer *srv);
 static gboolean rejoin_all_channels_cb(gpointer user_data);
+static void login_confirmed(SrnServer *srv);
+static bool is_login_confirmation(SrnServer *srv, const char *origin,
+        const char *msg);
 
 static void irc_event_connect(SircSession *sirc, const char *event,
         const SircMessageContext *context);
@@ -107,6 +113,15 @@ static void irc_event_channel_notice(SircSession *sirc, const char *event,
 static void irc_event_invite(SircSession *sirc, const char *event,
         const char *origin, const char *params[], int count,
         const SircMessageContext *context);
+static void irc_event_away(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context);
+static void irc_event_account(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context);
+static void irc_event_chghost(SircSession *sirc, const char *event,
+        const char *origin, const char *params[], int count,
+        const SircMessageContext *context);
 static void irc_event_ctcp_req(SircSession *sirc, const char *event,
         const char *origin, const char *params[], int count,
         const SircMessageContext *context);
@@ -131,9 +146,32 @@ static void irc_event_error(SircSession *sirc, const char *event,
 static void irc_event_welcome(SircSession *sirc, int event,
         const char *origin, const char *params[], int count,
         const SircMessageContext *context);
+static void irc_event_batch(SircSession *sirc, const char *event,
+        const char *params[], int count, const SircBatch *batch,
+        const SircMessageContext *context);
 static void irc_event_numeric (SircSession *sirc, int event,
         const char *origin, const char *params[], int count,
         const SircMessageContext *context);
+static void handle_netsplit(SrnServer *srv, const char *server1,
+        const char *server2, const SircBatch *batch,
+        const SircMessageContext *context);
+static void handle_netjoin(SrnServer *srv, const char *server1,
+        const char *server2, const SircBatch *batch,
+        const SircMessageContext *context);
+static void handle_chathistory(SrnServer *srv, const char *target,
+        const SircBatch *batch);
+static void add_batch_summaries(SrnServer *srv, GHashTable *chat_nicks,
+        const char *fmt, const char *server1, const char *server2,
+        const SircMessageContext *context);
+static void pipeline_cap_negotiation(SrnServer *srv, const char *reqs,
+        const SircMessageContext *context);
+static void end_cap_negotiation(SrnServer *srv);
+static void update_user_on_join(SrnServer *srv, SrnServerUser *srv_user,
+        const char **params, int count, const SircMessageContext *context);
+static char* parse_names_entry(char *entry, SrnChatUserType *type,
+        char **user, char **host);
+static void update_monitored_users(SrnServer *srv, const char *targets,
+        bool online, const SircMessageContext *context);
 
 void srn_application_init_irc_event(SrnApplication *app) {
     app->irc_events.connect = irc_event_connect;
@@ -158,6 +196,9 @@ void srn_application_init_irc_event(SrnApplication *app) {
     app->irc_events.note = irc_event_note;
     app->irc_events.channel_notice = irc_event_channel_notice;
     app->irc_events.invite = irc_event_invite;
+    app->irc_events.away = irc_event_away;
+    app->irc_events.account = irc_event_account;
+    app->irc_events.chghost = irc_event_chghost;
     app->irc_events.ctcp_req = irc_event_ctcp_req;
     app->irc_events.ctcp_rsp = irc_event_ctcp_rsp;
     app->irc_events.cap = irc_event_cap;
@@ -165,6 +206,7 @@ void srn_application_init_irc_event(SrnApplication *app) {
     app->irc_events.ping = irc_event_ping;
     app->irc_events.pong = irc_event_pong;
     app->irc_events.error = irc_event_error;
+    app->irc_events.batch = irc_event_batch;
     app->irc_events.numeric = irc_event_numeric;
 }
 
@@ -198,6 +240,11 @@ static void irc_event_connect(SircSession *sirc, const char *event, const SircMe
         list = g_list_next(list);
     }
 
+    /* Registration is pipelined: "CAP LS" suspends registration until
+     * "CAP END", so NICK/USER can be sent without waiting for it */
+    srn_server_cap_reset(srv->cap);
+    sirc_cork(srv->irc);
+
     /* Start client capability negotiation */
     sirc_cmd_cap_ls(srv->irc, "302");
 
@@ -209,6 +256,8 @@ static void irc_event_connect(SircSession *sirc, const char *event, const SircMe
     sirc_cmd_nick(srv->irc, srv->user->nick);
     sirc_cmd_user(srv->irc, srv->user->username, "hostname", "servername",
             srv->user->realname);
+
+    sirc_uncork(srv->irc);
 }
 
 static void irc_event_connect_fail(SircSession *sirc, const char *event,
@@ -320,6 +369,10 @@ static void irc_event_disconnect(SircSession *sirc, const char *event,
         g_source_remove(srv->ping_timer);
         srv->ping_timer = 0;
     }
+    if (srv->rejoin_timer){
+        g_source_remove(srv->rejoin_timer);
+        srv->rejoin_timer = 0;
+    }
 
     ret = srn_server_state_transfrom(srv, SRN_SERVER_ACTION_DISCONNECT_FINISH);
     g_return_if_fail(RET_IS_OK(ret));
@@ -335,6 +388,7 @@ static void irc_event_disconnect(SircSession *sirc, const char *event,
     srv->registered = FALSE;
     srv->loggedin = FALSE;
     srv->negotiated = FALSE;
+    srn_server_monitor_reset(srv->monitor);
 
     /* Mark all channels as unjoined */
     list = srv->chat_list;
@@ -442,8 +496,10 @@ static void irc_event_welcome(SircSession *sirc, int event,
             srn_chat_add_misc_message_fmt(srv->chat, context,
                     _("Logging in with %1$s..."),
                     srn_login_method_to_string(srv->cfg->user->login->method));
-            // Rejoin after 8s, We hope to complete the auth within it
-            g_timeout_add(8 * 1000, rejoin_all_channels_cb, srv);
+            // Rejoin when login is confirmed, or after a while if the
+            // confirmation is never received
+            srv->rejoin_timer = g_timeout_add(SRN_SERVER_LOGIN_TIMEOUT,
+                    rejoin_all_channels_cb, srv);
             return;
         } else {
             srn_chat_add_error_message(srv->chat,
@@ -482,8 +538,18 @@ static void irc_event_nick(SircSession *sirc, const char *event,
 
         chat_user = lst->data;
         // TODO: dialog nick track support
-        srn_chat_add_misc_message_with_user_fmt(chat_user->chat, chat_user, context,
-                _("%1$s is now known as %2$s"), old_nick, new_nick);
+        if (srv_user->is_me){
+            srn_chat_add_misc_message_with_user_fmt(chat_user->chat, chat_user,
+                    context, _("%1$s is now known as %2$s"), old_nick, new_nick);
+        } else {
+            char *content;
+
+            content = g_strdup_printf(_("%1$s is now known as %2$s"),
+                    old_nick, new_nick);
+            srn_chat_add_membership_message(chat_user->chat, chat_user,
+                    SRN_CHAT_MEMBERSHIP_NICK, content, context);
+            g_free(content);
+        }
         lst = g_list_next(lst);
     }
     if (srv_user->is_me){
@@ -524,11 +590,14 @@ static void irc_event_quit(SircSession *sirc, const char *event,
 
         // TODO: dialog support
         chat_user = lst->data;
-        srn_chat_add_misc_message_with_user(chat_user->chat, chat_user, buf, context);
+        srn_chat_add_membership_message(chat_user->chat, chat_user,
+                SRN_CHAT_MEMBERSHIP_QUIT, buf, context);
         lst = g_list_next(lst);
     }
 
     srn_server_user_set_is_online(srv_user, FALSE);
+    // Away state is unknown until the user comes back
+    srn_server_user_set_is_away(srv_user, FALSE);
 
     // If the quit user is your ghost (own your exact original nick)
     // and your are using alternate nick (bacause of original nick is in use),
@@ -557,6 +626,7 @@ static void irc_event_join(SircSession *sirc, const char *event,
 
     srv_user = srn_server_add_and_get_user(srv, origin);
     srn_server_user_set_is_online(srv_user, TRUE);
+    update_user_on_join(srv, srv_user, params, count, context);
     if (srv_user->is_me) {
         /* You has join a channel */
         srn_server_add_chat(srv, chan);
@@ -577,7 +647,12 @@ static void irc_event_join(SircSession *sirc, const char *event,
     g_return_if_fail(!chat_user->is_joined);
     srn_chat_user_set_is_joined(chat_user, TRUE);
 
-    srn_chat_add_misc_message_with_user(chat, chat_user, buf, context);
+    if (srv_user->is_me) {
+        srn_chat_add_misc_message_with_user(chat, chat_user, buf, context);
+    } else {
+        srn_chat_add_membership_message(chat, chat_user,
+                SRN_CHAT_MEMBERSHIP_JOIN, buf, context);
+    }
 }
 
 static void irc_event_part(SircSession *sirc, const char *event,
@@ -608,13 +683,20 @@ static void irc_event_part(SircSession *sirc, const char *event,
         snprintf(buf, sizeof(buf), _("%1$s has left"), origin);
     }
 
-    srn_chat_add_misc_message_with_user(chat, chat_user, buf, context);
+    if (chat_user->srv_user->is_me){
+        srn_chat_add_misc_message_with_user(chat, chat_user, buf, context);
+    } else {
+        srn_chat_add_membership_message(chat, chat_user,
+                SRN_CHAT_MEMBERSHIP_PART, buf, context);
+    }
     srn_chat_user_set_is_joined(chat_user, FALSE);
 
     /* You has left a channel */
     if (chat_user->srv_user->is_me){
         srn_chat_set_is_joined(chat, FALSE);
         srn_server_rm_chat(srv, chat);
+    } else {
+        srn_chat_rm_user(chat, chat_user);
     }
 }
 
@@ -818,6 +900,7 @@ static void irc_event_kick(SircSession *sirc, const char *event,
 
     srn_chat_user_set_is_joined(kicked_chat_user, FALSE);
     srn_chat_add_error_message_with_user(chat, kick_chat_user, buf, context);
+    srn_chat_rm_user(chat, kicked_chat_user);
 }
 
 static void irc_event_channel(SircSession *sirc, const char *event,
@@ -909,6 +992,10 @@ static void irc_event_notice(SircSession *sirc, const char *event,
     g_return_if_fail(chat_user);
 
     srn_chat_add_notice_message(chat, chat_user, msg, context);
+
+    if (is_login_confirmation(srv, origin, msg)){
+        login_confirmed(srv);
+    }
 }
 
 static void irc_event_tagmsg(SircSession *sirc, const char *event,
@@ -1025,6 +1112,89 @@ static void irc_event_invite(SircSession *sirc, const char *event,
 
 }
 
+static void irc_event_away(SircSession *sirc, const char *event,
+        const char *origin, const char **params, int count,
+        const SircMessageContext *context){
+    bool away;
+    SrnServer *srv;
+    SrnServerUser *srv_user;
+    SrnChat *chat;
+
+    srv = sirc_get_ctx(sirc);
+    g_return_if_fail(srn_server_is_valid(srv));
+
+    srv_user = srn_server_get_user(srv, origin);
+    if (!srv_user){
+        // Only users sharing channels with us are notified
+        return;
+    }
+
+    // "AWAY :<message>" if user is away, "AWAY" if user is back
+    away = count >= 1 && strlen(params[0]) > 0;
+    if (srv_user->is_away == away){
+        return;
+    }
+    srn_server_user_set_is_away(srv_user, away);
+
+    // Let you know in dialog
+    chat = srn_server_get_chat(srv, origin);
+    if (!chat || chat->type != SRN_CHAT_TYPE_DIALOG){
+        return;
+    }
+    if (away){
+        srn_chat_add_misc_message_fmt(chat, context,
+                _("%1$s is away: %2$s"), origin, params[0]);
+    } else {
+        srn_chat_add_misc_message_fmt(chat, context,
+                _("%1$s is back"), origin);
+    }
+}
+
+static void irc_event_account(SircSession *sirc, const char *event,
+        const char *origin, const char **params, int count,
+        const SircMessageContext *context){
+    const char *account;
+    SrnServer *srv;
+    SrnServerUser *srv_user;
+
+    g_return_if_fail(count >= 1);
+    account = params[0];
+
+    srv = sirc_get_ctx(sirc);
+    g_return_if_fail(srn_server_is_valid(srv));
+
+    srv_user = srn_server_get_user(srv, origin);
+    if (!srv_user){
+        return;
+    }
+    // "*" means the user has logged out
+    srn_server_user_set_loginname(srv_user,
+            strcmp(account, "*") == 0 ? NULL : account);
+}
+
+static void irc_event_chghost(SircSession *sirc, const char *event,
+        const char *origin, const char **params, int count,
+        const SircMessageContext *context){
+    const char *username;
+    const char *hostname;
+    SrnServer *srv;
+    SrnServerUser *srv_user;
+
+    g_return_if_fail(count >= 2);
+    username = params[0];
+    hostname = params[1];
+
+    srv = sirc_get_ctx(sirc);
+    g_return_if_fail(srn_server_is_valid(srv));
+
+    srv_user = srn_server_get_user(srv, origin);
+    if (!srv_user){
+        return;
+    }
+    srn_server_user_set_username(srv_user, username);
+    srn_server_user_set_hostname(srv_user, hostname);
+}
+
 static void irc_event_ctcp_req(SircSession *sirc, const char *event,
         const char *origin, const char **params, int count,
         const SircMessageContext *context){
@@ -1192,9 +1362,8 @@ static void irc_event_cap(SircSession *sirc, const char *event,
 
     /* Process CAP event */
     if (g_ascii_strcasecmp(cap_event, "LS") == 0){
-        GString *buf;
+        char *reqs;
 
-        buf = g_string_new(NULL);
         for (int i = 0; caps[i]; i++){
             const char *name;
             char *value;
@@ -1205,25 +1374,30 @@ static void irc_event_cap(SircSession *sirc, const char *event,
                 *value = '\0';
                 value++; // Skip '='
             }
-            if (srn_server_cap_is_support(srv->cap, name, value)
-                    && RET_IS_OK(srn_server_cap_server_enable(srv->cap, name, TRUE))){
-                g_string_append_printf(buf, "%s ", name);
+            if (srn_server_cap_is_support(srv->cap, name, value)){
+                srn_server_cap_server_enable(srv->cap, name, TRUE);
             }
         }
 
         srn_chat_add_misc_message_fmt(srv->chat, context,
                 _("Server capabilities: %1$s"), rawcaps);
-        if (buf->len > 0){
+        if (multiline){
+            // Request after the whole list is received
+            g_strfreev(caps);
+            return;
+        }
+
+        reqs = srn_server_cap_get_requests(srv->cap);
+        if (reqs){
             srn_chat_add_misc_message_fmt(srv->chat, context,
-                    _("Requesting capabilities: %1$s"), buf->str);
-            sirc_cmd_cap_req(sirc, buf->str);
+                    _("Requesting capabilities: %1$s"), reqs);
+            pipeline_cap_negotiation(srv, reqs, context);
+            g_free(reqs);
         } else {
             srn_chat_add_misc_message_fmt(srv->chat, context,
                     _("No capability to be requested"));
             cap_end = TRUE; // It's time to end the negotiation
         }
-
-        g_string_free(buf, TRUE);
     } else if (g_ascii_strcasecmp(cap_event, "NEW") == 0){
         GString *buf;
 
@@ -1327,25 +1501,14 @@ static void irc_event_cap(SircSession *sirc, const char *event,
     if (!srv->negotiated && cap_end){
         sirc_cmd_cap_list(sirc);
 
-        SrnLoginMethod method = srv->cfg->user->login->method;
-
-        switch (method) {
-            case SRN_LOGIN_METHOD_SASL_PLAIN:
-            case SRN_LOGIN_METHOD_SASL_ECDSA_NIST256P_CHALLENGE:
-            case SRN_LOGIN_METHOD_SASL_EXTERNAL:
-                if (srv->cap->client_enabled.sasl){
-                    // Negotiation should end after sasl authentication end
-                } else {
-                    srn_chat_add_error_message_fmt(srv->chat, context,
-                            _("SASL authentication is not supported on this server, login skipped"));
-                    sirc_cmd_cap_end(sirc); // End negotiation
-                    srv->negotiated = TRUE;
-                }
-                break;
-            default:
-                sirc_cmd_cap_end(sirc); // End negotiation
-                srv->negotiated = TRUE;
+        if (!srn_login_method_is_sasl(srv->cfg->user->login->method)){
+            end_cap_negotiation(srv);
+        } else if (!srv->cap->client_enabled.sasl){
+            srn_chat_add_error_message_fmt(srv->chat, context,
+                    _("SASL authentication is not supported on this server, login skipped"));
+            end_cap_negotiation(srv);
         }
+        // Else negotiation should end after sasl authentication end
     }
 
     g_strfreev(caps);
@@ -1521,6 +1684,37 @@ static void irc_event_error(SircSession *sirc, const char *event,
             _("ERROR: %1$s"), msg);
 }
 
+/**
+ * @brief irc_event_batch handles a batch as a whole, a netsplit or netjoin
+ * results in one summary per chat rather than one message per user, and
+ * messages of a chathistory batch are prepended to chat.
+ */
+static void irc_event_batch(SircSession *sirc, const char *event,
+        const char **params, int count, const SircBatch *batch,
+        const SircMessageContext *context){
+    const char *server1;
+    const char *server2;
+    SrnServer *srv;
+
+    srv = sirc_get_ctx(sirc);
+    g_return_if_fail(srn_server_is_valid(srv));
+
+    // "BATCH +ref netsplit|netjoin <server1> <server2>"
+    server1 = count >= 1 ? params[0] : "*";
+    server2 = count >= 2 ? params[1] : "*";
+
+    if (g_ascii_strcasecmp(event, "netsplit") == 0){
+        handle_netsplit(srv, server1, server2, batch, context);
+    } else if (g_ascii_strcasecmp(event, "netjoin") == 0){
+        handle_netjoin(srv, server1, server2, batch, context);
+    } else if (g_ascii_strcasecmp(event, "chathistory") == 0){
+        // "BATCH +ref chathistory <target>"
+        handle_chathistory(srv, count >= 1 ? params[0] : NULL, batch);
+    } else {
+        WARN_FR("Unsupported batch type: %s", event);
+    }
+}
+
 static void irc_event_numeric(SircSession *sirc, int event,
         const char *origin, const char **params, int count,
         const SircMessageContext *context){
@@ -1554,6 +1748,16 @@ static void irc_event_numeric(SircSession *sirc, int event,
                     if (!strcmp(key, "UTF8ONLY")){
                         /* https://ircv3.net/specs/extensions/utf8-only */
                         str_assign(&srv->cfg->irc->encoding, "utf-8");
+                    } else if (!strcmp(key, "CASEMAPPING")){
+                        SrnCasemapping casemapping;
+
+                        if (srn_casemapping_from_string(value, &casemapping)){
+                            srn_server_set_casemapping(srv, casemapping);
+                        }
+                    } else if (!strcmp(key, "MONITOR")){
+                        /* https://ircv3.net/specs/core/monitor-3.2 */
+                        srn_server_monitor_set_limit(srv->monitor,
+                                strlen(value) ? atoi(value) : -1);
                     }
 
                     g_free(key);
@@ -1638,34 +1842,19 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 for (nickptr = strtok(dup_names, " ");
                         nickptr;
                         nickptr = strtok(NULL, " ")){
-                    switch (nickptr[0]){
-                        case '~':
-                            nickptr++;
-                            type = SRN_CHAT_USER_TYPE_OWNER;
-                            break;
-                        case '&':
-                            nickptr++;
-                            type = SRN_CHAT_USER_TYPE_ADMIN;
-                            break;
-                        case '@':
-                            nickptr++;
-                            type = SRN_CHAT_USER_TYPE_FULL_OP;
-                            break;
-                        case '%':
-                            nickptr++;
-                            type = SRN_CHAT_USER_TYPE_HALF_OP;
-                            break;
-                        case '+':
-                            nickptr++;
-                            type = SRN_CHAT_USER_TYPE_VOICED;
-                            break;
-                        default:
-                            type = SRN_CHAT_USER_TYPE_CHIGUA;
-                    }
-                    srv_user = srn_server_add_and_get_user(srv, nickptr);
+                    char *nick;
+                    char *username;
+                    char *hostname;
+
+                    nick = parse_names_entry(nickptr, &type, &username, &hostname);
+                    srv_user = srn_server_add_and_get_user(srv, nick);
                     g_warn_if_fail(srv_user);
                     if (!srv_user) continue;
                     srn_server_user_set_is_online(srv_user, TRUE);
+                    if (username && hostname){
+                        srn_server_user_set_username(srv_user, username);
+                        srn_server_user_set_hostname(srv_user, hostname);
+                    }
 
                     chat_user = srn_chat_add_and_get_user(chat, srv_user);
                     g_warn_if_fail(chat_user);
@@ -1844,15 +2033,32 @@ static void irc_event_numeric(SircSession *sirc, int event,
             /************************ WHO message ************************/
         case SIRC_RFC_RPL_WHOREPLY:
             {
-                // const char *nick;
-                // const char *realname;
+                const char *username;
+                const char *hostname;
+                const char *nick;
+                const char *flags;
+                const char *realname;
+                SrnServerUser *srv_user;
 
-                g_return_if_fail(count >= 7);
-                // nick = params[5];
-                // params[count - 1] = "<hopcount> <realname>", Skip ' '
-                // realname = strchr(params[6], ' ');
+                g_return_if_fail(count >= 8);
+                username = params[2];
+                hostname = params[3];
+                nick = params[5];
+                flags = params[6];
+                // params[7] = "<hopcount> <realname>", Skip ' '
+                realname = strchr(params[7], ' ');
 
-                // TODO
+                srv_user = srn_server_get_user(srv, nick);
+                if (!srv_user){
+                    break;
+                }
+                srn_server_user_set_username(srv_user, username);
+                srn_server_user_set_hostname(srv_user, hostname);
+                if (realname){
+                    srn_server_user_set_realname(srv_user, realname + 1);
+                }
+                // "H" for here, "G" for gone
+                srn_server_user_set_is_away(srv_user, flags[0] == 'G');
                 break;
             }
         case SIRC_RFC_RPL_ENDOFWHO:
@@ -1940,6 +2146,7 @@ static void irc_event_numeric(SircSession *sirc, int event,
 
                 srv->loggedin = TRUE;
                 srn_chat_add_recv_message(srv->chat, chat_user, msg, context);
+                login_confirmed(srv);
                 break;
             }
         case SIRC_RFC_RPL_SASLSUCCESS:
@@ -1950,7 +2157,7 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 msg = params[1];
 
                 // See also: https://github.com/SrainApp/srain/issues/371
-                sirc_cmd_cap_end(sirc); // End negotiation
+                end_cap_negotiation(srv);
                 srn_chat_add_recv_message(srv->chat, chat_user, msg, context);
                 break;
             }
@@ -1971,7 +2178,7 @@ static void irc_event_numeric(SircSession *sirc, int event,
         case SIRC_RFC_RPL_SASLMECHS:
         case SIRC_RFC_ERR_SASLABORTED:
             {
-                sirc_cmd_cap_end(sirc); // End negotiation
+                end_cap_negotiation(srv);
                 add_numeric_error_message(srv->chat, event, origin, params, count, context);
                 break;
             }
@@ -2003,6 +2210,7 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 chat_user = srn_chat_add_and_get_user(chat, srv_user);
                 g_return_if_fail(chat_user);
 
+                srn_server_user_set_is_away(srv_user, TRUE);
                 srn_chat_add_error_message_with_user_fmt(chat, chat_user, context,
                         _("%1$s is away: %2$s"), nick, msg);
                 break;
@@ -2014,6 +2222,7 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 g_return_if_fail(count >= 2);
                 msg = params[1];
 
+                srn_server_user_set_is_away(srv->user, TRUE);
                 srn_chat_add_misc_message(srv->chat, msg, context);
                 break;
             }
@@ -2024,9 +2233,40 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 g_return_if_fail(count >= 2);
                 msg = params[1];
 
+                srn_server_user_set_is_away(srv->user, FALSE);
                 srn_chat_add_misc_message(srv->chat, msg, context);
                 break;
             }
+            /************************ MONITOR message ************************/
+        case SIRC_RFC_RPL_MONONLINE:
+        case SIRC_RFC_RPL_MONOFFLINE:
+            {
+                // <nick> :target[!user@host][,target[!user@host]]*
+                g_return_if_fail(count >= 2);
+
+                update_monitored_users(srv, params[1],
+                        event == SIRC_RFC_RPL_MONONLINE, context);
+                break;
+            }
+        case SIRC_RFC_RPL_MONLIST:
+        case SIRC_RFC_RPL_ENDOFMONLIST:
+            {
+                break;
+            }
+        case SIRC_RFC_ERR_MONLISTFULL:
+            {
+                const char *targets;
+
+                // <nick> <limit> <targets> :Monitor list is full
+                g_return_if_fail(count >= 3);
+                targets = params[2];
+
+                srn_server_monitor_reject(srv->monitor, targets);
+                srn_chat_add_error_message_fmt(srv->chat, context,
+                        _("Monitor list is full, failed to watch: %1$s"),
+                        targets);
+                break;
+            }
             /************************ MISC message ************************/
         case SIRC_RFC_RPL_CHANNEL_URL:
             {
@@ -2184,22 +2424,515 @@ static void add_numeric_error_message(SrnChat *chat, int event, const char
  * @brief Rejoin all channels already exist
  */
 static void rejoin_all_channels(SrnServer *srv) {
+    GPtrArray *chans;
+    GPtrArray *passwds;
+
     DBG_FR("Rejoining all channels already exist....");
 
+    if (srv->rejoin_timer){
+        g_source_remove(srv->rejoin_timer);
+        srv->rejoin_timer = 0;
+    }
+
+    chans = g_ptr_array_new();
+    passwds = g_ptr_array_new();
     GList *list = srv->chat_list;
     while (list){
         SrnChat *chat = list->data;
         if (sirc_target_is_channel(srv->irc, chat->name)){
-            sirc_cmd_join(srv->irc, chat->name, chat->cfg->password);
+            g_ptr_array_add(chans, chat->name);
+            g_ptr_array_add(passwds, chat->cfg->password);
         }
         list = g_list_next(list);
     }
+
+    // Packed into a few JOINs and sent with flood control
+    sirc_cmd_join_all(srv->irc, (const char **)chans->pdata,
+            (const char **)passwds->pdata, chans->len);
+
+    g_ptr_array_free(chans, TRUE);
+    g_ptr_array_free(passwds, TRUE);
 }
 
 /**
  * @brief Timer callback wrapper for rejoin_all_channels.
  */
 static gboolean rejoin_all_channels_cb(gpointer user_data) {
-    rejoin_all_channels(user_data);
+    SrnServer *srv;
+
+    srv = user_data;
+    srv->rejoin_timer = 0;
+    rejoin_all_channels(srv);
+
     return G_SOURCE_REMOVE;
 }
+
+/**
+ * @brief login_confirmed rejoins channels at once if we are waiting for login,
+ * so channels which require an identified account can be joined.
+ */
+static void login_confirmed(SrnServer *srv) {
+    if (!srv->rejoin_timer){
+        return;
+    }
+    rejoin_all_channels(srv);
+}
+
+/**
+ * @brief is_login_confirmation checks whether a notice from NickServ tells
+ * that we are identified. Services send RPL_LOGGEDIN as well on most networks,
+ * this is for those do not.
+ */
+static bool is_login_confirmation(SrnServer *srv, const char *origin,
+        const char *msg) {
+    if (!sirc_target_is_service(srv->irc, origin)
+            || g_ascii_strcasecmp(origin, "NickServ") != 0){
+        return FALSE;
+    }
+
+    // Atheme: "You are now identified for ...",
+    // Anope: "Password accepted - you are now recognized."
+    return strstr(msg, "now identified") || strstr(msg, "now recognized")
+        || strstr(msg, "Password accepted");
+}
+
+/**
+ * @brief pipeline_cap_negotiation sends the rest of negotiation along with
+ * "CAP REQ" in one write instead of waiting for "CAP ACK". Server processes
+ * commands in order, so "AUTHENTICATE" sees the requested "sasl", and
+ * "CAP END" can be sent before "CAP ACK" is received.
+ *
+ * If the request is rejected, the pending authentication fails and
+ * "CAP NAK" ends the negotiation as usual.
+ */
+static void pipeline_cap_negotiation(SrnServer *srv, const char *reqs,
+        const SircMessageContext *context){
+    sirc_cork(srv->irc);
+
+    sirc_cmd_cap_req(srv->irc, reqs);
+    if (!srn_login_method_is_sasl(srv->cfg->user->login->method)){
+        sirc_cmd_cap_list(srv->irc);
+        end_cap_negotiation(srv);
+    } else if (!srn_server_cap_begin_sasl(srv->cap)){
+        srn_chat_add_error_message_fmt(srv->chat, context,
+                _("SASL authentication is not supported on this server, login skipped"));
+        sirc_cmd_cap_list(srv->irc);
+        end_cap_negotiation(srv);
+    }
+    // Else negotiation should end after sasl authentication end
+
+    sirc_uncork(srv->irc);
+}
+
+/**
+ * @brief end_cap_negotiation sends "CAP END" once per connection.
+ */
+static void end_cap_negotiation(SrnServer *srv){
+    if (srv->negotiated){
+        return;
+    }
+    sirc_cmd_cap_end(srv->irc);
+    srv->negotiated = TRUE;
+}
+
+static void handle_netsplit(SrnServer *srv, const char *server1,
+        const char *server2, const SircBatch *batch,
+        const SircMessageContext *context){
+    GHashTable *chat_nicks;
+
+    // SrnChat -> GPtrArray of nicks
+    chat_nicks = g_hash_table_new_full(NULL, NULL,
+            NULL, (GDestroyNotify)g_ptr_array_unref);
+
+    for (int i = 0; i < sirc_batch_get_length(batch); i++){
+        const char *origin;
+        SrnServerUser *srv_user;
+
+        if (g_ascii_strcasecmp(sirc_batch_get_command(batch, i), "QUIT") != 0){
+            WARN_FR("Unexpected command in netsplit: %s",
+                    sirc_batch_get_command(batch, i));
+            continue;
+        }
+        origin = sirc_batch_get_origin(batch, i);
+        srv_user = srn_server_get_user(srv, origin);
+        if (!srv_user){
+            continue;
+        }
+
+        for (GList *lst = srv_user->chat_user_list; lst; lst = g_list_next(lst)){
+            GPtrArray *nicks;
+            SrnChatUser *chat_user;
+
+            chat_user = lst->data;
+            nicks = g_hash_table_lookup(chat_nicks, chat_user->chat);
+            if (!nicks){
+                nicks = g_ptr_array_new();
+                g_hash_table_insert(chat_nicks, chat_user->chat, nicks);
+            }
+            g_ptr_array_add(nicks, (char *)origin);
+        }
+
+        srn_server_user_set_is_online(srv_user, FALSE);
+        srn_server_user_set_is_away(srv_user, FALSE);
+
+        // See irc_event_quit()
+        if (g_strcmp0(srv->cfg->user->nick, origin) == 0
+                && srn_user_config_is_alternate_nick(srv->cfg->user,
+                    srv->user->nick)) {
+            sirc_cmd_nick(srv->irc, srv->cfg->user->nick);
+        }
+    }
+
+    add_batch_summaries(srv, chat_nicks,
+            _("%1$d users have quit due to netsplit between %2$s and %3$s: %4$s"),
+            server1, server2, context);
+    g_hash_table_destroy(chat_nicks);
+}
+
+static void handle_netjoin(SrnServer *srv, const char *server1,
+        const char *server2, const SircBatch *batch,
+        const SircMessageContext *context){
+    GHashTable *chat_nicks;
+
+    // SrnChat -> GPtrArray of nicks
+    chat_nicks = g_hash_table_new_full(NULL, NULL,
+            NULL, (GDestroyNotify)g_ptr_array_unref);
+
+    for (int i = 0; i < sirc_batch_get_length(batch); i++){
+        int count;
+        const char *origin;
+        const char **params;
+        GPtrArray *nicks;
+        SrnChat *chat;
+        SrnServerUser *srv_user;
+        SrnChatUser *chat_user;
+
+        origin = sirc_batch_get_origin(batch, i);
+        params = sirc_batch_get_params(batch, i, &count);
+        if (g_ascii_strcasecmp(sirc_batch_get_command(batch, i), "JOIN") != 0
+                || count < 1){
+            WARN_FR("Unexpected command in netjoin: %s",
+                    sirc_batch_get_command(batch, i));
+            continue;
+        }
+
+        srv_user = srn_server_add_and_get_user(srv, origin);
+        if (srv_user->is_me){
+            irc_event_join(srv->irc, "JOIN", origin, params, count, context);
+            continue;
+        }
+        srn_server_user_set_is_online(srv_user, TRUE);
+        update_user_on_join(srv, srv_user, params, count,
+                sirc_batch_get_context(batch, i));
+
+        chat = srn_server_get_chat(srv, params[0]);
+        if (!chat){
+            continue;
+        }
+        chat_user = srn_chat_add_and_get_user(chat, srv_user);
+        if (chat_user->is_joined){
+            continue;
+        }
+        srn_chat_user_set_is_joined(chat_user, TRUE);
+
+        nicks = g_hash_table_lookup(chat_nicks, chat);
+        if (!nicks){
+            nicks = g_ptr_array_new();
+            g_hash_table_insert(chat_nicks, chat, nicks);
+        }
+        g_ptr_array_add(nicks, (char *)origin);
+    }
+
+    add_batch_summaries(srv, chat_nicks,
+            _("%1$d users have rejoined after netsplit between %2$s and %3$s: %4$s"),
+            server1, server2, context);
+    g_hash_table_destroy(chat_nicks);
+}
+
+static void handle_chathistory(SrnServer *srv, const char *target,
+        const SircBatch *batch){
+    int len;
+    SrnChat *chat;
+
+    g_return_if_fail(target);
+    chat = srn_server_get_chat(srv, target);
+    if (!chat){
+        WARN_FR("No such chat: %s", target);
+        return;
+    }
+
+    // Messages are in chronological order, prepend them from the newest
+    len = sirc_batch_get_length(batch);
+    for (int i = len - 1; i >= 0; i--){
+        int count;
+        char *content;
+        const char *cmd;
+        const char *origin;
+        const char **params;
+        SrnMessageType type;
+        SrnServerUser *srv_user;
+
+        cmd = sirc_batch_get_command(batch, i);
+        origin = sirc_batch_get_origin(batch, i);
+        params = sirc_batch_get_params(batch, i, &count);
+        if (count < 2){
+            continue;
+        }
+
+        if (g_ascii_strcasecmp(cmd, "PRIVMSG") == 0){
+            srv_user = srn_server_get_user(srv, origin);
+            type = srv_user && srv_user->is_me
+                ? SRN_MESSAGE_TYPE_SENT
+                : SRN_MESSAGE_TYPE_RECV;
+        } else if (g_ascii_strcasecmp(cmd, "NOTICE") == 0){
+            type = SRN_MESSAGE_TYPE_NOTICE;
+        } else {
+            // Other events are not shown in history
+            continue;
+        }
+
+        if (params[1][0] == '\1'){
+            // Only CTCP ACTION is shown
+            if (!g_str_has_prefix(params[1], "\1ACTION ")){
+                continue;
+            }
+            content = g_strdup(params[1] + strlen("\1ACTION "));
+            if (g_str_has_suffix(content, "\1")){
+                content[strlen(content) - 1] = '\0';
+            }
+            type = SRN_MESSAGE_TYPE_ACTION;
+        } else {
+            content = g_strdup(params[1]);
+        }
+
+        srn_chat_add_history_message(chat, origin, type, content,
+                sirc_batch_get_context(batch, i));
+        g_free(content);
+    }
+
+    // Exhaustion is decided by the messages returned by server, even if
+    // none of them is added
+    srn_chat_end_history(chat, len,
+            len > 0 ? sirc_batch_get_context(batch, 0) : NULL);
+}
+
+/**
+ * @brief add_batch_summaries adds one misc message to every chat in
+ * chat_nicks, which lists nicks involved in the chat.
+ *
+ * @param srv
+ * @param chat_nicks SrnChat -> GPtrArray of nicks
+ * @param fmt Format string with number of nicks, server1, server2 and nicks
+ * @param server1
+ * @param server2
+ * @param context
+ */
+static void add_batch_summaries(SrnServer *srv, GHashTable *chat_nicks,
+        const char *fmt, const char *server1, const char *server2,
+        const SircMessageContext *context){
+    // Follow order of chat list
+    for (GList *lst = srv->chat_list; lst; lst = g_list_next(lst)){
+        char *str;
+        GString *buf;
+        GPtrArray *nicks;
+        SrnChat *chat;
+
+        chat = lst->data;
+        nicks = g_hash_table_lookup(chat_nicks, chat);
+        if (!nicks){
+            continue;
+        }
+
+        buf = g_string_new(NULL);
+        for (guint i = 0; i < MIN(nicks->len, BATCH_SUMMARY_MAX_NICKS); i++){
+            if (i > 0){
+                g_string_append(buf, ", ");
+            }
+            g_string_append(buf, nicks->pdata[i]);
+        }
+        if (nicks->len > BATCH_SUMMARY_MAX_NICKS){
+            str = g_strdup_printf(_("%1$s and %2$d more"), buf->str,
+                    nicks->len - BATCH_SUMMARY_MAX_NICKS);
+        } else {
+            str = g_strdup(buf->str);
+        }
+
+        srn_chat_add_misc_message_fmt(chat, context, fmt,
+                nicks->len, server1, server2, str);
+
+        g_free(str);
+        g_string_free(buf, TRUE);
+    }
+}
+
+/**
+ * @brief update_user_on_join updates user information carried by JOIN
+ * message: "nick!user@host" prefix, and account name and realname when
+ * IRCv3 "extended-join" is enabled, so that we need not WHO every member.
+ *
+ * @param srv
+ * @param srv_user
+ * @param params Parameters of JOIN message
+ * @param count
+ * @param context
+ */
+static void update_user_on_join(SrnServer *srv, SrnServerUser *srv_user,
+        const char **params, int count, const SircMessageContext *context){
+    const char *username;
+    const char *hostname;
+
+    username = sirc_message_context_get_user(context);
+    hostname = sirc_message_context_get_host(context);
+    if (username && hostname){
+        srn_server_user_set_username(srv_user, username);
+        srn_server_user_set_hostname(srv_user, hostname);
+    }
+
+    // "JOIN <channel> <account> :<realname>", "*" means not logged in
+    if (srv->cap->client_enabled.extended_join && count >= 3){
+        srn_server_user_set_loginname(srv_user,
+                strcmp(params[1], "*") == 0 ? NULL : params[1]);
+        srn_server_user_set_realname(srv_user, params[2]);
+    }
+}
+
+/**
+ * @brief parse_names_entry parses a member of RPL_NAMREPLY in place. With
+ * IRCv3 "multi-prefix", all prefixes of the member are listed in order of
+ * rank; With "userhost-in-names", nick is followed by "!user@host".
+ *
+ * @param entry Like "@+nick!user@host", it is modified
+ * @param type Returns type of the highest prefix
+ * @param user Returns username, NULL if not given
+ * @param host Returns hostname, NULL if not given
+ *
+ * @return Nickname in entry
+ */
+static char* parse_names_entry(char *entry, SrnChatUserType *type,
+        char **user, char **host){
+    char *nick;
+    char *ptr;
+
+    *type = SRN_CHAT_USER_TYPE_CHIGUA;
+    *user = NULL;
+    *host = NULL;
+
+    for (nick = entry; *nick; nick++){
+        SrnChatUserType prefix_type;
+
+        switch (*nick){
+            case '~':
+                prefix_type = SRN_CHAT_USER_TYPE_OWNER;
+                break;
+            case '&':
+                prefix_type = SRN_CHAT_USER_TYPE_ADMIN;
+                break;
+            case '@':
+                prefix_type = SRN_CHAT_USER_TYPE_FULL_OP;
+                break;
+            case '%':
+                prefix_type = SRN_CHAT_USER_TYPE_HALF_OP;
+                break;
+            case '+':
+                prefix_type = SRN_CHAT_USER_TYPE_VOICED;
+                break;
+            default:
+                prefix_type = SRN_CHAT_USER_TYPE_CHIGUA;
+        }
+        if (prefix_type == SRN_CHAT_USER_TYPE_CHIGUA){
+            break;
+        }
+        // The first prefix is the highest one
+        if (*type == SRN_CHAT_USER_TYPE_CHIGUA){
+            *type = prefix_type;
+        }
+    }
+
+    ptr = strchr(nick, '!');
+    if (ptr){
+        *ptr++ = '\0';
+        *user = ptr;
+        ptr = strchr(ptr, '@');
+        if (ptr){
+            *ptr++ = '\0';
+            *host = ptr;
+        }
+    }
+
+    return nick;
+}
+
+/**
+ * @brief update_monitored_users updates presence of users reported by
+ * RPL_MONONLINE or RPL_MONOFFLINE.
+ *
+ * @param srv
+ * @param targets Like "nick!user@host,nick2", "!user@host" is not given
+ *      for offline users
+ * @param online
+ * @param context
+ */
+static void update_monitored_users(SrnServer *srv, const char *targets,
+        bool online, const SircMessageContext *context){
+    char **strv;
+
+    strv = g_strsplit(targets, ",", 0);
+    for (int i = 0; strv[i]; i++){
+        char *nick;
+        char *user;
+        char *host;
+        bool changed;
+        SrnChat *chat;
+        SrnServerUser *srv_user;
+
+        nick = strv[i];
+        user = NULL;
+        host = NULL;
+        if ((user = strchr(nick, '!'))){
+            *user++ = '\0';
+            if ((host = strchr(user, '@'))){
+                *host++ = '\0';
+            }
+        }
+        if (str_is_empty(nick)){
+            continue;
+        }
+
+        srv_user = srn_server_add_and_get_user(srv, nick);
+        if (!srv_user){
+            continue;
+        }
+        changed = srv_user->is_online != online;
+        if (user){
+            srn_server_user_set_username(srv_user, user);
+        }
+        if (host){
+            srn_server_user_set_hostname(srv_user, host);
+        }
+        if (!online){
+            srn_server_user_set_is_away(srv_user, FALSE);
+        }
+        srn_server_user_set_is_online(srv_user, online);
+
+        // The user may have been swept since last report, so its presence
+        // is not changed, but the dialog still needs to know
+        chat = srn_server_get_chat(srv, nick);
+        if (chat && chat->type == SRN_CHAT_TYPE_DIALOG){
+            sui_set_presence(chat->ui, online, srv_user->is_away);
+        }
+
+        // Nicks listed in configuration are reported in server chat
+        if (!changed || !g_list_find_custom(srv->cfg->monitor_list, nick,
+                    (GCompareFunc)g_ascii_strcasecmp)){
+            continue;
+        }
+        if (online){
+            srn_chat_add_misc_message_fmt(srv->chat, context,
+                    _("%1$s is online"), nick);
+        } else {
+            srn_chat_add_misc_message_fmt(srv->chat, context,
+                    _("%1$s is offline"), nick);
+        }
+    }
+    g_strfreev(strv);
+}
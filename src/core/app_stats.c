@@ -0,0 +1,378 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file app_stats.c
+ * @brief Statistics of IRC sessions, shown by "/stats server" and
+ * periodically exported to file.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-16
+ */
+
+#include <glib.h>
+
+#include "core/core.h"
+#include "sirc/sirc.h"
+#include "log.h"
+#include "i18n.h"
+#include "utils.h"
+
+typedef struct _StatsMetric StatsMetric;
+
+struct _StatsMetric {
+    const char *name;
+    const char *type;   // Metric type of OpenMetrics: "counter" or "gauge"
+    const char *help;
+    double (*get) (SrnServer *srv);
+};
+
+static gboolean on_stats_timeout(gpointer user_data);
+static void sample_server(SrnServer *srv);
+static void write_stats_file(SrnApplication *app);
+static void append_escaped(GString *str, const char *val,
+        SrnStatsFormat fmt);
+
+static double get_bytes_in(SrnServer *srv);
+static double get_bytes_out(SrnServer *srv);
+static double get_lines_in(SrnServer *srv);
+static double get_lines_out(SrnServer *srv);
+static double get_parse_failures(SrnServer *srv);
+static double get_lines_per_sec(SrnServer *srv);
+static double get_ping_rtt(SrnServer *srv);
+static double get_reconnects(SrnServer *srv);
+static double get_connected(SrnServer *srv);
+static double get_interned_strings(SrnServer *srv);
+static double get_interned_bytes(SrnServer *srv);
+static double get_users(SrnServer *srv);
+static double get_reclaimed_users(SrnServer *srv);
+static double get_send_queue(SrnServer *srv);
+
+static const StatsMetric metrics[] = {
+    {
+        .name = "received_bytes",
+        .type = "counter",
+        .help = "Bytes received from server",
+        .get = get_bytes_in,
+    },
+    {
+        .name = "sent_bytes",
+        .type = "counter",
+        .help = "Bytes sent to server",
+        .get = get_bytes_out,
+    },
+    {
+        .name = "received_lines",
+        .type = "counter",
+        .help = "Lines received from server",
+        .get = get_lines_in,
+    },
+    {
+        .name = "sent_lines",
+        .type = "counter",
+        .help = "Lines sent to server",
+        .get = get_lines_out,
+    },
+    {
+        .name = "parse_failures",
+        .type = "counter",
+        .help = "Received lines which can not be parsed",
+        .get = get_parse_failures,
+    },
+    {
+        .name = "received_lines_per_second",
+        .type = "gauge",
+        .help = "Received lines per second during last sampling interval",
+        .get = get_lines_per_sec,
+    },
+    {
+        .name = "ping_rtt_milliseconds",
+        .type = "gauge",
+        .help = "Round-trip time of last PING",
+        .get = get_ping_rtt,
+    },
+    {
+        .name = "reconnects",
+        .type = "counter",
+        .help = "Reconnect attempts",
+        .get = get_reconnects,
+    },
+    {
+        .name = "connected",
+        .type = "gauge",
+        .help = "Whether the server is connected",
+        .get = get_connected,
+    },
+    {
+        .name = "interned_strings",
+        .type = "gauge",
+        .help = "Distinct nicks, hostnames and chat names in memory",
+        .get = get_interned_strings,
+    },
+    {
+        .name = "interned_bytes",
+        .type = "gauge",
+        .help = "Memory used by interned strings",
+        .get = get_interned_bytes,
+    },
+    {
+        .name = "users",
+        .type = "gauge",
+        .help = "Users of server in memory",
+        .get = get_users,
+    },
+    {
+        .name = "reclaimed_users",
+        .type = "counter",
+        .help = "Users freed since they are no longer referenced",
+        .get = get_reclaimed_users,
+    },
+    {
+        .name = "send_queue_lines",
+        .type = "gauge",
+        .help = "Lines held by flood control",
+        .get = get_send_queue,
+    },
+    { NULL },
+};
+
+/**
+ * @brief srn_application_init_stats (re)starts the timer for sampling
+ * statistics, should be called again when application config is changed.
+ *
+ * @param app
+ */
+void srn_application_init_stats(SrnApplication *app){
+    if (app->stats_timer){
+        g_source_remove(app->stats_timer);
+        app->stats_timer = 0;
+    }
+    g_return_if_fail(app->cfg->stats_interval > 0);
+
+    app->stats_timer = g_timeout_add_seconds(app->cfg->stats_interval,
+            on_stats_timeout, app);
+}
+
+/**
+ * @brief srn_application_dump_stats appends statistics of all servers to the
+ * given string.
+ *
+ * @param app
+ * @param str
+ * @param fmt
+ */
+void srn_application_dump_stats(SrnApplication *app, GString *str,
+        SrnStatsFormat fmt){
+    GList *lst;
+
+    switch (fmt) {
+        case SRN_STATS_FORMAT_TEXT:
+            for (lst = app->srv_list; lst; lst = g_list_next(lst)){
+                SrnServer *srv = lst->data;
+
+                g_string_append_printf(str, _("\nServer %1$s:"), srv->name);
+                for (int i = 0; metrics[i].name; i++){
+                    g_string_append_printf(str, "\n  * %s: %.15g",
+                            metrics[i].name, metrics[i].get(srv));
+                }
+            }
+            break;
+        case SRN_STATS_FORMAT_JSON:
+            g_string_append(str, "{\"servers\":[");
+            for (lst = app->srv_list; lst; lst = g_list_next(lst)){
+                SrnServer *srv = lst->data;
+
+                g_string_append(str, "{\"name\":\"");
+                append_escaped(str, srv->name, SRN_STATS_FORMAT_JSON);
+                g_string_append_c(str, '"');
+                for (int i = 0; metrics[i].name; i++){
+                    g_string_append_printf(str, ",\"%s\":%.15g",
+                            metrics[i].name, metrics[i].get(srv));
+                }
+                g_string_append_c(str, '}');
+                if (g_list_next(lst)){
+                    g_string_append_c(str, ',');
+                }
+            }
+            g_string_append(str, "]}\n");
+            break;
+        case SRN_STATS_FORMAT_OPENMETRICS:
+            // Samples of the same metric family must be grouped together
+            for (int i = 0; metrics[i].name; i++){
+                g_string_append_printf(str, "# TYPE srain_%s %s\n",
+                        metrics[i].name, metrics[i].type);
+                g_string_append_printf(str, "# HELP srain_%s %s\n",
+                        metrics[i].name, metrics[i].help);
+                for (lst = app->srv_list; lst; lst = g_list_next(lst)){
+                    SrnServer *srv = lst->data;
+
+                    g_string_append_printf(str, "srain_%s%s{server=\"",
+                            metrics[i].name,
+                            g_strcmp0(metrics[i].type, "counter") == 0
+                            ? "_total" : "");
+                    append_escaped(str, srv->name,
+                            SRN_STATS_FORMAT_OPENMETRICS);
+                    g_string_append_printf(str, "\"} %.15g\n",
+                            metrics[i].get(srv));
+                }
+            }
+            g_string_append(str, "# EOF\n");
+            break;
+        default:
+            g_warn_if_reached();
+    }
+}
+
+static gboolean on_stats_timeout(gpointer user_data){
+    GList *lst;
+    SrnApplication *app;
+
+    app = user_data;
+    for (lst = app->srv_list; lst; lst = g_list_next(lst)){
+        sample_server(lst->data);
+    }
+    if (!str_is_empty(app->cfg->stats_file)){
+        write_stats_file(app);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void sample_server(SrnServer *srv){
+    gint64 now;
+    const SircStats *stats;
+
+    now = g_get_monotonic_time();
+    stats = sirc_get_stats(srv->irc);
+    g_return_if_fail(stats);
+
+    if (srv->sampled_time && now > srv->sampled_time){
+        srv->lines_per_sec = (stats->lines_in - srv->sampled_lines_in)
+            * (double)G_USEC_PER_SEC / (now - srv->sampled_time);
+    }
+    srv->sampled_lines_in = stats->lines_in;
+    srv->sampled_time = now;
+}
+
+static void write_stats_file(SrnApplication *app){
+    GError *err;
+    GString *str;
+    SrnStatsFormat fmt;
+
+    fmt = SRN_STATS_FORMAT_JSON;
+    if (g_strcmp0(app->cfg->stats_format, "openmetrics") == 0){
+        fmt = SRN_STATS_FORMAT_OPENMETRICS;
+    }
+
+    str = g_string_new(NULL);
+    srn_application_dump_stats(app, str, fmt);
+
+    err = NULL;
+    // g_file_set_contents() replaces file atomically, scraper never sees a
+    // half written file
+    if (!g_file_set_contents(app->cfg->stats_file, str->str, str->len, &err)){
+        WARN_FR("Failed to write stats file '%s': %s",
+                app->cfg->stats_file, err->message);
+        g_error_free(err);
+    }
+
+    g_string_free(str, TRUE);
+}
+
+/* Escape string for JSON string or OpenMetrics label value. Both escape
+ * '\\', '"' and newline, JSON also requires other control characters to be
+ * escaped, which OpenMetrics does not allow, they are passed through */
+static void append_escaped(GString *str, const char *val,
+        SrnStatsFormat fmt){
+    for (const char *ptr = val; *ptr; ptr++){
+        switch (*ptr){
+            case '"':
+                g_string_append(str, "\\\"");
+                break;
+            case '\\':
+                g_string_append(str, "\\\\");
+                break;
+            case '\n':
+                g_string_append(str, "\\n");
+                break;
+            default:
+                if ((unsigned char)*ptr < 0x20
+                        && fmt == SRN_STATS_FORMAT_JSON){
+                    g_string_append_printf(str, "\\u%04x", *ptr);
+                } else {
+                    g_string_append_c(str, *ptr);
+                }
+        }
+    }
+}
+
+static double get_bytes_in(SrnServer *srv){
+    return sirc_get_stats(srv->irc)->bytes_in;
+}
+
+static double get_bytes_out(SrnServer *srv){
+    return sirc_get_stats(srv->irc)->bytes_out;
+}
+
+static double get_lines_in(SrnServer *srv){
+    return sirc_get_stats(srv->irc)->lines_in;
+}
+
+static double get_lines_out(SrnServer *srv){
+    return sirc_get_stats(srv->irc)->lines_out;
+}
+
+static double get_parse_failures(SrnServer *srv){
+    return sirc_get_stats(srv->irc)->parse_failures;
+}
+
+static double get_lines_per_sec(SrnServer *srv){
+    return srv->lines_per_sec;
+}
+
+static double get_ping_rtt(SrnServer *srv){
+    return srv->delay;
+}
+
+static double get_reconnects(SrnServer *srv){
+    return srv->reconn_count;
+}
+
+static double get_connected(SrnServer *srv){
+    return srv->state == SRN_SERVER_STATE_CONNECTED;
+}
+
+static double get_interned_strings(SrnServer *srv){
+    return srn_intern_pool_get_size(srv->intern_pool);
+}
+
+static double get_interned_bytes(SrnServer *srv){
+    return srn_intern_pool_get_bytes(srv->intern_pool);
+}
+
+static double get_users(SrnServer *srv){
+    return g_hash_table_size(srv->user_table);
+}
+
+static double get_reclaimed_users(SrnServer *srv){
+    return srv->reclaimed_users;
+}
+
+static double get_send_queue(SrnServer *srv){
+    return sirc_get_send_queue_length(srv->irc);
+}
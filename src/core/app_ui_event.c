@@ -59,6 +59,7 @@ static SrnRet ui_event_whois(SuiBuffer *sui, SuiEvent event, GVariantDict *param
 static SrnRet ui_event_ignore(SuiBuffer *sui, SuiEvent event, GVariantDict *params);
 static SrnRet ui_event_cutover(SuiBuffer *sui, SuiEvent event, GVariantDict *params);
 static SrnRet ui_event_chan_list(SuiBuffer *sui, SuiEvent event, GVariantDict *params);
+static SrnRet ui_event_load_history(SuiBuffer *sui, SuiEvent event, GVariantDict *params);
 
 void srn_application_init_ui_event(SrnApplication *app){
     app->ui_app_events.open = ui_event_open;
@@ -82,6 +83,7 @@ void srn_application_init_ui_event(SrnApplication *app){
     app->ui_events.ignore = ui_event_ignore;
     app->ui_events.cutover = ui_event_cutover;
     app->ui_events.chan_list = ui_event_chan_list;
+    app->ui_events.load_history = ui_event_load_history;
 }
 
 static SrnRet ui_event_open(SuiApplication *app, SuiEvent event, GVariantDict *params){
@@ -432,6 +434,15 @@ static SrnRet ui_event_chan_list(SuiBuffer *sui, SuiEvent event, GVariantDict *p
     return sirc_cmd_list(srv->irc, NULL, NULL);
 }
 
+static SrnRet ui_event_load_history(SuiBuffer *sui, SuiEvent event, GVariantDict *params){
+    SrnChat *chat;
+
+    chat = ctx_get_chat(sui);
+    g_return_val_if_fail(chat, SRN_ERR);
+
+    return srn_chat_load_history(chat);
+}
+
 /* Get a SrnServer object from SuiBuffer context (sui->ctx) */
 static SrnServer* ctx_get_server(SuiBuffer *sui){
     SrnChat *chat;
@@ -27,12 +27,21 @@
 #include "command.h"
 #include "log.h"
 #include "utils.h"
+#include "trace.h"
 #include "config/config.h"
 #include "extra_data.h"
 
 #include "sirc/sirc.h"
 
+static bool process_message(SrnMessage *msg, SrnRenderFlags rflags,
+        SrnFilterFlags fflags);
 static void add_message(SrnChat *self, SrnMessage *msg);
+static void trim_messages(SrnChat *self);
+static void remove_oldest_message(SrnChat *self);
+static bool is_duplicated(SrnChat *self, SrnChatUser *user,
+        const char *content, const SircMessageContext *context);
+static bool collapse_membership_message(SrnChat *self,
+        SrnChatMembership membership, SrnMessage *msg);
 
 SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
         SrnChatConfig *cfg){
@@ -41,7 +50,7 @@ SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
 
     self = g_malloc0(sizeof(SrnChat));
 
-    str_assign(&self->name, name);
+    self->name = (char *)srn_intern(srv->intern_pool, name);
     self->type = type;
     self->cfg = cfg;
     self->is_joined = FALSE;
@@ -49,6 +58,9 @@ SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
     self->user = srn_chat_add_and_get_user(self, srv->user);
     self->_user = srn_chat_add_and_get_user(self, srv->_user);
     self->extra_data = srn_extra_data_new();
+    // Keys are owned by messages
+    self->msg_ids = g_hash_table_new(g_str_hash, g_str_equal);
+    self->recv_dedup = srn_dedup_new(SRN_CHAT_DEDUP_SIZE);
 
     // Init self->ui
     events = &srn_application_get_default()->ui_events;
@@ -71,9 +83,18 @@ SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
 }
 
 void srn_chat_free(SrnChat *self){
-    str_assign(&self->name, NULL);
+    srn_intern_unref(self->name);
 
     srn_extra_data_free(self->extra_data);
+    g_hash_table_destroy(self->msg_ids);
+    srn_dedup_free(self->recv_dedup);
+    g_free(self->history_ref);
+    if (self->history_log_date){
+        g_date_time_unref(self->history_log_date);
+    }
+
+    // Messages hold references of users, free them before user list
+    g_list_free_full(self->msg_list, (GDestroyNotify)srn_message_free);
 
     // Free user list, self->user and self->_user also in this list
     g_list_free_full(self->user_list, (GDestroyNotify)srn_chat_user_free);
@@ -102,8 +123,10 @@ void srn_chat_set_is_joined(SrnChat *self, bool joined){
             SrnChatUser *user;
 
             user = lst->data;
-            srn_chat_user_set_is_joined(user, FALSE);
+            // User may be removed
             lst = g_list_next(lst);
+            srn_chat_user_set_is_joined(user, FALSE);
+            srn_chat_rm_user(self, user);
         }
     }
 }
@@ -132,14 +155,37 @@ SrnChatUser* srn_chat_add_and_get_user(SrnChat *self, SrnServerUser *srv_user){
     return srn_chat_get_user(self, srv_user->nick);
 }
 
+/**
+ * @brief srn_chat_rm_user removes and frees a user who has left the chat.
+ * The user is kept if it is still joined, ignored or referenced by any
+ * message, or if it is yourself or the target of dialog, so the caller can
+ * call it whenever a user may be no longer needed.
+ *
+ * @param self
+ * @param user
+ *
+ * @return SRN_OK if the user is removed
+ */
 SrnRet srn_chat_rm_user(SrnChat *self, SrnChatUser *user){
     GList *lst;
 
+    if (user->is_joined || user->is_ignored || user->refcount > 0){
+        return SRN_ERR;
+    }
+    if (user == self->user || user == self->_user){
+        return SRN_ERR;
+    }
+    if (self->type == SRN_CHAT_TYPE_DIALOG
+            && sirc_target_equal(user->srv_user->nick, self->name)){
+        return SRN_ERR;
+    }
+
     lst = g_list_find(self->user_list, user);
     if (!lst) {
         return SRN_ERR;
     }
     self->user_list = g_list_delete_link(self->user_list, lst);
+    srn_chat_user_free(user);
 
     return SRN_OK;
 }
@@ -173,11 +219,7 @@ void srn_chat_add_sent_message(SrnChat *self, const char *content,
     fflags = SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_SENT, context);
 
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        /* Ignore this message */
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -195,6 +237,10 @@ void srn_chat_add_recv_message(SrnChat *self, SrnChatUser *user,
     SrnRenderFlags rflags;
     SrnFilterFlags fflags;
 
+    if (is_duplicated(self, user, content, context)){
+        return;
+    }
+
     rflags = SRN_RENDER_FLAG_URL | SRN_RENDER_FLAG_PATTERN | SRN_RENDER_FLAG_MENTION;
     if (self->cfg->render_mirc_color) {
         rflags |= SRN_RENDER_FLAG_MIRC_COLORIZE;
@@ -204,10 +250,7 @@ void srn_chat_add_recv_message(SrnChat *self, SrnChatUser *user,
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
 
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_RECV, context);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -225,6 +268,10 @@ void srn_chat_add_notice_message(SrnChat *self, SrnChatUser *user,
     SrnRenderFlags rflags;
     SrnFilterFlags fflags;
 
+    if (is_duplicated(self, user, content, context)){
+        return;
+    }
+
     rflags = SRN_RENDER_FLAG_URL | SRN_RENDER_FLAG_PATTERN | SRN_RENDER_FLAG_MENTION;
     if (self->cfg->render_mirc_color) {
         rflags |= SRN_RENDER_FLAG_MIRC_COLORIZE;
@@ -234,10 +281,7 @@ void srn_chat_add_notice_message(SrnChat *self, SrnChatUser *user,
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
 
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_NOTICE, context);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -255,6 +299,10 @@ void srn_chat_add_action_message(SrnChat *self, SrnChatUser *user,
     SrnFilterFlags fflags;
     SrnRenderFlags rflags;
 
+    if (!user->srv_user->is_me && is_duplicated(self, user, content, context)){
+        return;
+    }
+
     rflags = SRN_RENDER_FLAG_URL;
     if (self->cfg->render_mirc_color) {
         rflags |= SRN_RENDER_FLAG_MIRC_COLORIZE;
@@ -268,14 +316,7 @@ void srn_chat_add_action_message(SrnChat *self, SrnChatUser *user,
         fflags |= SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN;
         rflags |= SRN_RENDER_FLAG_PATTERN | SRN_RENDER_FLAG_MENTION;
     }
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    if (!msg->ui){
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -345,10 +386,7 @@ void srn_chat_add_misc_message_with_user(SrnChat *self, SrnChatUser *user,
     rflags = SRN_RENDER_FLAG_URL;
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_MISC, context);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -371,6 +409,150 @@ void srn_chat_add_misc_message_with_user_fmt(SrnChat *self, SrnChatUser *user,
     g_free(content);
 }
 
+/**
+ * @brief Add a message from chat history, which is older than any message
+ * in chat. It is prepended to chat, and is neither logged nor notified.
+ *
+ * @param self
+ * @param sender Nick of sender, can be NULL for misc and error messages
+ * @param type
+ * @param content
+ * @param context Message with a known msgid is dropped
+ *
+ * @return TRUE if the message is added
+ */
+bool srn_chat_add_history_message(SrnChat *self, const char *sender,
+        SrnMessageType type, const char *content,
+        const SircMessageContext *context){
+    const char *msgid;
+    SrnChatUser *user;
+    SrnMessage *msg;
+    SrnRenderFlags rflags;
+    SrnFilterFlags fflags;
+
+    msgid = sirc_message_context_get_msgid(context);
+    if (msgid && g_hash_table_contains(self->msg_ids, msgid)){
+        return FALSE;
+    }
+
+    user = NULL;
+    if (type == SRN_MESSAGE_TYPE_SENT){
+        user = self->user;
+    } else if (sender){
+        user = srn_chat_get_user(self, sender);
+    }
+    if (!user){
+        // The sender may have gone, message is linked to no one
+        user = self->_user;
+    }
+
+    rflags = SRN_RENDER_FLAG_URL;
+    fflags = 0;
+    if (type != SRN_MESSAGE_TYPE_SENT
+            && type != SRN_MESSAGE_TYPE_MISC
+            && type != SRN_MESSAGE_TYPE_ERROR){
+        rflags |= SRN_RENDER_FLAG_PATTERN | SRN_RENDER_FLAG_MENTION;
+        if (self->cfg->render_mirc_color) {
+            rflags |= SRN_RENDER_FLAG_MIRC_COLORIZE;
+        } else {
+            rflags |= SRN_RENDER_FLAG_MIRC_STRIP;
+        }
+        fflags |= SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN;
+    }
+
+    msg = srn_message_new(self, user, content, type, context);
+    if (user == self->_user && sender){
+        srn_message_set_sender_name(msg, sender);
+    }
+    if (!process_message(msg, rflags, fflags)){
+        goto cleanup;
+    }
+
+    srn_message_create_ui(msg);
+    self->msg_list = g_list_prepend(self->msg_list, msg);
+    self->msg_count++;
+    if (!self->last_msg){
+        self->last_msg = msg;
+    }
+    if (msg->id){
+        g_hash_table_add(self->msg_ids, msg->id);
+    }
+    sui_buffer_prepend_message(self->ui, msg->ui);
+
+    return TRUE;
+
+cleanup:
+    srn_message_free(msg);
+    return FALSE;
+}
+
+/**
+ * @brief Remove all messages of chat. Cleared messages are not loaded again
+ * from chat history.
+ *
+ * @param self
+ */
+void srn_chat_clear_message(SrnChat *self){
+    sui_buffer_clear_message(self->ui);
+
+    g_hash_table_remove_all(self->msg_ids);
+    g_list_free_full(self->msg_list, (GDestroyNotify)srn_message_free);
+    self->msg_list = NULL;
+    self->msg_count = 0;
+    self->last_msg = NULL;
+    // Collapsed message has been cleared
+    self->membership_msg = NULL;
+    self->history_exhausted = TRUE;
+    g_free(self->history_ref);
+    self->history_ref = NULL;
+}
+
+/**
+ * @brief Add a misc message about membership change of user (JOIN, PART,
+ * QUIT and NICK).
+ *
+ * Consecutive membership messages within SrnChatConfig's
+ * membership_collapse_window are collapsed into one message which shows
+ * counts of changes, it is updated in place rather than adding new one.
+ * Every change is still filtered and logged separately.
+ *
+ * @param self
+ * @param user
+ * @param membership
+ * @param content
+ * @param context
+ */
+void srn_chat_add_membership_message(SrnChat *self, SrnChatUser *user,
+        SrnChatMembership membership, const char *content,
+        const SircMessageContext *context){
+    SrnMessage *msg;
+    SrnRenderFlags rflags;
+    SrnFilterFlags fflags;
+
+    g_return_if_fail(membership >= 0 && membership < SRN_CHAT_MEMBERSHIP_MAX);
+
+    rflags = SRN_RENDER_FLAG_URL;
+    fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
+    msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_MISC, context);
+    if (!process_message(msg, rflags, fflags)){
+        goto cleanup;
+    }
+    if (collapse_membership_message(self, membership, msg)){
+        goto cleanup;
+    }
+
+    add_message(self, msg);
+
+    // Following changes can be collapsed into this message
+    self->membership_msg = msg;
+    memset(self->membership_counts, 0, sizeof(self->membership_counts));
+    self->membership_counts[membership] = 1;
+    return;
+
+cleanup:
+    srn_message_free(msg);
+}
+
 /**
  * @brief Like srn_chat_add_misc_message, but for error message.
  *
@@ -422,10 +604,7 @@ void srn_chat_add_error_message_with_user(SrnChat *self, SrnChatUser *user,
     rflags = SRN_RENDER_FLAG_URL;
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_ERROR, context);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
+    if (!process_message(msg, rflags, fflags)){
         goto cleanup;
     }
 
@@ -472,15 +651,231 @@ void srn_chat_set_topic_setter(SrnChat *self, const char *setter){
     sui_set_topic_setter(self->ui, setter);
 }
 
+/**
+ * @brief process_message runs filters and renderers on the given message in
+ * the order of cost: sender is checked first, then raw content, rendering is
+ * only done for messages which are not dropped. The exception is pattern
+ * renderer, which extracts sender and content of message relayed by bot, it
+ * is run before content filters.
+ *
+ * @param msg
+ * @param rflags
+ * @param fflags
+ *
+ * @return FALSE if the message should be dropped.
+ */
+static bool process_message(SrnMessage *msg, SrnRenderFlags rflags,
+        SrnFilterFlags fflags){
+    bool ok;
+
+    SRN_TRACE_BEGIN(process);
+    ok = FALSE;
+    if (!srn_filter_message(msg, fflags, SRN_FILTER_INPUT_SENDER)){
+        goto out;
+    }
+    // Message relayed by bot is rewritten first, so content filters see
+    // what the relayed user said, as they did before filters were reordered
+    if (srn_render_message(msg, rflags & SRN_RENDER_FLAG_PATTERN) != SRN_OK){
+        goto out;
+    }
+    if (!srn_filter_message(msg, fflags, SRN_FILTER_INPUT_CONTENT)){
+        goto out;
+    }
+    if (srn_render_message(msg, rflags & ~(SRN_RENDER_FLAG_PATTERN)) != SRN_OK){
+        goto out;
+    }
+    if (!srn_filter_message(msg, fflags, SRN_FILTER_INPUT_RENDERED)){
+        goto out;
+    }
+    ok = TRUE;
+
+out:
+    SRN_TRACE_END(process, "process_message");
+    return ok;
+}
+
 static void add_message(SrnChat *self, SrnMessage *msg){
+    // Any new message ends the collapsing
+    self->membership_msg = NULL;
+
+    srn_message_create_ui(msg);
+
     self->msg_list = g_list_append(self->msg_list, msg);
+    self->msg_count++;
     self->last_msg = msg;
+    if (msg->id){
+        g_hash_table_add(self->msg_ids, msg->id);
+    }
 
+    SRN_TRACE_BEGIN(add);
     sui_buffer_add_message(self->ui, msg->ui);
+    SRN_TRACE_END(add, "sui_buffer_add_message");
     if (msg->mentioned
             || self->type == SRN_CHAT_TYPE_DIALOG
             || msg->type == SRN_MESSAGE_TYPE_NOTICE
             || msg->type == SRN_MESSAGE_TYPE_ERROR){
         sui_notify_message(msg->ui);
     }
+
+    trim_messages(self);
+}
+
+/**
+ * @brief trim_messages removes the oldest messages when there are more than
+ * SrnChatConfig's max_messages, they can be loaded again by
+ * srn_chat_load_history().
+ *
+ * Nothing is removed while the user is viewing older messages.
+ *
+ * @param self
+ */
+static void trim_messages(SrnChat *self){
+    if (self->cfg->max_messages <= 0
+            || self->msg_count <= (guint)self->cfg->max_messages){
+        return;
+    }
+    if (!sui_buffer_is_at_bottom(self->ui)){
+        return;
+    }
+
+    while (self->msg_count > (guint)self->cfg->max_messages){
+        remove_oldest_message(self);
+    }
+    // Removed messages are newer than the history got from server
+    self->history_exhausted = FALSE;
+    g_free(self->history_ref);
+    self->history_ref = NULL;
+}
+
+static void remove_oldest_message(SrnChat *self){
+    SrnMessage *msg;
+
+    msg = self->msg_list->data;
+    self->msg_list = g_list_delete_link(self->msg_list, self->msg_list);
+    self->msg_count--;
+    if (msg == self->last_msg){
+        self->last_msg = NULL;
+    }
+    if (msg == self->membership_msg){
+        self->membership_msg = NULL;
+    }
+    if (msg->id){
+        g_hash_table_remove(self->msg_ids, msg->id);
+    }
+
+    sui_buffer_remove_first_message(self->ui);
+    srn_message_free(msg);
+}
+
+/**
+ * @brief collapse_membership_message collapses a membership message into
+ * the last one if possible.
+ *
+ * @param self
+ * @param membership
+ * @param msg
+ *
+ * @return TRUE if collapsed, the msg is no longer needed
+ */
+static bool collapse_membership_message(SrnChat *self,
+        SrnChatMembership membership, SrnMessage *msg){
+    char *summary;
+    GString *str;
+    SrnMessage *last;
+
+    last = self->membership_msg;
+    if (!last || self->cfg->membership_collapse_window <= 0){
+        return FALSE;
+    }
+    if (msg->time - last->time
+            > (gint64)self->cfg->membership_collapse_window * G_USEC_PER_SEC){
+        return FALSE;
+    }
+
+    self->membership_counts[membership]++;
+
+    str = g_string_new(NULL);
+    for (int i = 0; i < SRN_CHAT_MEMBERSHIP_MAX; i++){
+        int count;
+
+        count = self->membership_counts[i];
+        if (!count){
+            continue;
+        }
+        if (str->len){
+            g_string_append(str, ", ");
+        }
+        switch (i){
+            case SRN_CHAT_MEMBERSHIP_JOIN:
+                g_string_append_printf(str, _("%1$d joined"), count);
+                break;
+            case SRN_CHAT_MEMBERSHIP_PART:
+                g_string_append_printf(str, _("%1$d left"), count);
+                break;
+            case SRN_CHAT_MEMBERSHIP_QUIT:
+                g_string_append_printf(str, _("%1$d quit"), count);
+                break;
+            case SRN_CHAT_MEMBERSHIP_NICK:
+                g_string_append_printf(str, _("%1$d changed nick"), count);
+                break;
+            default:
+                g_warn_if_reached();
+        }
+    }
+
+    summary = g_markup_escape_text(str->str, -1);
+    srn_message_set_rendered_content(last, summary);
+    g_string_free(str, TRUE);
+
+    // Update in place, no new widget
+    sui_update_message(last->ui);
+
+    return TRUE;
+}
+
+/**
+ * @brief is_duplicated checks whether a received message has been seen
+ * recently, for example, replayed by bouncer after reconnecting. It is
+ * checked before rendering so duplicates cost little.
+ *
+ * A message is identified by its msgid, or by its server time, sender and
+ * content. Message without a valid server time is never considered
+ * duplicated, as the same content may be sent repeatedly.
+ *
+ * @return TRUE if the message should be dropped
+ */
+static bool is_duplicated(SrnChat *self, SrnChatUser *user,
+        const char *content, const SircMessageContext *context){
+    char buf[32];
+    const char *msgid;
+    const char *nick;
+    guint64 hash;
+
+    if (self->type == SRN_CHAT_TYPE_SERVER){
+        // Server replies such as MOTD are full of identical lines
+        return FALSE;
+    }
+
+    msgid = sirc_message_context_get_msgid(context);
+    if (msgid){
+        hash = srn_dedup_hash(SRN_DEDUP_HASH_INIT, "msgid", sizeof("msgid"));
+        hash = srn_dedup_hash(hash, msgid, strlen(msgid));
+    } else if (sirc_message_context_has_server_time(context)){
+        g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT,
+                sirc_message_context_get_timestamp(context));
+        nick = user->srv_user->nick;
+        // Fields are separated by their terminating '\0'
+        hash = srn_dedup_hash(SRN_DEDUP_HASH_INIT, buf, strlen(buf) + 1);
+        hash = srn_dedup_hash(hash, nick, strlen(nick) + 1);
+        hash = srn_dedup_hash(hash, content, strlen(content));
+    } else {
+        return FALSE;
+    }
+
+    if (srn_dedup_check_and_add(self->recv_dedup, hash)){
+        DBG_FR("Duplicated message dropped: %s", msgid ? msgid : content);
+        return TRUE;
+    }
+
+    return FALSE;
 }
@@ -42,6 +42,7 @@
 #include "render/render.h"
 #include "filter/filter.h"
 #include "utils.h"
+#include "trace.h"
 #include "pattern_set.h"
 #include "chat_command.h"
 
@@ -917,7 +918,7 @@ SrnRet on_command_clear(SrnCommand *cmd, void *user_data){
     chat = ctx_get_chat(user_data);
     g_return_val_if_fail(chat, SRN_ERR);
 
-    sui_buffer_clear_message(chat->ui);
+    srn_chat_clear_message(chat);
 
     return SRN_OK;
 }
@@ -935,6 +936,76 @@ SrnRet on_command_pass(SrnCommand *cmd, void *user_data){
     return sirc_cmd_raw(srv->irc, "PASS %s\r\n", msg);
 }
 
+SrnRet on_command_stats(SrnCommand *cmd, void *user_data){
+    const char *subcmd;
+    bool json;
+    SrnRet ret;
+    GString *str;
+
+    subcmd = srn_command_get_subcmd(cmd);
+    g_return_val_if_fail(subcmd, SRN_ERR);
+    json = srn_command_get_opt(cmd, "-json", NULL);
+
+    str = g_string_new(NULL);
+    if (g_ascii_strcasecmp(subcmd, "render") == 0){
+        if (json) {
+            g_string_append(str, "{\"render\":");
+            srn_render_dump_stats(str, TRUE);
+            g_string_append(str, ",\"filter\":");
+            srn_filter_dump_stats(str, TRUE);
+            g_string_append_c(str, '}');
+        } else {
+            g_string_append(str, _("Time cost of render modules (ns):"));
+            srn_render_dump_stats(str, FALSE);
+            g_string_append_c(str, '\n');
+            g_string_append(str, _("Time cost of filter modules (ns):"));
+            srn_filter_dump_stats(str, FALSE);
+        }
+        if (srn_command_get_opt(cmd, "-reset", NULL)){
+            srn_render_reset_stats();
+            srn_filter_reset_stats();
+        }
+        ret = RET_OK("%s", str->str);
+    } else if (g_ascii_strcasecmp(subcmd, "server") == 0){
+        if (json) {
+            srn_application_dump_stats(ctx_get_app(user_data), str,
+                    SRN_STATS_FORMAT_JSON);
+        } else {
+            g_string_append(str, _("Statistics of servers:"));
+            srn_application_dump_stats(ctx_get_app(user_data), str,
+                    SRN_STATS_FORMAT_TEXT);
+        }
+        ret = RET_OK("%s", str->str);
+    } else {
+        g_warn_if_reached();
+        ret = SRN_ERR;
+    }
+    g_string_free(str, TRUE);
+
+    return ret;
+}
+
+SrnRet on_command_trace(SrnCommand *cmd, void *user_data){
+    const char *subcmd;
+
+    subcmd = srn_command_get_subcmd(cmd);
+    g_return_val_if_fail(subcmd, SRN_ERR);
+
+    if (!srn_trace_is_enabled()){
+        return RET_ERR(_("Tracing is not enabled in this build"));
+    }
+
+    if (g_ascii_strcasecmp(subcmd, "dump") == 0){
+        return srn_trace_dump(srn_command_get_arg(cmd, 0));
+    } else if (g_ascii_strcasecmp(subcmd, "clear") == 0){
+        srn_trace_clear();
+        return RET_OK(_("Trace buffers have been cleared"));
+    }
+
+    g_warn_if_reached();
+    return SRN_ERR;
+}
+
 /*******************************************************************************
  * Misc
  ******************************************************************************/
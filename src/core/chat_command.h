@@ -50,6 +50,8 @@ SrnRet on_command_unrender(SrnCommand *cmd, void *user_data);
 SrnRet on_command_quote(SrnCommand *cmd, void *user_data);
 SrnRet on_command_clear(SrnCommand *cmd, void *user_data);
 SrnRet on_command_pass(SrnCommand *cmd, void *user_data);
+SrnRet on_command_stats(SrnCommand *cmd, void *user_data);
+SrnRet on_command_trace(SrnCommand *cmd, void *user_data);
 
 static SrnCommandBinding cmd_bindings[] = {
     {
@@ -265,6 +267,25 @@ static SrnCommandBinding cmd_bindings[] = {
         .opt = { SRN_COMMAND_EMPTY_OPT },
         .cb = on_command_pass,
     },
+    {
+        .name = "/stats",
+        .subcmd = {"render", "server", NULL},
+        .argc = 0,
+        .opt = {
+            {.key = "-json", .val = SRN_COMMAND_OPT_NO_VAL },
+            {.key = "-reset", .val = SRN_COMMAND_OPT_NO_VAL },
+            SRN_COMMAND_EMPTY_OPT,
+        },
+        .cb = on_command_stats,
+    },
+    {
+        .name = "/trace",
+        .subcmd = {"dump", "clear", NULL},
+        .argc = 1, // [file]
+        .opt = { SRN_COMMAND_EMPTY_OPT },
+        .flags = SRN_COMMAND_FLAG_OMIT_ARG,
+        .cb = on_command_trace,
+    },
     SRN_COMMAND_EMPTY,
 };
 
@@ -0,0 +1,434 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file chat_history.c
+ * @brief Load older messages of chat on demand
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-06-01
+ *
+ * History is requested page by page when the message list is scrolled to
+ * top. It comes from IRCv3 "draft/chathistory" if the server supports it,
+ * otherwise from the chat log, see
+ * https://ircv3.net/specs/extensions/chathistory
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "core/core.h"
+#include "sirc/sirc.h"
+#include "srain.h"
+#include "log.h"
+#include "i18n.h"
+#include "path.h"
+
+#define HISTORY_PAGE_SIZE       50
+#define HISTORY_REQUEST_TIMEOUT (10 * G_USEC_PER_SEC) // Retry if no reply
+#define HISTORY_LOG_MAX_DAYS    30 // Days of log looked back for a page
+#define HISTORY_LOG_BLOCK_SIZE  (16 * 1024) // Bytes of log read at a time
+
+static SrnRet load_history_from_server(SrnChat *self);
+static SrnRet load_history_from_log(SrnChat *self);
+static char* history_ref_new(const char *msgid, gint64 time);
+static int read_log_file(SrnChat *self, GDateTime *date, gint64 before,
+        int limit, goffset *offset);
+static bool add_log_line(SrnChat *self, GDateTime *date, gint64 before,
+        const char *line, const char *cont);
+
+/**
+ * @brief srn_chat_load_history loads a page of messages which are older
+ * than any message in chat, the messages are added by
+ * srn_chat_add_history_message().
+ *
+ * @param self
+ *
+ * @return SRN_OK if history is loaded or requested, or there is nothing to
+ *      load
+ */
+SrnRet srn_chat_load_history(SrnChat *self){
+    SrnServer *srv;
+
+    g_return_val_if_fail(self, SRN_ERR);
+
+    if (self->history_exhausted){
+        return SRN_OK;
+    }
+    if (self->history_request_time
+            && g_get_monotonic_time() - self->history_request_time
+            < HISTORY_REQUEST_TIMEOUT){
+        // Last request is pending
+        return SRN_OK;
+    }
+
+    srv = self->srv;
+    if (self->type != SRN_CHAT_TYPE_SERVER
+            && srv->cap->client_enabled.draft_chathistory
+            && srv->cap->client_enabled.batch
+            && srn_server_is_registered(srv)){
+        return load_history_from_server(self);
+    }
+    if (self->cfg->log){
+        return load_history_from_log(self);
+    }
+
+    return SRN_OK;
+}
+
+/**
+ * @brief srn_chat_end_history should be called when a requested page of
+ * history has been got.
+ *
+ * History is exhausted if the page is not full. Messages of a page may be
+ * all filtered or duplicated, so the next page is requested before the
+ * oldest message of this page rather than the oldest message in chat.
+ *
+ * @param self
+ * @param count Number of messages in the page, including those not added
+ * @param oldest Context of the oldest message in the page, can be NULL
+ */
+void srn_chat_end_history(SrnChat *self, int count,
+        const SircMessageContext *oldest){
+    self->history_request_time = 0;
+    if (count < HISTORY_PAGE_SIZE){
+        self->history_exhausted = TRUE;
+    }
+    if (oldest){
+        g_free(self->history_ref);
+        self->history_ref = history_ref_new(
+                sirc_message_context_get_msgid(oldest),
+                sirc_message_context_get_timestamp(oldest));
+    }
+}
+
+static SrnRet load_history_from_server(SrnChat *self){
+    char *ref;
+    SrnRet ret;
+    SrnMessage *oldest;
+
+    oldest = self->msg_list ? self->msg_list->data : NULL;
+    if (self->history_ref){
+        ref = g_strdup(self->history_ref);
+    } else if (!oldest){
+        ref = g_strdup("*");
+    } else {
+        ref = history_ref_new(oldest->id, oldest->time);
+    }
+
+    DBG_FR("Request history of %s before %s", self->name, ref);
+
+    ret = sirc_cmd_chathistory(self->srv->irc,
+            oldest || self->history_ref ? "BEFORE" : "LATEST",
+            self->name, ref, HISTORY_PAGE_SIZE);
+    g_free(ref);
+    if (!RET_IS_OK(ret)){
+        return ret;
+    }
+    // Replied by a "chathistory" batch, see irc_event_batch()
+    self->history_request_time = g_get_monotonic_time();
+
+    return SRN_OK;
+}
+
+static SrnRet load_history_from_log(SrnChat *self){
+    int count;
+    gint64 before;
+    goffset offset;
+    GDateTime *date;
+
+    before = self->msg_list
+        ? ((SrnMessage *)self->msg_list->data)->time
+        : g_get_real_time();
+    if (self->history_log_date && self->history_log_time == before){
+        // Continue from where the last page ends, everything before the
+        // offset is older than any message in chat
+        date = g_date_time_ref(self->history_log_date);
+        offset = self->history_log_offset;
+        before = G_MAXINT64;
+    } else {
+        date = g_date_time_new_from_unix_local(before / G_USEC_PER_SEC);
+        offset = -1;
+    }
+
+    count = 0;
+    for (int i = 0; i < HISTORY_LOG_MAX_DAYS && count < HISTORY_PAGE_SIZE; i++){
+        if (i > 0){
+            GDateTime *day;
+
+            day = g_date_time_add_days(date, -1);
+            g_date_time_unref(date);
+            date = day;
+            offset = -1;
+        }
+        count += read_log_file(self, date, before,
+                HISTORY_PAGE_SIZE - count, &offset);
+    }
+    if (offset == 0){
+        // The file has been read through, continue from the previous day
+        GDateTime *day;
+
+        day = g_date_time_add_days(date, -1);
+        g_date_time_unref(date);
+        date = day;
+        offset = -1;
+    }
+
+    if (self->history_log_date){
+        g_date_time_unref(self->history_log_date);
+    }
+    self->history_log_date = date;
+    self->history_log_offset = offset;
+    self->history_log_time = self->msg_list
+        ? ((SrnMessage *)self->msg_list->data)->time
+        : 0;
+
+    DBG_FR("Loaded %d messages of %s from log", count, self->name);
+
+    srn_chat_end_history(self, count, NULL);
+
+    return SRN_OK;
+}
+
+/**
+ * @brief read_log_file adds the last messages in log file of given date
+ * which are older than given time. The file is read backwards from given
+ * offset block by block, so only the part being returned is read.
+ *
+ * @param self
+ * @param date
+ * @param before Unix time in microseconds
+ * @param limit
+ * @param offset End of the part of file to read, -1 for the end of file.
+ *      Returns the start of the oldest added message if limit is reached,
+ *      otherwise 0
+ *
+ * @return Number of read messages, including those not added
+ */
+static int read_log_file(SrnChat *self, GDateTime *date, gint64 before,
+        int limit, goffset *offset){
+    int count;
+    char *date_str;
+    char *basename;
+    char *file;
+    char *block;
+    goffset pos;
+    FILE *fp;
+    GString *tail;
+    GString *cont;
+
+    date_str = g_date_time_format(date, "%F");
+    basename = g_strdup_printf("%s.%s.log", date_str, self->name);
+    file = srn_get_log_file(self->srv->name, basename);
+    g_free(basename);
+    g_free(date_str);
+    g_return_val_if_fail(file, 0);
+
+    fp = g_fopen(file, "rb");
+    g_free(file);
+    if (!fp){
+        *offset = 0;
+        return 0;
+    }
+
+    pos = *offset;
+    if (pos < 0 && fseek(fp, 0, SEEK_END) == 0){
+        pos = ftell(fp);
+    }
+    if (pos < 0){
+        fclose(fp);
+        *offset = 0;
+        return 0;
+    }
+
+    // Walk from the newest, so every message can be simply prepended.
+    // A multi-line message is logged as one line with header and some
+    // continuation lines.
+    count = 0;
+    block = g_malloc(HISTORY_LOG_BLOCK_SIZE);
+    tail = g_string_new(NULL); // Unprocessed bytes from pos
+    cont = g_string_new(NULL);
+    while (count < limit){
+        char *line;
+        gsize start;
+
+        // Find the last complete line in tail
+        start = tail->len;
+        while (start > 0 && tail->str[start - 1] != '\n'){
+            start--;
+        }
+        if (start == 0 && pos > 0){
+            gsize len;
+
+            len = MIN(HISTORY_LOG_BLOCK_SIZE, pos);
+            pos -= len;
+            if (fseek(fp, pos, SEEK_SET) != 0
+                    || fread(block, 1, len, fp) != len){
+                pos = 0;
+                break;
+            }
+            g_string_prepend_len(tail, block, len);
+            continue;
+        }
+        if (start == 0 && tail->len == 0){
+            // Beginning of file
+            break;
+        }
+
+        line = g_strdup(tail->str + start);
+        g_string_truncate(tail, start > 0 ? start - 1 : 0);
+
+        if (strlen(line) < 11 || line[0] != '[' || line[9] != ']'){
+            if (cont->len){
+                g_string_prepend_c(cont, '\n');
+            }
+            g_string_prepend(cont, line);
+        } else {
+            if (add_log_line(self, date, before, line, cont->str)){
+                count++;
+            }
+            g_string_truncate(cont, 0);
+        }
+        g_free(line);
+    }
+    *offset = count < limit ? 0 : pos + tail->len + (tail->len ? 1 : 0);
+
+    g_string_free(cont, TRUE);
+    g_string_free(tail, TRUE);
+    g_free(block);
+    fclose(fp);
+
+    return count;
+}
+
+/**
+ * @brief add_log_line parses a line of log file written by log filter and
+ * adds it to chat if it is older than given time.
+ *
+ * @param self
+ * @param date
+ * @param before
+ * @param line Like "[10:00:00] <nick> content"
+ * @param cont Continuation lines of the message, can be empty
+ *
+ * @return TRUE if the line is a message older than given time, no matter
+ *      whether it is added
+ */
+static bool add_log_line(SrnChat *self, GDateTime *date, gint64 before,
+        const char *line, const char *cont){
+    int hour;
+    int minute;
+    int second;
+    char *sender;
+    char *content;
+    const char *rest;
+    const char *end;
+    SrnMessageType type;
+    GDateTime *time;
+    SircMessageContext *context;
+
+    if (sscanf(line, "[%2d:%2d:%2d] ", &hour, &minute, &second) != 3){
+        return FALSE;
+    }
+    time = g_date_time_new_local(
+            g_date_time_get_year(date),
+            g_date_time_get_month(date),
+            g_date_time_get_day_of_month(date),
+            hour, minute, second);
+    if (!time){
+        return FALSE;
+    }
+    // Only second is logged, messages in the same second of the oldest
+    // message are considered being shown
+    if (g_date_time_to_unix(time) >= before / G_USEC_PER_SEC){
+        g_date_time_unref(time);
+        return FALSE;
+    }
+
+    // See srn_message_to_string()
+    sender = NULL;
+    rest = line + strlen("[00:00:00] ");
+    if (rest[0] == '<' && (end = strstr(rest, "> "))){
+        sender = g_strndup(rest + 1, end - rest - 1);
+        if (g_str_has_suffix(sender, "*")){
+            sender[strlen(sender) - 1] = '\0';
+            type = SRN_MESSAGE_TYPE_SENT;
+        } else {
+            type = SRN_MESSAGE_TYPE_RECV;
+        }
+        rest = end + 2;
+    } else if (g_str_has_prefix(rest, "* ") && (end = strchr(rest + 2, ' '))){
+        sender = g_strndup(rest + 2, end - rest - 2);
+        type = SRN_MESSAGE_TYPE_ACTION;
+        rest = end + 1;
+    } else if (g_str_has_prefix(rest, "= ")){
+        type = SRN_MESSAGE_TYPE_MISC;
+        rest += 2;
+    } else if (g_str_has_prefix(rest, "! ")){
+        type = SRN_MESSAGE_TYPE_ERROR;
+        rest += 2;
+    } else {
+        g_date_time_unref(time);
+        return FALSE;
+    }
+
+    if (*cont){
+        content = g_strdup_printf("%s\n%s", rest, cont);
+    } else {
+        content = g_strdup(rest);
+    }
+
+    context = sirc_message_context_new(time);
+    srn_chat_add_history_message(self, sender, type, content, context);
+    sirc_message_context_free(context);
+
+    g_free(content);
+    g_free(sender);
+
+    return TRUE;
+}
+
+/**
+ * @brief history_ref_new returns the reference of a message used by
+ * CHATHISTORY command.
+ *
+ * @param msgid Can be NULL
+ * @param time Unix time in microseconds, used if msgid is NULL
+ *
+ * @return Like "msgid=xxx" or "timestamp=2019-06-01T10:00:00.000Z"
+ */
+static char* history_ref_new(const char *msgid, gint64 time){
+    char *ref;
+    char *time_str;
+    GDateTime *date;
+
+    if (msgid){
+        return g_strdup_printf("msgid=%s", msgid);
+    }
+
+    date = g_date_time_new_from_unix_utc(time / G_USEC_PER_SEC);
+    time_str = g_date_time_format(date, "%Y-%m-%dT%H:%M:%S");
+    ref = g_strdup_printf("timestamp=%s.%03dZ", time_str,
+            (int)(time % G_USEC_PER_SEC / 1000));
+    g_free(time_str);
+    g_date_time_unref(date);
+
+    return ref;
+}
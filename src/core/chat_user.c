@@ -43,6 +43,34 @@ void srn_chat_user_free(SrnChatUser *self){
     g_free(self);
 }
 
+/**
+ * @brief srn_chat_user_ref takes a reference of chat user for a message
+ * sent by it.
+ *
+ * @param self
+ *
+ * @return self
+ */
+SrnChatUser* srn_chat_user_ref(SrnChatUser *self){
+    self->refcount++;
+    return self;
+}
+
+/**
+ * @brief srn_chat_user_unref drops a reference taken by srn_chat_user_ref(),
+ * the user is removed from its chat if it has left the chat.
+ *
+ * @param self
+ */
+void srn_chat_user_unref(SrnChatUser *self){
+    g_return_if_fail(self->refcount > 0);
+
+    self->refcount--;
+    if (self->refcount == 0 && !self->is_joined){
+        srn_chat_rm_user(self->chat, self);
+    }
+}
+
 void srn_chat_user_update(SrnChatUser *self){
     if (self->is_joined) {
         sui_update_user(self->chat->ui, self->ui);
@@ -133,3 +133,14 @@ SrnLoginMethod srn_login_method_from_string(const char *str){
 
     return login;
 }
+
+bool srn_login_method_is_sasl(SrnLoginMethod lm){
+    switch (lm) {
+        case SRN_LOGIN_METHOD_SASL_PLAIN:
+        case SRN_LOGIN_METHOD_SASL_ECDSA_NIST256P_CHALLENGE:
+        case SRN_LOGIN_METHOD_SASL_EXTERNAL:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "core/core.h"
@@ -23,40 +24,153 @@
 #include "srain.h"
 #include "utils.h"
 
+static bool need_escape(const char *str);
+static GDateTime* date_time_new_from_timestamp(gint64 timestamp);
+
 SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user,
         const char *content, SrnMessageType type, const SircMessageContext *context){
+    gsize len;
+    gsize id_len;
+    const char *id;
     SrnMessage *self;
 
     g_return_val_if_fail(chat, NULL);
     g_return_val_if_fail(user, NULL);
     g_return_val_if_fail(user->srv_user, NULL);
 
-    self = g_malloc0(sizeof(SrnMessage));
-
     if (!content) {
         g_warn_if_reached();
         content = "";
     }
 
+    // Content and ID are stored inline
+    len = strlen(content);
+    id = sirc_message_context_get_msgid(context);
+    id_len = id ? strlen(id) + 1 : 0;
+    self = g_malloc0(sizeof(SrnMessage) + len + 1 + id_len);
+    memcpy(self->content, content, len + 1);
+    if (id) {
+        self->id = self->content + len + 1;
+        memcpy(self->id, id, id_len);
+    }
+
     self->type = type;
-    self->sender = user;
+    self->sender = srn_chat_user_ref(user);
     self->chat = chat;
-    self->content = g_strdup(content);
-    self->time = g_date_time_ref(sirc_message_context_get_time(context));
-
-    // Inital render
-    self->rendered_sender = g_markup_escape_text(user->srv_user->nick, -1);
-    self->rendered_remark = g_markup_escape_text("", -1);
-    self->rendered_content = g_markup_escape_text(content, -1);
-    self->rendered_short_time = g_date_time_format(self->time, "%R");
+    self->time = sirc_message_context_get_timestamp(context);
+
+    // Inital render, the escaped nick is shared by all messages of the user
+    self->sender_name = srn_intern_ref(user->srv_user->nick);
+    self->rendered_sender = srn_intern_get_markup(self->sender_name);
+    if (need_escape(content)) {
+        self->rendered_content = g_markup_escape_text(content, len);
+    } else {
+        // Most messages are plain text, share the raw content
+        self->rendered_content = self->content;
+    }
+
+    self->mentioned = FALSE;
+
+    return self;
+}
+
+/**
+ * @brief srn_message_set_sender_name changes the displayed sender of message,
+ * for example, to the real sender of message relayed by a bot.
+ *
+ * @param self
+ * @param name
+ */
+void srn_message_set_sender_name(SrnMessage *self, const char *name){
+    const char *old;
+
+    g_return_if_fail(name);
+
+    old = self->sender_name;
+    self->sender_name = srn_intern(self->chat->srv->intern_pool, name);
+    self->rendered_sender = srn_intern_get_markup(self->sender_name);
+    srn_intern_unref(old);
+}
+
+/**
+ * @brief srn_message_set_rendered_content replaces rendered content of
+ * message, renderers should use it instead of assigning the field.
+ *
+ * Renderers that change nothing still return a new string, it is dropped
+ * so that a plain message keeps sharing its raw content.
+ *
+ * @param self
+ * @param rendered Valid XML, the ownership is transferred to message
+ */
+void srn_message_set_rendered_content(SrnMessage *self, char *rendered){
+    g_return_if_fail(rendered);
+
+    if (strcmp(rendered, self->rendered_content) == 0) {
+        g_free(rendered);
+        return;
+    }
+    if (self->rendered_content != self->content) {
+        g_free(self->rendered_content);
+    }
+    if (strcmp(rendered, self->content) == 0) {
+        g_free(rendered);
+        rendered = self->content;
+    }
+    self->rendered_content = rendered;
+}
+
+/**
+ * @brief srn_message_get_time returns local time of message.
+ *
+ * @param self
+ *
+ * @return A new GDateTime, should be freed by g_date_time_unref()
+ */
+GDateTime* srn_message_get_time(const SrnMessage *self){
+    return date_time_new_from_timestamp(self->time);
+}
+
+/**
+ * @brief srn_message_format_time formats time of message for displaying.
+ *
+ * @param self
+ * @param full Whether to show date
+ *
+ * @return Valid XML, should be freed by g_free()
+ */
+char* srn_message_format_time(const SrnMessage *self, bool full){
+    char *str;
+    GDateTime *time;
+
+    if (!full && self->rendered_time) {
+        return g_strdup(self->rendered_time);
+    }
+
+    time = srn_message_get_time(self);
+    if (!full) {
+        str = g_date_time_format(time, "%R");
+    } else {
 #ifdef G_OS_WIN32
-    // FIXME: g_date_time_format(xxx, "%c") does not work on MS Windows
-    self->rendered_full_time = g_date_time_format(self->time, "%F %R");
+        // FIXME: g_date_time_format(xxx, "%c") does not work on MS Windows
+        str = g_date_time_format(time, "%F %R");
 #else
-    self->rendered_full_time = g_date_time_format(self->time, "%c");
+        str = g_date_time_format(time, "%c");
 #endif
+    }
+    g_date_time_unref(time);
 
-    self->mentioned = FALSE;
+    return str;
+}
+
+/**
+ * @brief srn_message_create_ui creates UI widget of message. It is not done
+ * in srn_message_new() because most messages dropped by filters never need
+ * a widget.
+ *
+ * @param self
+ */
+void srn_message_create_ui(SrnMessage *self){
+    g_return_if_fail(!self->ui);
 
     switch (self->type){
         case SRN_MESSAGE_TYPE_SENT:
@@ -81,15 +195,16 @@ SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user,
             self->ui = sui_new_misc_message(self, SUI_MISC_MESSAGE_STYLE_NORMAL);
             g_warn_if_reached();
     }
-
-    return self;
 }
 
 char* srn_message_to_string(const SrnMessage *self){
     char *time_str;
     char *msg_str;
+    GDateTime *time;
 
-    time_str = g_date_time_format(self->time, "%T");
+    time = srn_message_get_time(self);
+    time_str = g_date_time_format(time, "%T");
+    g_date_time_unref(time);
     g_return_val_if_fail(time_str, NULL);
 
     switch (self->type){
@@ -127,15 +242,57 @@ char* srn_message_to_string(const SrnMessage *self){
 }
 
 void srn_message_free(SrnMessage *self){
-    str_assign(&self->content, NULL);
-    g_date_time_unref(self->time);
-
-    str_assign(&self->rendered_sender, NULL);
+    srn_chat_user_unref(self->sender);
+    srn_intern_unref(self->sender_name);
+    if (self->rendered_content != self->content) {
+        g_free(self->rendered_content);
+    }
     str_assign(&self->rendered_remark, NULL);
-    str_assign(&self->rendered_content, NULL);
-    str_assign(&self->rendered_short_time, NULL);
-    str_assign(&self->rendered_full_time, NULL);
+    str_assign(&self->rendered_time, NULL);
     g_list_free_full(self->urls, g_free);
 
     g_free(self);
 }
+
+/**
+ * @brief need_escape returns whether g_markup_escape_text() changes the
+ * string, including XML special characters and control characters.
+ */
+static bool need_escape(const char *str){
+    const guchar *p;
+
+    for (p = (const guchar *)str; *p; p++){
+        switch (*p){
+            case '&':
+            case '<':
+            case '>':
+            case '\'':
+            case '"':
+            case 0x7f:
+                return TRUE;
+            case 0xc2:
+                // U+0080 ~ U+009F
+                if (p[1] >= 0x80 && p[1] <= 0x9f){
+                    return TRUE;
+                }
+                break;
+            default:
+                if (*p < 0x20 && *p != '\t' && *p != '\n' && *p != '\r'){
+                    return TRUE;
+                }
+        }
+    }
+
+    return FALSE;
+}
+
+static GDateTime* date_time_new_from_timestamp(gint64 timestamp){
+    GDateTime *sec_time;
+    GDateTime *time;
+
+    sec_time = g_date_time_new_from_unix_local(timestamp / G_USEC_PER_SEC);
+    time = g_date_time_add(sec_time, timestamp % G_USEC_PER_SEC);
+    g_date_time_unref(sec_time);
+
+    return time;
+}
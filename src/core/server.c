@@ -37,6 +37,13 @@
 #include "utils.h"
 #include "i18n.h"
 
+/* Number of stale users checked per idle callback, so that sweeping a large
+ * table does not block the main loop */
+#define SWEEP_BATCH_SIZE    256
+
+static gboolean on_sweep_idle(gpointer user_data);
+static void displace_user(SrnServer *srv, SrnServerUser *user);
+
 SrnServer* srn_server_new(const char *name, SrnServerConfig *cfg){
     SrnServer *srv;
 
@@ -60,17 +67,29 @@ SrnServer* srn_server_new(const char *name, SrnServerConfig *cfg){
 
     /* NOTE: Ping related issuses are not handled in server.c */
     srv->reconn_interval = SRN_SERVER_RECONN_INTERVAL;
+    srv->reconn_backoff = SRN_SERVER_RECONN_INTERVAL;
     /* srv->last_pong = 0; */ // by g_malloc0()
     /* srv->delay = 0; */ // by g_malloc0()
     /* srv->ping_timer = 0; */ // by g_malloc0()
     /* srv->reconn_timer = 0; */ // by g_malloc0()
 
     /* Server user */
+    srv->intern_pool = srn_intern_pool_new(SRN_CASEMAPPING_RFC1459);
+    // Keys are interned folded nicks, so they can be compared by pointer
     srv->user_table = g_hash_table_new_full(
-            g_str_hash, g_str_equal,
+            g_direct_hash, g_direct_equal,
             NULL, (GDestroyNotify)srn_server_user_free);
-    srv->_user = srn_server_add_and_get_user(srv, "");
-    srv->user = srn_server_add_and_get_user(srv, srv->cfg->user->nick);
+    srv->stale_users = g_queue_new();
+
+    // Monitored nicks are folded by casemapping of intern_pool
+    srv->monitor = srn_server_monitor_new(srv);
+    for (GList *lst = cfg->monitor_list; lst; lst = g_list_next(lst)){
+        srn_server_monitor_add(srv->monitor, lst->data);
+    }
+
+    srv->_user = srn_server_user_ref(srn_server_add_and_get_user(srv, ""));
+    srv->user = srn_server_user_ref(
+            srn_server_add_and_get_user(srv, srv->cfg->user->nick));
     srn_server_user_set_username(srv->user, srv->cfg->user->username);
     srn_server_user_set_realname(srv->user, srv->cfg->user->realname);
     srn_server_user_set_is_me(srv->user, TRUE);
@@ -99,10 +118,20 @@ void srn_server_free(SrnServer *srv){
     // Server's chat should be freed after all chat in chat list are freed
     srn_chat_free(srv->chat);
 
+    if (srv->sweep_id){
+        g_source_remove(srv->sweep_id);
+        srv->sweep_id = 0;
+    }
+    g_queue_free(srv->stale_users);
+
     // srv->user and srv->_user are freed here as well
     g_hash_table_remove_all(srv->user_table);
 
+    g_hash_table_destroy(srv->user_table);
+    srn_intern_pool_free(srv->intern_pool);
+
     srn_server_cap_free(srv->cap);
+    srn_server_monitor_free(srv->monitor);
 
     str_assign(&srv->name, NULL);
 
@@ -112,6 +141,14 @@ void srn_server_free(SrnServer *srv){
 void srn_server_set_config(SrnServer *srv, SrnServerConfig *cfg){
     sirc_set_config(srv->irc, cfg->irc);
 
+    // Add before remove, so unchanged nicks are never unmonitored
+    for (GList *lst = cfg->monitor_list; lst; lst = g_list_next(lst)){
+        srn_server_monitor_add(srv->monitor, lst->data);
+    }
+    for (GList *lst = srv->cfg->monitor_list; lst; lst = g_list_next(lst)){
+        srn_server_monitor_remove(srv->monitor, lst->data);
+    }
+
     srv->cfg = cfg;
     srv->addr = cfg->addrs->data;
 }
@@ -223,20 +260,14 @@ void srn_server_wait_until_registered(SrnServer *srv){
 }
 
 SrnRet srn_server_add_chat(SrnServer *srv, const char *name){
-    GList *lst;
     SrnRet ret;
     SrnChat *chat;
     SrnChatConfig *chat_cfg;
 
     g_return_val_if_fail(srn_server_is_valid(srv), SRN_ERR);
 
-    lst = srv->chat_list;
-    while (lst) {
-        chat = lst->data;
-        if (g_ascii_strcasecmp(chat->name, name) == 0){
-            return SRN_ERR;
-        }
-        lst = g_list_next(lst);
+    if (srn_server_get_chat(srv, name)){
+        return SRN_ERR;
     }
 
     chat_cfg = srn_chat_config_new();
@@ -265,6 +296,17 @@ SrnRet srn_server_add_chat(SrnServer *srv, const char *name){
         srv->chat_list = g_list_append(srv->chat_list, chat);
     }
 
+    if (chat->type == SRN_CHAT_TYPE_DIALOG){
+        SrnServerUser *user;
+
+        // Presence of dialog is pushed by server, see irc_event_numeric()
+        srn_server_monitor_add(srv->monitor, chat->name);
+        user = srn_server_get_user(srv, chat->name);
+        if (user && user->is_online){
+            sui_set_presence(chat->ui, user->is_online, user->is_away);
+        }
+    }
+
     /* Run chat auto run commands */
     for (GList *lst = chat->cfg->auto_run_cmd_list; lst; lst = g_list_next(lst)){
         SrnRet ret;
@@ -309,6 +351,9 @@ SrnRet srn_server_rm_chat(SrnServer *srv, SrnChat *chat){
     if (srv->cur_chat == chat){
         srv->cur_chat = srv->chat;
     }
+    if (chat->type == SRN_CHAT_TYPE_DIALOG){
+        srn_server_monitor_remove(srv->monitor, chat->name);
+    }
     chat_cfg = chat->cfg;
     srn_chat_free(chat);
     srn_chat_config_free(chat_cfg);
@@ -319,14 +364,21 @@ SrnRet srn_server_rm_chat(SrnServer *srv, SrnChat *chat){
 
 SrnChat* srn_server_get_chat(SrnServer *srv, const char *name) {
     GList *lst;
+    const char *folded;
     SrnChat *chat;
 
     g_return_val_if_fail(srn_server_is_valid(srv), NULL);
 
+    // No chat has the name if its folded form is not even interned
+    folded = srn_intern_lookup_folded(srv->intern_pool, name);
+    if (!folded){
+        return NULL;
+    }
+
     lst = srv->chat_list;
     while (lst) {
         chat = lst->data;
-        if (g_ascii_strcasecmp(chat->name, name) == 0){
+        if (srn_intern_get_folded(chat->name) == folded){
             return chat;
         }
         lst = g_list_next(lst);
@@ -369,12 +421,22 @@ SrnRet srn_server_add_user(SrnServer *srv, const char *nick){
         return SRN_ERR;
     }
     user = srn_server_user_new(srv, nick);
-    return g_hash_table_insert(srv->user_table, user->nick, user) ?
-        SRN_OK : SRN_ERR;
+    g_hash_table_insert(srv->user_table,
+            (gpointer)srn_intern_get_folded(user->nick), user);
+    // Reclaim it if nobody takes a reference
+    srn_server_queue_stale_user(srv, user);
+
+    return SRN_OK;
 }
 
 SrnServerUser* srn_server_get_user(SrnServer *srv, const char *nick){
-    return g_hash_table_lookup(srv->user_table, nick);
+    const char *folded;
+
+    folded = srn_intern_lookup_folded(srv->intern_pool, nick);
+    if (!folded){
+        return NULL;
+    }
+    return g_hash_table_lookup(srv->user_table, folded);
 }
 
 SrnServerUser* srn_server_add_and_get_user(SrnServer *srv, const char *nick){
@@ -383,15 +445,149 @@ SrnServerUser* srn_server_add_and_get_user(SrnServer *srv, const char *nick){
 }
 
 SrnRet srn_server_rm_user(SrnServer *srv, SrnServerUser *user){
-    return g_hash_table_remove(srv->user_table, user->nick) ? SRN_OK : SRN_ERR;
+    gconstpointer key;
+
+    g_return_val_if_fail(user->refcount == 0, SRN_ERR);
+
+    key = user->is_displaced ? (gconstpointer)user : srn_intern_get_folded(user->nick);
+    if (g_hash_table_lookup(srv->user_table, key) != user){
+        return SRN_ERR;
+    }
+    if (user->is_stale){
+        g_queue_remove(srv->stale_users, user);
+    }
+
+    return g_hash_table_remove(srv->user_table, key) ? SRN_OK : SRN_ERR;
 }
 
 SrnRet srn_server_rename_user(SrnServer *srv, SrnServerUser *user,
         const char *nick){
-    if (!g_hash_table_steal(srv->user_table, user->nick)){
+    SrnServerUser *old_user;
+
+    if (!g_hash_table_steal(srv->user_table, srn_intern_get_folded(user->nick))){
         return SRN_ERR;
     }
+    // The new nick may be held by a user we have seen before
+    old_user = srn_server_get_user(srv, nick);
+    if (old_user){
+        if (old_user->refcount == 0){
+            srn_server_rm_user(srv, old_user);
+        } else {
+            WARN_FR("Nick %s is still used by another user", nick);
+            // We must have missed its QUIT or NICK
+            srn_server_user_set_is_online(old_user, FALSE);
+            g_hash_table_steal(srv->user_table,
+                    srn_intern_get_folded(old_user->nick));
+            displace_user(srv, old_user);
+        }
+    }
     srn_server_user_set_nick(user, nick);
-    return g_hash_table_insert(srv->user_table, user->nick, user) ?
+    return g_hash_table_insert(srv->user_table,
+            (gpointer)srn_intern_get_folded(user->nick), user) ?
         SRN_OK : SRN_ERR;
 }
+
+/**
+ * @brief srn_server_set_casemapping changes how nicks and chat names are
+ * compared, usually announced by ISUPPORT token "CASEMAPPING".
+ *
+ * @param srv
+ * @param casemapping
+ */
+void srn_server_set_casemapping(SrnServer *srv, SrnCasemapping casemapping){
+    GList *users;
+    GList *lst;
+
+    if (srn_intern_pool_get_casemapping(srv->intern_pool) == casemapping){
+        return;
+    }
+
+    // Folded nicks are changed, rebuild the table
+    users = g_hash_table_get_values(srv->user_table);
+    g_hash_table_steal_all(srv->user_table);
+    srn_intern_pool_set_casemapping(srv->intern_pool, casemapping);
+    for (lst = users; lst; lst = g_list_next(lst)){
+        SrnServerUser *user;
+        const char *folded;
+
+        user = lst->data;
+        if (user->is_displaced){
+            displace_user(srv, user);
+            continue;
+        }
+        folded = srn_intern_get_folded(user->nick);
+        if (g_hash_table_contains(srv->user_table, folded)){
+            // Should not happen on a sane server, the user is kept until
+            // it is no longer referenced
+            WARN_FR("Nick %s conflicts after changing casemapping", user->nick);
+            displace_user(srv, user);
+            continue;
+        }
+        g_hash_table_insert(srv->user_table, (gpointer)folded, user);
+    }
+    g_list_free(users);
+
+    srn_server_monitor_refold(srv->monitor);
+}
+
+/**
+ * @brief srn_server_queue_stale_user queues a server user which is not
+ * referenced, it will be removed from server and freed when main loop is
+ * idle, unless it is referenced again before that.
+ *
+ * @param srv
+ * @param user
+ */
+void srn_server_queue_stale_user(SrnServer *srv, SrnServerUser *user){
+    g_return_if_fail(srv->stale_users);
+
+    if (user->is_stale){
+        return;
+    }
+    user->is_stale = TRUE;
+    g_queue_push_tail(srv->stale_users, user);
+
+    if (!srv->sweep_id){
+        srv->sweep_id = g_idle_add_full(G_PRIORITY_LOW,
+                on_sweep_idle, srv, NULL);
+    }
+}
+
+static gboolean on_sweep_idle(gpointer user_data){
+    SrnServer *srv;
+
+    srv = user_data;
+    for (int i = 0; i < SWEEP_BATCH_SIZE; i++){
+        SrnServerUser *user;
+
+        user = g_queue_pop_head(srv->stale_users);
+        if (!user){
+            srv->sweep_id = 0;
+            return G_SOURCE_REMOVE;
+        }
+        user->is_stale = FALSE;
+        if (user->refcount > 0){
+            // Referenced again after it was queued
+            continue;
+        }
+        if (RET_IS_OK(srn_server_rm_user(srv, user))){
+            srv->reclaimed_users++;
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief displace_user keeps a user whose nick is taken by another user in
+ * user table, it can no longer be found by nick, but it is still freed by
+ * srn_server_rm_user() or when server is freed.
+ */
+static void displace_user(SrnServer *srv, SrnServerUser *user){
+    user->is_displaced = TRUE;
+    // No interned string has the same address as the user
+    g_hash_table_insert(srv->user_table, user, user);
+    if (user->refcount == 0){
+        srn_server_queue_stale_user(srv, user);
+    }
+}
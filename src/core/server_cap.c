@@ -47,6 +47,7 @@ struct _ServerCapSupport {
 
 static bool sasl_is_support(const char *value);
 static void sasl_on_enable(SrnServerCap *scap, const char *name);
+static void sasl_authenticate(SrnServer *srv);
 
 /* Global cap support table */
 static ServerCapSupport supported_caps[] = {
@@ -55,23 +56,23 @@ static ServerCapSupport supported_caps[] = {
     //     .offset = offsetof(EnabledCap, identify_msg),
     // },
 
-    // /* IRCv3 */
-    // {
-    //     .name = "multi-prefix",
-    //     .offset = offsetof(EnabledCap, mulit_prefix),
-    // },
-    // {
-    //     .name = "away-notify",
-    //     .offset = offsetof(EnabledCap, away_notify),
-    // },
-    // {
-    //     .name = "account-notify",
-    //     .offset = offsetof(EnabledCap, account_notify),
-    // },
-    // {
-    //     .name = "extended-join",
-    //     .offset = offsetof(EnabledCap, extended_join),
-    // },
+    /* IRCv3 */
+    {
+        .name = "multi-prefix",
+        .offset = offsetof(EnabledCap, multi_prefix),
+    },
+    {
+        .name = "away-notify",
+        .offset = offsetof(EnabledCap, away_notify),
+    },
+    {
+        .name = "account-notify",
+        .offset = offsetof(EnabledCap, account_notify),
+    },
+    {
+        .name = "extended-join",
+        .offset = offsetof(EnabledCap, extended_join),
+    },
     {
         .name = "sasl",
         .offset = offsetof(EnabledCap, sasl),
@@ -86,23 +87,31 @@ static ServerCapSupport supported_caps[] = {
         .name = "server-time",
         .offset = offsetof(EnabledCap, server_time),
     },
-    // {
-    //     .name = "userhost-in-names",
-    //     .offset = offsetof(EnabledCap, userhost_in_names),
-    // },
+    {
+        .name = "userhost-in-names",
+        .offset = offsetof(EnabledCap, userhost_in_names),
+    },
     {
         // Auto enabled on IRCv3.2 and aboved
         .name = "cap-notify",
         .offset = offsetof(EnabledCap, cap_notify),
     },
-    // {
-    //     .name = "chghost",
-    //     .offset = offsetof(EnabledCap, chghost),
-    // },
+    {
+        .name = "chghost",
+        .offset = offsetof(EnabledCap, chghost),
+    },
     {
         .name = "invite-notify",
         .offset = offsetof(EnabledCap, invite_notify),
     },
+    {
+        .name = "batch",
+        .offset = offsetof(EnabledCap, batch),
+    },
+    {
+        .name = "draft/chathistory",
+        .offset = offsetof(EnabledCap, draft_chathistory),
+    },
 
     // /* ZNC */
     // {
@@ -133,6 +142,81 @@ void srn_server_cap_free(SrnServerCap *scap){
     g_free(scap);
 }
 
+/**
+ * @brief srn_server_cap_reset forgets all capabilities, should be called when
+ * a new connection is established.
+ *
+ * @param scap
+ */
+void srn_server_cap_reset(SrnServerCap *scap){
+    g_return_if_fail(scap);
+
+    memset(&scap->client_enabled, 0, sizeof(scap->client_enabled));
+    memset(&scap->server_enabled, 0, sizeof(scap->server_enabled));
+    scap->sasl_started = FALSE;
+}
+
+/**
+ * @brief srn_server_cap_get_requests returns capabilities supported by both
+ * server and us but not enabled yet.
+ *
+ * @param scap
+ *
+ * @return Space-separated capability names, should be freed by g_free(). NULL
+ * if nothing to request.
+ */
+char* srn_server_cap_get_requests(SrnServerCap *scap){
+    GString *str;
+
+    g_return_val_if_fail(scap, NULL);
+
+    str = g_string_new(NULL);
+    for (int i = 0; supported_caps[i].name; i++){
+        bool *server_cap;
+        bool *client_cap;
+
+        server_cap = (void *)&scap->server_enabled + supported_caps[i].offset;
+        client_cap = (void *)&scap->client_enabled + supported_caps[i].offset;
+        if (*server_cap && !*client_cap){
+            if (str->len){
+                g_string_append_c(str, ' ');
+            }
+            g_string_append(str, supported_caps[i].name);
+        }
+    }
+
+    return g_string_free(str, str->len == 0);
+}
+
+/**
+ * @brief srn_server_cap_begin_sasl starts SASL authentication before "sasl"
+ * capability is acknowledged, it is used for pipelining "AUTHENTICATE" with
+ * "CAP REQ", server processes them in order.
+ *
+ * @param scap
+ *
+ * @return TRUE if authentication is started, FALSE if server does not support
+ * SASL or SASL is not used.
+ */
+bool srn_server_cap_begin_sasl(SrnServerCap *scap){
+    SrnServer *srv;
+
+    g_return_val_if_fail(scap, FALSE);
+    srv = scap->srv;
+    g_return_val_if_fail(srv, FALSE);
+
+    if (!srn_login_method_is_sasl(srv->cfg->user->login->method)
+            || !scap->server_enabled.sasl
+            || srv->loggedin){
+        return FALSE;
+    }
+
+    sasl_authenticate(srv);
+    scap->sasl_started = TRUE;
+
+    return TRUE;
+}
+
 SrnRet srn_server_cap_server_enable(SrnServerCap *scap, const char *name, bool enable){
     bool *cap;
 
@@ -257,13 +341,8 @@ static void sasl_on_enable(SrnServerCap *scap, const char *name){
     srv = scap->srv;
     g_return_if_fail(srv);
 
-    switch (srv->cfg->user->login->method){
-        case SRN_LOGIN_METHOD_SASL_PLAIN:
-        case SRN_LOGIN_METHOD_SASL_ECDSA_NIST256P_CHALLENGE:
-        case SRN_LOGIN_METHOD_SASL_EXTERNAL:
-            break;
-        default:
-            return;
+    if (!srn_login_method_is_sasl(srv->cfg->user->login->method)){
+        return;
     }
     if (!srv->cap->client_enabled.sasl){
         return;
@@ -271,7 +350,15 @@ static void sasl_on_enable(SrnServerCap *scap, const char *name){
     if (srv->loggedin){
         return; // TODO: reauth?
     }
+    if (scap->sasl_started){
+        return; // Already sent along with "CAP REQ"
+    }
+
+    sasl_authenticate(srv);
+    scap->sasl_started = TRUE;
+}
 
+static void sasl_authenticate(SrnServer *srv){
     switch (srv->cfg->user->login->method){
         case SRN_LOGIN_METHOD_SASL_PLAIN:
             sirc_cmd_authenticate(srv->irc, "PLAIN");
@@ -88,6 +88,7 @@ void srn_server_config_free(SrnServerConfig *cfg){
     str_assign(&cfg->password, NULL);
     g_list_free_full(cfg->auto_join_chat_list, g_free);
     g_list_free_full(cfg->auto_run_cmd_list, g_free);
+    g_list_free_full(cfg->monitor_list, g_free);
 
     srn_user_config_free(cfg->user);
     sirc_config_free(cfg->irc);
@@ -0,0 +1,373 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file server_monitor.c
+ * @brief Track presence of users by IRCv3 MONITOR
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-06-04
+ *
+ * A nick is watched as long as a dialog with it is open or it is listed in
+ * server configuration, the watch set is synchronized to server's monitor
+ * list when main loop is idle, so nicks added at once (such as dialogs
+ * restored on startup) are sent in as few "MONITOR +" commands as possible.
+ * Server then pushes RPL_MONONLINE and RPL_MONOFFLINE, see
+ * https://ircv3.net/specs/core/monitor-3.2
+ *
+ * Nicks are compared by server's casemapping as the server does, so "Alice"
+ * and "alice" are one target.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "core/core.h"
+#include "sirc/sirc.h"
+#include "srain.h"
+#include "log.h"
+#include "utils.h"
+
+#define MONITOR_TARGETS_MAX_LEN 400 // Keep "MONITOR + <targets>" in a line
+
+typedef struct _MonitorTarget MonitorTarget;
+
+struct _MonitorTarget {
+    char *nick;     // Nick sent to server, as it is first added
+    int refcount;   // Number of dialogs and configuration entries watching it
+    bool monitored; // In server's monitor list
+    bool rejected;  // Server's monitor list is full, do not retry
+};
+
+static char* fold_nick(SrnServerMonitor *self, const char *nick);
+static void monitor_target_free(MonitorTarget *target);
+static void queue_sync(SrnServerMonitor *self);
+static gboolean on_sync_idle(gpointer user_data);
+static void append_target(SrnServerMonitor *self, GString *targets,
+        const char *op, const char *nick);
+
+SrnServerMonitor* srn_server_monitor_new(SrnServer *srv){
+    SrnServerMonitor *self;
+
+    self = g_malloc0(sizeof(SrnServerMonitor));
+    self->srv = srv;
+    self->targets = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify)monitor_target_free);
+
+    return self;
+}
+
+void srn_server_monitor_free(SrnServerMonitor *self){
+    g_return_if_fail(self);
+
+    if (self->sync_id){
+        g_source_remove(self->sync_id);
+    }
+    g_hash_table_destroy(self->targets);
+    g_free(self);
+}
+
+/**
+ * @brief srn_server_monitor_set_limit enables MONITOR on current
+ * connection, usually announced by ISUPPORT token "MONITOR".
+ *
+ * @param self
+ * @param limit Maximum number of nicks in monitor list, -1 if unlimited
+ */
+void srn_server_monitor_set_limit(SrnServerMonitor *self, int limit){
+    g_return_if_fail(self);
+
+    self->limit = limit;
+    queue_sync(self);
+}
+
+/**
+ * @brief srn_server_monitor_reset forgets server's monitor list, should be
+ * called when connection is lost.
+ *
+ * @param self
+ */
+void srn_server_monitor_reset(SrnServerMonitor *self){
+    GHashTableIter iter;
+    MonitorTarget *target;
+
+    g_return_if_fail(self);
+
+    self->limit = 0;
+    self->monitored = 0;
+    g_hash_table_iter_init(&iter, self->targets);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&target)){
+        if (target->refcount == 0){
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+        target->monitored = FALSE;
+        target->rejected = FALSE;
+    }
+    if (self->sync_id){
+        g_source_remove(self->sync_id);
+        self->sync_id = 0;
+    }
+}
+
+/**
+ * @brief srn_server_monitor_add starts watching a nick, a nick can be
+ * watched more than once.
+ *
+ * @param self
+ * @param nick
+ */
+void srn_server_monitor_add(SrnServerMonitor *self, const char *nick){
+    char *folded;
+    MonitorTarget *target;
+
+    g_return_if_fail(self);
+    g_return_if_fail(!str_is_empty(nick));
+
+    folded = fold_nick(self, nick);
+    target = g_hash_table_lookup(self->targets, folded);
+    if (!target){
+        target = g_malloc0(sizeof(MonitorTarget));
+        target->nick = g_strdup(nick);
+        g_hash_table_insert(self->targets, folded, target);
+    } else {
+        g_free(folded);
+    }
+    target->refcount++;
+    if (!target->monitored){
+        queue_sync(self);
+    }
+}
+
+/**
+ * @brief srn_server_monitor_remove stops watching a nick added by
+ * srn_server_monitor_add().
+ *
+ * @param self
+ * @param nick
+ */
+void srn_server_monitor_remove(SrnServerMonitor *self, const char *nick){
+    char *folded;
+    MonitorTarget *target;
+
+    g_return_if_fail(self);
+
+    folded = fold_nick(self, nick);
+    target = g_hash_table_lookup(self->targets, folded);
+    if (!target || target->refcount <= 0){
+        g_warn_if_reached();
+        g_free(folded);
+        return;
+    }
+
+    target->refcount--;
+    if (target->refcount == 0){
+        if (target->monitored){
+            // Removed from server's monitor list when syncing
+            queue_sync(self);
+        } else {
+            g_hash_table_remove(self->targets, folded);
+        }
+    }
+    g_free(folded);
+}
+
+/**
+ * @brief srn_server_monitor_reject marks nicks which are not added to
+ * server's monitor list because it is full, see ERR_MONLISTFULL.
+ *
+ * @param self
+ * @param nicks Comma-separated nicks
+ */
+void srn_server_monitor_reject(SrnServerMonitor *self, const char *nicks){
+    char **strv;
+
+    g_return_if_fail(self);
+    g_return_if_fail(nicks);
+
+    strv = g_strsplit(nicks, ",", 0);
+    for (int i = 0; strv[i]; i++){
+        char *folded;
+        MonitorTarget *target;
+
+        folded = fold_nick(self, strv[i]);
+        target = g_hash_table_lookup(self->targets, folded);
+        g_free(folded);
+        if (!target || !target->monitored){
+            continue;
+        }
+        target->monitored = FALSE;
+        target->rejected = TRUE;
+        self->monitored--;
+    }
+    g_strfreev(strv);
+}
+
+/**
+ * @brief srn_server_monitor_sync sends the changes of watch set to server.
+ * Targets are batched into as few commands as possible, and no more than
+ * the limit of server are monitored.
+ *
+ * @param self
+ */
+void srn_server_monitor_sync(SrnServerMonitor *self){
+    GString *targets;
+    GHashTableIter iter;
+    MonitorTarget *target;
+
+    g_return_if_fail(self);
+
+    if (self->sync_id){
+        g_source_remove(self->sync_id);
+        self->sync_id = 0;
+    }
+    if (self->limit == 0 || !srn_server_is_registered(self->srv)){
+        return;
+    }
+
+    targets = g_string_new(NULL);
+    sirc_cork(self->srv->irc);
+
+    // Remove unwatched nicks first, so there is room for new ones
+    g_hash_table_iter_init(&iter, self->targets);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&target)){
+        if (target->refcount > 0){
+            continue;
+        }
+        if (target->monitored){
+            append_target(self, targets, "-", target->nick);
+            self->monitored--;
+        }
+        g_hash_table_iter_remove(&iter);
+    }
+    if (targets->len){
+        sirc_cmd_monitor(self->srv->irc, "-", targets->str);
+        g_string_truncate(targets, 0);
+    }
+
+    g_hash_table_iter_init(&iter, self->targets);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&target)){
+        if (target->monitored || target->rejected){
+            continue;
+        }
+        if (self->limit > 0 && self->monitored >= self->limit){
+            WARN_FR("Monitor list of %s is full, limit: %d",
+                    self->srv->name, self->limit);
+            break;
+        }
+        append_target(self, targets, "+", target->nick);
+        target->monitored = TRUE;
+        self->monitored++;
+    }
+    if (targets->len){
+        sirc_cmd_monitor(self->srv->irc, "+", targets->str);
+    }
+
+    sirc_uncork(self->srv->irc);
+    g_string_free(targets, TRUE);
+}
+
+/**
+ * @brief srn_server_monitor_refold rebuilds targets after casemapping of
+ * server is changed. Targets which become the same nick are merged.
+ *
+ * @param self
+ */
+void srn_server_monitor_refold(SrnServerMonitor *self){
+    char *key;
+    GHashTable *old;
+    GHashTableIter iter;
+    MonitorTarget *target;
+
+    g_return_if_fail(self);
+
+    old = self->targets;
+    self->targets = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify)monitor_target_free);
+
+    g_hash_table_iter_init(&iter, old);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&target)){
+        char *folded;
+        MonitorTarget *dup;
+
+        g_hash_table_iter_steal(&iter);
+        g_free(key);
+        folded = fold_nick(self, target->nick);
+        dup = g_hash_table_lookup(self->targets, folded);
+        if (!dup){
+            g_hash_table_insert(self->targets, folded, target);
+            continue;
+        }
+
+        // Server's monitor list is compared by the same casemapping, the
+        // nick is in it at most once
+        dup->refcount += target->refcount;
+        if (dup->monitored && target->monitored){
+            self->monitored--;
+        }
+        dup->monitored = dup->monitored || target->monitored;
+        dup->rejected = dup->rejected && target->rejected;
+        monitor_target_free(target);
+        g_free(folded);
+    }
+    g_hash_table_destroy(old);
+}
+
+static char* fold_nick(SrnServerMonitor *self, const char *nick){
+    return srn_casemapping_fold(
+            srn_intern_pool_get_casemapping(self->srv->intern_pool), nick);
+}
+
+static void monitor_target_free(MonitorTarget *target){
+    g_free(target->nick);
+    g_free(target);
+}
+
+static void queue_sync(SrnServerMonitor *self){
+    if (self->limit == 0 || self->sync_id){
+        return;
+    }
+    self->sync_id = g_idle_add(on_sync_idle, self);
+}
+
+static gboolean on_sync_idle(gpointer user_data){
+    SrnServerMonitor *self;
+
+    self = user_data;
+    self->sync_id = 0;
+    srn_server_monitor_sync(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief append_target appends a nick to comma-separated targets, the
+ * targets are sent first if the line would be too long.
+ */
+static void append_target(SrnServerMonitor *self, GString *targets,
+        const char *op, const char *nick){
+    if (targets->len
+            && targets->len + strlen(nick) + 1 > MONITOR_TARGETS_MAX_LEN){
+        sirc_cmd_monitor(self->srv->irc, op, targets->str);
+        g_string_truncate(targets, 0);
+    }
+    if (targets->len){
+        g_string_append_c(targets, ',');
+    }
+    g_string_append(targets, nick);
+}
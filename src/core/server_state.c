@@ -37,6 +37,7 @@
 
 static const char *srn_server_state_to_string(SrnServerState state);
 static const char *srn_server_action_to_string(SrnServerAction action);
+static void srn_server_schedule_reconnect(SrnServer *srv);
 static gboolean srn_server_reconnect_timeout(gpointer user_data);
 static gboolean idle_to_rm_server(gpointer user_data);
 
@@ -71,6 +72,7 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
             switch (action) {
                 case SRN_SERVER_ACTION_RECONNECT:
                 case SRN_SERVER_ACTION_CONNECT:
+                    srv->reconn_backoff = SRN_SERVER_RECONN_INTERVAL;
                     sirc_connect(srv->irc, srv->addr->host, srv->addr->port);
                     next_state = SRN_SERVER_STATE_CONNECTING;
                     break;
@@ -93,13 +95,12 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                     ret = RET_ERR(unallowed, _("Hold on, srain is connecting to the server, please do not repeat the action"));
                     break;
                 case SRN_SERVER_ACTION_CONNECT_FAIL:
-                    srv->reconn_timer = g_timeout_add(srv->reconn_interval,
-                            srn_server_reconnect_timeout, srv);
+                    srn_server_schedule_reconnect(srv);
                     next_state = SRN_SERVER_STATE_RECONNECTING;
                     break;
                 case SRN_SERVER_ACTION_CONNECT_FINISH:
-                    // TODO: reset reconn_interval after connection becomes stable
-                    srv->reconn_interval = SRN_SERVER_RECONN_STEP;
+                    // Backoff is reset when disconnected if connection is stable
+                    srv->connected_time = g_get_monotonic_time();
                     next_state = SRN_SERVER_STATE_CONNECTED;
                     break;
                 case SRN_SERVER_ACTION_DISCONNECT:
@@ -134,8 +135,11 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                     next_state = SRN_SERVER_STATE_QUITING;
                     break;
                 case SRN_SERVER_ACTION_DISCONNECT_FINISH:
-                    srv->reconn_timer = g_timeout_add(srv->reconn_interval,
-                            srn_server_reconnect_timeout, srv);
+                    if (g_get_monotonic_time() - srv->connected_time
+                            >= SRN_SERVER_RECONN_STABLE_TIME * 1000){
+                        srv->reconn_backoff = SRN_SERVER_RECONN_INTERVAL;
+                    }
+                    srn_server_schedule_reconnect(srv);
                     next_state = SRN_SERVER_STATE_RECONNECTING;
                     break;
                 default:
@@ -196,6 +200,11 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
         case SRN_SERVER_STATE_RECONNECTING:
             switch (action) {
                 case SRN_SERVER_ACTION_CONNECT:
+                    // Connect now, for example, network becomes available
+                    if (srv->reconn_timer){
+                        g_source_remove(srv->reconn_timer);
+                        srv->reconn_timer = 0;
+                    }
                     sirc_connect(srv->irc, srv->addr->host, srv->addr->port);
                     next_state = SRN_SERVER_STATE_CONNECTING;
                     break;
@@ -291,11 +300,31 @@ static const char *srn_server_action_to_string(SrnServerAction action){
     }
 }
 
+/**
+ * @brief srn_server_schedule_reconnect schedules a reconnect with capped
+ * exponential backoff. The interval is randomly picked from the upper half of
+ * backoff, so servers disconnected at the same time, for example, by a
+ * network change, do not reconnect in lockstep.
+ *
+ * @param srv
+ */
+static void srn_server_schedule_reconnect(SrnServer *srv){
+    unsigned long backoff;
+
+    backoff = CLAMP(srv->reconn_backoff,
+            SRN_SERVER_RECONN_INTERVAL, SRN_SERVER_RECONN_MAX_INTERVAL);
+    srv->reconn_interval = backoff / 2 + g_random_int_range(0, backoff / 2 + 1);
+    srv->reconn_backoff = MIN(backoff * 2, SRN_SERVER_RECONN_MAX_INTERVAL);
+    srv->reconn_timer = g_timeout_add(srv->reconn_interval,
+            srn_server_reconnect_timeout, srv);
+}
+
 static gboolean srn_server_reconnect_timeout(gpointer user_data){
     SrnServer *srv;
 
     srv = user_data;
-    srv->reconn_interval += SRN_SERVER_RECONN_STEP;
+    srv->reconn_timer = 0;
+    srv->reconn_count++;
     srn_server_state_transfrom(srv, SRN_SERVER_ACTION_CONNECT);
 
     return G_SOURCE_REMOVE;
@@ -23,6 +23,9 @@
 #include "utils.h"
 
 static void srn_server_user_update_chat_user(SrnServerUser *self);
+static bool intern_assign(SrnServerUser *self, char **left, const char *right);
+static void update_dialog_presence(SrnServer *srv, const char *nick,
+        bool online, bool away);
 
 SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick){
     SrnServerUser *self;
@@ -32,18 +35,50 @@ SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick){
     self = g_malloc0(sizeof(SrnServerUser));
     self->srv = srv;
     self->is_ignored = FALSE;
-    str_assign(&self->nick, nick);
+    self->nick = (char *)srn_intern(srv->intern_pool, nick);
     self->extra_data = srn_extra_data_new();
 
     return self;
 }
 
+/**
+ * @brief srn_server_user_ref takes a reference of server user, so that it will
+ * not be reclaimed. SrnChatUser, ignore rule and the server itself hold
+ * references, a temporary pointer used within an event handler needs not.
+ *
+ * @param self
+ *
+ * @return The server user itself
+ */
+SrnServerUser *srn_server_user_ref(SrnServerUser *self){
+    self->refcount++;
+
+    return self;
+}
+
+/**
+ * @brief srn_server_user_unref releases a reference of server user. An
+ * unreferenced server user is not freed immediately but reclaimed when main
+ * loop is idle, see srn_server_queue_stale_user().
+ *
+ * @param self
+ */
+void srn_server_user_unref(SrnServerUser *self){
+    g_return_if_fail(self->refcount > 0);
+
+    self->refcount--;
+    if (self->refcount == 0){
+        srn_server_queue_stale_user(self->srv, self);
+    }
+}
+
 void srn_server_user_free(SrnServerUser *self){
     g_return_if_fail(g_list_length(self->chat_user_list) == 0);
 
-    str_assign(&self->nick, NULL);
-    str_assign(&self->username, NULL);
-    str_assign(&self->hostname, NULL);
+    srn_intern_unref(self->nick);
+    srn_intern_unref(self->username);
+    srn_intern_unref(self->hostname);
+    srn_intern_unref(self->loginname);
     str_assign(&self->realname, NULL);
     srn_extra_data_free(self->extra_data);
     g_free(self);
@@ -63,6 +98,7 @@ SrnRet srn_server_user_attach_chat_user(SrnServerUser *self, SrnChatUser *chat_u
         lst = g_list_next(lst);
     }
     self->chat_user_list = g_list_append(self->chat_user_list, chat_user);
+    srn_server_user_ref(self);
 
     return SRN_OK;
 }
@@ -73,6 +109,7 @@ SrnRet srn_server_user_detach_chat_user(SrnServerUser *self, SrnChatUser *chat_u
     lst = g_list_find(self->chat_user_list, chat_user);
     if (lst){
         self->chat_user_list = g_list_delete_link(self->chat_user_list, lst);
+        srn_server_user_unref(self);
         return SRN_OK;
     }
 
@@ -80,22 +117,48 @@ SrnRet srn_server_user_detach_chat_user(SrnServerUser *self, SrnChatUser *chat_u
 }
 
 void srn_server_user_set_nick(SrnServerUser *self, const char *nick){
-    str_assign(&self->nick, nick);
+    if (self->is_online){
+        // Dialog with the old nick no longer talks to anyone
+        update_dialog_presence(self->srv, self->nick, FALSE, FALSE);
+    }
+    intern_assign(self, &self->nick, nick);
     srn_server_user_update_chat_user(self);
+    if (self->is_online){
+        update_dialog_presence(self->srv, self->nick, TRUE, self->is_away);
+    }
 }
 
 void srn_server_user_set_username(SrnServerUser *self, const char *username){
-    str_assign(&self->username, username);
-    srn_server_user_update_chat_user(self);
+    if (intern_assign(self, &self->username, username)){
+        srn_server_user_update_chat_user(self);
+    }
 }
 
 void srn_server_user_set_hostname(SrnServerUser *self, const char *hostname){
-    str_assign(&self->hostname, hostname);
-    srn_server_user_update_chat_user(self);
+    if (intern_assign(self, &self->hostname, hostname)){
+        srn_server_user_update_chat_user(self);
+    }
 }
 
 void srn_server_user_set_realname(SrnServerUser *self, const char *realname){
+    if (g_strcmp0(self->realname, realname) == 0){
+        return;
+    }
     str_assign(&self->realname, realname);
+    srn_server_user_update_chat_user(self);
+}
+
+/**
+ * @brief srn_server_user_set_loginname sets the account name which the user
+ * has identified as.
+ *
+ * @param self
+ * @param loginname NULL if the user is not logged in
+ */
+void srn_server_user_set_loginname(SrnServerUser *self, const char *loginname){
+    if (intern_assign(self, &self->loginname, loginname)){
+        srn_server_user_update_chat_user(self);
+    }
 }
 
 void srn_server_user_set_is_me(SrnServerUser *self, bool me){
@@ -107,6 +170,9 @@ void srn_server_user_set_is_me(SrnServerUser *self, bool me){
 }
 
 void srn_server_user_set_is_online(SrnServerUser *self, bool online){
+    if (self->is_online != online){
+        update_dialog_presence(self->srv, self->nick, online, self->is_away);
+    }
     self->is_online = online;
 
     if (!self->is_online){
@@ -117,17 +183,37 @@ void srn_server_user_set_is_online(SrnServerUser *self, bool online){
             SrnChatUser *chat_user;
 
             chat_user = lst->data;
-            srn_chat_user_set_is_joined(chat_user, FALSE);
+            // Chat user may be removed and detached from list
             lst = g_list_next(lst);
+            srn_chat_user_set_is_joined(chat_user, FALSE);
+            srn_chat_rm_user(chat_user->chat, chat_user);
         }
     }
 }
 
+void srn_server_user_set_is_away(SrnServerUser *self, bool away){
+    if (self->is_away == away){
+        return;
+    }
+    self->is_away = away;
+    srn_server_user_update_chat_user(self);
+    if (self->is_online){
+        update_dialog_presence(self->srv, self->nick, TRUE, self->is_away);
+    }
+}
+
 void srn_server_user_set_is_ignored(SrnServerUser *self, bool is_ignored){
     if (self->is_ignored == is_ignored) {
         return;
     }
     self->is_ignored = is_ignored;
+
+    // Ignore rule is kept as long as the user
+    if (self->is_ignored){
+        srn_server_user_ref(self);
+    } else {
+        srn_server_user_unref(self);
+    }
 }
 
 static void srn_server_user_update_chat_user(SrnServerUser *self){
@@ -142,3 +228,36 @@ static void srn_server_user_update_chat_user(SrnServerUser *self){
         lst = g_list_next(lst);
     }
 }
+
+/**
+ * @brief intern_assign assigns an interned copy of right to left.
+ *
+ * @return TRUE if the value is changed
+ */
+static bool intern_assign(SrnServerUser *self, char **left, const char *right){
+    const char *old;
+
+    old = *left;
+    if (g_strcmp0(old, right) == 0){
+        return FALSE;
+    }
+    *left = right ? (char *)srn_intern(self->srv->intern_pool, right) : NULL;
+    srn_intern_unref(old);
+
+    return TRUE;
+}
+
+/**
+ * @brief update_dialog_presence shows presence of user on the dialog with
+ * it, if any.
+ */
+static void update_dialog_presence(SrnServer *srv, const char *nick,
+        bool online, bool away){
+    SrnChat *chat;
+
+    chat = srn_server_get_chat(srv, nick);
+    if (!chat || chat->type != SRN_CHAT_TYPE_DIALOG){
+        return;
+    }
+    sui_set_presence(chat->ui, online, away);
+}
@@ -20,6 +20,8 @@
 
 #include "srain.h"
 #include "log.h"
+#include "histogram.h"
+#include "trace.h"
 
 #include "filter/filter.h"
 #include "./filter2.h"
@@ -31,6 +33,7 @@ extern SrnMessageFilter user_filter;
 extern SrnMessageFilter pattern_filter;
 extern SrnMessageFilter log_filter;
 static SrnMessageFilter *filters[MAX_FILTER];
+static SrnHistogram stats[MAX_FILTER]; // Time cost of filters in ns
 
 void srn_filter_init(void){
     int i;
@@ -61,21 +64,73 @@ void srn_filter_finalize(void){
     }
 }
 
-bool srn_filter_message(const SrnMessage *msg, SrnFilterFlags flags){
+bool srn_filter_message(const SrnMessage *msg, SrnFilterFlags flags,
+        SrnFilterInput input){
     g_return_val_if_fail(msg, SRN_ERR);
 
     for (int i = 0; i < MAX_FILTER; i++){
+        bool pass;
+        guint64 start;
+        guint64 end;
+
         if (!(flags & (1 << i))) {
             continue;
         }
         g_return_val_if_fail(filters[i]
                 && filters[i]->name
                 && filters[i]->filter, SRN_ERR);
+        if (filters[i]->input != input) {
+            continue;
+        }
 
-        if (!filters[i]->filter(msg)) {
+        start = srn_get_monotonic_ns();
+        pass = filters[i]->filter(msg);
+        end = srn_get_monotonic_ns();
+        srn_histogram_record(&stats[i], end - start);
+        SRN_TRACE_RECORD(filters[i]->name, start, end);
+        if (!pass) {
             return FALSE;
         }
     }
 
     return TRUE;
 }
+
+/**
+ * @brief srn_filter_dump_stats appends time cost of every filter module to
+ * the given string.
+ *
+ * @param str
+ * @param json If TRUE, dump as a JSON object which is keyed by module name.
+ */
+void srn_filter_dump_stats(GString *str, bool json){
+    bool first;
+
+    first = TRUE;
+    if (json) {
+        g_string_append_c(str, '{');
+    }
+    for (int i = 0; i < MAX_FILTER; i++){
+        if (!filters[i]) {
+            continue;
+        }
+        if (json) {
+            g_string_append_printf(str, "%s\"%s\":",
+                    first ? "" : ",", filters[i]->name);
+            srn_histogram_to_json(&stats[i], str);
+        } else {
+            g_string_append_printf(str, "\n  * %s: ", filters[i]->name);
+            srn_histogram_to_string(&stats[i], str);
+        }
+        first = FALSE;
+    }
+    if (json) {
+        g_string_append_c(str, '}');
+    }
+}
+
+void srn_filter_reset_stats(void){
+    for (int i = 0; i < MAX_FILTER; i++){
+        srn_histogram_reset(&stats[i]);
+    }
+}
@@ -22,6 +22,7 @@
 #define __IN_FILTER_H
 
 #include "core/core.h"
+#include "filter/filter.h"
 
 /**
  * @brief SrnMessageFilter defines a module context of a SrnMessgae filter
@@ -31,6 +32,7 @@ typedef struct _SrnMessageFilter SrnMessageFilter;
 
 struct _SrnMessageFilter {
     const char *name;
+    SrnFilterInput input;
     void (*init) (void);
     bool (*filter) (const SrnMessage *msg);
     void (*finalize) (void);
@@ -40,9 +40,13 @@ static bool filter(const SrnMessage *msg);
 
 /**
  * @brief log_filter is a filter module for recording chat log.
+ *
+ * It only needs raw content, but it must see the final decision of other
+ * filters and renderers, so it is run at the last stage.
  */
 SrnMessageFilter log_filter = {
     .name = "log",
+    .input = SRN_FILTER_INPUT_RENDERED,
     .filter = filter,
 };
 
@@ -52,12 +56,15 @@ bool filter(const SrnMessage *msg) {
     FILE *fp;
     char *file;
     GString *basename;
+    GDateTime *time;
 
     if (!msg->chat->cfg->log) {
         return TRUE;
     }
 
-    date_str = g_date_time_format(msg->time, "%F");
+    time = srn_message_get_time(msg);
+    date_str = g_date_time_format(time, "%F");
+    g_date_time_unref(time);
     g_return_val_if_fail(date_str, TRUE);
 
     basename = g_string_new("");
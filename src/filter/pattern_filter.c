@@ -16,9 +16,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "core/core.h"
 #include "markup_renderer.h"
 #include "pattern_set.h"
+#include "mirc.h"
 
 #include "./filter2.h"
 
@@ -30,6 +33,8 @@ static bool filter(const SrnMessage *msg);
 static GList** alloc_patterns();
 static void free_patterns(GList **patterns);
 static GList* get_patterns(const SrnMessage *msg);
+static void strip_range(const char *text, gsize len, const MircStyle *style,
+        void *user_data);
 static void text(GMarkupParseContext *context, const gchar *text,
         gsize text_len, gpointer user_data, GError **error);
 
@@ -38,15 +43,20 @@ static SrnMarkupRenderer *markup_renderer;
 /**
  * @brief pattern_filter is a filter module for filtering message which matches
  * given pattern.
+ *
+ * Patterns are matched against raw content with mIRC formatting stripped, so
+ * the message need not be rendered before filtering. For message relayed by
+ * bot, it is the relayed content extracted by pattern renderer.
  */
 SrnMessageFilter pattern_filter = {
     .name = "pattern",
+    .input = SRN_FILTER_INPUT_CONTENT,
     .init = init,
     .finalize = finalize,
     .filter = filter,
 };
 
-void init(void) {
+static void init(void) {
     GMarkupParser *parser;
 
     markup_renderer = srn_markup_renderer_new();
@@ -56,31 +66,49 @@ void init(void) {
     parser->text = text;
 }
 
-void finalize(void) {
+static void finalize(void) {
     srn_markup_renderer_free(markup_renderer);
 }
 
 static bool filter(const SrnMessage *msg) {
     bool drop;
-    char *raw_content;
+    gsize len;
+    char *content;
+    GString *raw_content;
     GList *patterns;
     GList *lst;
-    SrnRet ret;
     SrnPatternSet *pattern_set;
 
     pattern_set = srn_application_get_default()->pattern_set;
     g_return_val_if_fail(pattern_set, TRUE);
 
-    raw_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &raw_content, NULL);
-    if (!RET_IS_OK(ret)){
-        ERR_FR("Failed to render markup text: %1$s", RET_MSG(ret));
+    patterns = get_patterns(msg);
+    if (!patterns) {
         return TRUE;
     }
 
+    content = NULL;
+    if (msg->rendered_content != msg->content) {
+        SrnRet ret;
+
+        // Content is escaped or rewritten by pattern renderer, take the text
+        // that will be shown
+        ret = srn_markup_renderer_render(markup_renderer,
+                msg->rendered_content, &content, NULL);
+        if (!RET_IS_OK(ret)) {
+            ERR_FR("Failed to render markup text: %1$s", RET_MSG(ret));
+            g_list_free(patterns);
+            return TRUE;
+        }
+    }
+
+    len = strlen(content ? content : msg->content);
+    raw_content = g_string_sized_new(len);
+    mirc_decode(content ? content : msg->content, len, strip_range,
+            raw_content);
+    g_free(content);
+
     drop = FALSE;
-    patterns = get_patterns(msg);
     lst = patterns;
     while (lst) {
         const char *pattern;
@@ -88,7 +116,7 @@ static bool filter(const SrnMessage *msg) {
 
         pattern = lst->data;
         regex = srn_pattern_set_get(pattern_set, pattern);
-        if (regex && g_regex_match(regex, raw_content, 0, NULL)) {
+        if (regex && g_regex_match(regex, raw_content->str, 0, NULL)) {
             drop = TRUE;
             break;
         }
@@ -96,7 +124,7 @@ static bool filter(const SrnMessage *msg) {
     }
 
     g_list_free(patterns);
-    g_free(raw_content);
+    g_string_free(raw_content, TRUE);
 
     return !drop;
 }
@@ -215,6 +243,11 @@ static GList* get_patterns(const SrnMessage *msg) {
     return patterns;
 }
 
+static void strip_range(const char *text, gsize len, const MircStyle *style,
+        void *user_data){
+    g_string_append_len(user_data, text, len);
+}
+
 static void text(GMarkupParseContext *context, const gchar *text,
         gsize text_len, gpointer user_data, GError **error){
     g_string_append_len(srn_markup_renderer_get_markup(user_data), text, text_len);
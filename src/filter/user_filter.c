@@ -29,6 +29,7 @@ static bool filter(const SrnMessage *msg);
  */
 SrnMessageFilter user_filter = {
     .name = "user",
+    .input = SRN_FILTER_INPUT_SENDER,
     .filter = filter,
 };
 
@@ -0,0 +1,60 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file arena.h
+ * @brief Bump allocator for short-lived data.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-23
+ */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <glib.h>
+
+typedef struct _SrnArena SrnArena;
+
+/**
+ * @brief SrnArena hands out memory from large blocks, there is no way to
+ * free a single allocation, all of them are released together by
+ * srn_arena_reset(). After a reset the memory is reused, so once the arena is
+ * large enough, allocating from it never calls malloc.
+ *
+ * Data which should outlive a reset must be copied to heap explicitly.
+ */
+SrnArena* srn_arena_new(gsize block_size);
+void srn_arena_free(SrnArena *self);
+void srn_arena_reset(SrnArena *self);
+
+gpointer srn_arena_alloc(SrnArena *self, gsize size);
+gpointer srn_arena_alloc0(SrnArena *self, gsize size);
+char* srn_arena_strdup(SrnArena *self, const char *str);
+char* srn_arena_strndup(SrnArena *self, const char *str, gsize len);
+void srn_arena_add_cleanup(SrnArena *self, GDestroyNotify func, gpointer data);
+
+gsize srn_arena_get_used(SrnArena *self);
+gsize srn_arena_get_capacity(SrnArena *self);
+
+#define srn_arena_new0(arena, type) \
+    ((type *)srn_arena_alloc0((arena), sizeof(type)))
+#define srn_arena_new0_n(arena, type, n) \
+    ((type *)srn_arena_alloc0((arena), sizeof(type) * (n)))
+
+#endif /* __ARENA_H */
@@ -59,19 +59,36 @@ struct _SrnApplication {
 
     SrnPatternSet *pattern_set;
     SrnCommandContext *cmd_ctx;
+
+    int stats_timer;
+
+    gulong network_handler; // Handler of GNetworkMonitor::network-changed
+    bool network_available;
 };
 
+typedef enum {
+    SRN_STATS_FORMAT_TEXT,
+    SRN_STATS_FORMAT_JSON,
+    SRN_STATS_FORMAT_OPENMETRICS,
+} SrnStatsFormat;
+
 struct _SrnApplicationConfig {
     bool prompt_on_quit; // TODO
     char *id;
     GList *auto_connect_srv_list;
 
+    /* Statistics */
+    char *stats_file;       // Periodically export statistics to this file
+    char *stats_format;     // "json" or "openmetrics"
+    int stats_interval;     // Sampling interval in seconds
+
     SuiApplicationConfig *ui;
 };
 
 GType srn_application_get_type(void);
 SrnApplication *srn_application_new(void);
 SrnApplication* srn_application_get_default(void);
+void srn_application_set_default(SrnApplication *app);
 void srn_application_run(SrnApplication *app, int argc, char *argv[]);
 void srn_application_quit(SrnApplication *app);
 SrnRet srn_application_open_url(SrnApplication *app, const char *url);
@@ -87,6 +104,11 @@ SrnServer* srn_application_get_server(SrnApplication *app, const char *name);
 SrnServer* srn_application_get_server_by_addr(SrnApplication *app, SrnServerAddr *addr);
 bool srn_application_is_server_valid(SrnApplication *app, SrnServer *srv);
 
+// Statistics
+void srn_application_init_stats(SrnApplication *app);
+void srn_application_dump_stats(SrnApplication *app, GString *str,
+        SrnStatsFormat fmt);
+
 SrnApplicationConfig *srn_application_config_new(void);
 SrnRet srn_application_config_check(SrnApplicationConfig *cfg);
 void srn_application_config_free(SrnApplicationConfig *cfg);
@@ -24,14 +24,20 @@
 #include "sirc/sirc.h"
 #include "sui/sui.h"
 #include "ret.h"
+#include "dedup.h"
 #include "extra_data.h"
 
 #ifndef __IN_CORE_H
 	#error This file should not be included directly, include just core.h
 #endif
 
+/* Number of recently received messages remembered for dropping duplicates
+ * replayed by bouncer */
+#define SRN_CHAT_DEDUP_SIZE     1024
+
 typedef struct _SrnChat SrnChat;
 typedef enum   _SrnChatType SrnChatType;
+typedef enum   _SrnChatMembership SrnChatMembership;
 typedef struct _SrnChatConfig SrnChatConfig;
 typedef struct _SrnChatUser SrnChatUser;
 typedef enum   _SrnChatUserType SrnChatUserType;
@@ -45,9 +51,19 @@ enum _SrnChatType {
     SRN_CHAT_TYPE_DIALOG,
 };
 
+/* Kinds of membership change, see srn_chat_add_membership_message() */
+enum _SrnChatMembership {
+    SRN_CHAT_MEMBERSHIP_JOIN,
+    SRN_CHAT_MEMBERSHIP_PART,
+    SRN_CHAT_MEMBERSHIP_QUIT,
+    SRN_CHAT_MEMBERSHIP_NICK,
+    /* ... */
+    SRN_CHAT_MEMBERSHIP_MAX,
+};
+
 /* Represent a channel or dialog or a server session */
 struct _SrnChat {
-    char *name;
+    char *name; // Interned in SrnServer->intern_pool, never modify it
     SrnChatType type;
     bool is_joined;
 
@@ -56,7 +72,22 @@ struct _SrnChat {
     GList *user_list;  // List of SrnChatUser
 
     GList *msg_list;
+    guint msg_count; // Length of msg_list
     SrnMessage *last_msg;
+    GHashTable *msg_ids; // IDs of messages in msg_list
+    SrnDedup *recv_dedup; // Fingerprints of recently received messages
+
+    /* Chat history, see srn_chat_load_history() */
+    gint64 history_request_time; // Monotonic time, 0 if nothing is pending
+    bool history_exhausted; // No more history can be loaded
+    char *history_ref; // Reference of the oldest message got from server
+    GDateTime *history_log_date; // Date of log file to continue reading
+    goffset history_log_offset; // End of unread part of the file, -1 if all
+    gint64 history_log_time; // Time of the oldest message read from log
+
+    /* Consecutive membership changes are collapsed into one message */
+    SrnMessage *membership_msg; // NULL if nothing can be collapsed into
+    int membership_counts[SRN_CHAT_MEMBERSHIP_MAX];
 
     /* Used by Filters & Decorators */
     GList *ignore_regex_list;
@@ -72,6 +103,8 @@ struct _SrnChat {
 struct _SrnChatConfig {
     bool log;
     bool render_mirc_color;
+    int membership_collapse_window; // In seconds, 0 means never collapse
+    int max_messages; // Messages kept in chat, 0 means unlimited
     char *password;
     GList *auto_run_cmd_list;
 
@@ -97,7 +130,9 @@ struct _SrnChatUser{
 
     SrnChatUserType type;
     SrnServerUser *srv_user;
-    GList *msg_list;    // TODO: List of SrnMessage
+    int refcount;       // Number of messages sent by the user, a user who
+                        // is neither joined nor referenced is removed from
+                        // chat, see srn_chat_rm_user()
 
     SuiUser *ui;
 
@@ -122,12 +157,18 @@ void srn_chat_add_misc_message(SrnChat *self, const char *content, const SircMes
 void srn_chat_add_misc_message_fmt(SrnChat *self, const SircMessageContext *context, const char *fmt, ...);
 void srn_chat_add_misc_message_with_user(SrnChat *chat, SrnChatUser *user, const char *content, const SircMessageContext *context);
 void srn_chat_add_misc_message_with_user_fmt(SrnChat *chat, SrnChatUser *user, const SircMessageContext *context, const char *fmt, ...);
+bool srn_chat_add_history_message(SrnChat *chat, const char *sender, SrnMessageType type, const char *content, const SircMessageContext *context);
+void srn_chat_add_membership_message(SrnChat *chat, SrnChatUser *user, SrnChatMembership membership, const char *content, const SircMessageContext *context);
 void srn_chat_add_error_message(SrnChat *self, const char *content, const SircMessageContext *context);
 void srn_chat_add_error_message_fmt(SrnChat *self, const SircMessageContext *context, const char *fmt, ...);
 void srn_chat_add_error_message_with_user(SrnChat *chat, SrnChatUser *user, const char *content, const SircMessageContext *context);
 void srn_chat_add_error_message_with_user_fmt(SrnChat *chat, SrnChatUser *user, const SircMessageContext *context, const char *fmt, ...);
 void srn_chat_set_topic(SrnChat *chat, SrnChatUser *user, const char *topic, const SircMessageContext *context);
 void srn_chat_set_topic_setter(SrnChat *chat, const char *setter);
+SrnRet srn_chat_load_history(SrnChat *chat);
+void srn_chat_end_history(SrnChat *chat, int count,
+        const SircMessageContext *oldest);
+void srn_chat_clear_message(SrnChat *chat);
 
 SrnChatConfig *srn_chat_config_new();
 void srn_chat_config_free(SrnChatConfig *cfg);
@@ -135,6 +176,8 @@ SrnRet srn_chat_config_check(SrnChatConfig *cfg);
 
 SrnChatUser *srn_chat_user_new(SrnChat *chat, SrnServerUser *srv_user);
 void srn_chat_user_free(SrnChatUser *self);
+SrnChatUser* srn_chat_user_ref(SrnChatUser *self);
+void srn_chat_user_unref(SrnChatUser *self);
 void srn_chat_user_update(SrnChatUser *self);
 void srn_chat_user_set_type(SrnChatUser *self, SrnChatUserType type);
 void srn_chat_user_set_is_joined(SrnChatUser *self, bool joined);
@@ -40,31 +40,43 @@ enum _SrnMessageType {
     SRN_MESSAGE_TYPE_ERROR,
 };
 
+/**
+ * @brief SrnMessage is allocated as a single block with its raw content,
+ * strings only used for displaying are derived on demand, so that a long
+ * scrollback costs little more than the text itself.
+ */
 struct _SrnMessage {
     SrnChat *chat;
     SrnChatUser *sender; // Sender of this message
-    SrnMessageType type;
+    const char *sender_name; // Interned, nick of sender unless rendered
+    char *id; // IRCv3 "msgid" tag stored after content, NULL if none
+    gint64 time; // Unix time in microseconds, see srn_message_get_time()
 
-    /* Raw message */
-    char *content;  // Raw message content
-    GDateTime *time; // Local time when creating message
+    guint type : 4; // SrnMessageType
+    guint mentioned : 1; // Whether this message should be mentioned
 
-    /* NOTE: All rendered_xxx fields MUST be valid XML and never be NULL */
-    char *rendered_sender; // Sender name
-    char *rendered_remark; // Message remark
-    char *rendered_content; // Rendered message content in
-    char *rendered_short_time; // Short format message time
-    char *rendered_full_time;  // Full format messsage time
+    /* NOTE: All rendered_xxx fields MUST be valid XML */
+    const char *rendered_sender; // Markup of sender_name, owned by it
+    char *rendered_content; // Rendered message content, never be NULL, set
+                            // it by srn_message_set_rendered_content()
+    char *rendered_remark; // Message remark, NULL if none
+    char *rendered_time; // Short format message time given by renderer,
+                         // NULL if not, see srn_message_format_time()
     GList *urls; // URLs in message, like "http://xxx", "irc://xxx"
 
-    bool mentioned; // Whether this message should be mentioned
+    SuiMessage *ui; // NULL until message is added to chat
 
-    SuiMessage *ui;
+    char content[]; // Raw message content, followed by id if any
 };
 
 SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user, const char *content,
         SrnMessageType type, const SircMessageContext *context);
+void srn_message_create_ui(SrnMessage *self);
 void srn_message_free(SrnMessage *msg);
+void srn_message_set_sender_name(SrnMessage *self, const char *name);
+void srn_message_set_rendered_content(SrnMessage *self, char *rendered);
+GDateTime* srn_message_get_time(const SrnMessage *self);
+char* srn_message_format_time(const SrnMessage *self, bool full);
 char* srn_message_to_string(const SrnMessage *self);
 
 #endif /* __MESSAGE_H */
@@ -25,6 +25,7 @@
 #include "sui/sui.h"
 #include "ret.h"
 #include "extra_data.h"
+#include "intern.h"
 
 #ifndef __IN_CORE_H
 	#error This file should not be included directly, include just core.h
@@ -34,7 +35,10 @@
 #define SRN_SERVER_PING_INTERVAL    (30 * 1000)
 #define SRN_SERVER_PING_TIMEOUT     (SRN_SERVER_PING_INTERVAL * 2)
 #define SRN_SERVER_RECONN_INTERVAL  (5 * 1000)
-#define SRN_SERVER_RECONN_STEP      SRN_SERVER_RECONN_INTERVAL
+#define SRN_SERVER_RECONN_MAX_INTERVAL  (5 * 60 * 1000)
+// Backoff of reconnecting is reset if connection lasts for such long time
+#define SRN_SERVER_RECONN_STABLE_TIME   (60 * 1000)
+#define SRN_SERVER_LOGIN_TIMEOUT    (8 * 1000)
 
 typedef struct _SrnServerUser SrnServerUser;
 typedef struct _SrnServerAddr SrnServerAddr;
@@ -47,12 +51,14 @@ typedef struct _SrnUserConfig SrnUserConfig;
 typedef struct _SrnServerConfig SrnServerConfig;
 typedef struct _EnabledCap EnabledCap;
 typedef struct _SrnServerCap SrnServerCap;
+typedef struct _SrnServerMonitor SrnServerMonitor;
 
 #include "chat.h"
 
 struct _SrnServerUser {
     SrnServer *srv;
 
+    /* Interned in SrnServer->intern_pool, never modify them */
     char *nick; // TODO: servername support
     char *username;
     char *hostname;
@@ -69,6 +75,13 @@ struct _SrnServerUser {
 
     GList *chat_user_list;  // List of SrnChatUser
 
+    /* Lifetime, the user is reclaimed when it is no longer referenced by any
+     * SrnChatUser, ignore rule or server itself, see srn_server_user_ref() */
+    int refcount;
+    bool is_stale;          // Whether it is in SrnServer->stale_users
+    bool is_displaced;      // Its nick is taken by another user, it is keyed
+                            // by itself in SrnServer->user_table
+
     SrnExtraData *extra_data;
 };
 
@@ -111,17 +124,31 @@ struct _SrnServer {
     unsigned long last_pong;        // Last pong time, in ms
     unsigned long delay;            // Delay in ms
     unsigned long reconn_interval;  // Interval of next reconnect, in ms
+    unsigned long reconn_backoff;   // Upper bound of reconn_interval, in ms
+    gint64 connected_time;          // Monotonic time of connecting, in us
     int ping_timer;
     int reconn_timer;
+    int rejoin_timer;               // Rejoin channels if login is not confirmed
+
+    /* Statistics, see app_stats.c */
+    unsigned long reconn_count;     // Number of reconnect attempts
+    guint64 sampled_lines_in;       // SircStats->lines_in of last sampling
+    gint64 sampled_time;            // Monotonic time of last sampling, in us
+    double lines_per_sec;           // Received lines per second
+    unsigned long reclaimed_users;  // Number of reclaimed SrnServerUser
 
     SrnServerCap *cap;      // Server capabilities
+    SrnServerMonitor *monitor; // Nicks whose presence is tracked
 
     SrnServerUser *user;    // Used to store your nick, username, realname
     SrnServerUser *_user;   // Hold all messages that do not belong other any user
     SrnChat *chat;          // Hold all messages that do not belong to any other SrnChat
     SrnChat *cur_chat;
     GList *chat_list;      // List of SrnChat
-    GHashTable *user_table; // Hash table of SrnServerUser
+    GHashTable *user_table; // Folded nick -> SrnServerUser
+    SrnInternPool *intern_pool; // Nicks, usernames, hostnames and chat names
+    GQueue *stale_users;    // Unreferenced SrnServerUser waiting for sweeping
+    guint sweep_id;         // Idle source of sweeping stale users
 
     SircSession *irc; // IRC session
 };
@@ -168,6 +195,7 @@ struct _SrnServerConfig {
     char *password;
     GList *auto_join_chat_list;
     GList *auto_run_cmd_list; // List of autorun commands
+    GList *monitor_list; // List of nicks whose presence is tracked
 
     /* SrnServerUser */
     SrnUserConfig *user;
@@ -177,7 +205,7 @@ struct _SrnServerConfig {
 struct _EnabledCap {
     // IRCv3
     bool identify_msg;
-    bool mulit_prefix;
+    bool multi_prefix;
     bool away_notify;
     bool account_notify;
     bool extended_join;
@@ -188,6 +216,8 @@ struct _EnabledCap {
     bool cap_notify;
     bool chghost;
     bool invite_notify;
+    bool batch;
+    bool draft_chathistory;
 
     // Vendor-Specific
     bool znc_server_time_iso;
@@ -198,6 +228,18 @@ struct _SrnServerCap {
     /* Capabilities */
     EnabledCap client_enabled;
     EnabledCap server_enabled;
+    bool sasl_started; // "AUTHENTICATE" has been sent on this connection
+
+    SrnServer *srv;
+};
+
+struct _SrnServerMonitor {
+    int limit;              // Maximum number of monitored nicks, -1 if
+                            // unlimited, 0 if MONITOR is not supported
+    int monitored;          // Number of nicks in server's monitor list
+    GHashTable *targets;    // Folded nick -> MonitorTarget, see
+                            // server_monitor.c
+    guint sync_id;          // Idle source of syncing with server
 
     SrnServer *srv;
 };
@@ -225,16 +267,21 @@ SrnRet srn_server_rm_user(SrnServer *srv, SrnServerUser *user);
 SrnServerUser* srn_server_get_user(SrnServer *srv, const char *nick);
 SrnServerUser* srn_server_add_and_get_user(SrnServer *srv, const char *nick);
 SrnRet srn_server_rename_user(SrnServer *srv, SrnServerUser *user, const char *nick);
+void srn_server_queue_stale_user(SrnServer *srv, SrnServerUser *user);
+void srn_server_set_casemapping(SrnServer *srv, SrnCasemapping casemapping);
 
 SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick);
 SrnServerUser *srn_server_user_ref(SrnServerUser *user);
+void srn_server_user_unref(SrnServerUser *user);
 void srn_server_user_free(SrnServerUser *user);
 void srn_server_user_set_nick(SrnServerUser *user, const char *nick);
 void srn_server_user_set_username(SrnServerUser *user, const char *username);
 void srn_server_user_set_hostname(SrnServerUser *user, const char *hostname);
 void srn_server_user_set_realname(SrnServerUser *user, const char *realname);
+void srn_server_user_set_loginname(SrnServerUser *user, const char *loginname);
 void srn_server_user_set_is_me(SrnServerUser *user, bool me);
 void srn_server_user_set_is_online(SrnServerUser *user, bool online);
+void srn_server_user_set_is_away(SrnServerUser *user, bool away);
 void srn_server_user_set_is_ignored(SrnServerUser *user, bool ignored);
 SrnRet srn_server_user_attach_chat_user(SrnServerUser *user, SrnChatUser *chat_user);
 SrnRet srn_server_user_detach_chat_user(SrnServerUser *user, SrnChatUser *chat_user);
@@ -257,6 +304,7 @@ void srn_login_config_free(SrnLoginConfig *self);
 SrnRet srn_login_config_check(SrnLoginConfig *self);
 const char* srn_login_method_to_string(SrnLoginMethod login);
 SrnLoginMethod srn_login_method_from_string(const char *str);
+bool srn_login_method_is_sasl(SrnLoginMethod login);
 
 SrnServerAddr* srn_server_addr_new(const char *host, int port);
 SrnServerAddr* srn_server_addr_new_from_string(const char *str);
@@ -265,10 +313,23 @@ bool srn_server_addr_equal(SrnServerAddr *addr1, SrnServerAddr *addr2);
 
 SrnServerCap* srn_server_cap_new();
 void srn_server_cap_free(SrnServerCap *scap);
+void srn_server_cap_reset(SrnServerCap *scap);
 SrnRet srn_server_cap_server_enable(SrnServerCap *scap, const char *name, bool enable);
 SrnRet srn_server_cap_client_enable(SrnServerCap *scap, const char *name, bool enable);
 bool srn_server_cap_all_enabled(SrnServerCap *scap);
 bool srn_server_cap_is_support(SrnServerCap *scap, const char *name, const char *value);
 char* srn_server_cap_dump(SrnServerCap *scap);
+char* srn_server_cap_get_requests(SrnServerCap *scap);
+bool srn_server_cap_begin_sasl(SrnServerCap *scap);
+
+SrnServerMonitor* srn_server_monitor_new(SrnServer *srv);
+void srn_server_monitor_free(SrnServerMonitor *self);
+void srn_server_monitor_set_limit(SrnServerMonitor *self, int limit);
+void srn_server_monitor_reset(SrnServerMonitor *self);
+void srn_server_monitor_add(SrnServerMonitor *self, const char *nick);
+void srn_server_monitor_remove(SrnServerMonitor *self, const char *nick);
+void srn_server_monitor_reject(SrnServerMonitor *self, const char *nicks);
+void srn_server_monitor_sync(SrnServerMonitor *self);
+void srn_server_monitor_refold(SrnServerMonitor *self);
 
 #endif /* __SERVER_H */
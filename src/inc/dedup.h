@@ -0,0 +1,48 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dedup.h
+ * @brief Bounded set of recently seen fingerprints.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-06-02
+ */
+
+#ifndef __DEDUP_H
+#define __DEDUP_H
+
+#include <stdbool.h>
+#include <glib.h>
+
+/* Initial value of srn_dedup_hash() */
+#define SRN_DEDUP_HASH_INIT     G_GUINT64_CONSTANT(0xcbf29ce484222325)
+
+typedef struct _SrnDedup SrnDedup;
+
+/**
+ * @brief SrnDedup remembers the last N fingerprints it has seen, the oldest
+ * one is forgotten when it is full. Both lookup and insertion are O(1).
+ */
+SrnDedup* srn_dedup_new(guint capacity);
+void srn_dedup_free(SrnDedup *self);
+bool srn_dedup_check_and_add(SrnDedup *self, guint64 fingerprint);
+
+guint64 srn_dedup_hash(guint64 hash, const void *data, gsize len);
+
+#endif /* __DEDUP_H */
@@ -35,19 +35,35 @@ typedef int SrnFilterFlags;
 #define SRN_FILTER_FLAG_PATTERN     1 << 1
 #define SRN_FILTER_FLAG_LOG         1 << 2
 
+/**
+ * @brief SrnFilterInput describes what a filter module needs to make its
+ * decision. Filters are run in this order, so a message dropped by a cheap
+ * filter is never rendered.
+ */
+typedef enum {
+    SRN_FILTER_INPUT_SENDER,    // Sender and chat of message
+    SRN_FILTER_INPUT_CONTENT,   // Raw content of message
+    SRN_FILTER_INPUT_RENDERED,  // Rendered message
+} SrnFilterInput;
+
 void srn_filter_init(void);
 void srn_filter_finalize(void);
 
 /**
- * @brief srn_render_message filters a SrnMessage according to the given flags.
+ * @brief srn_filter_message filters a SrnMessage according to the given flags.
  * Fields of SrnMessage MUST not be changed after filtering.
  *
  * @param msg is a SrnMessage instance.
  * @param flags indicates which filter modueles to use.
+ * @param input only filter modules which need this input are used.
  *
  * @return FALSE if the given message should be filtered.
  */
-bool srn_filter_message(const SrnMessage *msg, SrnFilterFlags flags);
+bool srn_filter_message(const SrnMessage *msg, SrnFilterFlags flags,
+        SrnFilterInput input);
+
+void srn_filter_dump_stats(GString *str, bool json);
+void srn_filter_reset_stats(void);
 
 SrnRet srn_filter_attach_pattern(SrnExtraData *extra_data, const char *pattern);
 SrnRet srn_filter_detach_pattern(SrnExtraData *extra_data, const char *pattern);
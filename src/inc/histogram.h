@@ -0,0 +1,58 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file histogram.h
+ * @brief Fixed size log-linear histogram for latency statistics.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-16
+ */
+
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+#include <glib.h>
+
+/* Values are grouped by their most significant bit, each group is split into
+ * 8 linear sub-buckets, so the relative error is within 12.5% */
+#define SRN_HISTOGRAM_SUB_BUCKETS   8
+#define SRN_HISTOGRAM_BUCKETS       (64 * SRN_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct _SrnHistogram SrnHistogram;
+
+/**
+ * @brief SrnHistogram can be embedded in other structures, recording a value
+ * never allocates memory.
+ */
+struct _SrnHistogram {
+    guint64 count;
+    guint64 sum;
+    guint64 max;
+    guint64 buckets[SRN_HISTOGRAM_BUCKETS];
+};
+
+void srn_histogram_reset(SrnHistogram *self);
+void srn_histogram_record(SrnHistogram *self, guint64 val);
+guint64 srn_histogram_percentile(const SrnHistogram *self, double percent);
+void srn_histogram_to_string(const SrnHistogram *self, GString *str);
+void srn_histogram_to_json(const SrnHistogram *self, GString *str);
+
+guint64 srn_get_monotonic_ns(void);
+
+#endif /* __HISTOGRAM_H */
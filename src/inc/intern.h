@@ -0,0 +1,73 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file intern.h
+ * @brief Reference counted string pool with IRC casemapping.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-23
+ */
+
+#ifndef __INTERN_H
+#define __INTERN_H
+
+#include <glib.h>
+
+typedef enum _SrnCasemapping SrnCasemapping;
+typedef struct _SrnInternPool SrnInternPool;
+
+/* https://modern.ircdocs.horse/#casemapping-parameter */
+enum _SrnCasemapping {
+    SRN_CASEMAPPING_ASCII,
+    SRN_CASEMAPPING_RFC1459,
+    SRN_CASEMAPPING_STRICT_RFC1459,
+};
+
+/**
+ * @brief SrnInternPool keeps one copy of each distinct string. An interned
+ * string is a plain "const char *" which also carries a reference count,
+ * its folded form under casemapping of pool, and its escaped markup.
+ *
+ * The folded form is interned in the same pool, so two strings are the same
+ * IRC name if and only if srn_intern_equal() (a pointer comparison) is TRUE.
+ *
+ * An interned string must never be modified or freed by g_free().
+ */
+SrnInternPool* srn_intern_pool_new(SrnCasemapping casemapping);
+void srn_intern_pool_free(SrnInternPool *self);
+void srn_intern_pool_set_casemapping(SrnInternPool *self,
+        SrnCasemapping casemapping);
+SrnCasemapping srn_intern_pool_get_casemapping(SrnInternPool *self);
+guint srn_intern_pool_get_size(SrnInternPool *self);
+gsize srn_intern_pool_get_bytes(SrnInternPool *self);
+
+const char* srn_intern(SrnInternPool *self, const char *str);
+const char* srn_intern_lookup_folded(SrnInternPool *self, const char *str);
+const char* srn_intern_ref(const char *istr);
+void srn_intern_unref(const char *istr);
+const char* srn_intern_get_folded(const char *istr);
+const char* srn_intern_get_markup(const char *istr);
+
+#define srn_intern_equal(a, b) \
+    (srn_intern_get_folded(a) == srn_intern_get_folded(b))
+
+gboolean srn_casemapping_from_string(const char *name, SrnCasemapping *casemapping);
+char* srn_casemapping_fold(SrnCasemapping casemapping, const char *str);
+
+#endif /* __INTERN_H */
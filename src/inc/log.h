@@ -48,52 +48,48 @@ struct _SrnLoggerConfig {
     GList *error_targets;
 };
 
-/* Debug output */
-#define DBG_FR(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_DEBUG, TRUE, TRUE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
-
-#define DBG_F(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_DEBUG, TRUE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+/**
+ * @brief SrnLogCallsite caches whether a log callsite is enabled.
+ *
+ * Every expansion of log macros owns a static SrnLogCallsite. Its value is
+ * srn_logger_generation if the callsite is disabled,
+ * srn_logger_generation + 1 if enabled, or anything else if it is outdated
+ * and should be recomputed by srn_logger_check_callsite(). So a disabled log
+ * call costs only one comparison.
+ */
+typedef guint SrnLogCallsite;
 
-#define DBG(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_DEBUG, FALSE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+extern guint srn_logger_generation;
 
-/* Info output */
-#define LOG_FR(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_INFO, TRUE, TRUE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+#define SRN_LOG(lv, print_prompt, new_line, ...) \
+    G_STMT_START { \
+        static SrnLogCallsite __srn_log_callsite = 0; \
+        if (G_UNLIKELY(__srn_log_callsite != srn_logger_generation) \
+                && srn_logger_check_callsite(&__srn_log_callsite, lv, \
+                    __FILE__)) { \
+            srn_logger_log(srn_logger_get_default(), lv, print_prompt, \
+                    new_line, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__); \
+        } \
+    } G_STMT_END
 
-#define LOG_F(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_INFO, TRUE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+/* Debug output */
+#define DBG_FR(...) SRN_LOG(LOG_DEBUG, TRUE, TRUE, __VA_ARGS__)
+#define DBG_F(...) SRN_LOG(LOG_DEBUG, TRUE, FALSE, __VA_ARGS__)
+#define DBG(...) SRN_LOG(LOG_DEBUG, FALSE, FALSE, __VA_ARGS__)
 
-#define LOG(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_INFO, FALSE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+/* Info output */
+#define LOG_FR(...) SRN_LOG(LOG_INFO, TRUE, TRUE, __VA_ARGS__)
+#define LOG_F(...) SRN_LOG(LOG_INFO, TRUE, FALSE, __VA_ARGS__)
+#define LOG(...) SRN_LOG(LOG_INFO, FALSE, FALSE, __VA_ARGS__)
 
 /* Warn output */
-#define WARN_FR(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_WARN, TRUE, TRUE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
-
-#define WARN_F(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_WARN, TRUE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
-
-#define WARN(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_WARN, FALSE, FALSE \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
-
-#define ERR_FR(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_ERROR, TRUE, TRUE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+#define WARN_FR(...) SRN_LOG(LOG_WARN, TRUE, TRUE, __VA_ARGS__)
+#define WARN_F(...) SRN_LOG(LOG_WARN, TRUE, FALSE, __VA_ARGS__)
+#define WARN(...) SRN_LOG(LOG_WARN, FALSE, FALSE, __VA_ARGS__)
 
-#define ERR_F(...) \
-    srn_logger_log(srn_logger_get_default(), LOG_ERROR, TRUE, FALSE, \
-            __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+/* Error output */
+#define ERR_FR(...) SRN_LOG(LOG_ERROR, TRUE, TRUE, __VA_ARGS__)
+#define ERR_F(...) SRN_LOG(LOG_ERROR, TRUE, FALSE, __VA_ARGS__)
 
 SrnLogger *srn_logger_get_default(void);
 void srn_logger_set_default(SrnLogger *logger);
@@ -102,6 +98,8 @@ SrnLogger *srn_logger_new(SrnLoggerConfig *cfg);
 void srn_logger_free(SrnLogger *logger);
 void srn_logger_set_config(SrnLogger *logger, SrnLoggerConfig *cfg);
 SrnLoggerConfig *srn_logger_get_config(SrnLogger *logger);
+bool srn_logger_check_callsite(SrnLogCallsite *callsite, SrnLogLevel lv,
+        const char *file);
 void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
         bool new_line, const char *file, const char *func, int line,
         const char *fmt, ...);
@@ -25,6 +25,7 @@
 char *srn_get_theme_file(const char *fname);
 char *srn_get_user_config_file();
 char *srn_get_system_config_file();
+char *srn_get_log_file(const char *srv_name, const char *fname);
 char *srn_create_log_file(const char *srv_name, const char *fname);
 SrnRet srn_create_user_file();
 char *srn_get_executable_path();
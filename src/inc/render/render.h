@@ -52,6 +52,9 @@ void srn_render_finalize(void);
  */
 SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags);
 
+void srn_render_dump_stats(GString *str, bool json);
+void srn_render_reset_stats(void);
+
 SrnRet srn_render_attach_pattern(SrnExtraData *extra_data, const char *pattern);
 SrnRet srn_render_detach_pattern(SrnExtraData *extra_data, const char *pattern);
 
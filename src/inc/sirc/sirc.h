@@ -33,9 +33,26 @@ typedef struct _SircSession SircSession;
 
 #define SIRC_BUF_LEN    1024
 
+typedef struct _SircStats SircStats;
+
+/**
+ * @brief SircStats holds counters of a SircSession, they are accumulated
+ * across reconnections.
+ */
+struct _SircStats {
+    guint64 bytes_in;
+    guint64 bytes_out;
+    guint64 lines_in;       // Lines received
+    guint64 lines_out;      // Lines sent
+    guint64 parse_failures; // Received lines which can not be parsed
+    guint64 parse_ns;       // Time spent in parsing and transcoding lines
+    guint64 dispatch_ns;    // Time spent in event handlers
+};
+
 #define __IN_SIRC_H
 #include "sirc_cmd.h"
 #include "sirc_context.h"
+#include "sirc_batch.h"
 #include "sirc_event.h"
 #include "sirc_numeric.h"
 #include "sirc_utils.h"
@@ -46,8 +63,16 @@ SircSession* sirc_new_session(SircEvents *events, SircConfig *cfg);
 void sirc_free_session(SircSession *sirc);
 void sirc_set_config(SircSession *sirc, SircConfig *cfg);
 void sirc_connect(SircSession *sirc, const char *host, int port);
+void sirc_flush_dns_cache(SircSession *sirc);
+void sirc_connect_stream(SircSession *sirc, GIOStream *stream);
 void sirc_cancel_connect(SircSession *sirc);
 void sirc_disconnect(SircSession *sirc);
+int sirc_send(SircSession *sirc, const char *data, size_t len);
+int sirc_send_queued(SircSession *sirc, const char *data, size_t len);
+void sirc_cork(SircSession *sirc);
+int sirc_uncork(SircSession *sirc);
+guint sirc_get_send_queue_length(SircSession *sirc);
+const SircStats* sirc_get_stats(SircSession *sirc);
 int sirc_get_fd(SircSession *sirc);
 GIOStream* sirc_get_stream(SircSession *sirc);
 SircEvents* sirc_get_events(SircSession *sirc);
@@ -0,0 +1,39 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SIRC_BATCH_H
+#define __SIRC_BATCH_H
+
+#ifndef __IN_SIRC_H
+	#error This file should not be included directly, include just sirc.h
+#endif
+
+/**
+ * @brief SircBatch is a group of messages enclosed by IRCv3 "BATCH +ref" and
+ * "BATCH -ref", see https://ircv3.net/specs/extensions/batch-3.2
+ */
+typedef struct _SircBatch SircBatch;
+
+const char* sirc_batch_get_type(const SircBatch *batch);
+int sirc_batch_get_length(const SircBatch *batch);
+const char* sirc_batch_get_command(const SircBatch *batch, int i);
+const char* sirc_batch_get_origin(const SircBatch *batch, int i);
+const char** sirc_batch_get_params(const SircBatch *batch, int i, int *count);
+const SircMessageContext* sirc_batch_get_context(const SircBatch *batch, int i);
+
+#endif /* __SIRC_BATCH_H */
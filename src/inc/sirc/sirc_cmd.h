@@ -27,6 +27,7 @@
 int sirc_cmd_ping(SircSession *sirc, const char *data);
 int sirc_cmd_pong(SircSession *sirc, const char *data);
 int sirc_cmd_join(SircSession *sirc, const char *chan, const char *passwd);
+int sirc_cmd_join_all(SircSession *sirc, const char **chans, const char **passwds, int count);
 int sirc_cmd_user(SircSession *sirc, const char *username, const char *hostname, const char *servername, const char *realname);
 int sirc_cmd_part(SircSession *sirc, const char *chan, const char *reason);
 int sirc_cmd_nick(SircSession *sirc, const char *nick);
@@ -49,6 +50,8 @@ int sirc_cmd_cap_req(SircSession *sirc, const char *caps);
 int sirc_cmd_cap_end(SircSession *sirc);
 int sirc_cmd_authenticate(SircSession *sirc, const char *msg);
 int sirc_cmd_away(SircSession *sirc, const char *msg);
+int sirc_cmd_chathistory(SircSession *sirc, const char *subcmd, const char *target, const char *ref, int limit);
+int sirc_cmd_monitor(SircSession *sirc, const char *op, const char *targets);
 int sirc_cmd_raw(SircSession *sirc, const char *fmt, ...);
 
 #endif /* __IRC_CMD_H */
@@ -34,6 +34,16 @@ void sirc_message_context_free(SircMessageContext *context);
 /* Server-provided "time" tag if any, or the time the message was received/sent.
  * Never returns NULL. */
 GDateTime* sirc_message_context_get_time(const SircMessageContext *context);
+/* Same as above but in unix time in microseconds, which is cheaper if the
+ * server does not provide a "time" tag. */
+gint64 sirc_message_context_get_timestamp(const SircMessageContext *context);
+/* Server-provided "msgid" tag, NULL if none. */
+const char* sirc_message_context_get_msgid(const SircMessageContext *context);
+/* Whether the time is provided by the server in a valid "time" tag. */
+bool sirc_message_context_has_server_time(const SircMessageContext *context);
+/* Username and hostname of "nick!user@host" prefix, NULL if not given. */
+const char* sirc_message_context_get_user(const SircMessageContext *context);
+const char* sirc_message_context_get_host(const SircMessageContext *context);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(SircMessageContext, sirc_message_context_free)
 
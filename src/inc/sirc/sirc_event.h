@@ -33,6 +33,15 @@ typedef void (*SircNumericEventCallback) (SircSession *sirc, int event,
         const char *origin, const char *params[], int count,
         const SircMessageContext *context);
 
+/**
+ * @param event Type of batch
+ * @param params Parameters after type
+ * @param batch Messages in batch, it is only valid in callback
+ */
+typedef void (*SircBatchEventCallback) (SircSession *sirc, const char *event,
+        const char *params[], int count, const SircBatch *batch,
+        const SircMessageContext *context);
+
 typedef struct {
     SircSimpleEventCallback     connect;
     SircEventCallback           connect_fail;
@@ -53,6 +62,9 @@ typedef struct {
     SircEventCallback           tagmsg;
     SircEventCallback           channel_notice;
     SircEventCallback           invite;
+    SircEventCallback           away;
+    SircEventCallback           account;
+    SircEventCallback           chghost;
     SircEventCallback           ctcp_req;
     SircEventCallback           ctcp_rsp;
     SircEventCallback           cap;
@@ -65,6 +77,7 @@ typedef struct {
     SircEventCallback           note;
     SircEventCallback           unknown;
 
+    SircBatchEventCallback      batch;
     SircNumericEventCallback    numeric;
 } SircEvents;
 
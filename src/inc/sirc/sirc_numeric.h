@@ -1258,6 +1258,13 @@
 #define SIRC_RFC_RPL_WHOISSECURE 671
 #define SIRC_RFC_RPL_TOPICWHOTIME 333
 
+/* MONITOR related, see https://ircv3.net/specs/core/monitor-3.2 */
+#define SIRC_RFC_RPL_MONONLINE 730
+#define SIRC_RFC_RPL_MONOFFLINE 731
+#define SIRC_RFC_RPL_MONLIST 732
+#define SIRC_RFC_RPL_ENDOFMONLIST 733
+#define SIRC_RFC_ERR_MONLISTFULL 734
+
 /* SASL related */
 #define SIRC_RFC_RPL_LOGGEDIN 900
 #define SIRC_RFC_RPL_LOGGEDOUT 901
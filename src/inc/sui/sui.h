@@ -68,6 +68,9 @@ void sui_activate_buffer(SuiBuffer *buf);
 void* sui_buffer_get_ctx(SuiBuffer *buf);
 void sui_buffer_set_config(SuiBuffer *buf, SuiBufferConfig *cfg);
 void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg);
+void sui_buffer_prepend_message(SuiBuffer *buf, SuiMessage *msg);
+void sui_buffer_remove_first_message(SuiBuffer *buf);
+bool sui_buffer_is_at_bottom(SuiBuffer *buf);
 void sui_buffer_clear_message(SuiBuffer *buf);
 
 /* SuiMessage */
@@ -88,6 +91,7 @@ void sui_update_user(SuiBuffer *buf, SuiUser *user);
 /* Misc */
 void sui_set_topic(SuiBuffer *sui, const char *topic);
 void sui_set_topic_setter(SuiBuffer *sui, const char *setter);
+void sui_set_presence(SuiBuffer *sui, bool online, bool away);
 void sui_message_box(const char *title, const char *msg);
 
 void sui_chan_list_start(SuiBuffer *sui);
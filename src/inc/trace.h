@@ -0,0 +1,74 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file trace.h
+ * @brief Span tracing which can be dumped as Chrome trace JSON.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-16
+ *
+ * Tracing is enabled by meson option "tracing", when disabled, all SRN_TRACE_*
+ * macros expand to nothing.
+ *
+ * Usage:
+ *
+ *      SRN_TRACE_BEGIN(span);
+ *      do_something();
+ *      SRN_TRACE_END(span, "do_something");
+ *
+ * If you already have the start and end time in nanoseconds returned by
+ * srn_get_monotonic_ns(), use SRN_TRACE_RECORD(name, start, end).
+ *
+ * Name of span MUST be a static string or a string returned by
+ * g_intern_string(), because it is referenced until the trace is dumped.
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <glib.h>
+
+#include "meta.h"
+#include "srain.h"
+#include "ret.h"
+
+#ifdef ENABLE_TRACING
+
+#define SRN_TRACE_BEGIN(span) \
+    guint64 __srn_trace_##span = srn_trace_now()
+#define SRN_TRACE_END(span, name) \
+    srn_trace_record(name, __srn_trace_##span, srn_trace_now())
+#define SRN_TRACE_RECORD(name, start, end) \
+    srn_trace_record(name, start, end)
+
+#else
+
+#define SRN_TRACE_BEGIN(span)
+#define SRN_TRACE_END(span, name)
+#define SRN_TRACE_RECORD(name, start, end)
+
+#endif
+
+guint64 srn_trace_now(void);
+void srn_trace_record(const char *name, guint64 start, guint64 end);
+SrnRet srn_trace_dump(const char *path);
+void srn_trace_clear(void);
+bool srn_trace_is_enabled(void);
+
+#endif /* __TRACE_H */
@@ -0,0 +1,222 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file arena.c
+ * @brief Bump allocator for short-lived data.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-23
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "arena.h"
+
+/* Enough for any fundamental type */
+#define ARENA_ALIGN     (2 * sizeof(gpointer))
+#define ALIGN_UP(size)  (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+typedef struct _SrnArenaBlock SrnArenaBlock;
+typedef struct _SrnArenaCleanup SrnArenaCleanup;
+
+struct _SrnArenaBlock {
+    SrnArenaBlock *next;    // Previous filled block
+    gsize size;
+    gsize pos;
+    /* Aligned data follows */
+};
+
+struct _SrnArenaCleanup {
+    SrnArenaCleanup *next;
+    GDestroyNotify func;
+    gpointer data;
+};
+
+struct _SrnArena {
+    SrnArenaBlock *block;       // Current block
+    gsize block_size;
+    gsize used;                 // Bytes allocated since last reset
+    SrnArenaCleanup *cleanups;  // Allocated in arena too
+};
+
+static SrnArenaBlock* block_new(gsize size, SrnArenaBlock *next);
+static char* block_data(SrnArenaBlock *block);
+
+SrnArena* srn_arena_new(gsize block_size){
+    SrnArena *self;
+
+    g_return_val_if_fail(block_size > 0, NULL);
+
+    self = g_malloc0(sizeof(SrnArena));
+    self->block_size = ALIGN_UP(block_size);
+    self->block = block_new(self->block_size, NULL);
+
+    return self;
+}
+
+void srn_arena_free(SrnArena *self){
+    SrnArenaBlock *block;
+
+    g_return_if_fail(self);
+
+    srn_arena_reset(self);
+    while (self->block){
+        block = self->block;
+        self->block = block->next;
+        g_free(block);
+    }
+    g_free(self);
+}
+
+/**
+ * @brief srn_arena_reset runs cleanup functions in the reverse order of
+ * registration, then marks all memory as unused.
+ *
+ * If more than one block has been used, they are merged into a larger one,
+ * so the next round fits in a single block.
+ */
+void srn_arena_reset(SrnArena *self){
+    gsize capacity;
+    SrnArenaCleanup *cleanup;
+    SrnArenaBlock *block;
+
+    g_return_if_fail(self);
+
+    for (cleanup = self->cleanups; cleanup; cleanup = cleanup->next){
+        cleanup->func(cleanup->data);
+    }
+    self->cleanups = NULL;
+
+    if (self->block->next){
+        capacity = srn_arena_get_capacity(self);
+        while (self->block){
+            block = self->block;
+            self->block = block->next;
+            g_free(block);
+        }
+        self->block_size = capacity;
+        self->block = block_new(self->block_size, NULL);
+    }
+    self->block->pos = 0;
+    self->used = 0;
+}
+
+gpointer srn_arena_alloc(SrnArena *self, gsize size){
+    gpointer ptr;
+
+    g_return_val_if_fail(self, NULL);
+
+    size = ALIGN_UP(MAX(size, 1));
+    if (self->block->pos + size > self->block->size){
+        self->block = block_new(MAX(self->block_size, size), self->block);
+    }
+
+    ptr = block_data(self->block) + self->block->pos;
+    self->block->pos += size;
+    self->used += size;
+
+    return ptr;
+}
+
+gpointer srn_arena_alloc0(SrnArena *self, gsize size){
+    gpointer ptr;
+
+    ptr = srn_arena_alloc(self, size);
+    if (ptr){
+        memset(ptr, 0, size);
+    }
+
+    return ptr;
+}
+
+char* srn_arena_strdup(SrnArena *self, const char *str){
+    if (!str){
+        return NULL;
+    }
+
+    return srn_arena_strndup(self, str, strlen(str));
+}
+
+char* srn_arena_strndup(SrnArena *self, const char *str, gsize len){
+    char *dup;
+
+    if (!str){
+        return NULL;
+    }
+
+    dup = srn_arena_alloc(self, len + 1);
+    memcpy(dup, str, len);
+    dup[len] = '\0';
+
+    return dup;
+}
+
+/**
+ * @brief srn_arena_add_cleanup registers a function which is called with
+ * given data on next reset, it is useful for releasing reference counted
+ * objects which are used by data in arena.
+ */
+void srn_arena_add_cleanup(SrnArena *self, GDestroyNotify func, gpointer data){
+    SrnArenaCleanup *cleanup;
+
+    g_return_if_fail(self);
+    g_return_if_fail(func);
+
+    cleanup = srn_arena_new0(self, SrnArenaCleanup);
+    cleanup->func = func;
+    cleanup->data = data;
+    cleanup->next = self->cleanups;
+    self->cleanups = cleanup;
+}
+
+gsize srn_arena_get_used(SrnArena *self){
+    g_return_val_if_fail(self, 0);
+
+    return self->used;
+}
+
+gsize srn_arena_get_capacity(SrnArena *self){
+    gsize capacity;
+    SrnArenaBlock *block;
+
+    g_return_val_if_fail(self, 0);
+
+    capacity = 0;
+    for (block = self->block; block; block = block->next){
+        capacity += block->size;
+    }
+
+    return capacity;
+}
+
+static SrnArenaBlock* block_new(gsize size, SrnArenaBlock *next){
+    SrnArenaBlock *block;
+
+    block = g_malloc(ALIGN_UP(sizeof(SrnArenaBlock)) + size);
+    block->next = next;
+    block->size = size;
+    block->pos = 0;
+
+    return block;
+}
+
+static char* block_data(SrnArenaBlock *block){
+    return (char *)block + ALIGN_UP(sizeof(SrnArenaBlock));
+}
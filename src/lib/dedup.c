@@ -0,0 +1,102 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dedup.c
+ * @brief Bounded set of recently seen fingerprints.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-06-02
+ */
+
+#include <glib.h>
+
+#include "dedup.h"
+
+struct _SrnDedup {
+    guint capacity;
+    guint size;
+    guint head;         // Slot of the oldest fingerprint when full
+    guint64 *ring;      // Fingerprints in order of insertion
+    GHashTable *set;    // Keys point to slots of ring
+};
+
+SrnDedup* srn_dedup_new(guint capacity){
+    SrnDedup *self;
+
+    g_return_val_if_fail(capacity > 0, NULL);
+
+    self = g_malloc0(sizeof(SrnDedup));
+    self->capacity = capacity;
+    self->ring = g_malloc0_n(capacity, sizeof(guint64));
+    self->set = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+    return self;
+}
+
+void srn_dedup_free(SrnDedup *self){
+    g_hash_table_destroy(self->set);
+    g_free(self->ring);
+    g_free(self);
+}
+
+/**
+ * @brief srn_dedup_check_and_add checks whether the fingerprint has been
+ * seen recently, and remembers it if not.
+ *
+ * @param self
+ * @param fingerprint
+ *
+ * @return TRUE if it is a duplicate
+ */
+bool srn_dedup_check_and_add(SrnDedup *self, guint64 fingerprint){
+    guint slot;
+
+    if (g_hash_table_contains(self->set, &fingerprint)){
+        return TRUE;
+    }
+
+    if (self->size < self->capacity){
+        slot = self->size++;
+    } else {
+        // Forget the oldest one
+        slot = self->head;
+        self->head = (self->head + 1) % self->capacity;
+        g_hash_table_remove(self->set, &self->ring[slot]);
+    }
+    self->ring[slot] = fingerprint;
+    g_hash_table_add(self->set, &self->ring[slot]);
+
+    return FALSE;
+}
+
+/**
+ * @brief srn_dedup_hash is 64-bit FNV-1a, hash of multiple fields can be
+ * computed by chaining calls starting with SRN_DEDUP_HASH_INIT.
+ */
+guint64 srn_dedup_hash(guint64 hash, const void *data, gsize len){
+    const guchar *p;
+
+    p = data;
+    for (gsize i = 0; i < len; i++){
+        hash ^= p[i];
+        hash *= G_GUINT64_CONSTANT(0x100000001b3);
+    }
+
+    return hash;
+}
@@ -25,72 +25,127 @@
  * @date 2019-05-25
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "extra_data.h"
 
-struct _SrnExtraData {
-    GHashTable *data_table;
-    GHashTable *destory_func_table;
+/* Most objects store no more than two keys, they are kept inline */
+#define INLINE_SLOTS    2
+
+typedef struct _ExtraDataSlot ExtraDataSlot;
+
+struct _ExtraDataSlot {
+    const char *key;
+    void *val;
+    GDestroyNotify destory_func;
 };
 
-SrnExtraData* srn_extra_data_new(void) {
-    SrnExtraData *self;
+struct _SrnExtraData {
+    ExtraDataSlot slots[INLINE_SLOTS];
+    GHashTable *slot_table; // Key -> ExtraDataSlot, NULL until slots are full
+};
 
-    self = g_malloc0(sizeof(SrnExtraData));
-    self->data_table = g_hash_table_new(g_str_hash, g_str_equal);
-    self->destory_func_table = g_hash_table_new(g_str_hash, g_str_equal);
+static ExtraDataSlot* lookup_slot(SrnExtraData *self, const char *key);
+static void slot_free(ExtraDataSlot *slot);
 
-    return self;
+SrnExtraData* srn_extra_data_new(void) {
+    return g_malloc0(sizeof(SrnExtraData));
 }
 
 void srn_extra_data_free(SrnExtraData *self) {
-    gpointer key, val;
-    GHashTableIter iter;
-
     // Free all extra data via destory func
-    g_hash_table_iter_init(&iter, self->data_table);
-    while (g_hash_table_iter_next(&iter, &key, &val)){
-        GDestroyNotify func;
+    for (int i = 0; i < INLINE_SLOTS; i++){
+        ExtraDataSlot *slot;
 
-        func = g_hash_table_lookup(self->destory_func_table, key);
-        if (func) {
-            func(val);
+        slot = &self->slots[i];
+        if (slot->key && slot->destory_func) {
+            slot->destory_func(slot->val);
         }
     }
+    if (self->slot_table) {
+        g_hash_table_destroy(self->slot_table);
+    }
 
-    g_hash_table_destroy(self->data_table);
-    g_hash_table_destroy(self->destory_func_table);
+    g_free(self);
 }
 
 void* srn_extra_data_get(SrnExtraData *self, const char *key) {
-    return g_hash_table_lookup(self->data_table, key);
+    ExtraDataSlot *slot;
+
+    g_return_val_if_fail(key, NULL);
+
+    slot = lookup_slot(self, key);
+
+    return slot ? slot->val : NULL;
 }
 
 void srn_extra_data_set(SrnExtraData *self, const char *key, void *val,
         GDestroyNotify val_destory_func) {
+    ExtraDataSlot *slot;
+
     g_return_if_fail(key);
 
+    slot = lookup_slot(self, key);
     if (val) { // Add a key, NOTE: Update a exsting key is not allowed for now
-        g_return_if_fail(!g_hash_table_contains(self->data_table, key));
-        g_return_if_fail(!g_hash_table_contains(self->destory_func_table, key));
+        g_return_if_fail(!slot);
 
-        g_hash_table_insert(self->data_table, (gpointer)key, val);
-        g_hash_table_insert(self->destory_func_table, (gpointer)key,
-                val_destory_func);
+        for (int i = 0; i < INLINE_SLOTS; i++){
+            if (!self->slots[i].key) {
+                slot = &self->slots[i];
+                break;
+            }
+        }
+        if (!slot) {
+            if (!self->slot_table) {
+                self->slot_table = g_hash_table_new_full(g_str_hash,
+                        g_str_equal, NULL, (GDestroyNotify)slot_free);
+            }
+            slot = g_malloc0(sizeof(ExtraDataSlot));
+            g_hash_table_insert(self->slot_table, (gpointer)key, slot);
+        }
+        slot->key = key;
+        slot->val = val;
+        slot->destory_func = val_destory_func;
     } else { // Remove a key
-        void *oldval;
-        GDestroyNotify func;
-
-        g_return_if_fail(g_hash_table_contains(self->data_table, key));
-        g_return_if_fail(g_hash_table_contains(self->destory_func_table, key));
+        g_return_if_fail(slot);
+
+        if (slot >= self->slots && slot < self->slots + INLINE_SLOTS) {
+            if (slot->destory_func) {
+                slot->destory_func(slot->val);
+            }
+            memset(slot, 0, sizeof(ExtraDataSlot));
+        } else {
+            g_hash_table_remove(self->slot_table, key);
+        }
+    }
+}
 
-        oldval = g_hash_table_lookup(self->data_table, key);
-        func = g_hash_table_lookup(self->destory_func_table, key);
-        if (func) {
-            func(oldval);
+/**
+ * @brief lookup_slot finds slot of given key. Keys are usually string
+ * literals, so they are compared by pointer first.
+ */
+static ExtraDataSlot* lookup_slot(SrnExtraData *self, const char *key) {
+    for (int i = 0; i < INLINE_SLOTS; i++){
+        if (self->slots[i].key == key) {
+            return &self->slots[i];
         }
-        g_hash_table_remove(self->data_table, key);
-        g_hash_table_remove(self->destory_func_table, key);
     }
+    for (int i = 0; i < INLINE_SLOTS; i++){
+        if (self->slots[i].key && g_str_equal(self->slots[i].key, key)) {
+            return &self->slots[i];
+        }
+    }
+    if (self->slot_table) {
+        return g_hash_table_lookup(self->slot_table, key);
+    }
+
+    return NULL;
+}
+
+static void slot_free(ExtraDataSlot *slot) {
+    if (slot->destory_func) {
+        slot->destory_func(slot->val);
+    }
+    g_free(slot);
 }
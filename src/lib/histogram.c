@@ -0,0 +1,167 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file histogram.c
+ * @brief Fixed size log-linear histogram for latency statistics.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-16
+ */
+
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#include "histogram.h"
+
+static int msb(guint64 val);
+static int bucket_index(guint64 val);
+static guint64 bucket_upper_bound(int idx);
+
+void srn_histogram_reset(SrnHistogram *self){
+    memset(self, 0, sizeof(*self));
+}
+
+void srn_histogram_record(SrnHistogram *self, guint64 val){
+    self->count++;
+    self->sum += val;
+    if (val > self->max){
+        self->max = val;
+    }
+    self->buckets[bucket_index(val)]++;
+}
+
+/**
+ * @brief srn_histogram_percentile returns the upper bound of bucket which
+ * contains the given percentile.
+ *
+ * @param self
+ * @param percent 0 ~ 100
+ *
+ * @return 0 if histogram is empty.
+ */
+guint64 srn_histogram_percentile(const SrnHistogram *self, double percent){
+    guint64 rank;
+    guint64 seen;
+
+    if (self->count == 0){
+        return 0;
+    }
+
+    rank = (guint64)(self->count * percent / 100.0 + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > self->count) {
+        rank = self->count;
+    }
+
+    seen = 0;
+    for (int i = 0; i < SRN_HISTOGRAM_BUCKETS; i++){
+        seen += self->buckets[i];
+        if (seen >= rank){
+            return MIN(bucket_upper_bound(i), self->max);
+        }
+    }
+
+    return self->max;
+}
+
+void srn_histogram_to_string(const SrnHistogram *self, GString *str){
+    g_string_append_printf(str,
+            "count=%" G_GUINT64_FORMAT
+            " p50=%" G_GUINT64_FORMAT
+            " p99=%" G_GUINT64_FORMAT
+            " max=%" G_GUINT64_FORMAT,
+            self->count,
+            srn_histogram_percentile(self, 50),
+            srn_histogram_percentile(self, 99),
+            self->max);
+}
+
+void srn_histogram_to_json(const SrnHistogram *self, GString *str){
+    g_string_append_printf(str,
+            "{\"count\":%" G_GUINT64_FORMAT
+            ",\"sum\":%" G_GUINT64_FORMAT
+            ",\"p50\":%" G_GUINT64_FORMAT
+            ",\"p99\":%" G_GUINT64_FORMAT
+            ",\"max\":%" G_GUINT64_FORMAT "}",
+            self->count,
+            self->sum,
+            srn_histogram_percentile(self, 50),
+            srn_histogram_percentile(self, 99),
+            self->max);
+}
+
+/**
+ * @brief srn_get_monotonic_ns returns monotonic time in nanoseconds,
+ * g_get_monotonic_time() is too coarse for timing a single render module.
+ *
+ * @return
+ */
+guint64 srn_get_monotonic_ns(void){
+#ifdef G_OS_WIN32
+    return (guint64)g_get_monotonic_time() * 1000;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#endif
+}
+
+static int msb(guint64 val){
+    int n;
+
+    n = 0;
+    if (val >> 32) { n += 32; val >>= 32; }
+    if (val >> 16) { n += 16; val >>= 16; }
+    if (val >> 8) { n += 8; val >>= 8; }
+    if (val >> 4) { n += 4; val >>= 4; }
+    if (val >> 2) { n += 2; val >>= 2; }
+    if (val >> 1) { n += 1; }
+
+    return n;
+}
+
+static int bucket_index(guint64 val){
+    int bit;
+
+    if (val < SRN_HISTOGRAM_SUB_BUCKETS){
+        return val;
+    }
+
+    // SRN_HISTOGRAM_SUB_BUCKETS is 2^3
+    bit = msb(val);
+    return (bit - 2) * SRN_HISTOGRAM_SUB_BUCKETS
+        + ((val >> (bit - 3)) & (SRN_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+static guint64 bucket_upper_bound(int idx){
+    int bit;
+    guint64 sub;
+
+    if (idx < SRN_HISTOGRAM_SUB_BUCKETS){
+        return idx;
+    }
+
+    bit = idx / SRN_HISTOGRAM_SUB_BUCKETS + 2;
+    sub = idx % SRN_HISTOGRAM_SUB_BUCKETS;
+    return ((SRN_HISTOGRAM_SUB_BUCKETS + sub + 1) << (bit - 3)) - 1;
+}
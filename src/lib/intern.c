@@ -0,0 +1,361 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file intern.c
+ * @brief Reference counted string pool with IRC casemapping.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-23
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "intern.h"
+
+/* Names shorter than it are folded on stack when looking up */
+#define FOLD_BUF_LEN    64
+
+typedef struct _SrnInternEntry SrnInternEntry;
+
+struct _SrnInternEntry {
+    SrnInternPool *pool;    // NULL if the pool has been freed
+    gint refcount;
+    const char *folded;     // Interned, it holds a reference unless it is str
+    char *markup;           // NULL until asked, may be str
+    char str[];
+};
+
+struct _SrnInternPool {
+    SrnCasemapping casemapping;
+    GHashTable *table;      // str -> SrnInternEntry
+    gsize bytes;
+};
+
+static SrnInternEntry* get_entry(const char *istr);
+static void entry_free(SrnInternEntry *entry);
+static void entry_fold(SrnInternEntry *entry);
+static void fold_to(SrnCasemapping casemapping, const char *src, char *dst);
+
+SrnInternPool* srn_intern_pool_new(SrnCasemapping casemapping){
+    SrnInternPool *self;
+
+    self = g_malloc0(sizeof(SrnInternPool));
+    self->casemapping = casemapping;
+    self->table = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return self;
+}
+
+/**
+ * @brief srn_intern_pool_free frees the pool, strings which are still
+ * referenced stay valid and are freed when their last reference is dropped.
+ */
+void srn_intern_pool_free(SrnInternPool *self){
+    GHashTableIter iter;
+    SrnInternEntry *entry;
+
+    g_return_if_fail(self);
+
+    g_hash_table_iter_init(&iter, self->table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)){
+        entry->pool = NULL;
+    }
+    g_hash_table_destroy(self->table);
+    g_free(self);
+}
+
+/**
+ * @brief srn_intern_pool_set_casemapping changes casemapping of the pool,
+ * folded form of all strings are updated. Pointers returned by
+ * srn_intern_get_folded() before are no longer comparable, tables keyed by
+ * them should be rebuilt.
+ */
+void srn_intern_pool_set_casemapping(SrnInternPool *self,
+        SrnCasemapping casemapping){
+    GList *entries;
+    GList *lst;
+
+    g_return_if_fail(self);
+
+    if (self->casemapping == casemapping){
+        return;
+    }
+    self->casemapping = casemapping;
+
+    // Hold all strings so none of them goes away when folded forms change
+    entries = g_hash_table_get_values(self->table);
+    for (lst = entries; lst; lst = g_list_next(lst)){
+        srn_intern_ref(((SrnInternEntry *)lst->data)->str);
+    }
+    for (lst = entries; lst; lst = g_list_next(lst)){
+        SrnInternEntry *entry;
+        const char *old_folded;
+
+        entry = lst->data;
+        old_folded = entry->folded;
+        entry_fold(entry);
+        if (old_folded != entry->str){
+            srn_intern_unref(old_folded);
+        }
+    }
+    for (lst = entries; lst; lst = g_list_next(lst)){
+        srn_intern_unref(((SrnInternEntry *)lst->data)->str);
+    }
+    g_list_free(entries);
+}
+
+SrnCasemapping srn_intern_pool_get_casemapping(SrnInternPool *self){
+    g_return_val_if_fail(self, SRN_CASEMAPPING_RFC1459);
+
+    return self->casemapping;
+}
+
+guint srn_intern_pool_get_size(SrnInternPool *self){
+    g_return_val_if_fail(self, 0);
+
+    return g_hash_table_size(self->table);
+}
+
+gsize srn_intern_pool_get_bytes(SrnInternPool *self){
+    g_return_val_if_fail(self, 0);
+
+    return self->bytes;
+}
+
+/**
+ * @brief srn_intern returns the interned copy of string, it is created if
+ * not exists.
+ *
+ * @param self
+ * @param str
+ *
+ * @return A new reference of interned string, should be released by
+ *      srn_intern_unref()
+ */
+const char* srn_intern(SrnInternPool *self, const char *str){
+    gsize len;
+    SrnInternEntry *entry;
+
+    g_return_val_if_fail(self, NULL);
+    g_return_val_if_fail(str, NULL);
+
+    entry = g_hash_table_lookup(self->table, str);
+    if (entry){
+        entry->refcount++;
+        return entry->str;
+    }
+
+    len = strlen(str);
+    entry = g_malloc(sizeof(SrnInternEntry) + len + 1);
+    entry->pool = self;
+    entry->refcount = 1;
+    entry->folded = NULL;
+    entry->markup = NULL;
+    memcpy(entry->str, str, len + 1);
+
+    g_hash_table_insert(self->table, entry->str, entry);
+    self->bytes += sizeof(SrnInternEntry) + len + 1;
+    entry_fold(entry);
+
+    return entry->str;
+}
+
+/**
+ * @brief srn_intern_lookup_folded returns the folded form of given string
+ * without interning it.
+ *
+ * @param self
+ * @param str
+ *
+ * @return Interned folded string without a new reference, NULL if no
+ *      interned string has the same folded form.
+ */
+const char* srn_intern_lookup_folded(SrnInternPool *self, const char *str){
+    gsize len;
+    char buf[FOLD_BUF_LEN];
+    char *folded;
+    SrnInternEntry *entry;
+
+    g_return_val_if_fail(self, NULL);
+    g_return_val_if_fail(str, NULL);
+
+    // Fast path, the string itself is interned
+    entry = g_hash_table_lookup(self->table, str);
+    if (entry){
+        return entry->folded;
+    }
+
+    len = strlen(str);
+    folded = len < sizeof(buf) ? buf : g_malloc(len + 1);
+    fold_to(self->casemapping, str, folded);
+    entry = g_hash_table_lookup(self->table, folded);
+    if (folded != buf){
+        g_free(folded);
+    }
+
+    return entry ? entry->folded : NULL;
+}
+
+const char* srn_intern_ref(const char *istr){
+    g_return_val_if_fail(istr, NULL);
+
+    get_entry(istr)->refcount++;
+
+    return istr;
+}
+
+void srn_intern_unref(const char *istr){
+    SrnInternEntry *entry;
+
+    if (!istr){
+        return;
+    }
+
+    entry = get_entry(istr);
+    g_return_if_fail(entry->refcount > 0);
+    if (--entry->refcount > 0){
+        return;
+    }
+
+    if (entry->pool){
+        g_hash_table_remove(entry->pool->table, entry->str);
+        entry->pool->bytes -= sizeof(SrnInternEntry) + strlen(entry->str) + 1;
+    }
+    entry_free(entry);
+}
+
+const char* srn_intern_get_folded(const char *istr){
+    g_return_val_if_fail(istr, NULL);
+
+    return get_entry(istr)->folded;
+}
+
+/**
+ * @brief srn_intern_get_markup returns the string escaped by
+ * g_markup_escape_text(), it is computed once and lives as long as the
+ * interned string.
+ */
+const char* srn_intern_get_markup(const char *istr){
+    SrnInternEntry *entry;
+
+    g_return_val_if_fail(istr, NULL);
+
+    entry = get_entry(istr);
+    if (!entry->markup){
+        entry->markup = g_markup_escape_text(entry->str, -1);
+        // Most names need no escape
+        if (strcmp(entry->markup, entry->str) == 0){
+            g_free(entry->markup);
+            entry->markup = entry->str;
+        }
+    }
+
+    return entry->markup;
+}
+
+gboolean srn_casemapping_from_string(const char *name,
+        SrnCasemapping *casemapping){
+    if (g_ascii_strcasecmp(name, "ascii") == 0){
+        *casemapping = SRN_CASEMAPPING_ASCII;
+    } else if (g_ascii_strcasecmp(name, "rfc1459") == 0){
+        *casemapping = SRN_CASEMAPPING_RFC1459;
+    } else if (g_ascii_strcasecmp(name, "strict-rfc1459") == 0){
+        *casemapping = SRN_CASEMAPPING_STRICT_RFC1459;
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+char* srn_casemapping_fold(SrnCasemapping casemapping, const char *str){
+    char *folded;
+
+    folded = g_malloc(strlen(str) + 1);
+    fold_to(casemapping, str, folded);
+
+    return folded;
+}
+
+static SrnInternEntry* get_entry(const char *istr){
+    return (SrnInternEntry *)(istr - G_STRUCT_OFFSET(SrnInternEntry, str));
+}
+
+static void entry_free(SrnInternEntry *entry){
+    if (entry->folded != entry->str){
+        srn_intern_unref(entry->folded);
+    }
+    if (entry->markup != entry->str){
+        g_free(entry->markup);
+    }
+    g_free(entry);
+}
+
+/**
+ * @brief entry_fold interns folded form of entry, the old folded form is
+ * overwritten without being released.
+ */
+static void entry_fold(SrnInternEntry *entry){
+    gsize len;
+    char buf[FOLD_BUF_LEN];
+    char *folded;
+
+    len = strlen(entry->str);
+    folded = len < sizeof(buf) ? buf : g_malloc(len + 1);
+    fold_to(entry->pool->casemapping, entry->str, folded);
+    if (strcmp(folded, entry->str) == 0){
+        entry->folded = entry->str;
+    } else {
+        entry->folded = srn_intern(entry->pool, folded);
+    }
+    if (folded != buf){
+        g_free(folded);
+    }
+}
+
+static void fold_to(SrnCasemapping casemapping, const char *src, char *dst){
+    for (; *src; src++, dst++){
+        char c;
+
+        c = *src;
+        if (c >= 'A' && c <= 'Z'){
+            c += 'a' - 'A';
+        } else if (casemapping != SRN_CASEMAPPING_ASCII){
+            switch (c){
+                case '[':
+                    c = '{';
+                    break;
+                case ']':
+                    c = '}';
+                    break;
+                case '\\':
+                    c = '|';
+                    break;
+                case '~':
+                    if (casemapping == SRN_CASEMAPPING_RFC1459){
+                        c = '^';
+                    }
+                    break;
+            }
+        }
+        *dst = c;
+    }
+    *dst = '\0';
+}
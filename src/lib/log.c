@@ -22,6 +22,18 @@
  * @author Shengyu Zhang <i@silverrainz.me>
  * @version 0.06.2
  * @date 2017-06-24
+ *
+ * Whether a log callsite is enabled is cached in the callsite itself, see
+ * SrnLogCallsite. The cache is invalidated by bumping srn_logger_generation
+ * when the config or the default logger changes.
+ *
+ * Non-error logs are written to stdout by a dedicated writer thread, so
+ * enabled logging doesn't block the main loop. Error logs are still written
+ * to stderr synchronously, they are rare and should not be lost on crash.
+ *
+ * If stdout is slower than logs are produced, at most LOG_QUEUE_MAX_LINES
+ * lines are queued, later lines are dropped and the number of dropped lines
+ * is written once the writer catches up.
  */
 
 #include <stdio.h>
@@ -32,11 +44,21 @@
 #include "config/config.h"
 #include "log.h"
 
+#define LOG_QUEUE_MAX_LINES 4096
+
 struct _SrnLogger {
     SrnLoggerConfig *cfg;
+
+    GThread *writer;
+    GAsyncQueue *queue; // Queue of strings to be written to stdout
+    int dropped; // Lines dropped since queue is full, accessed atomically
 };
 
+/* Always even, starts from 2 so that zero-initialized callsites are outdated */
+guint srn_logger_generation = 2;
+
 static SrnLogger *srn_logger = NULL;
+static char writer_quit; // Address of it is used as a quit sign of writer
 
 static char *prompts[2][LOG_MAX] = {
     [0] = {
@@ -55,6 +77,8 @@ static char *prompts[2][LOG_MAX] = {
 
 static bool is_exist(GList *files, const char *file);
 static bool is_enabled(SrnLoggerConfig *cfg, SrnLogLevel lv, const char *file);
+static void bump_generation(void);
+static gpointer writer_thread(gpointer user_data);
 
 /**
  * @brief log_print Print a log
@@ -74,16 +98,28 @@ SrnLogger* srn_logger_new(SrnLoggerConfig *cfg){
 
     logger = g_malloc0(sizeof(SrnLogger));
     logger->cfg = cfg;
+    logger->queue = g_async_queue_new_full(g_free);
+    logger->writer = g_thread_new("srn-logger", writer_thread, logger);
 
     return logger;
 }
 
 void srn_logger_free(SrnLogger *logger){
+    if (srn_logger == logger){
+        srn_logger_set_default(NULL);
+    }
+
+    // Write all pending logs before quitting
+    g_async_queue_push(logger->queue, &writer_quit);
+    g_thread_join(logger->writer);
+    g_async_queue_unref(logger->queue);
+
     g_free(logger);
 }
 
 void srn_logger_set_default(SrnLogger *logger) {
     srn_logger = logger;
+    bump_generation();
 }
 
 SrnLogger* srn_logger_get_default(void) {
@@ -92,12 +128,46 @@ SrnLogger* srn_logger_get_default(void) {
 
 void srn_logger_set_config(SrnLogger *logger, SrnLoggerConfig *cfg) {
     logger->cfg = cfg;
+    bump_generation();
 }
 
 SrnLoggerConfig *srn_logger_get_config(SrnLogger *logger) {
     return logger->cfg;
 }
 
+/**
+ * @brief srn_logger_check_callsite updates the cached state of an outdated
+ * callsite. It should only be called by the SRN_LOG() macro.
+ *
+ * @param callsite
+ * @param lv Log level of the callsite
+ * @param file File name of the callsite
+ *
+ * @return TRUE if the callsite is enabled
+ */
+bool srn_logger_check_callsite(SrnLogCallsite *callsite, SrnLogLevel lv,
+        const char *file){
+    guint gen;
+    SrnLogger *logger;
+
+    gen = g_atomic_int_get(&srn_logger_generation);
+    if (*callsite == gen + 1){
+        return TRUE;
+    }
+    if (*callsite == gen){
+        return FALSE;
+    }
+
+    logger = srn_logger_get_default();
+    if (logger && logger->cfg && file && is_enabled(logger->cfg, lv, file)){
+        *callsite = gen + 1;
+        return TRUE;
+    }
+
+    *callsite = gen;
+    return FALSE;
+}
+
 void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
         bool new_line, const char *file, const char *func, int line,
         const char *fmt, ...){
@@ -105,7 +175,7 @@ void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
     GString *prompt;
     GString *output;
 
-    if (!file || !is_enabled(logger->cfg, lv, file)) {
+    if (!logger || !file) {
         return;
     }
 
@@ -147,11 +217,13 @@ void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
 
     if (lv >= LOG_ERROR){
         g_fprintf(stderr, "%s", output->str);
+        g_string_free(output, TRUE);
+    } else if (g_async_queue_length(logger->queue) >= LOG_QUEUE_MAX_LINES){
+        g_atomic_int_inc(&logger->dropped);
+        g_string_free(output, TRUE);
     } else {
-        g_fprintf(stdout, "%s", output->str);
+        g_async_queue_push(logger->queue, g_string_free(output, FALSE));
     }
-
-    g_string_free(output, TRUE);
 }
 
 SrnLoggerConfig *srn_logger_config_new(void){
@@ -214,3 +286,38 @@ static bool is_enabled(SrnLoggerConfig *cfg, SrnLogLevel lv, const char *file){
 
     return enable;
 }
+
+static void bump_generation(void){
+    g_atomic_int_add(&srn_logger_generation, 2);
+}
+
+static gpointer writer_thread(gpointer user_data){
+    int dropped;
+    char *str;
+    SrnLogger *logger;
+    GAsyncQueue *queue;
+
+    logger = user_data;
+    queue = logger->queue;
+    for (;;){
+        str = g_async_queue_try_pop(queue);
+        if (!str){
+            // Flush only when the queue is drained to reduce syscalls
+            fflush(stdout);
+            str = g_async_queue_pop(queue);
+        }
+        if (str == &writer_quit){
+            break;
+        }
+        dropped = g_atomic_int_get(&logger->dropped);
+        if (dropped){
+            g_atomic_int_add(&logger->dropped, -dropped);
+            g_fprintf(stdout, "[srn-logger] %d log lines dropped\n", dropped);
+        }
+        fputs(str, stdout);
+        g_free(str);
+    }
+    fflush(stdout);
+
+    return NULL;
+}
@@ -206,11 +206,13 @@ char *srn_get_system_config_file(){
     return path;
 }
 
-// FIXME: actually it only create the dir.
-char *srn_create_log_file(const char *srv_name, const char *fname){
+/**
+ * @brief srn_get_log_file returns path of log file, unlike
+ * srn_create_log_file(), the file may not exist.
+ */
+char *srn_get_log_file(const char *srv_name, const char *fname){
     char *path;
     char *tmp;
-    SrnRet ret;
 
     tmp = srn_try_to_find_user_file("logs");
     if (tmp){
@@ -224,6 +226,15 @@ char *srn_create_log_file(const char *srv_name, const char *fname){
                                 srv_name, fname, NULL);
     }
 
+    return path;
+}
+
+// FIXME: actually it only create the dir.
+char *srn_create_log_file(const char *srv_name, const char *fname){
+    char *path;
+    SrnRet ret;
+
+    path = srn_get_log_file(srv_name, fname);
     if (!path){
         return NULL;
     }
@@ -0,0 +1,253 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file trace.c
+ * @brief Span tracing which can be dumped as Chrome trace JSON.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version
+ * @date 2019-05-16
+ *
+ * Every thread records spans into its own ring buffer, so recording never
+ * takes a lock. Old spans are overwritten when the ring is full.
+ *
+ * Only the owner thread writes head of a ring, srn_trace_clear() only moves
+ * tail to the head it sees, so clearing never loses a span recorded after it
+ * returns. A span being recorded while clearing may or may not be kept.
+ *
+ * The JSON file can be loaded by chrome://tracing or https://ui.perfetto.dev.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "i18n.h"
+#include "histogram.h"
+#include "trace.h"
+
+#ifdef ENABLE_TRACING
+
+#define RING_SIZE   16384 // Must be power of 2
+
+typedef struct _TraceSpan TraceSpan;
+typedef struct _TraceRing TraceRing;
+
+struct _TraceSpan {
+    const char *name;
+    guint64 start;  // In ns
+    guint64 end;    // In ns
+};
+
+struct _TraceRing {
+    int tid;
+    guint head; // Number of recorded spans, wraps around, only written by
+                // owner thread
+    guint tail; // Head when the ring is cleared, only written with
+                // rings_mutex held
+    TraceSpan spans[RING_SIZE];
+};
+
+static TraceRing* get_ring(void);
+static void append_json_string(GString *str, const char *val);
+
+static GPrivate local_ring = G_PRIVATE_INIT(NULL); // Rings are never freed
+static GMutex rings_mutex;
+static GList *rings; // List of TraceRing, protected by rings_mutex
+static int next_tid = 1;
+
+guint64 srn_trace_now(void){
+    return srn_get_monotonic_ns();
+}
+
+void srn_trace_record(const char *name, guint64 start, guint64 end){
+    TraceRing *ring;
+    TraceSpan *span;
+
+    ring = get_ring();
+    span = &ring->spans[ring->head & (RING_SIZE - 1)];
+    span->name = name;
+    span->start = start;
+    span->end = end;
+    // Publish the span after it is filled
+    g_atomic_int_inc(&ring->head);
+}
+
+/**
+ * @brief srn_trace_dump writes all recorded spans to the given file in Chrome
+ * trace event format.
+ *
+ * Spans of other threads being recorded during dumping may be incomplete,
+ * tracing is a debugging aid so we accept it.
+ *
+ * @param path If NULL, a file in temporary directory is used.
+ *
+ * @return SRN_OK if success
+ */
+SrnRet srn_trace_dump(const char *path){
+    bool first;
+    char *default_path;
+    GList *lst;
+    GString *str;
+    GError *err;
+    SrnRet ret;
+
+    first = TRUE;
+    str = g_string_new("{\"traceEvents\":[");
+
+    g_mutex_lock(&rings_mutex);
+    for (lst = rings; lst; lst = g_list_next(lst)){
+        guint head;
+        guint count;
+        TraceRing *ring;
+
+        ring = lst->data;
+        head = g_atomic_int_get(&ring->head);
+        // Unsigned subtraction is right even if head has wrapped around
+        count = MIN(head - g_atomic_int_get(&ring->tail), RING_SIZE);
+        for (guint i = head - count; i != head; i++){
+            TraceSpan *span = &ring->spans[i & (RING_SIZE - 1)];
+
+            guint64 dur = span->end - span->start;
+
+            g_string_append(str, first ? "\n{\"name\":" : ",\n{\"name\":");
+            append_json_string(str, span->name);
+            // Avoid "%f", decimal separator depends on locale
+            g_string_append_printf(str,
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%" G_GUINT64_FORMAT ".%03u,"
+                    "\"dur\":%" G_GUINT64_FORMAT ".%03u}",
+                    ring->tid,
+                    span->start / 1000, (unsigned)(span->start % 1000),
+                    dur / 1000, (unsigned)(dur % 1000));
+            first = FALSE;
+        }
+    }
+    g_mutex_unlock(&rings_mutex);
+
+    g_string_append(str, "\n]}\n");
+
+    default_path = NULL;
+    if (!path) {
+        char *basename;
+
+        basename = g_strdup_printf("srain-trace-%" G_GINT64_FORMAT ".json",
+                g_get_real_time() / G_USEC_PER_SEC);
+        default_path = g_build_filename(g_get_tmp_dir(), basename, NULL);
+        g_free(basename);
+        path = default_path;
+    }
+
+    err = NULL;
+    if (g_file_set_contents(path, str->str, str->len, &err)){
+        ret = RET_OK(_("Trace has been written to %1$s"), path);
+    } else {
+        ret = RET_ERR(_("Failed to write trace file: %1$s"), err->message);
+        g_error_free(err);
+    }
+
+    g_free(default_path);
+    g_string_free(str, TRUE);
+
+    return ret;
+}
+
+/**
+ * @brief srn_trace_clear forgets spans recorded so far by all threads.
+ *
+ * Spans are not touched, they are just no longer dumped. Recording threads
+ * are never blocked by it.
+ */
+void srn_trace_clear(void){
+    GList *lst;
+
+    g_mutex_lock(&rings_mutex);
+    for (lst = rings; lst; lst = g_list_next(lst)){
+        TraceRing *ring = lst->data;
+        g_atomic_int_set(&ring->tail, g_atomic_int_get(&ring->head));
+    }
+    g_mutex_unlock(&rings_mutex);
+}
+
+bool srn_trace_is_enabled(void){
+    return TRUE;
+}
+
+static TraceRing* get_ring(void){
+    TraceRing *ring;
+
+    ring = g_private_get(&local_ring);
+    if (G_LIKELY(ring)){
+        return ring;
+    }
+
+    ring = g_malloc0(sizeof(TraceRing));
+    g_mutex_lock(&rings_mutex);
+    ring->tid = next_tid++;
+    rings = g_list_append(rings, ring);
+    g_mutex_unlock(&rings_mutex);
+    g_private_set(&local_ring, ring);
+
+    return ring;
+}
+
+/**
+ * @brief append_json_string appends a quoted and escaped JSON string.
+ */
+static void append_json_string(GString *str, const char *val){
+    g_string_append_c(str, '"');
+    for (const char *p = val; *p; p++){
+        switch (*p){
+            case '"':
+                g_string_append(str, "\\\"");
+                break;
+            case '\\':
+                g_string_append(str, "\\\\");
+                break;
+            default:
+                if ((unsigned char)*p < 0x20){
+                    g_string_append_printf(str, "\\u%04x", (unsigned char)*p);
+                } else {
+                    g_string_append_c(str, *p);
+                }
+        }
+    }
+    g_string_append_c(str, '"');
+}
+
+#else
+
+guint64 srn_trace_now(void){
+    return 0;
+}
+
+void srn_trace_record(const char *name, guint64 start, guint64 end){
+}
+
+SrnRet srn_trace_dump(const char *path){
+    return RET_ERR(_("Tracing is not enabled in this build"));
+}
+
+void srn_trace_clear(void){
+}
+
+bool srn_trace_is_enabled(void){
+    return FALSE;
+}
+
+#endif /* ENABLE_TRACING */
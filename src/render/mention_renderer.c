@@ -41,6 +41,7 @@ static SrnMarkupRenderer *markup_renderer;
 
 SrnMessageRenderer mention_renderer = {
     .name = "mention",
+    .input = SRN_RENDER_INPUT_MARKUP,
     .init = init,
     .finalize = finalize,
     .render = render,
@@ -93,8 +94,7 @@ SrnRet render(SrnMessage *msg) {
         goto FIN;
     }
     if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
+        srn_message_set_rendered_content(msg, rendered_content);
     }
 
 FIN:
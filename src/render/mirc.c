@@ -0,0 +1,327 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file mirc.c
+ * @brief Decoder of mIRC formatting codes shared by mirc_strip_renderer and
+ * mirc_colorize_renderer
+ *
+ * ref: https://modern.ircdocs.horse/formatting.html
+ */
+
+#include <glib.h>
+
+#include "srain.h"
+
+#include "./mirc.h"
+
+typedef enum {
+    MIRC_CONTROL_NONE = 0,
+    MIRC_CONTROL_TOGGLE,
+    MIRC_CONTROL_COLOR,
+    MIRC_CONTROL_HEX_COLOR,
+    MIRC_CONTROL_RESET,
+} MircControlKind;
+
+typedef struct _MircControl {
+    MircControlKind kind;
+    unsigned flag; // Style flag toggled by MIRC_CONTROL_TOGGLE
+} MircControl;
+
+/* Indexed by byte, bytes not listed are ordinary text */
+static const MircControl control_table[256] = {
+    [MIRC_BOLD]             = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_BOLD },
+    [MIRC_COLOR]            = { MIRC_CONTROL_COLOR, 0 },
+    [MIRC_HEX_COLOR]        = { MIRC_CONTROL_HEX_COLOR, 0 },
+    [MIRC_BLINK]            = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_BLINK },
+    [MIRC_PLAIN]            = { MIRC_CONTROL_RESET, 0 },
+    [MIRC_MONOSPACE]        = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_MONOSPACE },
+    [MIRC_REVERSE]          = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_REVERSE },
+    [MIRC_ITALICS]          = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_ITALICS },
+    [MIRC_STRIKETHROUGH]    = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_STRIKETHROUGH },
+    [MIRC_UNDERLINE]        = { MIRC_CONTROL_TOGGLE, MIRC_STYLE_UNDERLINE },
+};
+
+// TODO: define in theme CSS?
+static const MircRgb color_map[MIRC_COLOR_DEFAULT] = {
+    [MIRC_COLOR_WHITE]          = 0xFFFFFF,
+    [MIRC_COLOR_BLACK]          = 0x000000,
+    [MIRC_COLOR_NAVY]           = 0x00007F,
+    [MIRC_COLOR_GREEN]          = 0x009300,
+    [MIRC_COLOR_RED]            = 0xFF0000,
+    [MIRC_COLOR_MAROON]         = 0x7F0000,
+    [MIRC_COLOR_PURPLE]         = 0x9C009C,
+    [MIRC_COLOR_OLIVE]          = 0xFC7F00,
+    [MIRC_COLOR_YELLOW]         = 0xFFFF00,
+    [MIRC_COLOR_LIGHT_GREEN]    = 0x00FC00,
+    [MIRC_COLOR_TEAL]           = 0x009393,
+    [MIRC_COLOR_CYAN]           = 0x00FFFF,
+    [MIRC_COLOR_ROYAL_BLUE]     = 0x0000FC,
+    [MIRC_COLOR_MAGENTA]        = 0xFF00FF,
+    [MIRC_COLOR_GRAY]           = 0x7F7F7F,
+    [MIRC_COLOR_LIGHT_GRAY]     = 0xD2D2D2,
+    /* Extended colors 16 ~ 98 */
+    0x470000, 0x472100, 0x474700, 0x324700, 0x004700, 0x00472C,
+    0x004747, 0x002747, 0x000047, 0x2E0047, 0x470047, 0x47002A,
+    0x740000, 0x743A00, 0x747400, 0x517400, 0x007400, 0x007449,
+    0x007474, 0x004074, 0x000074, 0x4B0074, 0x740074, 0x740045,
+    0xB50000, 0xB56300, 0xB5B500, 0x7DB500, 0x00B500, 0x00B571,
+    0x00B5B5, 0x0063B5, 0x0000B5, 0x7500B5, 0xB500B5, 0xB5006B,
+    0xFF0000, 0xFF8C00, 0xFFFF00, 0xB2FF00, 0x00FF00, 0x00FFA0,
+    0x00FFFF, 0x008CFF, 0x0000FF, 0xA500FF, 0xFF00FF, 0xFF0098,
+    0xFF5959, 0xFFB459, 0xFFFF71, 0xCFFF60, 0x6FFF6F, 0x65FFC9,
+    0x6DFFFF, 0x59B4FF, 0x5959FF, 0xC459FF, 0xFF66FF, 0xFF59BC,
+    0xFF9C9C, 0xFFD39C, 0xFFFF9C, 0xE2FF9C, 0x9CFF9C, 0x9CFFDB,
+    0x9CFFFF, 0x9CD3FF, 0x9C9CFF, 0xDC9CFF, 0xFF9CFF, 0xFF94D3,
+    0x000000, 0x131313, 0x282828, 0x363636, 0x4D4D4D, 0x656565,
+    0x818181, 0x9F9F9F, 0xBCBCBC, 0xE2E2E2, 0xFFFFFF,
+};
+
+static const char *parse_color(const char *ptr, const char *end,
+        MircStyle *style);
+static const char *parse_hex_color(const char *ptr, const char *end,
+        MircStyle *style);
+
+/**
+ * @brief mirc_decode splits the given text into ranges of the same style,
+ * formatting codes are consumed and never passed to func.
+ *
+ * The decoding is done in a single pass without any allocation.
+ *
+ * @param text
+ * @param len Length of text in bytes
+ * @param func Called for every non-empty range of text
+ * @param user_data Passed to func
+ */
+void mirc_decode(const char *text, gsize len, MircRangeFunc func,
+        void *user_data){
+    const char *ptr;
+    const char *start;
+    const char *end;
+    MircStyle style = {
+        .flags = 0,
+        .fg_color = MIRC_RGB_DEFAULT,
+        .bg_color = MIRC_RGB_DEFAULT,
+    };
+
+    ptr = start = text;
+    end = text + len;
+    while (ptr < end){
+        const MircControl *ctrl;
+
+        ctrl = &control_table[(guchar)*ptr];
+        if (ctrl->kind == MIRC_CONTROL_NONE){
+            ptr++;
+            continue;
+        }
+
+        if (ptr > start){
+            func(start, ptr - start, &style, user_data);
+        }
+        ptr++; // Skip control character
+
+        switch (ctrl->kind){
+            case MIRC_CONTROL_TOGGLE:
+                style.flags ^= ctrl->flag;
+                break;
+            case MIRC_CONTROL_COLOR:
+                ptr = parse_color(ptr, end, &style);
+                break;
+            case MIRC_CONTROL_HEX_COLOR:
+                ptr = parse_hex_color(ptr, end, &style);
+                break;
+            case MIRC_CONTROL_RESET:
+                style.flags = 0;
+                style.fg_color = MIRC_RGB_DEFAULT;
+                style.bg_color = MIRC_RGB_DEFAULT;
+                break;
+            default:
+                g_warn_if_reached();
+        }
+        start = ptr;
+    }
+
+    if (ptr > start){
+        func(start, ptr - start, &style, user_data);
+    }
+}
+
+/**
+ * @brief mirc_append_escaped appends markup escaped text to str, the result
+ * is the same as g_markup_escape_text() but no temporary string is allocated.
+ *
+ * @param str
+ * @param text Need not be nul-terminated
+ * @param len Length of text in bytes
+ */
+void mirc_append_escaped(GString *str, const char *text, gsize len){
+    const char *ptr;
+    const char *start;
+    const char *end;
+
+    ptr = start = text;
+    end = text + len;
+    while (ptr < end){
+        const char *escape;
+        guchar ch;
+        gunichar ctrl;
+        int skip;
+
+        ch = *ptr;
+        escape = NULL;
+        ctrl = 0;
+        skip = 1;
+        switch (ch){
+            case '&':
+                escape = "&amp;";
+                break;
+            case '<':
+                escape = "&lt;";
+                break;
+            case '>':
+                escape = "&gt;";
+                break;
+            case '\'':
+                escape = "&apos;";
+                break;
+            case '"':
+                escape = "&quot;";
+                break;
+            case '\t':
+            case '\n':
+            case '\r':
+                break;
+            case 0xC2:
+                // U+0080 ~ U+009F are C1 control characters
+                if (ptr + 1 < end
+                        && (guchar)ptr[1] >= 0x80 && (guchar)ptr[1] <= 0x9F){
+                    ctrl = (guchar)ptr[1];
+                    skip = 2;
+                }
+                break;
+            default:
+                if (ch < 0x20 || ch == 0x7F){
+                    ctrl = ch;
+                }
+        }
+
+        if (!escape && !ctrl){
+            ptr++;
+            continue;
+        }
+
+        g_string_append_len(str, start, ptr - start);
+        if (escape){
+            g_string_append(str, escape);
+        } else {
+            g_string_append_printf(str, "&#x%x;", ctrl);
+        }
+        ptr += skip;
+        start = ptr;
+    }
+
+    g_string_append_len(str, start, ptr - start);
+}
+
+/* Parse a color code of 1 ~ 2 digits, returns number of digits consumed */
+static int parse_color_code(const char *ptr, const char *end, int *color){
+    int i;
+
+    *color = 0;
+    for (i = 0; i < 2 && ptr + i < end && g_ascii_isdigit(ptr[i]); i++){
+        *color = *color * 10 + (ptr[i] - '0');
+    }
+
+    return i;
+}
+
+static MircRgb color_to_rgb(int color){
+    if (color < 0 || color >= MIRC_COLOR_DEFAULT) {
+        return MIRC_RGB_DEFAULT;
+    }
+    return color_map[color];
+}
+
+/* Format: "\x03[fg_color[,bg_color]]" */
+static const char *parse_color(const char *ptr, const char *end,
+        MircStyle *style){
+    int color;
+    int n;
+
+    n = parse_color_code(ptr, end, &color);
+    if (n == 0){ // No color, reset colors
+        style->fg_color = MIRC_RGB_DEFAULT;
+        style->bg_color = MIRC_RGB_DEFAULT;
+        return ptr;
+    }
+    style->fg_color = color_to_rgb(color);
+    ptr += n;
+
+    // Comma is a part of text if no digit follows it
+    if (ptr + 1 < end && *ptr == ',' && g_ascii_isdigit(ptr[1])){
+        ptr++;
+        ptr += parse_color_code(ptr, end, &color);
+        style->bg_color = color_to_rgb(color);
+    }
+
+    return ptr;
+}
+
+static MircRgb parse_rgb(const char *ptr, const char *end){
+    MircRgb rgb;
+
+    if (end - ptr < 6) {
+        return MIRC_RGB_DEFAULT;
+    }
+
+    rgb = 0;
+    for (int i = 0; i < 6; i++){
+        int val = g_ascii_xdigit_value(ptr[i]);
+        if (val < 0){
+            return MIRC_RGB_DEFAULT;
+        }
+        rgb = (rgb << 4) | val;
+    }
+
+    return rgb;
+}
+
+/* Format: "\x04[RRGGBB[,RRGGBB]]" */
+static const char *parse_hex_color(const char *ptr, const char *end,
+        MircStyle *style){
+    MircRgb rgb;
+
+    rgb = parse_rgb(ptr, end);
+    if (rgb == MIRC_RGB_DEFAULT){ // No color, reset colors
+        style->fg_color = MIRC_RGB_DEFAULT;
+        style->bg_color = MIRC_RGB_DEFAULT;
+        return ptr;
+    }
+    style->fg_color = rgb;
+    ptr += 6;
+
+    if (ptr < end && *ptr == ','){
+        rgb = parse_rgb(ptr + 1, end);
+        if (rgb != MIRC_RGB_DEFAULT){
+            style->bg_color = rgb;
+            ptr += 7;
+        }
+    }
+
+    return ptr;
+}
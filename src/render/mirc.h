@@ -19,16 +19,23 @@
 #ifndef __MIRC_H
 #define __MIRC_H
 
-/* mIRC color control characters */
-#define MIRC_BOLD       0x02
-#define MIRC_ITALICS    0x1D
-#define MIRC_UNDERLINE  0x1F
-#define MIRC_REVERSE    0x16
-#define MIRC_BLINK      0x06
-#define MIRC_PLAIN      0x0F
-#define MIRC_COLOR      0x03
-
-/* mIRC color code */
+#include <glib.h>
+
+#include "srain.h"
+
+/* mIRC formatting control characters */
+#define MIRC_BOLD           0x02
+#define MIRC_COLOR          0x03
+#define MIRC_HEX_COLOR      0x04
+#define MIRC_BLINK          0x06
+#define MIRC_PLAIN          0x0F
+#define MIRC_MONOSPACE      0x11
+#define MIRC_REVERSE        0x16
+#define MIRC_ITALICS        0x1D
+#define MIRC_STRIKETHROUGH  0x1E
+#define MIRC_UNDERLINE      0x1F
+
+/* mIRC color code, 16 ~ 98 are extended colors, see mirc.c */
 enum {
     MIRC_COLOR_WHITE        = 0,
     MIRC_COLOR_BLACK        = 1,
@@ -46,7 +53,46 @@ enum {
     MIRC_COLOR_MAGENTA      = 13,
     MIRC_COLOR_GRAY         = 14,
     MIRC_COLOR_LIGHT_GRAY   = 15,
-    MIRC_COLOR_UNKNOWN      = 16, // Not a part of protocol, just for convenience
+    MIRC_COLOR_DEFAULT      = 99, // Default foreground or background color
 };
 
+/* A 0xRRGGBB value, or MIRC_RGB_DEFAULT */
+typedef gint32 MircRgb;
+
+#define MIRC_RGB_DEFAULT    (-1)
+
+/* Bits of MircStyle->flags */
+#define MIRC_STYLE_BOLD             (1 << 0)
+#define MIRC_STYLE_ITALICS          (1 << 1)
+#define MIRC_STYLE_UNDERLINE        (1 << 2)
+#define MIRC_STYLE_STRIKETHROUGH    (1 << 3)
+#define MIRC_STYLE_MONOSPACE        (1 << 4)
+#define MIRC_STYLE_REVERSE          (1 << 5)
+#define MIRC_STYLE_BLINK            (1 << 6)
+
+typedef struct _MircStyle MircStyle;
+
+struct _MircStyle {
+    unsigned flags;
+    MircRgb fg_color;
+    MircRgb bg_color;
+};
+
+/**
+ * @brief MircRangeFunc is called for every range of text which shares the
+ * same style.
+ *
+ * @param text Start of the range, points into the decoded text and is NOT
+ * nul-terminated
+ * @param len Length of the range in bytes
+ * @param style Style of the range, only valid during the call
+ * @param user_data
+ */
+typedef void (*MircRangeFunc) (const char *text, gsize len,
+        const MircStyle *style, void *user_data);
+
+void mirc_decode(const char *text, gsize len, MircRangeFunc func,
+        void *user_data);
+void mirc_append_escaped(GString *str, const char *text, gsize len);
+
 #endif /* __MIRC_H */
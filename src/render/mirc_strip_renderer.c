@@ -33,15 +33,18 @@ static void finalize(void);
 static SrnRet render(SrnMessage *msg);
 static void text(GMarkupParseContext *context, const gchar *text,
         gsize text_len, gpointer user_data, GError **error);
+static void strip_range(const char *text, gsize len,
+        const MircStyle *style, void *user_data);
 
 /**
  * @brief mirc_strip_renderer is a render moduele for strip mIRC color from
  * message.
  *
- * ref: https://en.wikichip.org/wiki/irc/colors
+ * ref: https://modern.ircdocs.horse/formatting.html
  */
 SrnMessageRenderer mirc_strip_renderer = {
     .name = "mirc_strip",
+    .input = SRN_RENDER_INPUT_MARKUP,
     .init = init,
     .finalize = finalize,
     .render = render,
@@ -72,8 +75,7 @@ SrnRet render(SrnMessage *msg) {
         return RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
     }
     if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
+        srn_message_set_rendered_content(msg, rendered_content);
     }
 
     return SRN_OK;
@@ -81,54 +83,11 @@ SrnRet render(SrnMessage *msg) {
 
 static void text(GMarkupParseContext *context, const gchar *text,
         gsize text_len, gpointer user_data, GError **error){
-    GString *str;
-
-    str = srn_markup_renderer_get_markup(user_data);
+    mirc_decode(text, text_len, strip_range,
+            srn_markup_renderer_get_markup(user_data));
+}
 
-    for (int i = 0; i < text_len; i++){
-        switch (text[i]){
-            case MIRC_COLOR:
-                {
-                    const char *startptr = &text[i] + 1;
-                    char *endptr = NULL;
-                    strtoul(startptr, &endptr, 10);
-                    if (endptr > startptr){ // Get foreground color
-                        while (endptr - startptr > 2){ // Wrong number of digits
-                            endptr--;
-                        }
-                    }
-                    i += endptr - startptr;
-                    if (*endptr == ',') { // background color exists
-                        endptr++;
-                        startptr = endptr;
-                        endptr = NULL;
-                        strtoul(startptr, &endptr, 10);
-                        if (endptr > startptr){ // Get background color
-                            while (endptr - startptr > 2){ // Wrong number of digits
-                                endptr--;
-                            }
-                        }
-                        i += endptr - startptr;
-                    }
-                    break;
-                }
-            case MIRC_BOLD:
-            case MIRC_ITALICS:
-            case MIRC_UNDERLINE:
-            case MIRC_BLINK:
-            case MIRC_REVERSE:
-            case MIRC_PLAIN:
-                break;
-            default:
-                {
-                    // No control character, it is a utf-8 sequence
-                    const char *next = g_utf8_next_char(&text[i]);
-                    char *escape = g_markup_escape_text(&text[i], next - &text[i]);
-                    str = g_string_append(str, escape);
-                    g_free(escape);
-                    i += next - &text[i] - 1;
-                    break;
-                }
-        }
-    }
+static void strip_range(const char *text, gsize len,
+        const MircStyle *style, void *user_data){
+    mirc_append_escaped(user_data, text, len);
 }
@@ -17,70 +17,40 @@
  */
 
 #include "core/core.h"
-#include "markup_renderer.h"
 #include "pattern_set.h"
+#include "utils.h"
 
 #include "./renderer.h"
 
 #define PATTERNS_KEY "pattern_render_module_patterns"
 
-static void init(void);
-static void finalize(void);
 static SrnRet render(SrnMessage *msg);
 static GList** alloc_patterns();
 static void free_patterns(GList **patterns);
 static GList* get_patterns(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
-
-static SrnMarkupRenderer *markup_renderer;
 
 /**
  * @brief pattern_renderer is a render module for extracting text from message
  * content via given pattern, and use them as new message content.
  *
- * NOTE: Make sure pattern_renderer is executed as first renderer.
+ * It matches patterns against raw content, so it must be executed before
+ * any markup renderer.
  */
 SrnMessageRenderer pattern_renderer = {
     .name = "pattern",
-    .init = init,
-    .finalize = finalize,
+    .input = SRN_RENDER_INPUT_CONTENT,
     .render = render,
 };
 
-void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->start_element = NULL;
-    parser->end_element = NULL;
-    parser->text = text;
-}
-
-void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
-}
-
 static SrnRet render(SrnMessage *msg) {
-    char *raw_content;
     GList *patterns;
     GList *lst;
-    SrnRet ret;
     SrnPatternSet *pattern_set;
 
     pattern_set = srn_application_get_default()->pattern_set;
     g_return_val_if_fail(pattern_set, SRN_ERR);
 
     patterns = get_patterns(msg);
-
-    raw_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &raw_content, NULL);
-    if (!RET_IS_OK(ret)){
-        // ret = RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
-        // return TRUE;
-    }
     lst = patterns;
     while (lst) {
         const char *pattern;
@@ -92,7 +62,7 @@ static SrnRet render(SrnMessage *msg) {
             GMatchInfo *match_info;
 
             match_info = NULL;
-            g_regex_match(regex, raw_content, 0, &match_info);
+            g_regex_match(regex, msg->content, 0, &match_info);
             if (g_match_info_matches(match_info)) {
                 char *sender;
                 char *content;
@@ -103,24 +73,23 @@ static SrnRet render(SrnMessage *msg) {
                 time = g_match_info_fetch_named(match_info, "time");
 
                 if (sender) {
-                    g_free(msg->rendered_remark);
-                    msg->rendered_remark = msg->rendered_sender;
-                    msg->rendered_sender = g_markup_escape_text(sender, -1);
+                    str_assign(&msg->rendered_remark, msg->rendered_sender);
+                    srn_message_set_sender_name(msg, sender);
                 }
                 if (content) {
-                    g_free(msg->rendered_content);
-                    msg->rendered_content = g_markup_escape_text(content, -1);
+                    srn_message_set_rendered_content(msg,
+                            g_markup_escape_text(content, -1));
                 }
                 if (time) {
-                    g_free(msg->rendered_short_time);
-                    msg->rendered_short_time = g_markup_escape_text(time, -1);
+                    g_free(msg->rendered_time);
+                    msg->rendered_time = g_markup_escape_text(time, -1);
                 }
 
                 g_free(sender);
                 g_free(content);
                 g_free(time);
-                g_match_info_free(match_info);
             }
+            g_match_info_free(match_info);
         }
         lst = g_list_next(lst);
     }
@@ -235,8 +204,3 @@ static GList* get_patterns(SrnMessage *msg) {
 
     return patterns;
 }
-
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error){
-    g_string_append_len(srn_markup_renderer_get_markup(user_data), text, text_len);
-}
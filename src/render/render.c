@@ -21,6 +21,8 @@
 #include "srain.h"
 #include "log.h"
 #include "utils.h"
+#include "histogram.h"
+#include "trace.h"
 
 #include "render/render.h"
 #include "./renderer.h"
@@ -34,11 +36,13 @@ extern SrnMessageRenderer mirc_strip_renderer;
 extern SrnMessageRenderer url_renderer;
 extern SrnMessageRenderer mention_renderer;
 static SrnMessageRenderer *renderers[MAX_RENDERER];
+static SrnHistogram stats[MAX_RENDERER]; // Time cost of renderers in ns
 
 void srn_render_init(void){
     int i;
 
-    /* NOTE: Do not change the order renderer . */
+    /* NOTE: Do not change the order renderer, renderers which take raw
+     * content must come first, see SrnRenderInput. */
     i = 0;
     renderers[i++] = &pattern_renderer;
     renderers[i++] = &mirc_strip_renderer;
@@ -47,6 +51,14 @@ void srn_render_init(void){
     renderers[i++] = &mention_renderer;
     g_warn_if_fail(i < MAX_RENDERER);
 
+    for (int j = 1; j < i; j++){
+        if (renderers[j]->input == SRN_RENDER_INPUT_CONTENT
+                && renderers[j-1]->input != SRN_RENDER_INPUT_CONTENT){
+            ERR_FR("Renderer %s takes raw content but is executed after %s",
+                    renderers[j]->name, renderers[j-1]->name);
+        }
+    }
+
     /* Initial all renderers */
     for (int i = 0; i < MAX_RENDERER; i++){
         if (!renderers[i] || !renderers[i]->init) {
@@ -71,6 +83,8 @@ SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
 
     for (int i = 0; i < MAX_RENDERER; i++){
         SrnRet ret;
+        guint64 start;
+        guint64 end;
 
         if (!(flags & (1 << i))) {
             continue;
@@ -82,7 +96,11 @@ SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
         DBG_FR("Rendering message %p via render module %s",
                 msg, renderers[i]->name);
 
+        start = srn_get_monotonic_ns();
         ret = renderers[i]->render(msg);
+        end = srn_get_monotonic_ns();
+        srn_histogram_record(&stats[i], end - start);
+        SRN_TRACE_RECORD(renderers[i]->name, start, end);
         if (!RET_IS_OK(ret)) {
             return RET_ERR("Renderer %s failed to render message %p: %s",
                     renderers[i]->name, msg, RET_MSG(ret));
@@ -91,3 +109,42 @@ SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
 
     return SRN_OK;
 }
+
+/**
+ * @brief srn_render_dump_stats appends time cost of every render module to
+ * the given string.
+ *
+ * @param str
+ * @param json If TRUE, dump as a JSON object which is keyed by module name.
+ */
+void srn_render_dump_stats(GString *str, bool json){
+    bool first;
+
+    first = TRUE;
+    if (json) {
+        g_string_append_c(str, '{');
+    }
+    for (int i = 0; i < MAX_RENDERER; i++){
+        if (!renderers[i]) {
+            continue;
+        }
+        if (json) {
+            g_string_append_printf(str, "%s\"%s\":",
+                    first ? "" : ",", renderers[i]->name);
+            srn_histogram_to_json(&stats[i], str);
+        } else {
+            g_string_append_printf(str, "\n  * %s: ", renderers[i]->name);
+            srn_histogram_to_string(&stats[i], str);
+        }
+        first = FALSE;
+    }
+    if (json) {
+        g_string_append_c(str, '}');
+    }
+}
+
+void srn_render_reset_stats(void){
+    for (int i = 0; i < MAX_RENDERER; i++){
+        srn_histogram_reset(&stats[i]);
+    }
+}
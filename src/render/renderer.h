@@ -23,6 +23,17 @@
 
 #include "core/core.h"
 
+/**
+ * @brief SrnRenderInput describes what a render module reads from SrnMessage.
+ */
+typedef enum {
+    /* Raw SrnMessage->content, the renderer must run before any renderer
+     * which takes SRN_RENDER_INPUT_MARKUP */
+    SRN_RENDER_INPUT_CONTENT,
+    /* SrnMessage->rendered_content produced by previous renderers */
+    SRN_RENDER_INPUT_MARKUP,
+} SrnRenderInput;
+
 /**
  * @brief SrnMessageRenderer defines a module context of a SrnMessgae rendering
  *module.
@@ -31,6 +42,7 @@ typedef struct _SrnMessageRenderer SrnMessageRenderer;
 
 struct _SrnMessageRenderer {
     const char *name;
+    SrnRenderInput input;
     void (*init) (void);
     SrnRet (*render) (SrnMessage *msg);
     void (*finalize) (void);
@@ -42,6 +42,7 @@ static SrnMarkupRenderer *markup_renderer;
   */
 SrnMessageRenderer url_renderer = {
     .name = "url",
+    .input = SRN_RENDER_INPUT_MARKUP,
     .init = init,
     .finalize = finalize,
     .render = render,
@@ -117,8 +118,7 @@ SrnRet render(SrnMessage *msg) {
         return RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
     }
     if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
+        srn_message_set_rendered_content(msg, rendered_content);
     }
 
     return SRN_OK;
@@ -33,20 +33,56 @@
 #include "sirc/sirc.h"
 #include "sirc_parse.h"
 #include "sirc_event_hdr.h"
+#include "io_stream.h"
+#include "sirc_connector.h"
 
 #include "srain.h"
 #include "log.h"
 #include "i18n.h"
 #include "utils.h"
+#include "trace.h"
+#include "histogram.h"
+#include "arena.h"
+
+/* Enough for most lines and their contexts, the arena grows itself if not */
+#define SIRC_ARENA_BLOCK_SIZE   4096
+
+/* Flood control like RFC 1459 section 8.10: every line sent adds
+ * SIRC_FLOOD_PENALTY to a penalty clock, queued lines are held while the clock
+ * is ahead of now by more than SIRC_FLOOD_BURST, so about 5 lines can be sent
+ * at once and then 1 line every 2 seconds. PONG and lines of connection
+ * registration add no penalty, so they never delay the lines after them */
+#define SIRC_FLOOD_PENALTY      (2 * G_USEC_PER_SEC)
+#define SIRC_FLOOD_BURST        (10 * G_USEC_PER_SEC)
 
 struct _SircSession {
     int bufptr;
     char buf[SIRC_BUF_LEN];
-    GSocketClient *client;
+    SircConnector *connector;
     GIOStream *stream;
     GCancellable *cancel;
     char *host;
     int port;
+    SrnArena *arena;    // Per-line allocations, reset after each line
+    guint64 line_start; // Monotonic time in ns when the first byte of
+                        // current line is received
+
+    /* Flood control */
+    GQueue *send_queue; // Lines waiting for being sent
+    guint send_timer;
+    gint64 penalty_time; // Monotonic time of penalty clock, in us
+    bool registered; // Whether RPL_WELCOME is received
+    GString *cork_buf;  // Data held by sirc_cork(), NULL if not corked
+
+    GHashTable *batches; // Reference tag -> open SircBatch
+
+    /* TLS */
+    GTlsClientConnection *tls_session; // Session state of last connection
+                                       // to host:port, without socket
+    GTlsCertificate *cert;  // Cached client certificate
+    char *cert_filename;    // File of cached client certificate
+
+    SircStats stats;
 
     SircEvents *events; // Event callbacks
     SircConfig *cfg;
@@ -57,6 +93,15 @@ struct _SircSession {
 };
 
 static void sirc_recv(SircSession *sirc);
+static bool sirc_can_send(SircSession *sirc);
+static bool sirc_has_penalty(SircSession *sirc, const char *data, size_t len);
+static void sirc_schedule_send(SircSession *sirc);
+static void sirc_clear_send_queue(SircSession *sirc);
+static gboolean on_send_timeout(gpointer user_data);
+
+static GTlsCertificate* sirc_get_certificate(SircSession *sirc, GError **err);
+static void sirc_clear_tls_cache(SircSession *sirc);
+static void sirc_save_tls_session(SircSession *sirc, GIOStream *stream);
 
 static void on_connect_ready(GObject *obj, GAsyncResult *result, gpointer user_data);
 static gboolean on_accept_certificate(GTlsClientConnection *conn,
@@ -64,6 +109,7 @@ static gboolean on_accept_certificate(GTlsClientConnection *conn,
 static void on_connect_fail(SircSession *sirc, const char *reason);
 static void on_connect_finish(SircSession *sirc, GIOStream *stream);
 static void on_disconnect_ready(GObject *obj, GAsyncResult *result, gpointer user_data);
+static void on_close_ready(GObject *obj, GAsyncResult *result, gpointer user_data);
 static void on_recv_ready(GObject *obj, GAsyncResult *res, gpointer user_data);
 static void on_disconnect(SircSession *sirc, const char *reason);
 
@@ -80,9 +126,12 @@ SircSession* sirc_new_session(SircEvents *events, SircConfig *cfg){
     sirc->msgid = 0;
     /* sirc->bufptr = 0; // via g_malloc0() */
     /* sirc->stream = NULL; // via g_malloc0() */
-    sirc->client = g_socket_client_new();
-    // g_socket_client_set_timeout(sirc->client, SERVER_PING_INTERVAL);
+    sirc->connector = sirc_connector_new();
     sirc->cancel = g_cancellable_new();
+    sirc->arena = srn_arena_new(SIRC_ARENA_BLOCK_SIZE);
+    sirc->send_queue = g_queue_new();
+    sirc->batches = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify)sirc_batch_free);
 
     return sirc;
 }
@@ -98,8 +147,13 @@ SircSession* sirc_new_session(SircEvents *events, SircConfig *cfg){
 void sirc_free_session(SircSession *sirc){
     g_return_if_fail(sirc);
 
-    g_object_unref(sirc->client);
+    sirc_connector_free(sirc->connector);
     g_object_unref(sirc->cancel);
+    srn_arena_free(sirc->arena);
+    sirc_clear_send_queue(sirc);
+    g_queue_free(sirc->send_queue);
+    g_hash_table_destroy(sirc->batches);
+    sirc_clear_tls_cache(sirc);
     str_assign(&sirc->host, NULL);
 
     g_free(sirc);
@@ -107,6 +161,8 @@ void sirc_free_session(SircSession *sirc){
 
 void sirc_set_config(SircSession *sirc, SircConfig *cfg){
     sirc->cfg = cfg;
+    // Certificate file may be changed or renewed
+    sirc_clear_tls_cache(sirc);
 }
 
 int sirc_get_msgid(SircSession *sirc) {
@@ -121,6 +177,12 @@ void sirc_set_msgid(SircSession *sirc, int msgid) {
     sirc->msgid = msgid;
 }
 
+const SircStats* sirc_get_stats(SircSession *sirc){
+    g_return_val_if_fail(sirc, NULL);
+
+    return &sirc->stats;
+}
+
 GIOStream* sirc_get_stream(SircSession *sirc){
     g_return_val_if_fail(sirc, NULL);
 
@@ -133,6 +195,26 @@ SircEvents *sirc_get_events(SircSession *sirc){
     return sirc->events;
 }
 
+/**
+ * @brief sirc_set_registered is called when RPL_WELCOME is received, lines
+ * sent after it are under flood control.
+ */
+void sirc_set_registered(SircSession *sirc){
+    g_return_if_fail(sirc);
+
+    sirc->registered = TRUE;
+}
+
+/**
+ * @brief sirc_get_batches returns open batches of session, keys are
+ * reference tags and values are SircBatch.
+ */
+GHashTable* sirc_get_batches(SircSession *sirc){
+    g_return_val_if_fail(sirc, NULL);
+
+    return sirc->batches;
+}
+
 void sirc_set_ctx(SircSession *sirc, void *ctx){
     g_return_if_fail(sirc);
 
@@ -154,13 +236,46 @@ void sirc_connect(SircSession *sirc, const char *host, int port){
 
     escaped_host = g_uri_escape_string(host, NULL, FALSE);
     g_cancellable_reset(sirc->cancel);
+    if (g_strcmp0(sirc->host, escaped_host) != 0 || sirc->port != port){
+        // TLS session can only be resumed with the same server
+        g_clear_object(&sirc->tls_session);
+    }
     str_assign(&sirc->host, escaped_host);
     sirc->port = port;
-    g_socket_client_connect_to_host_async (sirc->client, escaped_host,
-            port, sirc->cancel, on_connect_ready, sirc);
+    sirc_connector_connect_async(sirc->connector, host, port, sirc->cancel,
+            on_connect_ready, sirc);
     g_free(escaped_host);
 }
 
+/**
+ * @brief sirc_flush_dns_cache forgets addresses resolved by previous
+ * sirc_connect(), should be called when network is changed.
+ *
+ * @param sirc
+ */
+void sirc_flush_dns_cache(SircSession *sirc){
+    g_return_if_fail(sirc);
+
+    sirc_connector_flush_cache(sirc->connector);
+}
+
+/**
+ * @brief sirc_connect_stream uses an established stream as the connection of
+ * session, the "CONNECT" event is emitted as if the session is connected by
+ * sirc_connect(). It is useful for replaying recorded traffic.
+ *
+ * @param sirc
+ * @param stream The ownership is transferred to session
+ */
+void sirc_connect_stream(SircSession *sirc, GIOStream *stream){
+    g_return_if_fail(sirc);
+    g_return_if_fail(!sirc->stream);
+    g_return_if_fail(G_IS_IO_STREAM(stream));
+
+    g_cancellable_reset(sirc->cancel);
+    on_connect_finish(sirc, stream);
+}
+
 void sirc_cancel_connect(SircSession *sirc){
     g_return_if_fail(sirc);
     g_return_if_fail(!g_cancellable_is_cancelled(sirc->cancel));
@@ -175,6 +290,255 @@ void sirc_disconnect(SircSession *sirc){
     g_io_stream_close_async(sirc->stream, 0, NULL, on_disconnect_ready, sirc);
 }
 
+/**
+ * @brief sirc_send sends raw data to server.
+ *
+ * @param sirc
+ * @param data
+ * @param len
+ *
+ * @return SRN_OK if all data are written
+ */
+int sirc_send(SircSession *sirc, const char *data, size_t len){
+    int ret;
+
+    g_return_val_if_fail(sirc, SRN_ERR);
+    g_return_val_if_fail(G_IS_IO_STREAM(sirc->stream), SRN_ERR);
+
+    if (sirc->cork_buf){
+        g_string_append_len(sirc->cork_buf, data, len);
+    } else {
+        ret = io_stream_write(sirc->stream, data, len);
+        if (ret < 0){
+            return SRN_ERR;
+        }
+        sirc->stats.bytes_out += ret;
+    }
+    sirc->stats.lines_out++;
+
+    // Lines sent directly are counted too, so queued lines wait for them
+    if (sirc_has_penalty(sirc, data, len)){
+        sirc->penalty_time = MAX(sirc->penalty_time, g_get_monotonic_time())
+            + SIRC_FLOOD_PENALTY;
+    }
+
+    return SRN_OK;
+}
+
+/**
+ * @brief sirc_cork holds data passed to sirc_send() until sirc_uncork() is
+ * called, so that several commands can be sent to server in one write, for
+ * example, pipelining commands of connection registration.
+ *
+ * @param sirc
+ */
+void sirc_cork(SircSession *sirc){
+    g_return_if_fail(sirc);
+    g_return_if_fail(!sirc->cork_buf);
+
+    sirc->cork_buf = g_string_new(NULL);
+}
+
+/**
+ * @brief sirc_uncork sends all data held since sirc_cork().
+ *
+ * @param sirc
+ *
+ * @return SRN_OK if all data are written
+ */
+int sirc_uncork(SircSession *sirc){
+    int ret;
+    GString *buf;
+
+    g_return_val_if_fail(sirc, SRN_ERR);
+    g_return_val_if_fail(sirc->cork_buf, SRN_ERR);
+
+    buf = sirc->cork_buf;
+    sirc->cork_buf = NULL;
+
+    ret = SRN_OK;
+    if (buf->len > 0){
+        if (G_IS_IO_STREAM(sirc->stream)
+                && io_stream_write(sirc->stream, buf->str, buf->len) >= 0){
+            sirc->stats.bytes_out += buf->len;
+        } else {
+            ret = SRN_ERR;
+        }
+    }
+    g_string_free(buf, TRUE);
+
+    return ret;
+}
+
+/**
+ * @brief sirc_send_queued sends raw data to server with flood control, it
+ * should be used for bulk commands which can be delayed, such as joining
+ * lots of channels. Lines are sent in order, and they are dropped when
+ * disconnected.
+ *
+ * @param sirc
+ * @param data A complete line, including the trailing CRLF
+ * @param len
+ *
+ * @return SRN_OK if data is sent or queued
+ */
+int sirc_send_queued(SircSession *sirc, const char *data, size_t len){
+    g_return_val_if_fail(sirc, SRN_ERR);
+    g_return_val_if_fail(G_IS_IO_STREAM(sirc->stream), SRN_ERR);
+
+    if (g_queue_is_empty(sirc->send_queue) && sirc_can_send(sirc)){
+        return sirc_send(sirc, data, len);
+    }
+
+    g_queue_push_tail(sirc->send_queue, g_strndup(data, len));
+    sirc_schedule_send(sirc);
+
+    return SRN_OK;
+}
+
+/**
+ * @brief sirc_get_send_queue_length returns number of lines held by flood
+ * control.
+ */
+guint sirc_get_send_queue_length(SircSession *sirc){
+    return g_queue_get_length(sirc->send_queue);
+}
+
+static bool sirc_can_send(SircSession *sirc){
+    return sirc->penalty_time - g_get_monotonic_time() < SIRC_FLOOD_BURST;
+}
+
+/**
+ * @brief sirc_has_penalty returns whether sending a line adds penalty.
+ * Replying PING must not wait, and lines before registration are pipelined
+ * in a burst, see irc_event_connect().
+ */
+static bool sirc_has_penalty(SircSession *sirc, const char *data, size_t len){
+    if (!sirc->registered){
+        return FALSE;
+    }
+    if (len >= strlen("PONG ")
+            && g_ascii_strncasecmp(data, "PONG ", strlen("PONG ")) == 0){
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void sirc_schedule_send(SircSession *sirc){
+    gint64 delay;
+
+    if (sirc->send_timer){
+        return;
+    }
+
+    delay = sirc->penalty_time - SIRC_FLOOD_BURST - g_get_monotonic_time();
+    sirc->send_timer = g_timeout_add(MAX(delay / 1000, 0) + 1,
+            on_send_timeout, sirc);
+}
+
+static void sirc_clear_send_queue(SircSession *sirc){
+    if (sirc->send_timer){
+        g_source_remove(sirc->send_timer);
+        sirc->send_timer = 0;
+    }
+    g_queue_foreach(sirc->send_queue, (GFunc)g_free, NULL);
+    g_queue_clear(sirc->send_queue);
+}
+
+static gboolean on_send_timeout(gpointer user_data){
+    SircSession *sirc;
+
+    sirc = user_data;
+    sirc->send_timer = 0;
+
+    while (!g_queue_is_empty(sirc->send_queue) && sirc_can_send(sirc)){
+        char *line;
+
+        line = g_queue_pop_head(sirc->send_queue);
+        sirc_send(sirc, line, strlen(line));
+        g_free(line);
+    }
+    if (!g_queue_is_empty(sirc->send_queue)){
+        sirc_schedule_send(sirc);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief sirc_get_certificate returns the client certificate specified by
+ * config, it is loaded from disk only once.
+ *
+ * @param sirc
+ * @param err
+ *
+ * @return A GTlsCertificate owned by session
+ */
+static GTlsCertificate* sirc_get_certificate(SircSession *sirc, GError **err){
+    const char *filename;
+
+    filename = sirc->cfg->certificate_filename;
+    if (sirc->cert && g_strcmp0(sirc->cert_filename, filename) == 0){
+        return sirc->cert;
+    }
+
+    g_clear_object(&sirc->cert);
+    str_assign(&sirc->cert_filename, NULL);
+
+    sirc->cert = g_tls_certificate_new_from_file(filename, err);
+    if (sirc->cert){
+        str_assign(&sirc->cert_filename, filename);
+    }
+
+    return sirc->cert;
+}
+
+static void sirc_clear_tls_cache(SircSession *sirc){
+    g_clear_object(&sirc->tls_session);
+    g_clear_object(&sirc->cert);
+    str_assign(&sirc->cert_filename, NULL);
+}
+
+/**
+ * @brief sirc_save_tls_session keeps the session state of a TLS connection
+ * for resuming it when reconnecting. The state is copied to a connection
+ * over an in-memory stream, so the connection and its socket can be closed.
+ * It is copied when disconnecting rather than after handshake, so session
+ * tickets sent by TLS 1.3 server are included.
+ */
+static void sirc_save_tls_session(SircSession *sirc, GIOStream *stream){
+#if GLIB_CHECK_VERSION(2, 46, 0)
+    GInputStream *in;
+    GOutputStream *out;
+    GIOStream *base;
+    GIOStream *holder;
+
+    if (!G_IS_TLS_CLIENT_CONNECTION(stream)){
+        return;
+    }
+
+    in = g_memory_input_stream_new();
+    out = g_memory_output_stream_new_resizable();
+    base = g_simple_io_stream_new(in, out);
+    holder = g_tls_client_connection_new(base,
+            g_tls_client_connection_get_server_identity(
+                G_TLS_CLIENT_CONNECTION(stream)),
+            NULL);
+    g_object_unref(base);
+    g_object_unref(out);
+    g_object_unref(in);
+    if (!holder){
+        return;
+    }
+
+    g_tls_client_connection_copy_session_state(
+            G_TLS_CLIENT_CONNECTION(holder), G_TLS_CLIENT_CONNECTION(stream));
+    g_clear_object(&sirc->tls_session);
+    sirc->tls_session = G_TLS_CLIENT_CONNECTION(holder);
+#endif
+}
+
 static void sirc_recv(SircSession *sirc){
     GInputStream *in;
 
@@ -185,6 +549,8 @@ static void sirc_recv(SircSession *sirc){
 
 static void on_recv_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
     int size;
+    guint64 start;
+    guint64 parsed;
     GInputStream *in;
     GError *err;
     SircSession *sirc;
@@ -210,9 +576,14 @@ static void on_recv_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
         return;
     }
 
+    sirc->stats.bytes_in += size;
+    if (sirc->bufptr == 0){
+        sirc->line_start = srn_get_monotonic_ns();
+    }
     sirc->bufptr++;
     if (sirc->bufptr > sizeof(sirc->buf)){
         WARN_FR("Length of the line exceeds the buffer");
+        sirc->stats.parse_failures++;
         goto FIN;
     }
 
@@ -229,21 +600,38 @@ static void on_recv_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
     sirc->buf[sirc->bufptr] = '\0';
 
     DBG_FR("Line: %s", sirc->buf);
-
-    imsg = sirc_parse(sirc->buf);
+    sirc->stats.lines_in++;
+
+    start = srn_get_monotonic_ns();
+    // Receiving and splitting the line, including waiting for the rest of
+    // it when it comes in more than one packet
+    SRN_TRACE_RECORD("sirc_recv_line", sirc->line_start, start);
+    SRN_TRACE_BEGIN(parse);
+    imsg = sirc_parse(sirc->buf, sirc->arena);
+    SRN_TRACE_END(parse, "sirc_parse");
     if (!imsg){
         ERR_FR("Failed to parse line: %s", sirc->buf);
+        sirc->stats.parse_failures++;
         goto FIN;
     }
 
     /* Transcoding */
+    SRN_TRACE_BEGIN(transcoding);
     sirc_message_transcoding(imsg, sirc->cfg->encoding);
+    SRN_TRACE_END(transcoding, "sirc_message_transcoding");
+    parsed = srn_get_monotonic_ns();
+    sirc->stats.parse_ns += parsed - start;
     /* Handle event */
+    SRN_TRACE_BEGIN(hdr);
     sirc_event_hdr(sirc, imsg);
-
-    sirc_message_free(imsg);
+    SRN_TRACE_END(hdr, "sirc_event_hdr");
+    sirc->stats.dispatch_ns += srn_get_monotonic_ns() - parsed;
 
 FIN:
+    /* Everything of the line goes away, including the message. It is safe
+     * even if a handler iterates main loop, as the next read is not issued
+     * until now */
+    srn_arena_reset(sirc->arena);
     /* Clear buffer */
     sirc->bufptr = 0;
     memset(sirc->buf, 0, sizeof(sirc->buf));
@@ -286,25 +674,27 @@ static void on_handshake_ready(GObject *obj, GAsyncResult *res, gpointer user_da
     g_tls_connection_handshake_finish(tls_conn, res, &err);
     if (err){
         g_object_unref(tls_conn);
+        // Do not resume a session which may be rejected
+        g_clear_object(&sirc->tls_session);
         on_connect_fail(sirc, err->message);
         g_error_free(err);
         return;
     }
     LOG_FR("TLS handshake successed");
 
+    // Session of this connection is saved when disconnecting, see
+    // sirc_save_tls_session()
     on_connect_finish(sirc, G_IO_STREAM(tls_conn));
 }
 
 static void on_connect_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
     GError *err;
-    GSocketClient *client;
     GSocketConnection *conn;
     SircSession *sirc;
 
-    client = G_SOCKET_CLIENT(obj);
     sirc = user_data;
     err = NULL;
-    conn = g_socket_client_connect_finish(client, res, &err);
+    conn = sirc_connector_connect_finish(sirc->connector, res, &err);
     if (err){
         on_connect_fail(sirc, err->message);
         g_error_free(err);
@@ -337,11 +727,24 @@ static void on_connect_ready(GObject *obj, GAsyncResult *res, gpointer user_data
          g_signal_connect(tls_conn, "accept-certificate",
                  G_CALLBACK(on_accept_certificate), NULL);
 
+#if GLIB_CHECK_VERSION(2, 46, 0)
+         /* Resume session of last connection, an abbreviated handshake
+          * saves a round trip. TLS backend falls back to full handshake if
+          * server refuses */
+         if (sirc->tls_session){
+             g_tls_client_connection_copy_session_state(
+                     G_TLS_CLIENT_CONNECTION(tls_conn), sirc->tls_session);
+             DBG_FR("Resuming TLS session");
+         }
+#endif
+
          /* Set client certificate for authentication with SASL EXTERNAL */
-         const char *cert_filename = sirc->cfg->certificate_filename;
-         if (cert_filename) {
-             g_autoptr(GTlsCertificate) cert = g_tls_certificate_new_from_file(cert_filename, &err);
+         if (sirc->cfg->certificate_filename) {
+             GTlsCertificate *cert;
+
+             cert = sirc_get_certificate(sirc, &err);
              if (err){
+                 g_object_unref(tls_conn);
                  on_connect_fail(sirc, err->message);
                  g_error_free(err);
                  return;
@@ -370,11 +773,21 @@ static void on_disconnect_ready(GObject *obj, GAsyncResult *result, gpointer use
     g_io_stream_close_finish(stream, result, &err);
 }
 
+static void on_close_ready(GObject *obj, GAsyncResult *result, gpointer user_data){
+    GIOStream *stream;
+
+    stream = G_IO_STREAM(obj);
+    // Nothing can be done if it fails, the socket is released anyway
+    g_io_stream_close_finish(stream, result, NULL);
+    g_object_unref(stream);
+}
+
 static void on_connect_finish(SircSession *sirc, GIOStream *stream){
     LOG_FR("Connected");
     g_autoptr(SircMessageContext) context = sirc_message_context_new(NULL);
 
     sirc->stream = stream;
+    sirc->registered = FALSE;
     sirc_recv(sirc);
 
     if (!sirc->events->connect) {
@@ -401,8 +814,19 @@ static void on_disconnect(SircSession *sirc, const char *reason){
 
     LOG_FR("Disconnected: %s", reason);
 
-    g_object_unref(sirc->stream);
+    sirc_save_tls_session(sirc, sirc->stream);
+    // Release the socket now rather than when the stream is finalized
+    if (!g_io_stream_is_closed(sirc->stream)
+            && !g_io_stream_has_pending(sirc->stream)){
+        g_io_stream_close_async(sirc->stream, 0, NULL,
+                on_close_ready, NULL);
+    } else {
+        g_object_unref(sirc->stream);
+    }
     sirc->stream = NULL;
+    sirc_clear_send_queue(sirc);
+    // Unfinished batches are dropped
+    g_hash_table_remove_all(sirc->batches);
 
     if (!sirc->events->disconnect) {
         g_return_if_fail(0);
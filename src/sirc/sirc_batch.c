@@ -0,0 +1,336 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file sirc_batch.c
+ * @brief IRCv3 batch
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-29
+ *
+ * Messages of a buffered batch are held until the batch ends, then they are
+ * delivered to SircEvents->batch as a whole, so that a netsplit of hundreds
+ * of QUITs can be handled once, and a page of chat history can be told from
+ * live messages. Messages of other batches are dispatched as
+ * usual when they arrive.
+ *
+ * A buffered batch holds at most SIRC_BATCH_MAX_MESSAGES messages for at
+ * most SIRC_BATCH_MAX_AGE, so a server never ending a batch can not make us
+ * buffer without limit. Beyond that, messages of a "chathistory" batch are
+ * dropped as they are only for displaying, messages of other batches are
+ * flushed and then dispatched as usual, see sirc_batch_event_hdr().
+ *
+ * A session keeps at most SIRC_BATCH_MAX_OPEN open batches, the one started
+ * first is closed to open another one.
+ */
+
+#include <glib.h>
+
+#include "sirc/sirc.h"
+#include "sirc_parse.h"
+
+#include "srain.h"
+
+#define SIRC_BATCH_MAX_MESSAGES 4096
+#define SIRC_BATCH_MAX_AGE      (60 * G_USEC_PER_SEC)
+#define SIRC_BATCH_MAX_OPEN     64
+
+struct _SircBatch {
+    char *ref;
+    char *type;
+    char *parent_ref;   // Reference of outer batch, NULL if not nested
+    bool buffered;
+    bool droppable;     // Whether messages beyond limit can be dropped
+    gint64 start_time;  // Monotonic time when batch starts
+    GPtrArray *params;  // Parameters after type, NULL-terminated
+    GPtrArray *msgs;    // SircMessage on heap
+    GPtrArray *contexts; // SircMessageContext of every message
+};
+
+/* Types of batches which are buffered and delivered as a whole */
+static const char *buffered_types[] = {
+    "netsplit",
+    "netjoin",
+    "chathistory",
+    NULL,
+};
+
+/* Types of buffered batches whose messages are dropped beyond limit */
+static const char *droppable_types[] = {
+    "chathistory",
+    NULL,
+};
+
+/**
+ * @brief sirc_batch_new creates a batch.
+ *
+ * @param ref Reference tag, without the leading '+'
+ * @param type
+ * @param params Parameters after type
+ * @param count
+ * @param parent The batch which encloses this one, can be NULL
+ *
+ * @return A SircBatch, should be freed by sirc_batch_free()
+ */
+SircBatch* sirc_batch_new(const char *ref, const char *type,
+        const char **params, int count, const SircBatch *parent){
+    SircBatch *batch;
+
+    batch = g_malloc0(sizeof(SircBatch));
+    batch->ref = g_strdup(ref);
+    batch->type = g_strdup(type);
+    batch->params = g_ptr_array_new_with_free_func(g_free);
+    for (int i = 0; i < count; i++){
+        g_ptr_array_add(batch->params, g_strdup(params[i]));
+    }
+    g_ptr_array_add(batch->params, NULL);
+    batch->msgs = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)sirc_message_free);
+    batch->contexts = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)sirc_message_context_free);
+    batch->start_time = g_get_monotonic_time();
+
+    if (parent){
+        batch->parent_ref = g_strdup(parent->ref);
+        // Nested batch goes with its parent
+        batch->buffered = parent->buffered;
+        batch->droppable = parent->droppable;
+    } else {
+        for (int i = 0; buffered_types[i]; i++){
+            if (g_ascii_strcasecmp(buffered_types[i], type) == 0){
+                batch->buffered = TRUE;
+                break;
+            }
+        }
+        for (int i = 0; droppable_types[i]; i++){
+            if (g_ascii_strcasecmp(droppable_types[i], type) == 0){
+                batch->droppable = TRUE;
+                break;
+            }
+        }
+    }
+
+    return batch;
+}
+
+void sirc_batch_free(SircBatch *batch){
+    g_free(batch->ref);
+    g_free(batch->type);
+    g_free(batch->parent_ref);
+    g_ptr_array_free(batch->params, TRUE);
+    g_ptr_array_free(batch->msgs, TRUE);
+    g_ptr_array_free(batch->contexts, TRUE);
+    g_free(batch);
+}
+
+const char* sirc_batch_get_ref(const SircBatch *batch){
+    return batch->ref;
+}
+
+const char* sirc_batch_get_parent_ref(const SircBatch *batch){
+    return batch->parent_ref;
+}
+
+bool sirc_batch_is_buffered(const SircBatch *batch){
+    return batch->buffered;
+}
+
+bool sirc_batch_is_droppable(const SircBatch *batch){
+    return batch->droppable;
+}
+
+/**
+ * @brief sirc_batch_is_full returns whether batch has buffered as many
+ * messages or as long as allowed.
+ */
+bool sirc_batch_is_full(const SircBatch *batch){
+    return batch->msgs->len >= SIRC_BATCH_MAX_MESSAGES
+        || g_get_monotonic_time() - batch->start_time > SIRC_BATCH_MAX_AGE;
+}
+
+/**
+ * @brief sirc_batch_can_merge returns whether all messages of a nested
+ * batch can be merged into its parent within limit.
+ */
+bool sirc_batch_can_merge(const SircBatch *parent, const SircBatch *batch){
+    return parent->msgs->len + batch->msgs->len <= SIRC_BATCH_MAX_MESSAGES;
+}
+
+/**
+ * @brief sirc_batch_lookup_oldest returns the open batch which starts first
+ * if there are as many open batches as allowed, otherwise NULL.
+ *
+ * @param batches Open batches of session, see sirc_get_batches()
+ */
+SircBatch* sirc_batch_lookup_oldest(GHashTable *batches){
+    GHashTableIter iter;
+    SircBatch *batch;
+    SircBatch *oldest;
+
+    if (g_hash_table_size(batches) < SIRC_BATCH_MAX_OPEN){
+        return NULL;
+    }
+
+    oldest = NULL;
+    g_hash_table_iter_init(&iter, batches);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&batch)){
+        if (!oldest || batch->start_time < oldest->start_time){
+            oldest = batch;
+        }
+    }
+
+    return oldest;
+}
+
+/**
+ * @brief sirc_batch_unbuffer drops all messages of batch and stops
+ * buffering, messages should have been dispatched by caller unless they
+ * can be dropped.
+ */
+void sirc_batch_unbuffer(SircBatch *batch){
+    batch->buffered = FALSE;
+    g_ptr_array_set_size(batch->msgs, 0);
+    g_ptr_array_set_size(batch->contexts, 0);
+}
+
+/**
+ * @brief sirc_batch_add_message appends a copy of message to batch, along
+ * with a context which keeps its own "time" and "msgid" tags and source.
+ */
+void sirc_batch_add_message(SircBatch *batch, const SircMessage *imsg){
+    SircMessageContext *context;
+
+    context = sirc_message_context_new_with_tags(
+            sirc_message_get_tag(imsg, "time"),
+            sirc_message_get_tag(imsg, "msgid"));
+    sirc_message_context_set_source(context, imsg->user, imsg->host);
+
+    g_ptr_array_add(batch->msgs, sirc_message_dup(imsg));
+    g_ptr_array_add(batch->contexts, context);
+}
+
+/**
+ * @brief sirc_batch_merge moves all messages of a nested batch to its parent.
+ * Messages beyond limit of parent are dropped, a parent whose messages can
+ * not be dropped should be flushed before if !sirc_batch_can_merge().
+ */
+void sirc_batch_merge(SircBatch *parent, SircBatch *batch){
+    guint len;
+
+    len = MIN(batch->msgs->len, SIRC_BATCH_MAX_MESSAGES
+            - MIN(parent->msgs->len, SIRC_BATCH_MAX_MESSAGES));
+    for (guint i = 0; i < len; i++){
+        g_ptr_array_add(parent->msgs, batch->msgs->pdata[i]);
+        g_ptr_array_add(parent->contexts, batch->contexts->pdata[i]);
+    }
+    // Merged messages are owned by parent now, the rest are freed
+    g_ptr_array_remove_range(batch->msgs, len, batch->msgs->len - len);
+    g_ptr_array_remove_range(batch->contexts, len, batch->contexts->len - len);
+    g_ptr_array_set_free_func(batch->msgs, NULL);
+    g_ptr_array_set_size(batch->msgs, 0);
+    g_ptr_array_set_free_func(batch->msgs, (GDestroyNotify)sirc_message_free);
+    g_ptr_array_set_free_func(batch->contexts, NULL);
+    g_ptr_array_set_size(batch->contexts, 0);
+    g_ptr_array_set_free_func(batch->contexts,
+            (GDestroyNotify)sirc_message_context_free);
+}
+
+SircMessage* sirc_batch_get_message(const SircBatch *batch, int i){
+    g_return_val_if_fail(i >= 0 && i < batch->msgs->len, NULL);
+
+    return batch->msgs->pdata[i];
+}
+
+const char* sirc_batch_get_type(const SircBatch *batch){
+    g_return_val_if_fail(batch, NULL);
+
+    return batch->type;
+}
+
+/**
+ * @brief sirc_batch_get_length returns number of messages in batch.
+ */
+int sirc_batch_get_length(const SircBatch *batch){
+    g_return_val_if_fail(batch, 0);
+
+    return batch->msgs->len;
+}
+
+const char* sirc_batch_get_command(const SircBatch *batch, int i){
+    SircMessage *imsg;
+
+    imsg = sirc_batch_get_message(batch, i);
+    g_return_val_if_fail(imsg, NULL);
+
+    return imsg->cmd;
+}
+
+/**
+ * @brief sirc_batch_get_origin returns nick or servername of the i-th
+ * message.
+ */
+const char* sirc_batch_get_origin(const SircBatch *batch, int i){
+    SircMessage *imsg;
+
+    imsg = sirc_batch_get_message(batch, i);
+    g_return_val_if_fail(imsg, NULL);
+
+    return imsg->nick ? imsg->nick : imsg->prefix;
+}
+
+/**
+ * @brief sirc_batch_get_params returns parameters of the i-th message.
+ *
+ * @param batch
+ * @param i
+ * @param count Returns number of parameters
+ *
+ * @return Parameters owned by batch
+ */
+const char** sirc_batch_get_params(const SircBatch *batch, int i, int *count){
+    SircMessage *imsg;
+
+    imsg = sirc_batch_get_message(batch, i);
+    g_return_val_if_fail(imsg, NULL);
+
+    *count = imsg->nparam;
+
+    return (const char **)imsg->params;
+}
+
+/**
+ * @brief sirc_batch_get_context returns context of the i-th message, which
+ * carries its own time and msgid.
+ */
+const SircMessageContext* sirc_batch_get_context(const SircBatch *batch,
+        int i){
+    g_return_val_if_fail(batch, NULL);
+    g_return_val_if_fail(i >= 0 && i < batch->contexts->len, NULL);
+
+    return batch->contexts->pdata[i];
+}
+
+/**
+ * @brief sirc_batch_get_batch_params returns parameters after type of
+ * "BATCH +ref type", it is NULL-terminated.
+ */
+const char** sirc_batch_get_batch_params(const SircBatch *batch, int *count){
+    *count = batch->params->len - 1;
+
+    return (const char **)batch->params->pdata;
+}
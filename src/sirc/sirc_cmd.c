@@ -33,13 +33,18 @@
 #include <string.h>
 
 #include "sirc/sirc.h"
-#include "io_stream.h"
 #include "sirc_cmd_builder.h"
 
 #include "srain.h"
 #include "log.h"
 #include "utils.h"
 
+static bool join_key_is_packable(const char *passwd);
+static bool join_fits(GString *chan_param, GString *key_param,
+        const char *chan, const char *passwd);
+static int join_flush(SircSession *sirc, GString *chan_param,
+        GString *key_param);
+
 int sirc_cmd_ping(SircSession *sirc, const char *data){
     g_return_val_if_fail(!str_is_empty(data), SRN_ERR);
 
@@ -75,6 +80,78 @@ int sirc_cmd_join(SircSession *sirc, const char *chan, const char *passwd){
     }
 }
 
+/**
+ * @brief sirc_cmd_join_all joins lots of channels at once, channels are
+ * packed into as few JOIN commands as possible and sent with flood control.
+ *
+ * @param sirc
+ * @param chans
+ * @param passwds Keys of channels, can be NULL, or an array of which element
+ *      can be NULL if the corresponding channel has no key
+ * @param count Number of channels
+ *
+ * @return SRN_OK if all commands are sent or queued
+ */
+int sirc_cmd_join_all(SircSession *sirc, const char **chans,
+        const char **passwds, int count){
+    int ret;
+    GString *chan_param;
+    GString *key_param;
+
+    g_return_val_if_fail(chans, SRN_ERR);
+
+    ret = SRN_OK;
+    chan_param = g_string_new(NULL);
+    key_param = g_string_new(NULL);
+
+    // Keys are matched with channels by position, so channels with key go
+    // first in both passes
+    for (int keyed = 1; keyed >= 0; keyed--){
+        for (int i = 0; i < count; i++){
+            const char *passwd;
+
+            passwd = passwds && !str_is_empty(passwds[i]) ? passwds[i] : NULL;
+            if (str_is_empty(chans[i]) || (passwd != NULL) != keyed){
+                continue;
+            }
+            if (passwd && !join_key_is_packable(passwd)){
+                // Can only be sent as a trailing param
+                char *cmd;
+
+                cmd = g_strdup_printf("JOIN %s :%s\r\n", chans[i], passwd);
+                if (!RET_IS_OK(sirc_send_queued(sirc, cmd, strlen(cmd)))){
+                    ret = SRN_ERR;
+                }
+                g_free(cmd);
+                continue;
+            }
+            if (!join_fits(chan_param, key_param, chans[i], passwd)){
+                if (!RET_IS_OK(join_flush(sirc, chan_param, key_param))){
+                    ret = SRN_ERR;
+                }
+            }
+            if (chan_param->len){
+                g_string_append_c(chan_param, ',');
+            }
+            g_string_append(chan_param, chans[i]);
+            if (passwd){
+                if (key_param->len){
+                    g_string_append_c(key_param, ',');
+                }
+                g_string_append(key_param, passwd);
+            }
+        }
+    }
+    if (!RET_IS_OK(join_flush(sirc, chan_param, key_param))){
+        ret = SRN_ERR;
+    }
+
+    g_string_free(chan_param, TRUE);
+    g_string_free(key_param, TRUE);
+
+    return ret;
+}
+
 // sirc_cmd_part: For leaving a chan
 int sirc_cmd_part(SircSession *sirc, const char *chan, const char *reason){
     g_return_val_if_fail(!str_is_empty(chan), SRN_ERR);
@@ -278,6 +355,50 @@ int sirc_cmd_away(SircSession *sirc, const char *msg){
     }
 }
 
+/**
+ * @brief sirc_cmd_chathistory requests history of target, see
+ * https://ircv3.net/specs/extensions/chathistory
+ *
+ * @param sirc
+ * @param subcmd Such as "BEFORE", "LATEST"
+ * @param target
+ * @param ref Message reference like "msgid=xxx", "timestamp=xxx" or "*"
+ * @param limit Maximum number of messages
+ *
+ * @return SRN_OK if sent
+ */
+int sirc_cmd_chathistory(SircSession *sirc, const char *subcmd,
+        const char *target, const char *ref, int limit){
+    g_return_val_if_fail(!str_is_empty(subcmd), SRN_ERR);
+    g_return_val_if_fail(!str_is_empty(target), SRN_ERR);
+    g_return_val_if_fail(!str_is_empty(ref), SRN_ERR);
+    g_return_val_if_fail(limit > 0, SRN_ERR);
+
+    return sirc_cmd_raw(sirc, "CHATHISTORY %s %s %s %d\r\n",
+            subcmd, target, ref, limit);
+}
+
+/**
+ * @brief sirc_cmd_monitor manages the list of nicks whose presence is
+ * notified by server, see https://ircv3.net/specs/core/monitor-3.2
+ *
+ * @param sirc
+ * @param op "+" or "-" to add or remove targets; "C", "L" or "S" to clear,
+ *      list or show status of the list
+ * @param targets Comma-separated nicks, required by "+" and "-"
+ *
+ * @return SRN_OK if sent
+ */
+int sirc_cmd_monitor(SircSession *sirc, const char *op, const char *targets){
+    g_return_val_if_fail(!str_is_empty(op), SRN_ERR);
+
+    if (targets) {
+        return sirc_cmd_raw(sirc, "MONITOR %s %s\r\n", op, targets);
+    } else {
+        return sirc_cmd_raw(sirc, "MONITOR %s\r\n", op);
+    }
+}
+
 int sirc_get_msgid(SircSession *sirc);
 void sirc_set_msgid(SircSession *sirc, int msgid);
 
@@ -286,12 +407,9 @@ int sirc_cmd_raw(SircSession *sirc, const char *fmt, ...){
     int len = 0;
     int msgid = sirc_get_msgid(sirc);
     va_list args;
-    GIOStream *stream;
 
     g_return_val_if_fail(sirc, SRN_ERR);
     g_return_val_if_fail(fmt, SRN_ERR);
-    stream = sirc_get_stream(sirc);
-    g_return_val_if_fail(G_IS_IO_STREAM(stream), SRN_ERR);
 
     if (strlen(fmt) != 0){
         va_start(args, fmt);
@@ -308,6 +426,80 @@ int sirc_cmd_raw(SircSession *sirc, const char *fmt, ...){
     // TODO send it totally
     msgid++;
     sirc_set_msgid(sirc, msgid);
-    return (io_stream_write(stream, buf, len) < 0) ?
-        SRN_ERR : SRN_OK;
+    return sirc_send(sirc, buf, len);
+}
+
+/**
+ * @brief join_key_is_packable checks whether a channel key can be packed into
+ * a comma-separated middle param.
+ */
+static bool join_key_is_packable(const char *passwd){
+    return passwd[0] != ':' && !strpbrk(passwd, " ,");
+}
+
+/**
+ * @brief join_fits checks whether a JOIN command is still in length limit
+ * after a channel and its key are added.
+ */
+static bool join_fits(GString *chan_param, GString *key_param,
+        const char *chan, const char *passwd){
+    bool fits;
+    char *chans;
+    char *keys;
+    SircCommandBuilder *builder;
+
+    if (!chan_param->len){
+        return TRUE;
+    }
+
+    chans = g_strconcat(chan_param->str, ",", chan, NULL);
+    if (!passwd){
+        keys = g_strdup(key_param->str);
+    } else if (key_param->len){
+        keys = g_strconcat(key_param->str, ",", passwd, NULL);
+    } else {
+        keys = g_strdup(passwd);
+    }
+
+    builder = sirc_command_builder_new("JOIN");
+    fits = sirc_command_builder_add_middle(builder, chans)
+        && (!*keys || sirc_command_builder_add_middle(builder, keys));
+    sirc_command_builder_free(builder);
+
+    g_free(chans);
+    g_free(keys);
+
+    return fits;
+}
+
+/**
+ * @brief join_flush sends a JOIN command of packed channels and keys, then
+ * clears them.
+ */
+static int join_flush(SircSession *sirc, GString *chan_param,
+        GString *key_param){
+    int ret;
+    char *cmd;
+    SircCommandBuilder *builder;
+
+    if (!chan_param->len){
+        return SRN_OK;
+    }
+
+    builder = sirc_command_builder_new("JOIN");
+    sirc_command_builder_add_middle(builder, chan_param->str);
+    if (key_param->len){
+        sirc_command_builder_add_middle(builder, key_param->str);
+    }
+    cmd = sirc_command_builder_build(builder);
+    sirc_command_builder_free(builder);
+
+    DBG_FR("Send queued: %s", cmd);
+    ret = sirc_send_queued(sirc, cmd, strlen(cmd));
+    g_free(cmd);
+
+    g_string_truncate(chan_param, 0);
+    g_string_truncate(key_param, 0);
+
+    return ret;
 }
@@ -0,0 +1,516 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file sirc_connector.c
+ * @brief Dual-stack TCP connector
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-28
+ *
+ * Connection attempts follow RFC 8305 (Happy Eyeballs Version 2): resolved
+ * addresses are interleaved by address family, the next address is attempted
+ * when the previous attempt fails or does not succeed within
+ * SIRC_CONNECT_ATTEMPT_DELAY, the first established connection wins and the
+ * others are cancelled. So an unreachable IPv6 route costs 250ms rather than
+ * a full TCP timeout.
+ *
+ * Resolved addresses are cached for SIRC_DNS_CACHE_TTL so reconnecting does
+ * not wait for DNS, the address which was connected is moved to the front.
+ * The cache is dropped when no address can be connected.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "sirc_connector.h"
+
+#include "srain.h"
+#include "log.h"
+#include "i18n.h"
+
+#define SIRC_CONNECT_ATTEMPT_DELAY      250         // ms, see RFC 8305 section 5
+#define SIRC_CONNECT_ATTEMPT_TIMEOUT    (10 * 1000) // ms
+#define SIRC_DNS_CACHE_TTL              (10 * 60 * G_USEC_PER_SEC)
+
+struct _SircConnector {
+    GSocketClient *client;
+
+    /* DNS cache */
+    char *host;
+    GList *addrs;           // List of GInetAddress
+    gint64 resolved_time;   // Monotonic time of resolving, in us
+};
+
+/* A connect operation, which races connection attempts to all addresses */
+typedef struct _ConnectRace {
+    int refcount;           // Held by the operation and every attempt
+    bool done;              // Result has been returned
+    SircConnector *connector; // Only valid when !done
+    GTask *task;
+    char *host;
+    int port;
+    GList *addrs;           // GInetAddress not attempted yet
+    GList *attempts;        // In-flight ConnectAttempt
+    guint delay_timer;
+    gulong cancel_id;
+    GError *err;            // Error of the last failed attempt
+} ConnectRace;
+
+typedef struct _ConnectAttempt {
+    ConnectRace *race;
+    GInetAddress *addr;
+    GCancellable *cancel;
+    guint timeout_timer;
+    bool timed_out;
+} ConnectAttempt;
+
+static ConnectRace* race_ref(ConnectRace *race);
+static void race_unref(ConnectRace *race);
+static void race_attempt_next(ConnectRace *race);
+static void race_return_error(ConnectRace *race);
+static void race_finish(ConnectRace *race);
+static void race_cancel_attempts(ConnectRace *race);
+static void attempt_free(ConnectAttempt *attempt);
+static GList* sort_addresses(GList *addrs);
+static bool cache_is_valid(SircConnector *self, const char *host);
+static void cache_store(SircConnector *self, const char *host, GList *addrs);
+static void cache_promote(SircConnector *self, const char *host, GInetAddress *addr);
+
+static void on_resolve_ready(GObject *obj, GAsyncResult *res, gpointer user_data);
+static void on_attempt_ready(GObject *obj, GAsyncResult *res, gpointer user_data);
+static gboolean on_attempt_delay(gpointer user_data);
+static gboolean on_attempt_timeout(gpointer user_data);
+static void on_race_cancelled(GCancellable *cancel, gpointer user_data);
+
+SircConnector* sirc_connector_new(void){
+    SircConnector *self;
+
+    self = g_malloc0(sizeof(SircConnector));
+    self->client = g_socket_client_new();
+
+    return self;
+}
+
+/**
+ * @brief sirc_connector_free frees a connector, in-flight connect operations
+ * should have been cancelled and finished.
+ *
+ * @param self
+ */
+void sirc_connector_free(SircConnector *self){
+    g_return_if_fail(self);
+
+    sirc_connector_flush_cache(self);
+    g_object_unref(self->client);
+
+    g_free(self);
+}
+
+/**
+ * @brief sirc_connector_connect_async connects to the given host, the
+ * result should be retrieved by sirc_connector_connect_finish() in callback.
+ *
+ * @param self
+ * @param host Hostname or IP address literal, not URI escaped
+ * @param port
+ * @param cancel
+ * @param callback
+ * @param user_data
+ */
+void sirc_connector_connect_async(SircConnector *self, const char *host,
+        int port, GCancellable *cancel, GAsyncReadyCallback callback,
+        gpointer user_data){
+    ConnectRace *race;
+
+    g_return_if_fail(self);
+    g_return_if_fail(host);
+    g_return_if_fail(port > 0);
+
+    race = g_malloc0(sizeof(ConnectRace));
+    race->refcount = 1;
+    race->connector = self;
+    race->task = g_task_new(NULL, cancel, callback, user_data);
+    g_task_set_source_tag(race->task, sirc_connector_connect_async);
+    race->host = g_strdup(host);
+    race->port = port;
+    if (cancel){
+        race->cancel_id = g_cancellable_connect(cancel,
+                G_CALLBACK(on_race_cancelled), race, NULL);
+    }
+
+    if (cache_is_valid(self, host)){
+        DBG_FR("Using cached addresses of %s", host);
+        race->addrs = g_list_copy_deep(self->addrs, (GCopyFunc)g_object_ref, NULL);
+        race_attempt_next(race);
+    } else {
+        GResolver *resolver;
+
+        resolver = g_resolver_get_default();
+        g_resolver_lookup_by_name_async(resolver, host, cancel,
+                on_resolve_ready, race);
+        g_object_unref(resolver);
+    }
+}
+
+GSocketConnection* sirc_connector_connect_finish(SircConnector *self,
+        GAsyncResult *res, GError **err){
+    g_return_val_if_fail(g_task_is_valid(res, NULL), NULL);
+
+    return g_task_propagate_pointer(G_TASK(res), err);
+}
+
+/**
+ * @brief sirc_connector_flush_cache forgets resolved addresses, for example,
+ * when network is changed.
+ *
+ * @param self
+ */
+void sirc_connector_flush_cache(SircConnector *self){
+    g_return_if_fail(self);
+
+    g_resolver_free_addresses(self->addrs);
+    self->addrs = NULL;
+    g_free(self->host);
+    self->host = NULL;
+    self->resolved_time = 0;
+}
+
+static ConnectRace* race_ref(ConnectRace *race){
+    race->refcount++;
+
+    return race;
+}
+
+static void race_unref(ConnectRace *race){
+    if (--race->refcount > 0){
+        return;
+    }
+
+    g_warn_if_fail(race->done);
+    g_warn_if_fail(!race->attempts);
+    g_warn_if_fail(!race->delay_timer);
+
+    g_resolver_free_addresses(race->addrs);
+    if (race->err){
+        g_error_free(race->err);
+    }
+    g_object_unref(race->task);
+    g_free(race->host);
+    g_free(race);
+}
+
+/**
+ * @brief race_attempt_next starts a connection attempt to the next address.
+ *
+ * @param race
+ */
+static void race_attempt_next(ConnectRace *race){
+    char *addr_str;
+    GSocketAddress *sockaddr;
+    ConnectAttempt *attempt;
+
+    if (race->delay_timer){
+        g_source_remove(race->delay_timer);
+        race->delay_timer = 0;
+    }
+
+    if (g_task_return_error_if_cancelled(race->task)){
+        race_finish(race);
+        return;
+    }
+    if (!race->addrs){
+        if (!race->attempts){
+            race_return_error(race);
+        }
+        return; // Wait for in-flight attempts
+    }
+
+    attempt = g_malloc0(sizeof(ConnectAttempt));
+    attempt->race = race_ref(race);
+    attempt->addr = race->addrs->data;
+    attempt->cancel = g_cancellable_new();
+    race->addrs = g_list_delete_link(race->addrs, race->addrs);
+    race->attempts = g_list_prepend(race->attempts, attempt);
+
+    addr_str = g_inet_address_to_string(attempt->addr);
+    DBG_FR("Connecting to %s port %d", addr_str, race->port);
+    g_free(addr_str);
+
+    sockaddr = g_inet_socket_address_new(attempt->addr, race->port);
+    g_socket_client_connect_async(race->connector->client,
+            G_SOCKET_CONNECTABLE(sockaddr), attempt->cancel,
+            on_attempt_ready, attempt);
+    g_object_unref(sockaddr);
+
+    attempt->timeout_timer = g_timeout_add(SIRC_CONNECT_ATTEMPT_TIMEOUT,
+            on_attempt_timeout, attempt);
+    if (race->addrs){
+        race->delay_timer = g_timeout_add(SIRC_CONNECT_ATTEMPT_DELAY,
+                on_attempt_delay, race);
+    }
+}
+
+/**
+ * @brief race_return_error is called when all addresses have been attempted
+ * and failed.
+ *
+ * @param race
+ */
+static void race_return_error(ConnectRace *race){
+    // Addresses may be outdated
+    sirc_connector_flush_cache(race->connector);
+
+    if (race->err){
+        g_task_return_error(race->task, race->err);
+        race->err = NULL;
+    } else {
+        g_task_return_new_error(race->task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                _("No address of %1$s can be connected"), race->host);
+    }
+    race_finish(race);
+}
+
+/**
+ * @brief race_finish is called after result has been returned, it cancels
+ * remaining attempts and releases the reference held by operation.
+ *
+ * @param race
+ */
+static void race_finish(ConnectRace *race){
+    GCancellable *cancel;
+
+    race->done = TRUE;
+    race->connector = NULL;
+
+    if (race->delay_timer){
+        g_source_remove(race->delay_timer);
+        race->delay_timer = 0;
+    }
+    cancel = g_task_get_cancellable(race->task);
+    if (race->cancel_id){
+        g_cancellable_disconnect(cancel, race->cancel_id);
+        race->cancel_id = 0;
+    }
+    race_cancel_attempts(race);
+
+    race_unref(race);
+}
+
+static void race_cancel_attempts(ConnectRace *race){
+    GList *attempts;
+
+    // Callback of attempt may be invoked and remove itself from list
+    attempts = g_list_copy(race->attempts);
+    for (GList *lst = attempts; lst; lst = g_list_next(lst)){
+        ConnectAttempt *attempt;
+
+        attempt = lst->data;
+        g_cancellable_cancel(attempt->cancel);
+    }
+    g_list_free(attempts);
+}
+
+static void attempt_free(ConnectAttempt *attempt){
+    if (attempt->timeout_timer){
+        g_source_remove(attempt->timeout_timer);
+    }
+    g_object_unref(attempt->addr);
+    g_object_unref(attempt->cancel);
+    race_unref(attempt->race);
+    g_free(attempt);
+}
+
+/**
+ * @brief sort_addresses interleaves addresses by address family as RFC 8305
+ * section 4 suggested, the family of the first address is preferred.
+ *
+ * @param addrs A list of GInetAddress, the ownership is transferred
+ *
+ * @return A sorted list of GInetAddress
+ */
+static GList* sort_addresses(GList *addrs){
+    GSocketFamily family;
+    GList *preferred;
+    GList *others;
+    GList *sorted;
+
+    if (!addrs){
+        return NULL;
+    }
+
+    family = g_inet_address_get_family(addrs->data);
+    preferred = NULL;
+    others = NULL;
+    for (GList *lst = addrs; lst; lst = g_list_next(lst)){
+        if (g_inet_address_get_family(lst->data) == family){
+            preferred = g_list_prepend(preferred, lst->data);
+        } else {
+            others = g_list_prepend(others, lst->data);
+        }
+    }
+    g_list_free(addrs);
+    preferred = g_list_reverse(preferred);
+    others = g_list_reverse(others);
+
+    sorted = NULL;
+    while (preferred || others){
+        if (preferred){
+            sorted = g_list_prepend(sorted, preferred->data);
+            preferred = g_list_delete_link(preferred, preferred);
+        }
+        if (others){
+            sorted = g_list_prepend(sorted, others->data);
+            others = g_list_delete_link(others, others);
+        }
+    }
+
+    return g_list_reverse(sorted);
+}
+
+static bool cache_is_valid(SircConnector *self, const char *host){
+    return self->addrs
+        && g_ascii_strcasecmp(self->host, host) == 0
+        && g_get_monotonic_time() - self->resolved_time < SIRC_DNS_CACHE_TTL;
+}
+
+static void cache_store(SircConnector *self, const char *host, GList *addrs){
+    sirc_connector_flush_cache(self);
+
+    self->host = g_strdup(host);
+    self->addrs = g_list_copy_deep(addrs, (GCopyFunc)g_object_ref, NULL);
+    self->resolved_time = g_get_monotonic_time();
+}
+
+static void cache_promote(SircConnector *self, const char *host,
+        GInetAddress *addr){
+    if (!self->addrs || g_ascii_strcasecmp(self->host, host) != 0){
+        return;
+    }
+
+    for (GList *lst = self->addrs; lst; lst = g_list_next(lst)){
+        if (g_inet_address_equal(lst->data, addr)){
+            self->addrs = g_list_remove_link(self->addrs, lst);
+            self->addrs = g_list_concat(lst, self->addrs);
+            break;
+        }
+    }
+}
+
+static void on_resolve_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
+    GList *addrs;
+    GError *err;
+    ConnectRace *race;
+
+    race = user_data;
+    err = NULL;
+    addrs = g_resolver_lookup_by_name_finish(G_RESOLVER(obj), res, &err);
+    if (err){
+        race->err = err;
+        race_return_error(race);
+        return;
+    }
+
+    race->addrs = sort_addresses(addrs);
+    cache_store(race->connector, race->host, race->addrs);
+    race_attempt_next(race);
+}
+
+static void on_attempt_ready(GObject *obj, GAsyncResult *res, gpointer user_data){
+    char *addr_str;
+    GError *err;
+    GSocketConnection *conn;
+    ConnectAttempt *attempt;
+    ConnectRace *race;
+
+    attempt = user_data;
+    race = race_ref(attempt->race);
+    race->attempts = g_list_remove(race->attempts, attempt);
+
+    err = NULL;
+    conn = g_socket_client_connect_finish(G_SOCKET_CLIENT(obj), res, &err);
+    if (race->done){
+        // Lost the race or the operation is finished
+        if (conn){
+            g_object_unref(conn);
+        }
+        if (err){
+            g_error_free(err);
+        }
+        goto FIN;
+    }
+
+    addr_str = g_inet_address_to_string(attempt->addr);
+    if (conn){
+        DBG_FR("Connected to %s port %d", addr_str, race->port);
+        cache_promote(race->connector, race->host, attempt->addr);
+        g_task_return_pointer(race->task, conn, g_object_unref);
+        race_finish(race);
+    } else {
+        if (attempt->timed_out){
+            g_error_free(err);
+            err = g_error_new(G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    _("Connection to %1$s timed out"), addr_str);
+        }
+        DBG_FR("Failed to connect to %s port %d: %s",
+                addr_str, race->port, err->message);
+        if (race->err){
+            g_error_free(race->err);
+        }
+        race->err = err;
+        race_attempt_next(race);
+    }
+    g_free(addr_str);
+
+FIN:
+    attempt_free(attempt);
+    race_unref(race);
+}
+
+static gboolean on_attempt_delay(gpointer user_data){
+    ConnectRace *race;
+
+    race = user_data;
+    race->delay_timer = 0;
+    race_attempt_next(race);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_attempt_timeout(gpointer user_data){
+    ConnectAttempt *attempt;
+
+    attempt = user_data;
+    attempt->timeout_timer = 0;
+    attempt->timed_out = TRUE;
+    g_cancellable_cancel(attempt->cancel);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void on_race_cancelled(GCancellable *cancel, gpointer user_data){
+    ConnectRace *race;
+
+    race = user_data;
+    if (race->delay_timer){
+        g_source_remove(race->delay_timer);
+        race->delay_timer = 0;
+    }
+    // Results are returned when attempts are finished
+    race_cancel_attempts(race);
+}
@@ -0,0 +1,36 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SIRC_CONNECTOR_H
+#define __SIRC_CONNECTOR_H
+
+#include <gio/gio.h>
+
+/**
+ * @brief A TCP connector which tries IPv6 and IPv4 addresses in parallel and
+ * caches resolved addresses for reconnecting.
+ */
+typedef struct _SircConnector SircConnector;
+
+SircConnector* sirc_connector_new(void);
+void sirc_connector_free(SircConnector *self);
+void sirc_connector_connect_async(SircConnector *self, const char *host, int port, GCancellable *cancel, GAsyncReadyCallback callback, gpointer user_data);
+GSocketConnection* sirc_connector_connect_finish(SircConnector *self, GAsyncResult *res, GError **err);
+void sirc_connector_flush_cache(SircConnector *self);
+
+#endif /* __SIRC_CONNECTOR_H */
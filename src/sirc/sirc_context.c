@@ -18,11 +18,23 @@
  */
 
 #include "sirc/sirc.h"
+#include "sirc_parse.h"
 
 struct _SircMessageContext {
-    GDateTime *time; 
+    GDateTime *time; // Created on demand if the context is lazy
+    SrnArena *arena;
+    gint64 recv_time; // Local time of receiving, in microseconds
+    const char *time_tag; // Value of "time" tag
+    char *msgid; // Value of "msgid" tag, owned by context unless it is lazy
+    bool server_time; // Whether the time is parsed from "time" tag, unknown
+                      // until time is created
+    char *user; // Username of message source, owned by context unless it is lazy
+    char *host; // Hostname of message source, ditto
 };
 
+static GDateTime* context_new_time(const SircMessageContext *context,
+        bool *server_time);
+
 SircMessageContext* sirc_message_context_new(GDateTime* time) {
     SircMessageContext *context;
 
@@ -36,13 +48,192 @@ SircMessageContext* sirc_message_context_new(GDateTime* time) {
     return context;
 }
 
+/**
+ * @brief sirc_message_context_new_lazy creates a context in arena for an
+ * incoming message, the GDateTime is not created until it is asked for,
+ * as many messages never use it.
+ *
+ * @param arena The context is released by srn_arena_reset()
+ * @param time_tag Value of IRCv3 "time" tag, it should live as long as the
+ *      context
+ * @param msgid Value of IRCv3 "msgid" tag, it should live as long as the
+ *      context
+ *
+ * @return A SircMessageContext, should not be freed by
+ *      sirc_message_context_free()
+ */
+SircMessageContext* sirc_message_context_new_lazy(SrnArena *arena,
+        const char *time_tag, const char *msgid) {
+    SircMessageContext *context;
+
+    g_return_val_if_fail(arena, NULL);
+
+    context = srn_arena_new0(arena, SircMessageContext);
+    context->arena = arena;
+    context->recv_time = g_get_real_time();
+    context->time_tag = time_tag;
+    context->msgid = (char *)msgid;
+
+    return context;
+}
+
+/**
+ * @brief sirc_message_context_new_with_tags creates a context for an
+ * incoming message which outlives the arena, such as message in a batch.
+ *
+ * @param time_tag Value of IRCv3 "time" tag, can be NULL
+ * @param msgid Value of IRCv3 "msgid" tag, can be NULL
+ *
+ * @return A SircMessageContext, should be freed by
+ *      sirc_message_context_free()
+ */
+SircMessageContext* sirc_message_context_new_with_tags(const char *time_tag,
+        const char *msgid) {
+    SircMessageContext *context;
+
+    context = g_malloc0(sizeof(SircMessageContext));
+    context->recv_time = g_get_real_time();
+    context->time_tag = time_tag;
+    context->time = context_new_time(context, &context->server_time);
+    context->time_tag = NULL; // Not owned by context
+    context->msgid = g_strdup(msgid);
+
+    return context;
+}
+
+/**
+ * @brief sirc_message_context_set_source records username and hostname of
+ * the "nick!user@host" prefix of an incoming message.
+ *
+ * @param context
+ * @param user Can be NULL
+ * @param host Can be NULL
+ */
+void sirc_message_context_set_source(SircMessageContext *context,
+        const char *user, const char *host) {
+    g_return_if_fail(context);
+
+    if (context->arena) {
+        // Lives as long as the message
+        context->user = (char *)user;
+        context->host = (char *)host;
+    } else {
+        g_free(context->user);
+        g_free(context->host);
+        context->user = g_strdup(user);
+        context->host = g_strdup(host);
+    }
+}
+
 GDateTime* sirc_message_context_get_time(const SircMessageContext *context) {
+    SircMessageContext *mut_context;
+
     g_return_val_if_fail(context, NULL);
+
+    if (!context->time) {
+        // Filling the cache does not change what the context means
+        mut_context = (SircMessageContext *)context;
+        mut_context->time = context_new_time(context,
+                &mut_context->server_time);
+        srn_arena_add_cleanup(context->arena,
+                (GDestroyNotify)g_date_time_unref, mut_context->time);
+    }
+
     return context->time;
 }
 
+gint64 sirc_message_context_get_timestamp(const SircMessageContext *context) {
+    GDateTime *time;
+
+    g_return_val_if_fail(context, 0);
+
+    if (!context->time && !context->time_tag) {
+        return context->recv_time;
+    }
+
+    time = sirc_message_context_get_time(context);
+    return g_date_time_to_unix(time) * G_USEC_PER_SEC
+        + g_date_time_get_microsecond(time);
+}
+
+const char* sirc_message_context_get_msgid(const SircMessageContext *context) {
+    g_return_val_if_fail(context, NULL);
+
+    return context->msgid;
+}
+
+bool sirc_message_context_has_server_time(const SircMessageContext *context) {
+    g_return_val_if_fail(context, FALSE);
+
+    if (!context->time && context->time_tag) {
+        // Whether the tag is valid is known after parsing
+        sirc_message_context_get_time(context);
+    }
+
+    return context->server_time;
+}
+
+const char* sirc_message_context_get_user(const SircMessageContext *context) {
+    g_return_val_if_fail(context, NULL);
+
+    return context->user;
+}
+
+const char* sirc_message_context_get_host(const SircMessageContext *context) {
+    g_return_val_if_fail(context, NULL);
+
+    return context->host;
+}
+
 void sirc_message_context_free(SircMessageContext *context) {
     g_return_if_fail(context);
+    g_return_if_fail(!context->arena);
+
     g_date_time_unref(context->time);
+    g_free(context->msgid);
+    g_free(context->user);
+    g_free(context->host);
     g_free(context);
 }
+
+/**
+ * @brief context_new_time creates time of context from its "time" tag, or
+ * from the time of receiving if the tag is absent or invalid.
+ *
+ * @param context
+ * @param server_time Returns whether the time is parsed from tag
+ *
+ * @return A GDateTime in local timezone
+ */
+static GDateTime* context_new_time(const SircMessageContext *context,
+        bool *server_time) {
+    GDateTime *time;
+    GDateTime *utc_time;
+    GDateTime *sec_time;
+    GTimeZone *local_tz;
+
+    time = NULL;
+    if (context->time_tag) {
+        /* https://ircv3.net/specs/extensions/server-time requires the
+         * timezone to be explicitly UTC in the timestamp, so we don't
+         * need to provide default_tz */
+        utc_time = g_date_time_new_from_iso8601(context->time_tag, NULL);
+        if (utc_time) {
+            local_tz = g_time_zone_new_local();
+            time = g_date_time_to_timezone(utc_time, local_tz);
+            g_time_zone_unref(local_tz);
+            g_date_time_unref(utc_time);
+        }
+    }
+
+    *server_time = time != NULL;
+    if (!time) {
+        /* Either not provided by the server, or could not be parsed */
+        sec_time = g_date_time_new_from_unix_local(
+                context->recv_time / G_USEC_PER_SEC);
+        time = g_date_time_add(sec_time, context->recv_time % G_USEC_PER_SEC);
+        g_date_time_unref(sec_time);
+    }
+
+    return time;
+}
@@ -33,38 +33,50 @@
 
 #include "srain.h"
 #include "log.h"
+#include "trace.h"
 
 static void sirc_ctcp_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageContext *context);
+static bool sirc_batch_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageContext *context);
+static void sirc_batch_end(SircSession *sirc, SircBatch *batch, const SircMessageContext *context);
+static void sirc_batch_flush(SircSession *sirc, SircBatch *batch);
+static void sirc_batch_close(SircSession *sirc, SircBatch *batch);
+#ifdef ENABLE_TRACING
+static const char* trace_span_name(const char *cmd);
+#endif
 
 void _sirc_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageContext *context);
 
+/**
+ * @brief sirc_event_hdr dispatches a message to event callbacks.
+ *
+ * @param sirc
+ * @param imsg If the message is in arena, the context and temporary strings
+ *      are allocated from the same arena
+ */
 void sirc_event_hdr(SircSession *sirc, SircMessage *imsg){
-    GDateTime *time = NULL;
-    GDateTime *utc_time = NULL;
-    GTimeZone *local_tz = NULL;
-
-    local_tz = g_time_zone_new_local();
-    for (size_t i=0; i<imsg->ntags; i++) {
-        if (!g_strcmp0(imsg->tags[i].key, "time") && imsg->tags[i].value) {
-            /* https://ircv3.net/specs/extensions/server-time requires the
-             * timezone to be explicitly UTC in the timestamp, so we don't
-             * need to provide default_tz */
-            utc_time = g_date_time_new_from_iso8601(imsg->tags[i].value, NULL);
-            time = g_date_time_to_timezone(utc_time, local_tz);
-            g_date_time_unref(utc_time);
-            break;
-        }
+    const char *time_tag;
+    const char *msgid;
+    SircMessageContext *context;
+
+    time_tag = sirc_message_get_tag(imsg, "time");
+    msgid = sirc_message_get_tag(imsg, "msgid");
+    if (imsg->arena) {
+        context = sirc_message_context_new_lazy(imsg->arena, time_tag, msgid);
+    } else {
+        context = sirc_message_context_new_with_tags(time_tag, msgid);
     }
-    g_time_zone_unref(local_tz);
+    sirc_message_context_set_source(context, imsg->user, imsg->host);
 
-    if (!time) {
-        /* Either not provided by the server, or could not be parsed */
-        time = g_date_time_new_now_local();
+    // The span covers event handler of the command
+    SRN_TRACE_BEGIN(hdr);
+    if (!sirc_batch_event_hdr(sirc, imsg, context)) {
+        _sirc_event_hdr(sirc, imsg, context);
     }
+    SRN_TRACE_END(hdr, trace_span_name(imsg->cmd));
 
-    g_autoptr(SircMessageContext) context = sirc_message_context_new(time);
-
-    _sirc_event_hdr(sirc, imsg, context);
+    if (!imsg->arena) {
+        sirc_message_context_free(context);
+    }
 }
 
 void _sirc_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageContext *context){
@@ -106,6 +118,7 @@ void _sirc_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageCont
                 events->umode(sirc, imsg->cmd, origin, params, imsg->nparam, context);
                 return;
             case SIRC_RFC_RPL_WELCOME:
+                sirc_set_registered(sirc);
                 g_return_if_fail(events->welcome);
                 events->welcome(sirc, num, origin, params, imsg->nparam, context);
                 /* Do not break here */
@@ -203,6 +216,20 @@ void _sirc_event_hdr(SircSession *sirc, SircMessage *imsg, const SircMessageCont
              g_return_if_fail(events->invite);
              events->invite(sirc, event, origin, params, imsg->nparam, context);
          }
+         /* AWAY/ACCOUNT/CHGHOST are sent to client which enabled IRCv3
+          * "away-notify", "account-notify" and "chghost" */
+         else if (strcasecmp(event, "AWAY") == 0){
+             g_return_if_fail(events->away);
+             events->away(sirc, event, origin, params, imsg->nparam, context);
+         }
+         else if (strcasecmp(event, "ACCOUNT") == 0){
+             g_return_if_fail(events->account);
+             events->account(sirc, event, origin, params, imsg->nparam, context);
+         }
+         else if (strcasecmp(event, "CHGHOST") == 0){
+             g_return_if_fail(events->chghost);
+             events->chghost(sirc, event, origin, params, imsg->nparam, context);
+         }
          else if (strcasecmp(event, "CAP") == 0){
              g_return_if_fail(events->cap);
              events->cap(sirc, event, origin, params, imsg->nparam, context);
@@ -268,7 +295,11 @@ static void sirc_ctcp_event_hdr(SircSession *sirc, SircMessage *imsg, const Sirc
 
     event = imsg->cmd;
     tmp = imsg->params[imsg->nparam - 1];
-    ptr = ctcp_msg = g_strdup(tmp);
+    if (imsg->arena) {
+        ptr = ctcp_msg = srn_arena_strdup(imsg->arena, tmp);
+    } else {
+        ptr = ctcp_msg = g_strdup(tmp);
+    }
     len = strlen(ctcp_msg);
     /* Cast to immutable string */
     origin = imsg->nick ? imsg->nick : imsg->prefix;
@@ -302,5 +333,190 @@ static void sirc_ctcp_event_hdr(SircSession *sirc, SircMessage *imsg, const Sirc
         g_warn_if_reached();
     }
 
-    g_free(ctcp_msg);
+    if (!imsg->arena) {
+        g_free(ctcp_msg);
+    }
+}
+
+/**
+ * @brief sirc_batch_event_hdr handles "BATCH" commands and messages which
+ * belong to a buffered batch.
+ *
+ * @return TRUE if the message is consumed
+ */
+static bool sirc_batch_event_hdr(SircSession *sirc, SircMessage *imsg,
+        const SircMessageContext *context) {
+    const char *ref;
+    GHashTable *batches;
+    SircBatch *batch;
+
+    batches = sirc_get_batches(sirc);
+
+    if (strcasecmp(imsg->cmd, "BATCH") != 0) {
+        ref = sirc_message_get_tag(imsg, "batch");
+        if (!ref) {
+            return FALSE;
+        }
+        batch = g_hash_table_lookup(batches, ref);
+        if (!batch || !sirc_batch_is_buffered(batch)) {
+            return FALSE;
+        }
+        if (sirc_batch_is_full(batch)) {
+            if (sirc_batch_is_droppable(batch)) {
+                DBG_FR("Batch %s is full, message dropped", ref);
+                return TRUE;
+            }
+            // Flush buffered messages, this one is dispatched by caller
+            sirc_batch_flush(sirc, batch);
+            return FALSE;
+        }
+        sirc_batch_add_message(batch, imsg);
+        return TRUE;
+    }
+
+    g_return_val_if_fail(imsg->nparam >= 1, TRUE);
+    ref = imsg->params[0];
+    if (ref[0] == '+') {
+        const char *parent_ref;
+        SircBatch *parent;
+
+        g_return_val_if_fail(imsg->nparam >= 2, TRUE);
+        batch = sirc_batch_lookup_oldest(batches);
+        if (batch) {
+            g_hash_table_steal(batches, sirc_batch_get_ref(batch));
+            sirc_batch_close(sirc, batch);
+            sirc_batch_free(batch);
+        }
+        parent_ref = sirc_message_get_tag(imsg, "batch");
+        parent = parent_ref ? g_hash_table_lookup(batches, parent_ref) : NULL;
+        batch = sirc_batch_new(ref + 1, imsg->params[1],
+                (const char **)imsg->params + 2, imsg->nparam - 2, parent);
+        g_hash_table_replace(batches, (char *)sirc_batch_get_ref(batch), batch);
+    } else if (ref[0] == '-') {
+        batch = g_hash_table_lookup(batches, ref + 1);
+        if (!batch) {
+            WARN_FR("Unknown batch: %s", ref + 1);
+            return TRUE;
+        }
+        g_hash_table_steal(batches, ref + 1);
+        sirc_batch_end(sirc, batch, context);
+        sirc_batch_free(batch);
+    } else {
+        WARN_FR("Invalid batch reference tag: %s", ref);
+    }
+
+    return TRUE;
+}
+
+static void sirc_batch_end(SircSession *sirc, SircBatch *batch,
+        const SircMessageContext *context) {
+    int count;
+    const char *parent_ref;
+    const char **params;
+    SircBatch *parent;
+    SircEvents *events;
+
+    if (!sirc_batch_is_buffered(batch)) {
+        return; // Messages have been dispatched
+    }
+
+    parent_ref = sirc_batch_get_parent_ref(batch);
+    parent = parent_ref
+        ? g_hash_table_lookup(sirc_get_batches(sirc), parent_ref)
+        : NULL;
+    if (parent && sirc_batch_is_buffered(parent)
+            && !sirc_batch_is_droppable(parent)
+            && !sirc_batch_can_merge(parent, batch)) {
+        sirc_batch_flush(sirc, parent);
+    }
+    if (parent && sirc_batch_is_buffered(parent)) {
+        sirc_batch_merge(parent, batch);
+        if (sirc_batch_is_full(parent) && !sirc_batch_is_droppable(parent)) {
+            sirc_batch_flush(sirc, parent);
+        }
+        return;
+    }
+    if (parent) {
+        // Parent has been flushed
+        sirc_batch_flush(sirc, batch);
+        return;
+    }
+
+    DBG_FR("sirc: %p, batch: %s, length: %d",
+            sirc, sirc_batch_get_type(batch), sirc_batch_get_length(batch));
+
+    events = sirc_get_events(sirc);
+    if (events->batch) {
+        params = sirc_batch_get_batch_params(batch, &count);
+        events->batch(sirc, sirc_batch_get_type(batch), params, count, batch,
+                context);
+    } else {
+        // Dispatch messages one by one
+        for (int i = 0; i < sirc_batch_get_length(batch); i++) {
+            _sirc_event_hdr(sirc, sirc_batch_get_message(batch, i),
+                    sirc_batch_get_context(batch, i));
+        }
+    }
+}
+
+/**
+ * @brief sirc_batch_flush dispatches buffered messages of batch one by one
+ * and stops buffering it, when the batch exceeds its limit.
+ */
+static void sirc_batch_flush(SircSession *sirc, SircBatch *batch) {
+    WARN_FR("sirc: %p, batch %s of type %s is too large or too long, "
+            "flushing %d messages",
+            sirc, sirc_batch_get_ref(batch), sirc_batch_get_type(batch),
+            sirc_batch_get_length(batch));
+
+    for (int i = 0; i < sirc_batch_get_length(batch); i++) {
+        _sirc_event_hdr(sirc, sirc_batch_get_message(batch, i),
+                sirc_batch_get_context(batch, i));
+    }
+    sirc_batch_unbuffer(batch);
+}
+
+/**
+ * @brief sirc_batch_close closes a batch which has not ended when there are
+ * too many open batches. Buffered messages are dropped if they can be,
+ * otherwise flushed.
+ */
+static void sirc_batch_close(SircSession *sirc, SircBatch *batch) {
+    WARN_FR("sirc: %p, too many open batches, closing batch %s of type %s",
+            sirc, sirc_batch_get_ref(batch), sirc_batch_get_type(batch));
+
+    if (!sirc_batch_is_buffered(batch)) {
+        return;
+    }
+    if (sirc_batch_is_droppable(batch)) {
+        sirc_batch_unbuffer(batch);
+        return;
+    }
+    sirc_batch_flush(sirc, batch);
+}
+
+#ifdef ENABLE_TRACING
+/**
+ * @brief trace_span_name returns a static span name for a command. Command
+ * comes from server, so unknown ones fall into a single bucket rather than
+ * being interned.
+ */
+static const char* trace_span_name(const char *cmd){
+    static const char *known_cmds[] = {
+        "PRIVMSG", "NOTICE", "JOIN", "PART", "QUIT", "NICK", "MODE", "TOPIC",
+        "KICK", "INVITE", "PING", "PONG", "ERROR", "CAP", "AUTHENTICATE",
+        "BATCH", "AWAY", "ACCOUNT", "CHGHOST", NULL,
+    };
+
+    if (atoi(cmd) != 0){
+        return "numeric";
+    }
+    for (int i = 0; known_cmds[i]; i++){
+        if (strcasecmp(cmd, known_cmds[i]) == 0){
+            return known_cmds[i];
+        }
+    }
+
+    return "other";
 }
+#endif
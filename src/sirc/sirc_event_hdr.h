@@ -24,4 +24,8 @@
 
 void sirc_event_hdr(SircSession *sirc, SircMessage *imsg);
 
+/* Defined in sirc.c */
+GHashTable* sirc_get_batches(SircSession *sirc);
+void sirc_set_registered(SircSession *sirc);
+
 #endif /* __SIRC_EVENT_HDR_H */
@@ -38,11 +38,40 @@
 /* https://ircv3.net/specs/extensions/message-tags#size-limit */
 #define TAGS_SIZE_LIMIT 8191
 
-SircMessage *sirc_message_new(){
-    return g_malloc0(sizeof(SircMessage));
+static char* message_strdup(SircMessage *imsg, const char *str);
+static void message_transcoding(SircMessage *imsg, char **str,
+        const char *from_codeset);
+
+/**
+ * @brief sirc_message_new creates an empty message.
+ *
+ * @param arena If not NULL, the message and all its strings are allocated
+ *      from the arena, and are released by srn_arena_reset()
+ *
+ * @return A SircMessage
+ */
+SircMessage *sirc_message_new(SrnArena *arena){
+    SircMessage *imsg;
+
+    if (arena) {
+        imsg = srn_arena_new0(arena, SircMessage);
+    } else {
+        imsg = g_malloc0(sizeof(SircMessage));
+    }
+    imsg->arena = arena;
+
+    return imsg;
 }
 
+/**
+ * @brief sirc_message_free frees a message on heap, it does nothing for
+ * message in arena.
+ */
 void sirc_message_free(SircMessage *imsg){
+    if (imsg->arena) {
+        return;
+    }
+
     str_assign(&imsg->prefix, NULL);
     str_assign(&imsg->nick, NULL);
     str_assign(&imsg->user, NULL);
@@ -65,15 +94,65 @@ void sirc_message_free(SircMessage *imsg){
     g_free(imsg);
 }
 
+/**
+ * @brief sirc_message_dup makes a deep copy of message on heap, it is the
+ * way to promote a message in arena which should outlive the line.
+ *
+ * @param imsg
+ *
+ * @return A SircMessage, should be freed by sirc_message_free()
+ */
+SircMessage *sirc_message_dup(const SircMessage *imsg){
+    SircMessage *dup;
+
+    dup = sirc_message_new(NULL);
+    dup->prefix = g_strdup(imsg->prefix);
+    dup->nick = g_strdup(imsg->nick);
+    dup->user = g_strdup(imsg->user);
+    dup->host = g_strdup(imsg->host);
+    dup->cmd = g_strdup(imsg->cmd);
+
+    dup->nparam = imsg->nparam;
+    for (int i = 0; i < imsg->nparam; i++){
+        dup->params[i] = g_strdup(imsg->params[i]);
+    }
+
+    dup->ntags = imsg->ntags;
+    if (imsg->ntags > 0) {
+        dup->tags = g_malloc0_n(imsg->ntags, sizeof(SircMessageTag));
+        for (int i = 0; i < imsg->ntags; i++){
+            dup->tags[i].key = g_strdup(imsg->tags[i].key);
+            dup->tags[i].value = g_strdup(imsg->tags[i].value);
+        }
+    }
+
+    return dup;
+}
+
+/**
+ * @brief sirc_message_get_tag returns value of the tag with given key.
+ *
+ * @return NULL if no such tag or the tag has no value
+ */
+const char* sirc_message_get_tag(const SircMessage *imsg, const char *key){
+    for (size_t i = 0; i < imsg->ntags; i++){
+        if (g_strcmp0(imsg->tags[i].key, key) == 0){
+            return imsg->tags[i].value;
+        }
+    }
+
+    return NULL;
+}
+
 void sirc_message_transcoding(SircMessage *imsg, const char *from_codeset) {
-    str_transcoding(&imsg->prefix, from_codeset);
-    str_transcoding(&imsg->nick, from_codeset);
-    str_transcoding(&imsg->user, from_codeset);
-    str_transcoding(&imsg->host, from_codeset);
-    str_transcoding(&imsg->cmd, from_codeset);
+    message_transcoding(imsg, &imsg->prefix, from_codeset);
+    message_transcoding(imsg, &imsg->nick, from_codeset);
+    message_transcoding(imsg, &imsg->user, from_codeset);
+    message_transcoding(imsg, &imsg->host, from_codeset);
+    message_transcoding(imsg, &imsg->cmd, from_codeset);
 
     for (int i = 0; i < imsg->nparam; i++){
-        str_transcoding(&imsg->params[i], from_codeset);
+        message_transcoding(imsg, &imsg->params[i], from_codeset);
     }
 
     /* No need to transcode tags, they are guaranteed to be UTF-8
@@ -84,15 +163,16 @@ void sirc_message_transcoding(SircMessage *imsg, const char *from_codeset) {
  * @brief Parsing IRC raw data
  *
  * @param line A buffer contains ONE IRC raw message (without the trailing "\r\n")
+ * @param arena Where the message is allocated, NULL for heap
  *
  * @return A SircMessage structure
  */
-SircMessage* sirc_parse(char *line){
+SircMessage* sirc_parse(char *line, SrnArena *arena){
     SircMessage *imsg;
 
     DBG_FR("raw: %s", line);
 
-    imsg = sirc_message_new();
+    imsg = sirc_message_new(arena);
 
     /* This is a IRC message
      * IRC protocol message format?
@@ -119,7 +199,11 @@ SircMessage* sirc_parse(char *line){
         }
 
         imsg->ntags = ntags;
-        imsg->tags = g_malloc0_n(ntags, sizeof(SircMessageTag));
+        if (arena) {
+            imsg->tags = srn_arena_new0_n(arena, SircMessageTag, ntags);
+        } else {
+            imsg->tags = g_malloc0_n(ntags, sizeof(SircMessageTag));
+        }
         size_t i=0;
         char current_tag_key[TAGS_SIZE_LIMIT];
         char current_tag_value[TAGS_SIZE_LIMIT];
@@ -140,14 +224,14 @@ SircMessage* sirc_parse(char *line){
                 /* next tag or end of tags*/
                 in_key = TRUE;
                 *current_tag_key_ptr = '\0';
-                imsg->tags[i].key = strdup(current_tag_key);
+                imsg->tags[i].key = message_strdup(imsg, current_tag_key);
                 if (current_tag_value == current_tag_value_ptr){
                     /* Key is absent or empty */
                     imsg->tags[i].value = NULL;
                 }
                 else {
                     *current_tag_value_ptr = '\0';
-                    imsg->tags[i].value = strdup(current_tag_value);
+                    imsg->tags[i].value = message_strdup(imsg, current_tag_value);
                 }
                 if (*p == ' '){
                     /* end of tags */
@@ -212,25 +296,25 @@ SircMessage* sirc_parse(char *line){
     params_ptr = strtok(NULL, "");
 
     if (!command_ptr || !params_ptr) goto bad;
-    imsg->cmd = g_strdup(command_ptr);
+    imsg->cmd = message_strdup(imsg, command_ptr);
     DBG_FR("command: %s", imsg->cmd);
 
     if (prefix_ptr){
-        imsg->prefix = g_strdup(prefix_ptr);
+        imsg->prefix = message_strdup(imsg, prefix_ptr);
         // <prefix> ::= <servername> | <nick> [ '!' <user> ] [ '@' <host> ]
         nick_ptr = strtok(prefix_ptr, "!");
         user_ptr = strtok(NULL, "@");
         host_ptr = strtok(NULL, "");
         if (nick_ptr && user_ptr && host_ptr){
-            imsg->nick = g_strdup(nick_ptr);
-            imsg->user = g_strdup(user_ptr);
-            imsg->host = g_strdup(host_ptr);
+            imsg->nick = message_strdup(imsg, nick_ptr);
+            imsg->user = message_strdup(imsg, user_ptr);
+            imsg->host = message_strdup(imsg, host_ptr);
             DBG_FR("nick: %s, user: %s, host: %s", imsg->nick, imsg->user, imsg->host);
         } else {
             DBG_FR("servername: %s", imsg->prefix);
         }
     } else {
-        imsg->prefix = g_strdup("");
+        imsg->prefix = message_strdup(imsg, "");
     }
 
     // <params> ::= <SPACE> [ ':' <trailing> | <middle> <params> ]
@@ -258,7 +342,7 @@ SircMessage* sirc_parse(char *line){
                 ERR_FR("Too many params: %s", line);
                 goto bad;
             }
-            imsg->params[imsg->nparam++] = g_strdup(params_ptr);
+            imsg->params[imsg->nparam++] = message_strdup(imsg, params_ptr);
             DBG("%s(%d) ", imsg->params[imsg->nparam-1], imsg->nparam);
         } while ((params_ptr = strtok(NULL, " ")) != NULL);
         DBG("\n");
@@ -269,7 +353,7 @@ SircMessage* sirc_parse(char *line){
             ERR_FR("Too many params: %s", line);
             goto bad;
         }
-        imsg->params[imsg->nparam++] = g_strdup(trailing_ptr);
+        imsg->params[imsg->nparam++] = message_strdup(imsg, trailing_ptr);
         DBG_FR("trailing: %s", imsg->params[imsg->nparam-1]);
     }
 
@@ -280,3 +364,34 @@ bad:
 
     return NULL;
 }
+
+static char* message_strdup(SircMessage *imsg, const char *str){
+    if (imsg->arena) {
+        return srn_arena_strdup(imsg->arena, str);
+    }
+    return g_strdup(str);
+}
+
+static void message_transcoding(SircMessage *imsg, char **str,
+        const char *from_codeset){
+    char *tmp;
+
+    if (!imsg->arena) {
+        str_transcoding(str, from_codeset);
+        return;
+    }
+
+    if (!*str) {
+        return;
+    }
+    // Common case, nothing to do and nothing is allocated
+    if (g_ascii_strcasecmp(from_codeset, SRN_CODESET) == 0
+            && g_utf8_validate(*str, -1, NULL)) {
+        return;
+    }
+
+    tmp = g_strdup(*str);
+    str_transcoding(&tmp, from_codeset);
+    *str = srn_arena_strdup(imsg->arena, tmp);
+    g_free(tmp);
+}
@@ -19,6 +19,9 @@
 #ifndef __SIRC_PARSE_H
 #define __SIRC_PARSE_H
 
+#include "sirc/sirc.h"
+#include "arena.h"
+
 #define SIRC_PARAM_COUNT    64      // RFC 2812 limits it to 14
 
 typedef struct {
@@ -27,6 +30,8 @@ typedef struct {
 } SircMessageTag;
 
 typedef struct {
+    SrnArena *arena; // Owner of the message, NULL if it is on heap
+
     size_t ntags;
     SircMessageTag *tags;
 
@@ -38,9 +43,36 @@ typedef struct {
     char *params[SIRC_PARAM_COUNT];  // middle and trailing
 } SircMessage;
 
-SircMessage *sirc_message_new();
+SircMessage *sirc_message_new(SrnArena *arena);
 void sirc_message_free(SircMessage *imsg);
+SircMessage *sirc_message_dup(const SircMessage *imsg);
+const char* sirc_message_get_tag(const SircMessage *imsg, const char *key);
 void sirc_message_transcoding(SircMessage *imsg, const char *from_codeset);
-SircMessage *sirc_parse(char *line);
+SircMessage *sirc_parse(char *line, SrnArena *arena);
+
+/* Defined in sirc_context.c */
+SircMessageContext* sirc_message_context_new_lazy(SrnArena *arena,
+        const char *time_tag, const char *msgid);
+SircMessageContext* sirc_message_context_new_with_tags(const char *time_tag,
+        const char *msgid);
+void sirc_message_context_set_source(SircMessageContext *context,
+        const char *user, const char *host);
+
+/* Defined in sirc_batch.c */
+SircBatch* sirc_batch_new(const char *ref, const char *type,
+        const char **params, int count, const SircBatch *parent);
+void sirc_batch_free(SircBatch *batch);
+const char* sirc_batch_get_ref(const SircBatch *batch);
+const char* sirc_batch_get_parent_ref(const SircBatch *batch);
+bool sirc_batch_is_buffered(const SircBatch *batch);
+bool sirc_batch_is_droppable(const SircBatch *batch);
+bool sirc_batch_is_full(const SircBatch *batch);
+bool sirc_batch_can_merge(const SircBatch *parent, const SircBatch *batch);
+SircBatch* sirc_batch_lookup_oldest(GHashTable *batches);
+void sirc_batch_unbuffer(SircBatch *batch);
+void sirc_batch_add_message(SircBatch *batch, const SircMessage *imsg);
+void sirc_batch_merge(SircBatch *parent, SircBatch *batch);
+SircMessage* sirc_batch_get_message(const SircBatch *batch, int i);
+const char** sirc_batch_get_batch_params(const SircBatch *batch, int *count);
 
 #endif /* __SIRC_PARSE_H */
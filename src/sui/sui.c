@@ -160,6 +160,62 @@ void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg){
     }
 }
 
+/**
+ * @brief sui_buffer_prepend_message adds an older message to the top of
+ * buffer, such as message from chat history. It neither scrolls the buffer
+ * nor updates the side bar.
+ *
+ * @param buf
+ * @param msg
+ */
+void sui_buffer_prepend_message(SuiBuffer *buf, SuiMessage *msg){
+    GType type;
+    SuiMessageList *list;
+
+    g_return_if_fail(SUI_IS_BUFFER(buf));
+    g_return_if_fail(SUI_IS_MESSAGE(msg));
+
+    sui_message_set_buffer(msg, buf);
+    sui_message_update(msg);
+    list = sui_buffer_get_message_list(buf);
+    type = G_OBJECT_TYPE(msg);
+    if (type == SUI_TYPE_MISC_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_CENTER);
+    } else if (type == SUI_TYPE_SEND_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_END);
+    } else if (type == SUI_TYPE_RECV_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_START);
+    } else {
+        g_warn_if_reached();
+    }
+}
+
+/**
+ * @brief sui_buffer_remove_first_message removes the oldest message from
+ * buffer, the message is destroyed.
+ *
+ * @param buf
+ */
+void sui_buffer_remove_first_message(SuiBuffer *buf){
+    g_return_if_fail(SUI_IS_BUFFER(buf));
+
+    sui_message_list_remove_first_message(sui_buffer_get_message_list(buf));
+}
+
+/**
+ * @brief sui_buffer_is_at_bottom returns whether the newest messages of
+ * buffer are being viewed.
+ *
+ * @param buf
+ *
+ * @return
+ */
+bool sui_buffer_is_at_bottom(SuiBuffer *buf){
+    g_return_val_if_fail(SUI_IS_BUFFER(buf), FALSE);
+
+    return sui_message_list_is_at_bottom(sui_buffer_get_message_list(buf));
+}
+
 void sui_buffer_clear_message(SuiBuffer *buf){
     SuiWindow *win;
     SuiSideBar *sidebar;
@@ -182,6 +238,12 @@ void sui_buffer_clear_message(SuiBuffer *buf){
     sui_side_bar_item_clear_count(item);
 }
 
+void sui_update_message(SuiMessage *msg){
+    g_return_if_fail(SUI_IS_MESSAGE(msg));
+
+    sui_message_update(msg);
+}
+
 void sui_free_message(SuiMessage *msg){
     // TODO
 }
@@ -312,6 +374,40 @@ void sui_set_topic_setter(SuiBuffer *buf, const char *setter){
     sui_buffer_set_topic_setter(buffer, setter);
 }
 
+/**
+ * @brief sui_set_presence shows whether the peer of dialog buffer is online
+ * on its side bar item.
+ *
+ * @param buf
+ * @param online
+ * @param away
+ */
+void sui_set_presence(SuiBuffer *buf, bool online, bool away){
+    const char *icon;
+    SuiWindow *win;
+    SuiSideBar *sidebar;
+    SuiSideBarItem *item;
+
+    g_return_if_fail(SUI_IS_BUFFER(buf));
+
+    if (!online){
+        icon = "user-offline-symbolic";
+    } else if (away){
+        icon = "user-away-symbolic";
+    } else {
+        icon = "user-available-symbolic";
+    }
+
+    win = SUI_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(buf)));
+    g_return_if_fail(SUI_IS_WINDOW(win));
+
+    sidebar = sui_window_get_side_bar(win);
+    item = sui_side_bar_get_item(sidebar, buf);
+    g_return_if_fail(item);
+
+    sui_side_bar_item_set_icon(item, icon);
+}
+
 void sui_message_box(const char *title, const char *msg){
     GtkMessageDialog *dia;
     char *markuped_msg;
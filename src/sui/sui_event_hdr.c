@@ -109,6 +109,9 @@ static SuiEventParamFormat formats[SUI_EVENT_UNKNOWN][SUI_EVENT_MAX_PARAM] = {
     [SUI_EVENT_CHAN_LIST] = {
         { .key = NULL, .fmt = NULL, },
     },
+    [SUI_EVENT_LOAD_HISTORY] = {
+        { .key = NULL, .fmt = NULL, },
+    },
 };
 
 static SrnRet check_params(SuiEvent event, GVariantDict *params);
@@ -227,6 +230,9 @@ SrnRet sui_buffer_event_hdr(SuiBuffer *buf, SuiEvent event, GVariantDict *params
         case SUI_EVENT_CHAN_LIST:
             g_return_val_if_fail(events->chan_list, SRN_ERR);
             return events->chan_list(buf, event, params);
+        case SUI_EVENT_LOAD_HISTORY:
+            g_return_val_if_fail(events->load_history, SRN_ERR);
+            return events->load_history(buf, event, params);
         default:
             ERR_FR("No such SuiEvent: %d", event);
             return SRN_ERR;
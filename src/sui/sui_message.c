@@ -47,6 +47,7 @@ static void sui_message_real_update_side_bar_item(SuiMessage *self,
         SuiSideBarItem *item);
 static void sui_message_real_compose_prev(SuiMessage *self, SuiMessage *prev);
 static void sui_message_real_compose_next(SuiMessage *self, SuiMessage *next);
+static void sui_message_real_decompose_prev(SuiMessage *self);
 static SuiNotification* sui_message_real_new_notification(SuiMessage *self);
 
 static void sui_message_set_ctx(SuiMessage *self, void *ctx);
@@ -157,6 +158,7 @@ static void sui_message_class_init(SuiMessageClass *class){
     class->update_side_bar_item = sui_message_real_update_side_bar_item;
     class->compose_prev = sui_message_real_compose_prev;
     class->compose_next = sui_message_real_compose_next;
+    class->decompose_prev = sui_message_real_decompose_prev;
     class->new_notification = sui_message_real_new_notification;
 }
 
@@ -206,7 +208,7 @@ void sui_message_compose_prev(SuiMessage *self, SuiMessage *prev){
 
     // Only compose messages sent by same user.
     if (self->ctx->sender != prev->ctx->sender
-            || g_ascii_strcasecmp(self->ctx->rendered_sender, prev->ctx->rendered_sender) != 0){
+            || !srn_intern_equal(self->ctx->sender_name, prev->ctx->sender_name)){
         return;
     }
 
@@ -223,13 +225,33 @@ void sui_message_compose_next(SuiMessage *self, SuiMessage *next){
 
     // Only compose messages sent by same user.
     if (self->ctx->sender != next->ctx->sender
-            || g_ascii_strcasecmp(self->ctx->rendered_sender, next->ctx->rendered_sender) != 0){
+            || !srn_intern_equal(self->ctx->sender_name, next->ctx->sender_name)){
         return;
     }
 
     class->compose_next(self, next);
 }
 
+/**
+ * @brief sui_message_decompose_prev makes self the head of its group again,
+ * it is called when the previous message is going to be removed.
+ *
+ * @param self
+ */
+void sui_message_decompose_prev(SuiMessage *self){
+    SuiMessageClass *class;
+
+    g_return_if_fail(SUI_IS_MESSAGE(self));
+    class = SUI_MESSAGE_GET_CLASS(self);
+    g_return_if_fail(class->decompose_prev);
+
+    if (!self->prev){
+        return;
+    }
+
+    class->decompose_prev(self);
+}
+
 SuiNotification* sui_message_new_notification(SuiMessage *self){
     SuiMessageClass *class;
 
@@ -296,20 +318,30 @@ void sui_message_label_on_popup(GtkLabel *label, GtkMenu *menu, gpointer user_da
     }
 }
 
-const char* sui_message_get_time(SuiMessage *self){
+/**
+ * @brief sui_message_get_time returns short format time of message.
+ *
+ * @return Should be freed by g_free()
+ */
+char* sui_message_get_time(SuiMessage *self){
     SrnMessage *ctx;
 
     ctx = sui_message_get_ctx(self);
 
-    return ctx->rendered_short_time;
+    return srn_message_format_time(ctx, FALSE);
 }
 
-const char* sui_message_get_full_time(SuiMessage *self){
+/**
+ * @brief sui_message_get_full_time returns full format time of message.
+ *
+ * @return Should be freed by g_free()
+ */
+char* sui_message_get_full_time(SuiMessage *self){
     SrnMessage *ctx;
 
     ctx = sui_message_get_ctx(self);
 
-    return ctx->rendered_full_time;
+    return srn_message_format_time(ctx, TRUE);
 }
 
 bool sui_message_is_mentioned(SuiMessage *self){
@@ -416,6 +448,16 @@ static void sui_message_real_compose_prev(SuiMessage *self, SuiMessage *prev){
     }
 }
 
+static void sui_message_real_decompose_prev(SuiMessage *self){
+    GtkStyleContext *style_context;
+
+    self->prev = NULL;
+
+    style_context = gtk_widget_get_style_context(GTK_WIDGET(self));
+    gtk_style_context_add_class(style_context, "sui-message-head");
+    // Keep self->size_group, the rest of group is still aligned
+}
+
 static void sui_message_real_compose_next(SuiMessage *self, SuiMessage *next){
     GtkStyleContext *style_context;
 
@@ -76,6 +76,8 @@ struct _SuiMessageClass {
     void (*compose_prev) (SuiMessage *self, SuiMessage *prev);
     // Compose self to next message
     void (*compose_next) (SuiMessage *self, SuiMessage *next);
+    // Detach self from previous message which is being removed
+    void (*decompose_prev) (SuiMessage *self);
     // New a SuiNotification for self
     SuiNotification* (*new_notification) (SuiMessage *self);
 };
@@ -86,6 +88,7 @@ void sui_message_update(SuiMessage *self);
 void sui_message_update_side_bar_item(SuiMessage *self, SuiSideBarItem *item);
 void sui_message_compose_prev(SuiMessage *self, SuiMessage *prev);
 void sui_message_compose_next(SuiMessage *self, SuiMessage *next);
+void sui_message_decompose_prev(SuiMessage *self);
 SuiNotification* sui_message_new_notification(SuiMessage *self);
 
 void* sui_message_get_ctx(SuiMessage *self);
@@ -93,8 +96,8 @@ void sui_message_set_buffer(SuiMessage *self, SuiBuffer *buf);
 SuiBuffer* sui_message_get_buffer(SuiMessage *self);
 SuiMessage* sui_message_get_prev(SuiMessage *self);
 SuiMessage* sui_message_get_next(SuiMessage *self);
-const char* sui_message_get_time(SuiMessage *self);
-const char* sui_message_get_full_time(SuiMessage *self);
+char* sui_message_get_time(SuiMessage *self);
+char* sui_message_get_full_time(SuiMessage *self);
 bool sui_message_is_mentioned(SuiMessage *self);
 
 void sui_message_label_on_popup(GtkLabel *label, GtkMenu *menu, gpointer user_data);
@@ -29,6 +29,8 @@
 
 #include "sui_common.h"
 #include "sui_window.h"
+#include "sui_buffer.h"
+#include "sui_event_hdr.h"
 #include "sui_message_list.h"
 
 #include "i18n.h"
@@ -38,6 +40,9 @@ struct _SuiMessageList {
     GtkBox parent;
 
     int scroll_timer;
+    int prepend_timer;
+    GtkListBoxRow *prepend_anchor; // First row before messages prepended
+    int prepend_anchor_y; // Last known y of prepend_anchor
     GtkScrolledWindow *scrolled_window;
     GtkViewport *viewport;
     GtkListBox *list_box;
@@ -64,6 +69,9 @@ static gboolean scroll_to_bottom_timeout(gpointer user_data);
 static void smart_scroll(SuiMessageList *self);
 static double get_page_count_to_bottom(SuiMessageList *self);
 static void go_next_mentioned_row(SuiMessageList *self, GtkDirectionType dir);
+static void keep_position_on_prepend(SuiMessageList *self);
+static gboolean keep_position_on_prepend_timeout(gpointer user_data);
+static void load_history(SuiMessageList *self);
 
 static void scrolled_window_on_edge_reached(GtkScrolledWindow *swin,
                GtkPositionType pos, gpointer user_data);
@@ -73,6 +81,8 @@ static void clear_selection_button_on_click(GtkButton *button, gpointer user_dat
 static void go_prev_mention_button_on_click(GtkButton *button, gpointer user_data);
 static void go_next_mention_button_on_click(GtkButton *button, gpointer user_data);
 static void list_box_on_selected_rows_changed(GtkListBox *box, gpointer user_data);
+static void list_box_on_size_allocate(GtkWidget *widget,
+        GdkRectangle *allocation, gpointer user_data);
 
 /*****************************************************************************
  * GObject functions
@@ -97,6 +107,8 @@ static void sui_message_list_init(SuiMessageList *self){
             G_CALLBACK(scroll_to_bottom), self);
     g_signal_connect(self->list_box, "selected-rows-changed",
             G_CALLBACK(list_box_on_selected_rows_changed), self);
+    g_signal_connect(self->list_box, "size-allocate",
+            G_CALLBACK(list_box_on_size_allocate), self);
 
     // Tell GtkScrolledWindow scrolls to show a row of GtkListBox when it is
     // focused. It is required by gtk_container_set_focus_child().
@@ -111,6 +123,9 @@ static void sui_message_list_finalize(GObject *object){
     if (self->scroll_timer) {
         g_source_remove(self->scroll_timer);
     }
+    if (self->prepend_timer) {
+        g_source_remove(self->prepend_timer);
+    }
 
     G_OBJECT_CLASS(sui_message_list_parent_class)->finalize(object);
 }
@@ -184,9 +199,12 @@ void sui_message_list_append_message(SuiMessageList *self, SuiMessage *msg,
     smart_scroll(self);
 }
 
+/**
+ * @brief sui_message_list_prepend_message adds a older message to the top of
+ * list, the visible messages stay where they are.
+ */
 void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg,
         GtkAlign halign){
-    GtkBox *box;
     GtkListBoxRow *row;
 
     if (self->first_msg
@@ -199,17 +217,65 @@ void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg,
         self->last_msg = msg;
     }
 
-    box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
-    gtk_box_pack_start(box, GTK_WIDGET(msg), TRUE, TRUE, 0);
-    gtk_widget_set_halign(GTK_WIDGET(msg), halign);
-    row = sui_common_unfocusable_list_box_row_new(GTK_WIDGET(box));
+    keep_position_on_prepend(self);
+
+    // Same as sui_message_list_append_message(), so that
+    // sui_message_list_get_recent_messages() works
+    row = sui_common_unfocusable_list_box_row_new(GTK_WIDGET(msg));
     gtk_list_box_prepend(self->list_box, GTK_WIDGET(row));
     self->first_row = row;
     if (!self->last_row) {
         self->last_row = row;
     }
+}
 
-    smart_scroll(self);
+/**
+ * @brief sui_message_list_remove_first_message removes the oldest message
+ * from list, the next message becomes the head of its group.
+ *
+ * @param self
+ */
+void sui_message_list_remove_first_message(SuiMessageList *self){
+    SuiMessage *msg;
+    GtkListBoxRow *row;
+    GtkListBoxRow *next_row;
+
+    msg = self->first_msg;
+    row = self->first_row;
+    g_return_if_fail(msg && row);
+
+    if (msg->next && msg->next->prev == msg){
+        sui_message_decompose_prev(msg->next);
+    }
+    if (row == self->prepend_anchor){
+        self->prepend_anchor = NULL;
+    }
+
+    next_row = gtk_list_box_get_row_at_index(self->list_box,
+            gtk_list_box_row_get_index(row) + 1);
+    if (next_row){
+        self->first_row = next_row;
+        self->first_msg = SUI_MESSAGE(gtk_bin_get_child(GTK_BIN(next_row)));
+    } else {
+        self->first_msg = NULL;
+        self->first_row = NULL;
+        self->last_msg = NULL;
+        self->last_row = NULL;
+    }
+
+    gtk_container_remove(GTK_CONTAINER(self->list_box), GTK_WIDGET(row));
+}
+
+/**
+ * @brief sui_message_list_is_at_bottom returns whether the list is scrolled
+ * to (nearly) bottom, the same threshold as smart_scroll() is used.
+ *
+ * @param self
+ *
+ * @return
+ */
+bool sui_message_list_is_at_bottom(SuiMessageList *self){
+    return get_page_count_to_bottom(self) <= 0.15;
 }
 
 void sui_message_list_add_message(SuiMessageList *self, SuiMessage *msg,
@@ -249,6 +315,11 @@ GList *sui_message_list_get_recent_messages(SuiMessageList *self, int limit){
  */
 void sui_message_list_clear_message(SuiMessageList *self){
     // Clear pointers
+    if (self->prepend_timer) {
+        g_source_remove(self->prepend_timer);
+        self->prepend_timer = 0;
+    }
+    self->prepend_anchor = NULL;
     self->first_msg = NULL;
     self->first_row = NULL;
     self->last_msg = NULL;
@@ -331,6 +402,57 @@ static void smart_scroll(SuiMessageList *self){
     scroll_to_bottom(self);
 }
 
+/**
+ * @brief keep_position_on_prepend remembers the first row and its position
+ * before messages are prepended. When the prepended messages are allocated,
+ * the row is moved down by their height, the scroll position is moved down
+ * by the same distance in list_box_on_size_allocate(), so that the list does
+ * not jump. Changes below the row, such as appended messages, are not
+ * counted.
+ */
+static void keep_position_on_prepend(SuiMessageList *self){
+    GtkAllocation alloc;
+
+    if (self->prepend_timer){
+        // Already kept, more messages are being prepended
+        return;
+    }
+
+    self->prepend_anchor = self->first_row;
+    if (self->prepend_anchor){
+        gtk_widget_get_allocation(GTK_WIDGET(self->prepend_anchor), &alloc);
+        self->prepend_anchor_y = alloc.y;
+    }
+    // Messages of one page are prepended together, stop keeping position
+    // after they are allocated
+    self->prepend_timer = g_timeout_add(500,
+            keep_position_on_prepend_timeout, self);
+}
+
+static gboolean keep_position_on_prepend_timeout(gpointer user_data){
+    SuiMessageList *self;
+
+    self = SUI_MESSAGE_LIST(user_data);
+    self->prepend_timer = 0;
+    self->prepend_anchor = NULL;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void load_history(SuiMessageList *self){
+    GtkWidget *buf;
+
+    if (self->prepend_timer){
+        // Still prepending last page
+        return;
+    }
+
+    buf = gtk_widget_get_ancestor(GTK_WIDGET(self), SUI_TYPE_BUFFER);
+    g_return_if_fail(buf);
+
+    sui_buffer_event_hdr(SUI_BUFFER(buf), SUI_EVENT_LOAD_HISTORY, NULL);
+}
+
 /* ``scrolled_window_on_edge_overshot()`` and ``scrolled_window_on_edge_reached()``
  * are used for implement dynamic hide&load messages */
 
@@ -338,7 +460,8 @@ static void scrolled_window_on_edge_overshot(GtkScrolledWindow *swin,
         GtkPositionType pos, gpointer user_data){
     switch (pos) {
         case GTK_POS_TOP:
-            // TODO: Dynamic load
+            // The list may be too short to be scrolled
+            load_history(SUI_MESSAGE_LIST(user_data));
             break;
         case GTK_POS_BOTTOM:
             break;
@@ -351,6 +474,8 @@ static void scrolled_window_on_edge_reached(GtkScrolledWindow *swin,
                GtkPositionType pos, gpointer user_data){
     switch (pos) {
         case GTK_POS_TOP:
+            // Older messages are prepended when they arrive
+            load_history(SUI_MESSAGE_LIST(user_data));
             break;
         case GTK_POS_BOTTOM:
             // TODO: Dynamic free
@@ -448,3 +573,25 @@ static void list_box_on_selected_rows_changed(GtkListBox *box,
     gtk_revealer_set_reveal_child(self->tool_bar_revealer,
             gtk_list_box_get_selected_row(box) != NULL);
 }
+
+static void list_box_on_size_allocate(GtkWidget *widget,
+        GdkRectangle *allocation, gpointer user_data){
+    int offset;
+    GtkAllocation alloc;
+    GtkAdjustment *adj;
+    SuiMessageList *self;
+
+    self = user_data;
+    if (!self->prepend_anchor){
+        return;
+    }
+
+    // Rows have been allocated, anchor is only moved by rows above it
+    gtk_widget_get_allocation(GTK_WIDGET(self->prepend_anchor), &alloc);
+    offset = alloc.y - self->prepend_anchor_y;
+    if (offset != 0){
+        adj = gtk_scrolled_window_get_vadjustment(self->scrolled_window);
+        gtk_adjustment_set_value(adj, gtk_adjustment_get_value(adj) + offset);
+        self->prepend_anchor_y = alloc.y;
+    }
+}
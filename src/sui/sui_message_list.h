@@ -33,6 +33,10 @@ GType sui_message_list_get_type(void);
 SuiMessageList *sui_message_list_new(void);
 
 void sui_message_list_add_message(SuiMessageList *self, SuiMessage *msg, GtkAlign halign);
+void sui_message_list_append_message(SuiMessageList *self, SuiMessage *msg, GtkAlign halign);
+void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg, GtkAlign halign);
+void sui_message_list_remove_first_message(SuiMessageList *self);
+bool sui_message_list_is_at_bottom(SuiMessageList *self);
 GList *sui_message_list_get_recent_messages(SuiMessageList *self, int limit);
 void sui_message_list_clear_message(SuiMessageList *self);
 
@@ -36,6 +36,7 @@
 static void sui_recv_message_update(SuiMessage *msg);
 static void sui_recv_message_compose_prev(SuiMessage *_self, SuiMessage *_prev);
 static void sui_recv_message_compose_next(SuiMessage *_self, SuiMessage *_next);
+static void sui_recv_message_decompose_prev(SuiMessage *_self);
 
 static void sender_event_box_on_button_press(GtkWidget *widget,
         GdkEventButton *event, gpointer user_data);
@@ -81,11 +82,12 @@ static void sui_recv_message_class_init(SuiRecvMessageClass *class){
     message_class->update = sui_recv_message_update;
     message_class->compose_prev = sui_recv_message_compose_prev;
     message_class->compose_next = sui_recv_message_compose_next;
+    message_class->decompose_prev = sui_recv_message_decompose_prev;
 }
 
 static void sui_recv_message_update(SuiMessage *_self){
-    const char *time;
-    const char *full_time;
+    char *time;
+    char *full_time;
     SrnMessage *ctx;
     SuiRecvMessage *self;
 
@@ -98,13 +100,14 @@ static void sui_recv_message_update(SuiMessage *_self){
         gtk_label_set_text(self->remark_label, ctx->rendered_remark);
     }
 
-    time =  sui_message_get_time(_self);
+    time = sui_message_get_time(_self);
     full_time = sui_message_get_full_time(_self);
-    g_return_if_fail(time);
-    g_return_if_fail(full_time);
-
-    gtk_label_set_text(self->time_label, time);
-    gtk_widget_set_tooltip_text(GTK_WIDGET(self->time_label), full_time);
+    if (time && full_time) {
+        gtk_label_set_text(self->time_label, time);
+        gtk_widget_set_tooltip_text(GTK_WIDGET(self->time_label), full_time);
+    }
+    g_free(time);
+    g_free(full_time);
 
     SUI_MESSAGE_CLASS(sui_recv_message_parent_class)->update(_self);
 }
@@ -129,6 +132,16 @@ static void sui_recv_message_compose_next(SuiMessage *_self, SuiMessage *_next){
     SUI_MESSAGE_CLASS(sui_recv_message_parent_class)->compose_next(_self, _next);
 }
 
+static void sui_recv_message_decompose_prev(SuiMessage *_self){
+    SuiRecvMessage *self;
+
+    self = SUI_RECV_MESSAGE(_self);
+
+    gtk_widget_show(GTK_WIDGET(self->sender_box));
+
+    SUI_MESSAGE_CLASS(sui_recv_message_parent_class)->decompose_prev(_self);
+}
+
 /*****************************************************************************
  * Expored functions
  *****************************************************************************/
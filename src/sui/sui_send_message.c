@@ -76,8 +76,8 @@ SuiSendMessage* sui_send_message_new(void *ctx){
 }
 
 static void sui_send_message_update(SuiMessage *_self){
-    const char *time;
-    const char *full_time;
+    char *time;
+    char *full_time;
     SrnMessage *ctx;
     SuiSendMessage *self;
 
@@ -85,13 +85,14 @@ static void sui_send_message_update(SuiMessage *_self){
     g_return_if_fail(ctx);
     self = SUI_SEND_MESSAGE(_self);
 
-    time =  sui_message_get_time(_self);
+    time = sui_message_get_time(_self);
     full_time = sui_message_get_full_time(_self);
-    g_return_if_fail(time);
-    g_return_if_fail(full_time);
-
-    gtk_label_set_text(self->time_label, time);
-    gtk_widget_set_tooltip_text(GTK_WIDGET(self->time_label), full_time);
+    if (time && full_time) {
+        gtk_label_set_text(self->time_label, time);
+        gtk_widget_set_tooltip_text(GTK_WIDGET(self->time_label), full_time);
+    }
+    g_free(time);
+    g_free(full_time);
 
     SUI_MESSAGE_CLASS(sui_send_message_parent_class)->update(_self);
 }
@@ -154,6 +154,10 @@ void sui_side_bar_item_clear_count(SuiSideBarItem *self){
     gtk_style_context_remove_class(ctx, "highlighted");
 }
 
+void sui_side_bar_item_set_icon(SuiSideBarItem *self, const char *icon){
+    gtk_image_set_from_icon_name(self->image, icon, GTK_ICON_SIZE_BUTTON);
+}
+
 unsigned long sui_side_bar_item_get_update_time(SuiSideBarItem *self){
     return self->update_time;
 }
@@ -35,6 +35,7 @@ void sui_side_bar_item_update(SuiSideBarItem *self, const char *nick, const char
 void sui_side_bar_item_highlight(SuiSideBarItem *self);
 void sui_side_bar_item_inc_count(SuiSideBarItem *self);
 void sui_side_bar_item_clear_count(SuiSideBarItem *self);
+void sui_side_bar_item_set_icon(SuiSideBarItem *self, const char *icon);
 
 unsigned long sui_side_bar_item_get_update_time(SuiSideBarItem *self);
 const gchar *sui_side_bar_item_get_title(SuiSideBarItem *self);
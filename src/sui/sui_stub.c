@@ -0,0 +1,359 @@
+/* Copyright (C) 2016-2019 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file sui_stub.c
+ * @brief Headless implementation of sui.h
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.9
+ * @date 2019-05-21
+ *
+ * Selected by meson option ``-Dsui_backend=stub``. Nothing is displayed,
+ * buffers and messages are plain structures which only hold what core passes
+ * to them, so the core can be built and run without GTK, for example on a CI
+ * box. It is also linked by benchmarks and srain-replay.
+ */
+
+#include <glib.h>
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <glib-unix.h>
+#endif
+
+#include "sui/sui.h"
+
+#include "srain.h"
+#include "i18n.h"
+#include "log.h"
+#include "meta.h"
+
+struct _SuiApplication {
+    void *ctx;
+    SuiApplicationEvents *events;
+    SuiApplicationConfig *cfg;
+    SuiApplicationOptions *opts;
+    GMainLoop *loop;
+};
+
+struct _SuiWindow {
+    SuiApplication *app;
+    SuiWindowEvents *events;
+};
+
+struct _SuiBuffer {
+    void *ctx;
+    SuiBufferEvents *events;
+    SuiBufferConfig *cfg;
+    GPtrArray *msgs; // Array of SuiMessage
+};
+
+struct _SuiMessage {
+    void *ctx;
+};
+
+struct _SuiUser {
+    void *ctx;
+};
+
+static SuiApplication *app_instance = NULL;
+
+#ifdef G_OS_UNIX
+static gboolean on_quit_signal(gpointer user_data);
+#endif
+
+void sui_proc_pending_event(void){
+    while (g_main_context_pending(NULL)) g_main_context_iteration(NULL, FALSE);
+}
+
+SuiApplication* sui_new_application(const char *id, void *ctx,
+        SuiApplicationEvents *events, SuiApplicationConfig *cfg){
+    if (app_instance == NULL) {
+        app_instance = g_malloc0(sizeof(SuiApplication));
+        app_instance->ctx = ctx;
+        app_instance->events = events;
+        app_instance->cfg = cfg;
+        app_instance->opts = sui_application_options_new();
+        app_instance->loop = g_main_loop_new(NULL, FALSE);
+    }
+
+    return app_instance;
+}
+
+void sui_free_application(SuiApplication *app){
+    g_return_if_fail(app);
+
+    if (app_instance == app) {
+        app_instance = NULL;
+    }
+    sui_application_options_free(app->opts);
+    g_main_loop_unref(app->loop);
+    g_free(app);
+}
+
+void sui_run_application(SuiApplication *app, int argc, char *argv[]){
+    bool version;
+    bool no_auto;
+    char **urls;
+    GError *err;
+    GOptionContext *opt_ctx;
+    SrnRet ret;
+    GOptionEntry entries[] = {
+        { "version", 'v', 0, G_OPTION_ARG_NONE, &version,
+            N_("Show version information"), NULL },
+        { "no-auto", 'a', 0, G_OPTION_ARG_NONE, &no_auto,
+            N_("Don't auto connect to servers"), NULL },
+        { G_OPTION_REMAINING, '\0', 0, G_OPTION_ARG_STRING_ARRAY, &urls,
+            N_("Open one or more IRC URLs"), N_("[URL…]") },
+        { NULL },
+    };
+
+    g_return_if_fail(app);
+
+    version = FALSE;
+    no_auto = FALSE;
+    urls = NULL;
+    err = NULL;
+    opt_ctx = g_option_context_new(NULL);
+    g_option_context_add_main_entries(opt_ctx, entries, GETTEXT_PACKAGE);
+    if (!g_option_context_parse(opt_ctx, &argc, &argv, &err)){
+        g_printerr("%s\n", err->message);
+        g_error_free(err);
+        g_option_context_free(opt_ctx);
+        return;
+    }
+    g_option_context_free(opt_ctx);
+
+    if (version){
+        g_print("%s %s-%s\n", PACKAGE_NAME, PACKAGE_VERSION, PACKAGE_BUILD);
+        g_strfreev(urls);
+        return;
+    }
+    app->opts->no_auto_connect = no_auto;
+
+    ret = app->events->activate(app, SUI_EVENT_ACTIVATE, NULL);
+    if (!RET_IS_OK(ret)){
+        sui_message_box(_("Error"), RET_MSG(ret));
+    }
+
+    if (urls){
+        GVariantDict *params;
+
+        params = g_variant_dict_new(NULL);
+        g_variant_dict_insert(params, "urls", SUI_EVENT_PARAM_STRINGS,
+                urls, g_strv_length(urls));
+        ret = app->events->open(app, SUI_EVENT_OPEN, params);
+        if (!RET_IS_OK(ret)){
+            sui_message_box(_("Error"), RET_MSG(ret));
+        }
+        g_variant_dict_unref(params);
+        g_strfreev(urls);
+    }
+
+#ifdef G_OS_UNIX
+    g_unix_signal_add(SIGINT, on_quit_signal, app);
+    g_unix_signal_add(SIGTERM, on_quit_signal, app);
+#endif
+
+    g_main_loop_run(app->loop);
+
+    app->events->shutdown(app, SUI_EVENT_SHUTDOWN, NULL);
+}
+
+void* sui_application_get_ctx(SuiApplication *app){
+    g_return_val_if_fail(app, NULL);
+
+    return app->ctx;
+}
+
+void sui_application_set_config(SuiApplication *app, SuiApplicationConfig *cfg){
+    g_return_if_fail(app);
+
+    app->cfg = cfg;
+}
+
+SuiApplicationConfig* sui_application_get_config(SuiApplication *app){
+    g_return_val_if_fail(app, NULL);
+
+    return app->cfg;
+}
+
+SuiApplicationOptions* sui_application_get_options(SuiApplication *app){
+    g_return_val_if_fail(app, NULL);
+
+    return app->opts;
+}
+
+SuiWindow* sui_new_window(SuiApplication *app, SuiWindowEvents *events){
+    SuiWindow *win;
+
+    win = g_malloc0(sizeof(SuiWindow));
+    win->app = app;
+    win->events = events;
+
+    return win;
+}
+
+void sui_free_window(SuiWindow *win){
+    g_free(win);
+}
+
+SuiBuffer* sui_new_buffer(void *ctx, SuiBufferEvents *events, SuiBufferConfig *cfg){
+    SuiBuffer *buf;
+
+    buf = g_malloc0(sizeof(SuiBuffer));
+    buf->ctx = ctx;
+    buf->events = events;
+    buf->cfg = cfg;
+    buf->msgs = g_ptr_array_new_with_free_func(g_free);
+
+    return buf;
+}
+
+void sui_free_buffer(SuiBuffer *buf){
+    g_return_if_fail(buf);
+
+    g_ptr_array_free(buf->msgs, TRUE);
+    g_free(buf);
+}
+
+void sui_activate_buffer(SuiBuffer *buf){
+}
+
+void* sui_buffer_get_ctx(SuiBuffer *buf){
+    g_return_val_if_fail(buf, NULL);
+
+    return buf->ctx;
+}
+
+void sui_buffer_set_config(SuiBuffer *buf, SuiBufferConfig *cfg){
+    g_return_if_fail(buf);
+
+    buf->cfg = cfg;
+}
+
+void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg){
+    g_return_if_fail(buf);
+    g_return_if_fail(msg);
+
+    g_ptr_array_add(buf->msgs, msg);
+}
+
+void sui_buffer_prepend_message(SuiBuffer *buf, SuiMessage *msg){
+    g_return_if_fail(buf);
+    g_return_if_fail(msg);
+
+    g_ptr_array_insert(buf->msgs, 0, msg);
+}
+
+void sui_buffer_remove_first_message(SuiBuffer *buf){
+    g_return_if_fail(buf);
+    g_return_if_fail(buf->msgs->len);
+
+    g_ptr_array_remove_index(buf->msgs, 0);
+}
+
+bool sui_buffer_is_at_bottom(SuiBuffer *buf){
+    g_return_val_if_fail(buf, FALSE);
+
+    return TRUE;
+}
+
+void sui_buffer_clear_message(SuiBuffer *buf){
+    g_return_if_fail(buf);
+
+    g_ptr_array_set_size(buf->msgs, 0);
+}
+
+SuiMessage *sui_new_misc_message(void *ctx, SuiMiscMessageStyle style){
+    SuiMessage *msg;
+
+    msg = g_malloc0(sizeof(SuiMessage));
+    msg->ctx = ctx;
+
+    return msg;
+}
+
+SuiMessage *sui_new_send_message(void *ctx){
+    return sui_new_misc_message(ctx, SUI_MISC_MESSAGE_STYLE_NONE);
+}
+
+SuiMessage *sui_new_recv_message(void *ctx){
+    return sui_new_misc_message(ctx, SUI_MISC_MESSAGE_STYLE_NONE);
+}
+
+void sui_update_message(SuiMessage *msg){
+}
+
+void sui_notify_message(SuiMessage *msg){
+}
+
+SuiUser* sui_new_user(void *ctx){
+    SuiUser *user;
+
+    user = g_malloc0(sizeof(SuiUser));
+    user->ctx = ctx;
+
+    return user;
+}
+
+void sui_free_user(SuiUser *user){
+    g_free(user);
+}
+
+void sui_add_user(SuiBuffer *buf, SuiUser *user){
+}
+
+void sui_rm_user(SuiBuffer *buf, SuiUser *user){
+}
+
+void sui_update_user(SuiBuffer *buf, SuiUser *user){
+}
+
+void sui_set_topic(SuiBuffer *buf, const char *topic){
+}
+
+void sui_set_topic_setter(SuiBuffer *buf, const char *setter){
+}
+
+void sui_set_presence(SuiBuffer *buf, bool online, bool away){
+}
+
+void sui_message_box(const char *title, const char *msg){
+    g_printerr("%s: %s\n", title, msg);
+}
+
+void sui_chan_list_start(SuiBuffer *buf){
+}
+
+void sui_chan_list_add(SuiBuffer *buf, const char *chan, int users,
+        const char *topic){
+}
+
+void sui_chan_list_end(SuiBuffer *buf){
+}
+
+#ifdef G_OS_UNIX
+static gboolean on_quit_signal(gpointer user_data){
+    SuiApplication *app;
+
+    app = user_data;
+    g_main_loop_quit(app->loop);
+
+    return G_SOURCE_REMOVE;
+}
+#endif
@@ -30,10 +30,13 @@
 
 #include "sui_user.h"
 
+#include "i18n.h"
+
 #define COL_NAME    0
 #define COL_ICON    1
 #define COL_USER    2
 #define COL_TYPE    3
+#define COL_TOOLTIP 4
 
 /**
  * @brief SuiUser is a iterator of SuiUserList.
@@ -49,7 +52,8 @@ struct _SuiUser {
 };
 
 static cairo_surface_t* new_user_icon_from_type(SrnChatUserType type,
-        GtkStyleContext *style_context, GdkWindow *window);
+        bool away, GtkStyleContext *style_context, GdkWindow *window);
+static char* new_user_tooltip(SrnServerUser *srv_user);
 
 /*****************************************************************************
  * Expored functions
@@ -97,6 +101,8 @@ int sui_user_compare(SuiUser *user1, SuiUser *user2){
 
 void sui_user_update(SuiUser *self, GtkStyleContext *style_context,
         GdkWindow *window){
+    char *tooltip;
+
     g_return_if_fail(self->list);
     g_return_if_fail(self->stat);
     g_return_if_fail(self->ctx);
@@ -135,16 +141,19 @@ void sui_user_update(SuiUser *self, GtkStyleContext *style_context,
         }
     }
     self->type = self->ctx->type;
+    tooltip = new_user_tooltip(self->ctx->srv_user);
     gtk_list_store_set(self->list, (GtkTreeIter *)self,
             COL_NAME, self->ctx->srv_user->nick,
             COL_USER, self->ctx,
             COL_TYPE, self->ctx->type,
+            COL_TOOLTIP, tooltip,
             -1);
+    g_free(tooltip);
 
     // Update icon only when GdkWindow available
     if (window) {
         cairo_surface_t *icon = new_user_icon_from_type(self->ctx->type,
-                style_context, window);
+                self->ctx->srv_user->is_away, style_context, window);
         gtk_list_store_set(self->list, (GtkTreeIter *)self, COL_ICON, icon, -1);
         cairo_surface_destroy(icon);
     }
@@ -175,8 +184,9 @@ const char* sui_user_get_nickname(SuiUser *self){
  *****************************************************************************/
 
 static cairo_surface_t* new_user_icon_from_type(SrnChatUserType type,
-        GtkStyleContext *style_context, GdkWindow *window){
+        bool away, GtkStyleContext *style_context, GdkWindow *window){
     const char *color_str;
+    const char *icon_name;
     GError *err;
     GdkRGBA fg_color;
     GdkPixbuf *pixbuf;
@@ -206,16 +216,17 @@ static cairo_surface_t* new_user_icon_from_type(SrnChatUserType type,
         ERR_FR("Failed to parser color str %s", color_str);
     }
 
+    icon_name = away ? "user-away" : "user-available";
     icon_info = gtk_icon_theme_lookup_icon_for_scale(
             gtk_icon_theme_get_default(),
-            "user-available",
+            icon_name,
             16,
             gdk_window_get_scale_factor(window),
             GTK_ICON_LOOKUP_FORCE_SYMBOLIC);
     if (!icon_info) {
         icon_info = gtk_icon_theme_lookup_icon_for_scale(
                 gtk_icon_theme_get_default(),
-                "user-available",
+                icon_name,
                 16,
                 gdk_window_get_scale_factor(window),
                 0);
@@ -243,3 +254,41 @@ static cairo_surface_t* new_user_icon_from_type(SrnChatUserType type,
     g_object_unref(pixbuf);
     return surface;
 }
+
+/**
+ * @brief new_user_tooltip returns markup of what we know about the user,
+ * such as "nick!user@host", realname, account and away state.
+ */
+static char* new_user_tooltip(SrnServerUser *srv_user){
+    char *markup;
+    GString *tooltip;
+
+    tooltip = g_string_new(NULL);
+    if (srv_user->username && srv_user->hostname){
+        markup = g_markup_printf_escaped("<b>%s</b>!%s@%s",
+                srv_user->nick, srv_user->username, srv_user->hostname);
+    } else {
+        markup = g_markup_printf_escaped("<b>%s</b>", srv_user->nick);
+    }
+    g_string_append(tooltip, markup);
+    g_free(markup);
+
+    if (srv_user->realname){
+        markup = g_markup_printf_escaped("\n%s", srv_user->realname);
+        g_string_append(tooltip, markup);
+        g_free(markup);
+    }
+    if (srv_user->loginname){
+        markup = g_markup_printf_escaped(_("Logged in as %1$s"),
+                srv_user->loginname);
+        g_string_append_c(tooltip, '\n');
+        g_string_append(tooltip, markup);
+        g_free(markup);
+    }
+    if (srv_user->is_away){
+        g_string_append_c(tooltip, '\n');
+        g_string_append(tooltip, _("Away"));
+    }
+
+    return g_string_free(tooltip, FALSE);
+}
@@ -183,16 +183,18 @@ static void user_tree_view_set_model(SuiUserList *self){
     GtkTreeModel *filter;
     GtkTreeView *view;
 
-    /* 4 columns: user, icon, model, type */
-    self->user_list_store = gtk_list_store_new(4,
+    /* 5 columns: user, icon, model, type, tooltip */
+    self->user_list_store = gtk_list_store_new(5,
             G_TYPE_STRING,
             CAIRO_GOBJECT_TYPE_SURFACE,
             G_TYPE_POINTER,
-            G_TYPE_INT);
+            G_TYPE_INT,
+            G_TYPE_STRING);
     gtk_tree_view_column_add_attribute(self->user_tree_view_column,
             GTK_CELL_RENDERER(self->user_name_cell_renderer), "text", 0);
     gtk_tree_view_column_add_attribute(self->user_tree_view_column,
             GTK_CELL_RENDERER(self->user_icon_cell_renderer), "surface", 1);
+    gtk_tree_view_set_tooltip_column(self->user_tree_view, 4);
 
     store = self->user_list_store;
     view = self->user_tree_view;
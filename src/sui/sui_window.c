@@ -33,6 +33,7 @@
 #include "meta.h"
 #include "log.h"
 #include "i18n.h"
+#include "trace.h"
 
 #include "sui_common.h"
 #include "sui_event_hdr.h"
@@ -118,6 +119,13 @@ static void on_notify_is_active(GObject *object, GParamSpec *pspec,
         gpointer data);
 static gboolean on_delete_event(GtkWidget *widget, GdkEvent *event,
             gpointer user_data);
+#ifdef ENABLE_TRACING
+static void on_realize(GtkWidget *widget, gpointer user_data);
+static void frame_clock_on_before_paint(GdkFrameClock *clock,
+        gpointer user_data);
+static void frame_clock_on_after_paint(GdkFrameClock *clock,
+        gpointer user_data);
+#endif
 
 static void window_stack_on_child_changed(GtkWidget *widget, GParamSpec *pspec,
         gpointer user_data);
@@ -236,6 +244,10 @@ static void sui_window_init(SuiWindow *self){
             G_CALLBACK(on_notify_is_active), NULL);
     g_signal_connect(self, "delete-event",
             G_CALLBACK(on_delete_event), NULL);
+#ifdef ENABLE_TRACING
+    g_signal_connect(self, "realize",
+            G_CALLBACK(on_realize), NULL);
+#endif
 
     // Click to show/hide GtkPopover
     g_signal_connect(self->connect_button, "clicked",
@@ -631,6 +643,37 @@ static void set_server_visibility(SuiWindow* self){
     }
 }
 
+#ifdef ENABLE_TRACING
+static guint64 frame_paint_start;
+
+static void on_realize(GtkWidget *widget, gpointer user_data){
+    GdkFrameClock *clock;
+
+    // Frame clock is only available after the window is realized
+    clock = gtk_widget_get_frame_clock(widget);
+    g_return_if_fail(clock);
+
+    g_signal_connect(clock, "before-paint",
+            G_CALLBACK(frame_clock_on_before_paint), NULL);
+    g_signal_connect(clock, "after-paint",
+            G_CALLBACK(frame_clock_on_after_paint), NULL);
+}
+
+static void frame_clock_on_before_paint(GdkFrameClock *clock,
+        gpointer user_data){
+    frame_paint_start = srn_trace_now();
+}
+
+static void frame_clock_on_after_paint(GdkFrameClock *clock,
+        gpointer user_data){
+    if (!frame_paint_start){
+        return;
+    }
+    srn_trace_record("sui_window_paint", frame_paint_start, srn_trace_now());
+    frame_paint_start = 0;
+}
+#endif
+
 static void on_destroy(SuiWindow *self){
     // Nothing to do for now
 }